@@ -97,6 +97,7 @@
 	#include <sys/stat.h>
 	#include <utime.h>
 	#include <unistd.h>
+	#include <sys/uio.h>
 #endif
 
 #include "echidna/listapi.h"
@@ -245,6 +246,11 @@ extern "C" {
 #define EIO_INCPATH_LIBS		"libs"
 #define EIO_INCPATH_INIS		"inis"
 
+/*
+ * Most buffers one EIO_AsyncReadV() or EIO_AsyncWriteV() can take
+ */
+#define EIO_ASYNC_MAXIOV	8
+
 
 /***************************** T Y P E D E F S ****************************/
 
@@ -426,6 +432,32 @@ typedef FileDateType FileCommentType;
 #error Need Stuff
 #endif
 
+/*
+ * One buffer of a vectored read or write
+ */
+#if _EL_OS_IRIX53__
+typedef struct iovec EIO_IOVEC;
+#else
+typedef struct {
+	void	*iov_base;
+	size_t	 iov_len;
+} EIO_IOVEC;
+#endif
+
+/*
+ * A queue of reads and writes that run while the caller gets on with
+ * something else.  See EIO_AsyncCreate().
+ */
+typedef struct EIO_ASYNC EIO_ASYNC;
+
+/*
+ * What EIO_AsyncComplete() says about a finished read or write
+ */
+typedef struct {
+	void	*pUserData;	// as passed to EIO_AsyncRead() etc
+	long	 result;	// bytes read or written, -1 on error
+} EIO_ASYNCDONE;
+
 /******************************* M A C R O S ******************************/
 
 #if (_EL_OS_WIN32__ || _EL_OS_MSDOS__)
@@ -451,7 +483,7 @@ typedef FileDateType FileCommentType;
 #define EIO_Read(fh,buf,size)	read((fh),(buf),(size))
 #define EIO_Write(fh,buf,size)	write((fh),(buf),(size))
 #define EIO_Seek(fh,off,org)	lseek((fh),(off),(org))
-#define EIO_Tell(fh)			tell(fh)
+#define EIO_Tell(fh)			lseek((fh),0L,SEEK_CUR)
 
 #else
 #error Need EIO_Open,EIO_Close...
@@ -534,6 +566,29 @@ extern int			 EIO_FindInclude (char* fixedfilespec, const char *groupName, const
 
 #endif
 
+#if _EL_OS_IRIX53__
+
+	#define EIO_ReadV(fh,iov,count)		readv((fh),(iov),(count))
+	#define EIO_WriteV(fh,iov,count)	writev((fh),(iov),(count))
+
+#else
+
+	extern long		 EIO_ReadV (int fh, const EIO_IOVEC *iov, int count);
+	extern long		 EIO_WriteV (int fh, const EIO_IOVEC *iov, int count);
+
+#endif
+
+extern EIO_ASYNC	*EIO_AsyncCreate (int depth);
+extern void			 EIO_AsyncDestroy (EIO_ASYNC *aio);
+extern int			 EIO_AsyncRead (EIO_ASYNC *aio, int fh, void *buf, long size, long offset, void *pUserData);
+extern int			 EIO_AsyncWrite (EIO_ASYNC *aio, int fh, const void *buf, long size, long offset, void *pUserData);
+extern int			 EIO_AsyncReadV (EIO_ASYNC *aio, int fh, const EIO_IOVEC *iov, int count, long offset, void *pUserData);
+extern int			 EIO_AsyncWriteV (EIO_ASYNC *aio, int fh, const EIO_IOVEC *iov, int count, long offset, void *pUserData);
+extern int			 EIO_AsyncSubmit (EIO_ASYNC *aio);
+extern int			 EIO_AsyncComplete (EIO_ASYNC *aio, EIO_ASYNCDONE *pDone);
+extern int			 EIO_AsyncPending (EIO_ASYNC *aio);
+extern long			 EIO_CopyData (int outfh, int infh, long size);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,90 @@
+/*************************************************************************
+ *                                                                       *
+ *                                 ELZ.H                                 *
+ *                                                                       *
+ *************************************************************************
+
+		Copyright (c) 1996-2008, Echidna
+
+		All rights reserved.
+
+		Redistribution and use in source and binary forms, with or
+		without modification, are permitted provided that the following
+		conditions are met:
+
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer. 
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer
+		  in the documentation and/or other materials provided with the
+		  distribution. 
+
+		THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+		CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+		INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+		MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+		DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+		BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+		EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+		TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+		DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+		ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+		OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+		OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+		POSSIBILITY OF SUCH DAMAGE.
+
+
+   DESCRIPTION
+		A small, fast LZ77 block compressor for data that has to be
+		decompressed quickly, like the row bands of a GFF RGBZ chunk.
+		Each block stands alone so blocks can be decompressed in any
+		order and on any thread.
+
+   PROGRAMMERS
+
+
+   FUNCTIONS
+
+   TABS : 5 9
+
+   HISTORY
+		10/17/26 : Created.
+
+ *************************************************************************/
+
+#ifndef EL_ELZ_H
+#define EL_ELZ_H
+/**************************** I N C L U D E S ****************************/
+
+#include "platform.h"
+#include "switches.h"
+#include "echidna/ensure.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*************************** C O N S T A N T S ***************************/
+
+
+/******************************* T Y P E S *******************************/
+
+
+/***************************** G L O B A L S *****************************/
+
+
+/****************************** M A C R O S ******************************/
+
+// most bytes ELZ_Compress can make from srcLen bytes
+#define ELZ_COMPRESS_BOUND(srcLen)	((srcLen) + (srcLen) / 255 + 16)
+
+/************************** P R O T O T Y P E S **************************/
+
+extern long ELZ_Compress (const void *src, long srcLen, void *dst, long dstMax);
+extern int  ELZ_Decompress (const void *src, long srcLen, void *dst, long dstLen);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* EL_ELZ_H */
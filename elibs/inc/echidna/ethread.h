@@ -0,0 +1,111 @@
+/*************************************************************************
+ *                                                                       *
+ *                               ETHREAD.H                               *
+ *                                                                       *
+ *************************************************************************
+
+		Copyright (c) 1996-2008, Echidna
+
+		All rights reserved.
+
+		Redistribution and use in source and binary forms, with or
+		without modification, are permitted provided that the following
+		conditions are met:
+
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer. 
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer
+		  in the documentation and/or other materials provided with the
+		  distribution. 
+
+		THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+		CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+		INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+		MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+		DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+		BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+		EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+		TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+		DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+		ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+		OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+		OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+		POSSIBILITY OF SUCH DAMAGE.
+
+
+   DESCRIPTION
+		Minimal portable threads.  A pool of worker threads that runs
+		a batch of numbered jobs and waits for them all to finish, and
+		single tasks that run in the background until they're waited
+		for, on a thread of their own or queued for a pool's threads,
+		and locks for the little bits of state they share.
+
+   PROGRAMMERS
+
+
+   FUNCTIONS
+
+   TABS : 5 9
+
+   HISTORY
+		10/17/26 : Created.
+
+ *************************************************************************/
+
+#ifndef EL_ETHREAD_H
+#define EL_ETHREAD_H
+/**************************** I N C L U D E S ****************************/
+
+#include "platform.h"
+#include "switches.h"
+#include "echidna/ensure.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*************************** C O N S T A N T S ***************************/
+
+
+/******************************* T Y P E S *******************************/
+
+typedef struct ETHREAD_POOL ETHREAD_POOL;
+typedef struct ETHREAD_TASK ETHREAD_TASK;
+typedef struct ETHREAD_LOCK ETHREAD_LOCK;
+
+/*
+ * one job of a batch.  job goes from 0 to numJobs - 1 in no particular
+ * order and on any thread.
+ */
+typedef void (*PFNETHREADJOB) (void *pUserData, int job);
+
+/***************************** G L O B A L S *****************************/
+
+
+/****************************** M A C R O S ******************************/
+
+
+/************************** P R O T O T Y P E S **************************/
+
+extern int ETHREAD_NumCPUs (void);
+extern ETHREAD_POOL *ETHREAD_CreatePool (int numThreads);
+extern void ETHREAD_DestroyPool (ETHREAD_POOL *pool);
+extern ETHREAD_POOL *ETHREAD_DefaultPool (void);
+extern int ETHREAD_PoolThreads (ETHREAD_POOL *pool);
+extern void ETHREAD_ParallelFor (ETHREAD_POOL *pool, int numJobs, PFNETHREADJOB pfnJob, void *pUserData);
+extern ETHREAD_TASK *ETHREAD_StartTask (PFNETHREADJOB pfnJob, void *pUserData, int job);
+extern ETHREAD_TASK *ETHREAD_StartPoolTask (ETHREAD_POOL *pool, PFNETHREADJOB pfnJob, void *pUserData, int job);
+extern void ETHREAD_FinishTask (ETHREAD_TASK *task);
+extern ETHREAD_LOCK *ETHREAD_CreateLock (void);
+extern void ETHREAD_DestroyLock (ETHREAD_LOCK *lock);
+extern void ETHREAD_Lock (ETHREAD_LOCK *lock);
+extern void ETHREAD_Unlock (ETHREAD_LOCK *lock);
+extern void ETHREAD_LockGlobals (void);
+extern void ETHREAD_UnlockGlobals (void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* EL_ETHREAD_H */
@@ -58,7 +58,9 @@
        endian or all little endian).  There is a field in the first chunk 
        which indicates which order is used in the file.  The first chunk is 
        always the GGFF chunk.  Thereafter chunks may follow in any order.  
-       GFF uses no compression on the pixel data.  
+       Pixel data is either plain (RGBA) or compressed in row bands (RGBZ).
+       ReadGFF and loadGFF32Bit hand back RGBZ as RGBA so programs in the
+       pipeline never see the difference.
    
        GGFF Chunk:
            Always the first chunk.  Basic image information.
@@ -82,6 +84,24 @@
            4        Size     
            Size     Data        Pixel Data. One byte per color component and alpha channel
                                 in this order: Red, Green, Blue, Alpha. Pixels stored row major.
+
+       RGBZ Chunk:
+           Compressed RGBA chunk.  Used instead of RGBA, never with it.
+           The image is cut into bands of BandRows rows (the last may be
+           shorter), each compressed on its own with ELZ so bands can be
+           decoded in parallel or one at a time.
+   
+           Length   Name        Value Description    Comment
+           ------   --------    -----------          ------------------------------
+           4        ID          'R','G','B','Z'      
+           4        Size     
+           4        BandRows    Rows per band
+           4        NumBands    (h + BandRows - 1) / BandRows
+           4*NumBands BandSize  Bytes of each band.  If the top bit
+                                (GFF_RGBZ_STORED) is set the band is
+                                stored as plain RGBA, not compressed.
+           ...      Bands       The bands one after the other.  Each
+                                decodes to rows * w * 4 RGBA bytes.
        PCON Chunk:
            Palette constraints chunk.  Contains information on palette 
            constraints to be maintained in the final output of the pipeline.  
@@ -180,8 +200,18 @@ extern "C" {
 #define IDPCN2 IDOF4CHARS('P','C', 'N', '2')    // pcon + alpha
 #define IDPNDX IDOF4CHARS('P','N', 'D', 'X')
 #define IDINVP IDOF4CHARS('I','N', 'V', 'P')
+#define IDRGBZ IDOF4CHARS('R','G', 'B', 'Z')    // compressed rgba
 
 #define GFF_BYTE_ORDER  0x1234ABCD
+#define GFF_BYTE_ORDER_SWAPPED  0xCDAB3412   // file from a machine of the other endian
+#define GFF_RGBZ_STORED 0x80000000  // RGBZ band is not compressed
+
+/* WriteGFFEx flags */
+#define GFFWRITE_SWAP   0x0001      // write the other endian from this machine
+#define GFFWRITE_COMPRESS 0x0002    // write RGBA chunks as RGBZ
+
+/* ReadGFFEx flags */
+#define GFFREAD_LAZY    0x0001      // read chunk data when first asked for
 
 /******************************* T Y P E S *******************************/
 typedef UINT32 IDTYPE;
@@ -261,7 +291,9 @@ typedef struct {
 
 typedef struct {
    LST_NODE    node;
-   CHUNKGENERIC *pchunk;
+   CHUNKGENERIC *pchunk;      // NULL until read for a lazy GFF
+   CHUNKHEADER Header;        // Copy of the chunk's header, valid even if pchunk is NULL
+   long        Offset;        // Where the chunk's data is in the file
 } CHUNKNODE;
 
 typedef struct {
@@ -274,6 +306,10 @@ typedef struct {
       CHUNKPCON *pchunkpcon;    // Pointer to PCON Chunk if present.
       CHUNKPCN2 *pchunkpcn2;    // Pointer to PCN2 Chunk if present.
       CHUNKINVP *pchunkinvp;    // Pointer to PCON Chunk if present.
+
+      // Lazy GFFs only
+      int   fh;                 // File chunks are read from, 0 if none.
+      BOOL  fSwap;              // File is the other endian.
 } GFF;
 
 
@@ -286,6 +322,8 @@ typedef struct {
 /************************** P R O T O T Y P E S **************************/
 
 extern GFF        *ReadGFF (char *pszFilename);
+extern GFF        *ReadGFFEx (const char *pszFilename, int flags);
+extern CHUNKGENERIC *LoadGFFChunkNode (GFF *pgff, CHUNKNODE *pchunknode);
 extern void       FreeGFF (GFF *pgff);
 extern GFF        *CreateGFF (void);
 extern GFF        *CreateGFFNoFail (void);
@@ -293,8 +331,12 @@ extern CHUNKNODE  *CreateGFFChunkNode(IDTYPE id, UINT32 DataSize);
 extern CHUNKNODE  *CreateGFFChunkNodeNoFail(IDTYPE id, UINT32 DataSize);
 extern void       DestroyGFFChunkNode (CHUNKNODE *pchunknode);
 extern int        WriteGFF (const char *pszFilename, GFF *pgff);
+extern int        WriteGFFEx (const char *pszFilename, GFF *pgff, int flags);
 extern int        loadGFF32Bit (BlockO32BitPixels *pbop, MEMFILE *mf);
 extern int        saveGFF32Bit (int fh, BlockO32BitPixels *pbop); 
+extern int        saveGFF32BitEx (int fh, BlockO32BitPixels *pbop, int fCompress);
+extern int        loadGFFInfo (PictureInfo *pInfo, MEMFILE *mf);
+extern int        streamGFF32Bit (MEMFILE *mf, long bandRows, PFNPICTUREROWS pfnRows, void *pUserData);
 extern CHUNKNODE  *PChunkNodeOfId (GFF *pgff, IDTYPE id);
 
 #ifdef __cplusplus
@@ -64,6 +64,8 @@ extern "C" {
 
 /*************************** C O N S T A N T S ***************************/
 
+// files at least this big are mapped instead of read by MEMFILE_Open
+#define MEMFILE_MAP_THRESHOLD   (4L * 1024L * 1024L)
 
 /******************************* T Y P E S *******************************/
 
@@ -73,6 +75,8 @@ typedef struct MEMFILE
     uint8   *curPtr;
     long     size;
     long     bytesLeft;
+    int      mapped;        // TRUE if buffer came from MEMFILE_Map
+    void    *mapHandle;     // OS mapping object (Win32 only)
 }
 MEMFILE;
 
@@ -89,6 +93,9 @@ MEMFILE;
 
 extern void MEMFILE_Init(MEMFILE* mf, void* buf, long len);
 extern MEMFILE *MEMFILE_Load (const char* filename);
+extern MEMFILE *MEMFILE_Map (const char* filename);
+extern void MEMFILE_Unmap (MEMFILE *mf);
+extern MEMFILE *MEMFILE_Open (const char* filename);
 extern void MEMFILE_Close (MEMFILE *mf);
 extern int MEMFILE_Read(MEMFILE *mf, void *buf, long len);
 extern int MEMFILE_Seek (MEMFILE *mf, long pos, int type);
@@ -0,0 +1,111 @@
+/*************************************************************************
+ *                                                                       *
+ *                               PIXCONV.H                               *
+ *                                                                       *
+ *************************************************************************
+
+		Copyright (c) 1996-2008, Echidna
+
+		All rights reserved.
+
+		Redistribution and use in source and binary forms, with or
+		without modification, are permitted provided that the following
+		conditions are met:
+
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer. 
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer
+		  in the documentation and/or other materials provided with the
+		  distribution. 
+
+		THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+		CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+		INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+		MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+		DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+		BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+		EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+		TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+		DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+		ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+		OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+		OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+		POSSIBILITY OF SUCH DAMAGE.
+
+
+   DESCRIPTION
+		Pixel conversion kernels used by the picture readers.  Each
+		kernel has a plain C version and, where the CPU has them, SSE2,
+		SSSE3, AVX2 or NEON versions picked at run time.
+
+   PROGRAMMERS
+
+
+   FUNCTIONS
+
+   TABS : 5 9
+
+   HISTORY
+		10/17/26 : Created.
+
+ *************************************************************************/
+
+#ifndef EL_PIXCONV_H
+#define EL_PIXCONV_H
+/**************************** I N C L U D E S ****************************/
+
+#include "platform.h"
+#include "switches.h"
+#include "echidna/ensure.h"
+
+#include "echidna/readgfx.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*************************** C O N S T A N T S ***************************/
+
+/* PixConv_CPUFeatures flags */
+#define PIXCONV_CPU_SSE2	(1 << 0)
+#define PIXCONV_CPU_SSSE3	(1 << 1)
+#define PIXCONV_CPU_AVX2	(1 << 2)
+#define PIXCONV_CPU_NEON	(1 << 3)
+
+/******************************* T Y P E S *******************************/
+
+
+/***************************** G L O B A L S *****************************/
+
+
+/****************************** M A C R O S ******************************/
+
+
+/************************** P R O T O T Y P E S **************************/
+
+extern int  PixConv_CPUFeatures (void);
+extern void PixConv_SetCPUFeatures (int features);
+
+extern void PixConv_Fill32 (pixel32 *d, pixel32 p, long count);
+extern void PixConv_BGR24 (pixel32 *d, const uint8 *s, long count);
+extern void PixConv_BGRA32 (pixel32 *d, const uint8 *s, long count);
+extern void PixConv_BGR555 (pixel32 *d, const uint8 *s, long count, int fAlpha);
+extern void PixConv_Grey8 (pixel32 *d, const uint8 *s, long count);
+extern void PixConv_Index8 (pixel32 *d, const uint8 *s, long count, const pixel32 *colorMap);
+
+extern void PixConv_ToBGRA32 (uint8 *d, const pixel32 *s, long count);
+
+extern long PixConv_RunLength32 (const pixel32 *p, long count);
+extern long PixConv_FindRepeat32 (const pixel32 *p, long count);
+extern long PixConv_RunLength8 (const uint8 *p, long count);
+extern long PixConv_FindRepeat8 (const uint8 *p, long count);
+
+extern void PixConv_Swap16 (void *p, long count);
+extern void PixConv_Swap32 (void *p, long count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* EL_PIXCONV_H */
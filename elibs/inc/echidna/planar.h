@@ -0,0 +1,141 @@
+/*************************************************************************
+ *                                                                       *
+ *                               PLANAR.H                                *
+ *                                                                       *
+ *************************************************************************
+
+		Copyright (c) 1996-2008, Echidna
+
+		All rights reserved.
+
+		Redistribution and use in source and binary forms, with or
+		without modification, are permitted provided that the following
+		conditions are met:
+
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer
+		  in the documentation and/or other materials provided with the
+		  distribution.
+
+		THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+		CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+		INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+		MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+		DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+		BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+		EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+		TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+		DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+		ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+		OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+		OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+		POSSIBILITY OF SUCH DAMAGE.
+
+
+   DESCRIPTION
+		Pictures stored a plane per component instead of as pixel32s,
+		and the filters the gf tools run over whole pictures (scale,
+		reduce/dither to 5 bits, transparency test) written for them.
+
+   PROGRAMMERS
+
+
+   FUNCTIONS
+
+   TABS : 5 9
+
+   HISTORY
+		10/17/26 : Created.
+
+ *************************************************************************/
+
+#ifndef EL_PLANAR_H
+#define EL_PLANAR_H
+/**************************** I N C L U D E S ****************************/
+
+#include "platform.h"
+#include "switches.h"
+#include "echidna/ensure.h"
+
+#include "echidna/readgfx.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*************************** C O N S T A N T S ***************************/
+
+// PlanarImage plane indices
+#define PLANAR_RED		0
+#define PLANAR_GREEN	1
+#define PLANAR_BLUE		2
+#define PLANAR_ALPHA	3
+
+// rows start on and are padded out to this many bytes
+#define PLANAR_ALIGN	32
+
+// PlanarKey kinds, the same order as the gf tools' TRANSPARENCYKIND
+#define PLANAR_KEY_NONE			0	// nothing is transparent
+#define PLANAR_KEY_ALPHALOW		1	// alpha <= key alpha is transparent
+#define PLANAR_KEY_ALPHAHIGH	2	// alpha >= key alpha is transparent
+#define PLANAR_KEY_RGB			3	// red, green and blue == key is transparent
+
+/******************************* T Y P E S *******************************/
+
+/*
+ * Row y of plane p starts at plane[p] + y * stride.  stride is a
+ * multiple of PLANAR_ALIGN and at least width so the kernels can
+ * read and write whole vectors past the end of a row.  What's in the
+ * padding is undefined.
+ */
+typedef struct PlanarImage
+{
+	long	 width;
+	long	 height;
+	long	 stride;
+	uint8	*plane[4];
+	void	*pMem;			// what to free
+} PlanarImage;
+
+/*
+ * Which pixels count as transparent
+ */
+typedef struct PlanarKey
+{
+	int		kind;			// PLANAR_KEY_???
+	uint8	alpha;
+	uint8	red;
+	uint8	green;
+	uint8	blue;
+} PlanarKey;
+
+/***************************** G L O B A L S *****************************/
+
+
+/****************************** M A C R O S ******************************/
+
+#define PLANAR_ROW(pi,p,y)	((pi)->plane[p] + (y) * (pi)->stride)
+
+/************************** P R O T O T Y P E S **************************/
+
+extern int  Planar_Create (PlanarImage *pi, long width, long height);
+extern void Planar_Destroy (PlanarImage *pi);
+
+extern void Planar_FromPixel32 (PlanarImage *pi, const pixel32 *s);
+extern void Planar_ToPixel32 (pixel32 *d, const PlanarImage *pi);
+extern void Planar_FromRGBA (PlanarImage *pi, const uint8 *s);
+extern void Planar_ToRGBA (uint8 *d, const PlanarImage *pi);
+
+extern void Planar_AlphaTest (PlanarImage *d, const PlanarImage *s, const PlanarKey *pKey);
+extern void Planar_Reduce555 (PlanarImage *d, const PlanarImage *s);
+extern int  Planar_Dither555 (PlanarImage *d, const PlanarImage *s);
+extern void Planar_ScaledSize (long width, long height, long xin, long xout, long yin, long yout, long *pWidth, long *pHeight);
+extern int  Planar_Scale (PlanarImage *d, const PlanarImage *s, long xin, long xout, long yin, long yout, const PlanarKey *pKey);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* EL_PLANAR_H */
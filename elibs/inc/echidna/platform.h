@@ -602,6 +602,55 @@ extern "C" {
 		   #define _EL_INCSYNTAX_C__    1     // e.g. echidna\platform.h
 		   #define _EL_INCSYNTAX_D__    0     // e.g. :echidna:platform.h
 
+	#elif defined(_EL_PLAT_LINUX__)	/* x86 Linux with gcc */
+
+		/* Processor:
+		 *    Set one of the defines below to 1, the rest to 0.
+		 */
+
+		   #define _EL_CPU_iAPx86__   1
+		   #define _EL_CPU_M68000__   0
+		   #define _EL_CPU_ARM60__    0
+		   #define _EL_CPU_PPC602__   0
+		   #define _EL_CPU_r4400__    0
+		   #define _EL_CPU_R3000__    0
+
+		/* Operating System:
+		 *    Set one of the defines below to 1, the rest to 0.
+		 *    The Unix code is under _EL_OS_IRIX53__.
+		 */
+
+
+		   #define _EL_OS_MSDOS__          0
+		   #define _EL_OS_WIN32__          0
+		   #define _EL_OS_AMIGAOS__        0
+		   #define _EL_OS_MACOS__          0
+		   #define _EL_OS_IRIX53__         1
+		   #define _EL_OS_PSXOS__          0
+
+		/* Compiler:
+		 *    Set one of the defines below to 1, the rest to 0.
+		 */
+
+		   #define _EL_CC_TURBOC__      0     // Borland
+		   #define _EL_CC_ARMC__        0     // Arm
+		   #define _EL_CC_WATCOMC__     0     // Watcom
+		   #define _EL_CC_ZTC__         0     // Zortech
+		   #define _EL_CC_MACSC__       0     // Macintosh
+		   #define _EL_CC_DIABC__       0     // Diab
+		   #define _EL_CC_SGIC__        0     // SGI C
+		   #define _EL_CC_VC__          0     // Microsoft VC++
+		   #define _EL_CC_CCPSX__       0     // Psygnosis Psy-Q
+		   #define _EL_CC_GCC__         1     // gcc or clang
+
+		/* Include Syntax:
+		 *    Set one of the defines below to 1, the rest to 0.
+		 */
+		   #define _EL_INCSYNTAX_A__    1     // e.g. echidna/platform.h
+		   #define _EL_INCSYNTAX_B__    0     // e.g. echidna:platform.h
+		   #define _EL_INCSYNTAX_C__    0     // e.g. echidna\platform.h
+		   #define _EL_INCSYNTAX_D__    0     // e.g. :echidna:platform.h
+
    #else
  	   #error It would be best if you choose a platform.
 	#endif
@@ -711,6 +760,25 @@ extern "C" {
 
       #elif _EL_CC_ZTC__
 
+      #elif _EL_CC_GCC__
+
+  		 #define TRUE  1
+   		 #define FALSE 0
+
+		 #define far
+		 #define huge
+         #define FAR32
+         #define HUGE32
+
+         // long is 64 bits on x86-64 so the 32 bit types are ints
+         typedef signed    char     INT8;
+         typedef unsigned  char     UINT8;
+         typedef signed    short    INT16;
+         typedef unsigned  short    UINT16;
+         typedef signed    int      INT32;
+         typedef unsigned  int      UINT32;
+         typedef           int      BOOL;
+
 	  #elif _EL_CC_VC__
 
   		 #define TRUE  1
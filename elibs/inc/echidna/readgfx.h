@@ -68,6 +68,22 @@ extern "C" {
 
 /*************************** C O N S T A N T S ***************************/
 
+/* PictureInfo.format and the formatHint of the *FromMemory readers */
+#define PICFMT_UNKNOWN	0
+#define PICFMT_TGA		1
+#define PICFMT_PSD		2
+#define PICFMT_PIC		3
+#define PICFMT_PCX		4
+#define PICFMT_GFF		5
+
+// rows per callback if Stream32BitPicture is passed 0 for bandRows
+#define PICTURE_STREAM_BAND_ROWS	16
+
+/* Write???PictureEx flags */
+#define PICWRITE_RLE	0x0001		// compress if the format can (tga, gff)
+
+/* Read32BitPictureEx flags */
+#define PICREAD_NATIVE_ORIENTATION	0x0001	// rows in the file's order, see fBottomUp
 
 /******************************* T Y P E S *******************************/
 
@@ -99,12 +115,31 @@ typedef struct
 }
 paletteEntry;
 
+/*
+ * Keeps freed pixel buffers to decode more pictures into.  See
+ * CreatePicturePool.
+ */
+typedef struct PicturePool PicturePool;
+
 typedef struct BlockO32BitPixels
 {
 	long	 width;
 	long	 height;
 	int		 channels;
 	pixel32	*rgba;
+
+	// Where rgba's memory comes from.  Both 0 for malloc.  capacity
+	// without a pool means rgba is the caller's, see
+	// Read32BitPictureInto.
+	long			 capacity;	// pixels rgba has room for
+	PicturePool		*pool;		// rgba goes back here when freed
+
+	// Rows are top first unless fNativeOrientation was set before
+	// loading, then a format that stores them bottom first (tga) is
+	// left that way round, which saves reversing them, and fBottomUp
+	// says so.
+	int				 fNativeOrientation;
+	int				 fBottomUp;
 } BlockO32BitPixels;
 
 typedef struct BlockO8BitPixels
@@ -122,6 +157,33 @@ typedef struct BlockOGrey8BitPixels
 	uint8			*pixels;
 } BlockOGrey8BitPixels;
 
+/*
+ * What ReadPictureInfo can tell you from the header alone.
+ */
+typedef struct PictureInfo
+{
+	long	 width;
+	long	 height;
+	int		 channels;		// channels stored in the file (1 = grey/indexed, 3 = rgb, 4 = rgba)
+	int		 bitsPerPixel;	// bits per pixel as stored in the file
+	int		 hasAlpha;		// TRUE if the file has an alpha channel
+	int		 format;		// PICFMT_???
+} PictureInfo;
+
+/*
+ * Stream32BitPicture calls this with each band of decoded rows, top row
+ * first.  pRows holds numRows * pInfo->width pixels for rows y through
+ * y + numRows - 1 and is only valid until the function returns.
+ * Return FALSE to stop decoding.
+ */
+typedef int (*PFNPICTUREROWS) (void *pUserData, const PictureInfo *pInfo, const pixel32 *pRows, long y, long numRows);
+
+/*
+ * A list of pictures being read ahead in the background.  See
+ * Read32BitPictureBatch.
+ */
+typedef struct PictureBatch PictureBatch;
+
 /***************************** G L O B A L S *****************************/
 
 /****************************** M A C R O S ******************************/
@@ -129,17 +191,38 @@ typedef struct BlockOGrey8BitPixels
 /************************** P R O T O T Y P E S **************************/
 
 extern BlockO32BitPixels *Read32BitPicture (const char* filename);
+extern BlockO32BitPixels *Read32BitPictureEx (const char* filename, int flags);
+extern BlockO32BitPixels *Read32BitPictureFromMemory (const void *pData, long size, int formatHint);
+extern int Read32BitPictureInto (const char* filename, BlockO32BitPixels *pBOP);
+extern BlockO32BitPixels *Read32BitPictureFromPool (const char* filename, PicturePool *pool);
 extern int Write32BitPicture (const char* filename, BlockO32BitPixels *pBOP);
+extern int Write32BitPictureEx (const char* filename, BlockO32BitPixels *pBOP, int flags);
 extern void Free32BitPicture (BlockO32BitPixels *pBOP);
 
+extern PicturePool *CreatePicturePool (long maxBytes);
+extern void DestroyPicturePool (PicturePool *pool);
+
+extern PictureBatch *Read32BitPictureBatch (const char **filenames, int numFiles, int readAhead, long memoryBudget, PicturePool *pool);
+extern int Read32BitPictureBatchNext (PictureBatch *pBatch, BlockO32BitPixels **ppBOP, const char **pFilename);
+extern void Read32BitPictureBatchClose (PictureBatch *pBatch);
+
 extern BlockO8BitPixels *Read8BitPicture (const char* filename);
+extern BlockO8BitPixels *Read8BitPictureFromMemory (const void *pData, long size, int formatHint);
 extern int Write8BitPicture (const char* filename, BlockO8BitPixels *pBOP);
 extern void Free8BitPicture (BlockO8BitPixels *pBOP);
 
 extern BlockOGrey8BitPixels *ReadGrey8BitPicture (const char* filename);
+extern BlockOGrey8BitPixels *ReadGrey8BitPictureFromMemory (const void *pData, long size, int formatHint);
 extern int WriteGrey8BitPicture (const char* filename, BlockOGrey8BitPixels *pBOP);
+extern int WriteGrey8BitPictureEx (const char* filename, BlockOGrey8BitPixels *pBOP, int flags);
 extern void FreeGrey8BitPicture (BlockOGrey8BitPixels *pBOP);
 
+extern int ReadPictureInfo (const char* filename, PictureInfo *pInfo);
+extern void SetPictureCacheDir (const char *dir);
+extern int DetectPictureFormat (const void *pData, long size);
+extern int Stream32BitPicture (const char* filename, long bandRows, PFNPICTUREROWS pfnRows, void *pUserData);
+extern const char *PictureFormatName (int format);
+
 extern int flipBuffer (void *buffer, long rowSize, long rows);
 
 extern UINT8 *ReadRawPalette (const char *filename, int *pNumColors);
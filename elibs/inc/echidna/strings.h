@@ -67,7 +67,7 @@ extern "C" {
 #include <stddef.h>
 
 /******************************* M A C R O S ******************************/
-#if (__TURBOC__ || (__ZTC__ && __MSDOS__) || __MACSC__ || __WATCOMC__ || _EL_PLAT_SGI__)
+#if (__TURBOC__ || (__ZTC__ && __MSDOS__) || __MACSC__ || __WATCOMC__ || _EL_PLAT_SGI__ || _EL_PLAT_LINUX__)
 #define dupstr(val)		strdup (val)
 #endif
 
@@ -162,7 +162,7 @@ extern void		 pStrCopy(const unsigned char *src,unsigned char *dest);
 extern char		*dupstr (const char *s);
 #endif
 
-#if _EL_PLAT_SGI__
+#if _EL_PLAT_SGI__ || _EL_PLAT_LINUX__
 	#define	stricmp		strcasecmp
 	#define	strnicmp	strncasecmp
 #endif
@@ -181,6 +181,11 @@ extern int		 stricmp (const char *s1, const char *s2);
 extern int		 strnicmp (const char *s1, const char *s2, size_t len);
 #endif
 
+#if _EL_CC_GCC__
+extern char		*strupr (char *s);
+extern char		*strlwr (char *s);
+#endif
+
 #if _EL_PLAT_SONY__
 extern int		 stricmp (const char *s1, const char *s2);
 extern int		 strnicmp (const char *s1, const char *s2, size_t len);
@@ -763,7 +763,7 @@ int arganoid (char **outv, int *in_argc, char ***in_argv, ArgSpec *template, int
 					NEXTARG ();
 					break;
 				case TOGGLE_ARG:
-					outv[pos] = (char *)*arg;
+					outv[pos] = (char *)(size_t)*arg;
 					NEXTARG ();
 					break;
 				default:
@@ -55,6 +55,7 @@
 #include "echidna/ensure.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "echidna/memsafe.h"
 #include "echidna/listapi.h"
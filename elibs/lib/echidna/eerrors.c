@@ -79,6 +79,7 @@
 	#include <ErrMgr.h>
 #endif
 #include "echidna/eerrors.h"
+#include "echidna/ethread.h"
 
 /*------------------------------------------------------------------------*/
 /**# MODULE:EERRORS_Globals                                               */
@@ -131,9 +132,11 @@ char	*GlobalErrMsg = GlobalErrMsgBuffer;
 void ClearGlobalError (void)
 {
 
+	ETHREAD_LockGlobals ();
 	GlobalErr             = 0;
 	GlobalErrMsg          = GlobalErrMsgBuffer;
 	GlobalErrMsgBuffer[0] = '\0';
+	ETHREAD_UnlockGlobals ();
 
 } /* ClearGlobalError */
 
@@ -155,7 +158,8 @@ void ClearGlobalError (void)
  *
  * RESULTS
  *		Prints error message and args to GlobalErrMsgBuffer and
- *		sets GlobalErrMsg to point to GlobalErrMsgBuffer.
+ *		sets GlobalErrMsg to point to GlobalErrMsgBuffer.  Decoders
+ *		call this on worker threads so the buffer is locked.
  *
  * BUGS
  *		none.
@@ -171,6 +175,8 @@ void __PrintError (int append, char *fmt, ...)
 	va_list		 ap;	/* points to each unnamed arg in turn */
 	char		*out;
 
+	ETHREAD_LockGlobals ();
+
 	if (append) {
 		out	 = &GlobalErrMsgBuffer[strlen(GlobalErrMsgBuffer)];
 	} else {
@@ -187,6 +193,8 @@ void __PrintError (int append, char *fmt, ...)
 	
 	fflush (stdout);
 
+	ETHREAD_UnlockGlobals ();
+
 } /* PrintError */
 
 /*------------------------------------------------------------------------*/
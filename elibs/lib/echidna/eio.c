@@ -60,6 +60,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <fcntl.h>
+#include <time.h>
 #include "echidna/eio.h"
 #include "echidna/eerrors.h"
 #include "echidna/strings.h"
@@ -118,6 +119,10 @@
 	#include <Time.h>
 #endif
 
+#if _EL_OS_IRIX53__
+	#include <unistd.h>
+#endif
+
 /*------------------------------------------------------------------------*/
 /**# MODULE:EIO_FileExists                                                */
 /*------------------------------------------------------------------------*/
@@ -1206,6 +1211,16 @@ int	 EIO_ChangeDir (char *path)
         result = (_chdir (path) == 0);
     }
 
+    return result;
+#elif _EL_OS_IRIX53__
+
+    int result = TRUE;
+
+    if (path && strlen(path) > 0)
+    {
+        result = (chdir (path) == 0);
+    }
+
     return result;
 #else
     #error Need 'EIO_ChangeDir'
@@ -4464,7 +4479,7 @@ int	 EIO_GetFileAttrib (const char* filename, FileAttribType *fat)
 	}
 
 #else
-#error Need Support for 'EIO_GetFileAttrib
+#error Need Support for 'EIO_GetFileAttrib'
 #endif
 
 } /* EIO_GetFileAttrib */
@@ -4524,7 +4539,7 @@ int	 EIO_SetFileAttrib (const char* filename, FileAttribType *fat)
 	}
 	return TRUE;
 #else
-#error Need Support for 'EIO_SetFileAttrib
+#error Need Support for 'EIO_SetFileAttrib'
 #endif
 
 #elif _EL_OS_AMIGAOS__
@@ -4558,7 +4573,7 @@ int	 EIO_SetFileAttrib (const char* filename, FileAttribType *fat)
 	}
 
 #else
-#error Need Support for 'EIO_SetFileAttrib
+#error Need Support for 'EIO_SetFileAttrib'
 #endif
 
 } /* EIO_SetFileAttrib */
@@ -5469,24 +5484,14 @@ ErrorExit:
  *		EIO_GetFileAttrib, EIO_SetFileAttrib
  *	
 */
-#define CBUF_SIZE	16384
 int	 EIO_CopyFile (const char* from, const char* to)
 {
 #if (_EL_OS_MSDOS__ || _EL_OS_AMIGAOS__ || _EL_OS_IRIX53__ || _EL_OS_WIN32__)
 	{
-		uint8	*buf = NULL;
 		int		 in  = -1;
 		int		 out = -1;
-		long	 bytes;
 		int		 status = FALSE;
 		
-		buf = malloc (CBUF_SIZE);
-		if (!buf) {
-			SetGlobalErr (ERR_OUT_OF_MEMORY);
-			GEprintf ("EIO_CopyFile:OOM copy buffer");
-			goto cfcleanup;
-		}
-	
 		in = EIO_ReadOpen (from);
 		if (in == (-1)) {
 			SetGlobalErr (ERR_GENERIC);
@@ -5501,18 +5506,8 @@ int	 EIO_CopyFile (const char* from, const char* to)
 			goto cfcleanup;
 		}
 	
-		while ((bytes = EIO_Read (in, buf, CBUF_SIZE)) > 0) {
-//			EL_printf ("copying %ld\n", bytes);
-			if (EIO_Write (out, buf, bytes) == (-1)) {
-				SetGlobalErr (ERR_GENERIC);
-				GEprintf1 ("EIO_CopyFile:Error Writing to file '%s'", to);
-				goto cfcleanup;
-			}
-		}
-	
-		if (bytes < 0) {
-			SetGlobalErr (ERR_GENERIC);
-			GEprintf1 ("EIO_CopyFile:Error Reading from file '%s'", from);
+		if (EIO_CopyData (out, in, EIO_FileLength (in)) < 0) {
+			GEcatf2 ("\nEIO_CopyFile:Couldn't copy '%s' to '%s'", from, to);
 			goto cfcleanup;
 		}
 	
@@ -5559,7 +5554,6 @@ int	 EIO_CopyFile (const char* from, const char* to)
 		status = TRUE;
 	
 	cfcleanup:
-		if (buf) free (buf);
 		if (out != -1) close (out);
 		if (in  != -1) close (in);
 		return status;
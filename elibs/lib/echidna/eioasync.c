@@ -0,0 +1,1381 @@
+/*************************************************************************
+ *                                                                       *
+ *                              EIOASYNC.C                               *
+ *                                                                       *
+ *************************************************************************
+
+		Copyright (c) 1996-2008, Echidna
+
+		All rights reserved.
+
+		Redistribution and use in source and binary forms, with or
+		without modification, are permitted provided that the following
+		conditions are met:
+
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer. 
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer
+		  in the documentation and/or other materials provided with the
+		  distribution. 
+
+		THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+		CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+		INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+		MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+		DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+		BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+		EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+		TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+		DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+		ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+		OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+		OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+		POSSIBILITY OF SUCH DAMAGE.
+
+
+
+   DESCRIPTION
+		Reads and writes that run while the caller does something else.
+		Requests are queued with EIO_AsyncRead() and friends, started
+		together with EIO_AsyncSubmit() and collected one at a time
+		with EIO_AsyncComplete().  On Linux they go to the kernel
+		through io_uring, a whole batch in one system call.  Anywhere
+		else, or if the kernel says no, a batch is run by a few worker
+		threads doing positioned reads and writes, so several requests
+		are still waiting on the disk at once.
+
+		An EIO_ASYNC belongs to one thread.
+
+   PROGRAMMERS
+
+
+   FUNCTIONS
+
+   TABS : 5 9
+
+   HISTORY
+		10/17/26 : Created.
+
+ *************************************************************************/
+
+/**************************** I N C L U D E S ****************************/
+
+#include "platform.h"
+#include "switches.h"
+#include "echidna/ensure.h"
+
+#include "echidna/eio.h"
+#include "echidna/eerrors.h"
+#include "echidna/ethread.h"
+
+#include <string.h>
+#include <errno.h>
+
+#if _EL_PLAT_LINUX__
+	#include <sys/syscall.h>
+	#include <sys/mman.h>
+	#include <linux/io_uring.h>
+#endif
+
+#if _EL_PLAT_LINUX__ && defined(__NR_io_uring_setup)
+	#define EIO_URING	1
+#else
+	#define EIO_URING	0
+#endif
+
+/*************************** C O N S T A N T S ***************************/
+
+// most requests one queue will have going at once
+#define EIO_ASYNC_MAXDEPTH		64
+
+// most worker threads a queue will use when it can't use io_uring
+#define EIO_ASYNC_MAXTHREADS	8
+
+// EIO_CopyData reads this much at a time and keeps this many reads going
+#define EIO_COPY_CHUNK			(256 * 1024)
+#define EIO_COPY_DEPTH			8
+
+/******************************* T Y P E S *******************************/
+
+/*
+ * One queued or running request
+ */
+typedef struct
+{
+	int			 fh;
+	int			 fWrite;
+	long		 offset;
+	long		 size;		// all of iov
+	int			 count;
+	EIO_IOVEC	 iov[EIO_ASYNC_MAXIOV];
+	void		*pUserData;
+	long		 result;
+	int			 fInRing;	// the kernel has it, not handed back yet
+} EIO_AREQ;
+
+/*
+ * Requests submitted together when there's no io_uring.  They're
+ * handed back in the order they were queued.
+ */
+typedef struct EIO_ABATCH
+{
+	struct EIO_ABATCH	*next;
+	EIO_ASYNC			*aio;
+	ETHREAD_TASK		*task;
+	int					 fFinished;
+	int					 count;
+	int					 nextDone;
+	int					 slots[1];	// really count
+} EIO_ABATCH;
+
+struct EIO_ASYNC
+{
+	int				 depth;
+	EIO_AREQ		*reqs;			// depth of them
+	int				*freeSlots;		// stack of unused reqs
+	int				 numFree;
+	int				*queued;		// reqs waiting for EIO_AsyncSubmit
+	int				 numQueued;
+	int				 numRunning;	// submitted but not completed
+
+	// no io_uring
+	ETHREAD_POOL	*pool;
+	EIO_ABATCH		*batches;		// oldest first
+	EIO_ABATCH		*lastBatch;
+
+	#if EIO_URING
+		int						 ringFd;	// -1 if not using it
+		int						 numInRing;	// reqs with fInRing set
+		void					*sqRing;
+		size_t					 sqRingSize;
+		void					*cqRing;
+		size_t					 cqRingSize;
+		struct io_uring_sqe		*sqes;
+		size_t					 sqesSize;
+		unsigned				*sqTail;
+		unsigned				*sqMask;
+		unsigned				*sqArray;
+		unsigned				*cqHead;
+		unsigned				*cqTail;
+		unsigned				*cqMask;
+		struct io_uring_cqe		*cqes;
+	#endif
+};
+
+/************************** P R O T O T Y P E S **************************/
+
+static int threadSubmit (EIO_ASYNC *aio);
+
+/***************************** G L O B A L S *****************************/
+
+
+/****************************** M A C R O S ******************************/
+
+#if EIO_URING
+	// the rings are shared with the kernel
+	#define RING_LOAD(p)		__atomic_load_n ((p), __ATOMIC_ACQUIRE)
+	#define RING_STORE(p,v)		__atomic_store_n ((p), (v), __ATOMIC_RELEASE)
+#endif
+
+/**************************** R O U T I N E S ****************************/
+
+/*********************************************************************
+ *
+ * posIO
+ *
+ * SYNOPSIS
+ *		static long posIO (int fh, int fWrite, const EIO_IOVEC *iov, int count, long offset)
+ *
+ * PURPOSE
+ *		Read or write iov at offset without using or moving the file
+ *		position, so several threads can do it to one file at once.
+ *		Keeps going after a short transfer.
+ *
+ * RETURN VALUE
+ *		Bytes read or written, less than asked for only at the end of
+ *		the file.  -1 on error.
+ *
+*/
+static long posIO (int fh, int fWrite, const EIO_IOVEC *iov, int count, long offset)
+{
+	long	total = 0;
+	int		i;
+
+	for (i = 0; i < count; i++)
+	{
+		uint8	*p    = (uint8 *)iov[i].iov_base;
+		long	 left = (long)iov[i].iov_len;
+
+		while (left > 0)
+		{
+			long	len;
+
+			#if _EL_OS_IRIX53__
+				len = fWrite ? (long)pwrite (fh, p, left, offset) : (long)pread (fh, p, left, offset);
+				if (len < 0 && errno == EINTR)
+				{
+					continue;
+				}
+			#elif _EL_OS_WIN32__
+			{
+				OVERLAPPED	ov;
+				DWORD		done = 0;
+				BOOL		ok;
+
+				memset (&ov, 0, sizeof (ov));
+				ov.Offset = (DWORD)offset;
+				if (fWrite)
+				{
+					ok = WriteFile ((HANDLE)_get_osfhandle (fh), p, (DWORD)left, &done, &ov);
+				}
+				else
+				{
+					ok = ReadFile ((HANDLE)_get_osfhandle (fh), p, (DWORD)left, &done, &ov);
+					if (!ok && GetLastError () == ERROR_HANDLE_EOF)
+					{
+						ok = TRUE;
+					}
+				}
+				len = ok ? (long)done : -1;
+			}
+			#else
+				// no threads here so nobody else is using the position
+				if (EIO_Seek (fh, offset, EIO_SEEK_BEGINNING) == -1)
+				{
+					return -1;
+				}
+				len = fWrite ? EIO_Write (fh, p, left) : EIO_Read (fh, p, left);
+			#endif
+
+			if (len < 0)
+			{
+				return -1;
+			}
+			if (len == 0)
+			{
+				return total;
+			}
+			p      += len;
+			left   -= len;
+			offset += len;
+			total  += len;
+		}
+	}
+
+	return total;
+}
+// posIO
+
+#if !_EL_OS_IRIX53__
+
+/*********************************************************************
+ *
+ * EIO_ReadV
+ *
+ * SYNOPSIS
+ *		long EIO_ReadV (int fh, const EIO_IOVEC *iov, int count)
+ *
+ * PURPOSE
+ *		Read into count buffers one after the other, like readv.
+ *		Unix has the real thing, see eio.h.
+ *
+ * RETURN VALUE
+ *		Bytes read or -1 on error.
+ *
+*/
+long EIO_ReadV (int fh, const EIO_IOVEC *iov, int count)
+{
+	long	total = 0;
+	int		i;
+
+	for (i = 0; i < count; i++)
+	{
+		long	len = EIO_Read (fh, iov[i].iov_base, (long)iov[i].iov_len);
+
+		if (len < 0)
+		{
+			return -1;
+		}
+		total += len;
+		if (len < (long)iov[i].iov_len)
+		{
+			break;
+		}
+	}
+
+	return total;
+}
+// EIO_ReadV
+
+/*********************************************************************
+ *
+ * EIO_WriteV
+ *
+ * SYNOPSIS
+ *		long EIO_WriteV (int fh, const EIO_IOVEC *iov, int count)
+ *
+ * PURPOSE
+ *		Write count buffers one after the other, like writev.
+ *
+ * RETURN VALUE
+ *		Bytes written or -1 on error.
+ *
+*/
+long EIO_WriteV (int fh, const EIO_IOVEC *iov, int count)
+{
+	long	total = 0;
+	int		i;
+
+	for (i = 0; i < count; i++)
+	{
+		long	len = EIO_Write (fh, iov[i].iov_base, (long)iov[i].iov_len);
+
+		if (len < 0)
+		{
+			return -1;
+		}
+		total += len;
+		if (len < (long)iov[i].iov_len)
+		{
+			break;
+		}
+	}
+
+	return total;
+}
+// EIO_WriteV
+
+#endif /* !_EL_OS_IRIX53__ */
+
+#if EIO_URING
+
+/*********************************************************************
+ *
+ * uringOpen
+ *
+ * SYNOPSIS
+ *		static int uringOpen (EIO_ASYNC *aio)
+ *
+ * PURPOSE
+ *		Make an io_uring with room for aio->depth requests and map its
+ *		rings.  Talks to the kernel directly so there's nothing extra
+ *		to link.
+ *
+ * RETURN VALUE
+ *		FALSE if the kernel doesn't have io_uring or won't let us use
+ *		it, aio->ringFd is -1 and the worker threads get used instead.
+ *
+*/
+static int uringOpen (EIO_ASYNC *aio)
+{
+	struct io_uring_params	p;
+	int						fd;
+	uint8				   *sq;
+	uint8				   *cq;
+
+	memset (&p, 0, sizeof (p));
+	fd = (int)syscall (__NR_io_uring_setup, aio->depth, &p);
+	if (fd < 0)
+	{
+		return FALSE;
+	}
+
+	aio->sqRingSize = p.sq_off.array + p.sq_entries * sizeof (unsigned);
+	aio->cqRingSize = p.cq_off.cqes + p.cq_entries * sizeof (struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP)
+	{
+		if (aio->cqRingSize > aio->sqRingSize)
+		{
+			aio->sqRingSize = aio->cqRingSize;
+		}
+		aio->cqRingSize = 0;
+	}
+	aio->sqesSize = p.sq_entries * sizeof (struct io_uring_sqe);
+
+	aio->sqRing = mmap (NULL, aio->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	if (aio->sqRing == MAP_FAILED)
+	{
+		close (fd);
+		return FALSE;
+	}
+	aio->cqRing = aio->sqRing;
+	if (aio->cqRingSize)
+	{
+		aio->cqRing = mmap (NULL, aio->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+		if (aio->cqRing == MAP_FAILED)
+		{
+			munmap (aio->sqRing, aio->sqRingSize);
+			close (fd);
+			return FALSE;
+		}
+	}
+	aio->sqes = (struct io_uring_sqe *)mmap (NULL, aio->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+	if (aio->sqes == MAP_FAILED)
+	{
+		if (aio->cqRingSize)
+		{
+			munmap (aio->cqRing, aio->cqRingSize);
+		}
+		munmap (aio->sqRing, aio->sqRingSize);
+		close (fd);
+		return FALSE;
+	}
+
+	sq = (uint8 *)aio->sqRing;
+	cq = (uint8 *)aio->cqRing;
+	aio->sqTail  = (unsigned *)(sq + p.sq_off.tail);
+	aio->sqMask  = (unsigned *)(sq + p.sq_off.ring_mask);
+	aio->sqArray = (unsigned *)(sq + p.sq_off.array);
+	aio->cqHead  = (unsigned *)(cq + p.cq_off.head);
+	aio->cqTail  = (unsigned *)(cq + p.cq_off.tail);
+	aio->cqMask  = (unsigned *)(cq + p.cq_off.ring_mask);
+	aio->cqes    = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+	aio->ringFd  = fd;
+
+	return TRUE;
+}
+// uringOpen
+
+/*********************************************************************
+ *
+ * uringClose
+ *
+ * SYNOPSIS
+ *		static void uringClose (EIO_ASYNC *aio)
+ *
+ * PURPOSE
+ *		Unmap the rings and close the io_uring.
+ *
+*/
+static void uringClose (EIO_ASYNC *aio)
+{
+	munmap (aio->sqes, aio->sqesSize);
+	if (aio->cqRingSize)
+	{
+		munmap (aio->cqRing, aio->cqRingSize);
+	}
+	munmap (aio->sqRing, aio->sqRingSize);
+	close (aio->ringFd);
+	aio->ringFd = -1;
+}
+// uringClose
+
+/*********************************************************************
+ *
+ * uringEnter
+ *
+ * SYNOPSIS
+ *		static int uringEnter (EIO_ASYNC *aio, unsigned toSubmit, unsigned minComplete)
+ *
+ * PURPOSE
+ *		Start toSubmit new requests and wait for minComplete to
+ *		finish.
+ *
+ * RETURN VALUE
+ *		How many were started or -1 on error.
+ *
+*/
+static int uringEnter (EIO_ASYNC *aio, unsigned toSubmit, unsigned minComplete)
+{
+	int	ret;
+
+	do
+	{
+		ret = (int)syscall (__NR_io_uring_enter, aio->ringFd, toSubmit, minComplete, minComplete ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+	}
+	while (ret < 0 && errno == EINTR);
+
+	return ret;
+}
+// uringEnter
+
+/*********************************************************************
+ *
+ * uringFail
+ *
+ * SYNOPSIS
+ *		static void uringFail (EIO_ASYNC *aio)
+ *
+ * PURPOSE
+ *		Give up on the io_uring after io_uring_enter fails.  Whatever
+ *		the kernel still has is handed back by uringTakeFailed as
+ *		failed and from now on the worker threads are used.
+ *
+*/
+static void uringFail (EIO_ASYNC *aio)
+{
+	int	i;
+
+	SetGlobalErr (ERR_GENERIC);
+	GEprintf1 ("EIO_Async:io_uring_enter failed (%s)", strerror (errno));
+
+	for (i = 0; i < aio->depth; i++)
+	{
+		if (aio->reqs[i].fInRing)
+		{
+			aio->reqs[i].result = -1;
+		}
+	}
+	uringClose (aio);
+}
+// uringFail
+
+/*********************************************************************
+ *
+ * uringSubmit
+ *
+ * SYNOPSIS
+ *		static int uringSubmit (EIO_ASYNC *aio)
+ *
+ * PURPOSE
+ *		Put every queued request in the submission ring and tell the
+ *		kernel about all of them at once.  The ring has at least depth
+ *		entries and no more than depth requests are ever out so it
+ *		can't fill up.  If the kernel won't take them all the ring is
+ *		given up on and the rest go to the worker threads.
+ *
+ * RETURN VALUE
+ *		FALSE on error (GlobalErr is set).
+ *
+*/
+static int uringSubmit (EIO_ASYNC *aio)
+{
+	unsigned	tail = *aio->sqTail;
+	unsigned	mask = *aio->sqMask;
+	int			started;
+	int			ret;
+	int			i;
+
+	for (i = 0; i < aio->numQueued; i++)
+	{
+		int						 slot = aio->queued[i];
+		EIO_AREQ				*req  = &aio->reqs[slot];
+		unsigned				 ndx  = tail & mask;
+		struct io_uring_sqe		*sqe  = &aio->sqes[ndx];
+
+		memset (sqe, 0, sizeof (*sqe));
+		sqe->opcode    = req->fWrite ? IORING_OP_WRITEV : IORING_OP_READV;
+		sqe->fd        = req->fh;
+		sqe->off       = (unsigned long)req->offset;
+		sqe->addr      = (unsigned long)req->iov;
+		sqe->len       = req->count;
+		sqe->user_data = slot;
+
+		aio->sqArray[ndx] = ndx;
+		tail++;
+	}
+	RING_STORE(aio->sqTail, tail);
+
+	for (started = 0; started < aio->numQueued; started += ret)
+	{
+		ret = uringEnter (aio, aio->numQueued - started, 0);
+		if (ret <= 0)
+		{
+			break;
+		}
+	}
+
+	// the kernel takes them in order so it has the first started
+	for (i = 0; i < started; i++)
+	{
+		aio->reqs[aio->queued[i]].fInRing = TRUE;
+	}
+	aio->numInRing  += started;
+	aio->numRunning += started;
+	aio->numQueued  -= started;
+	memmove (aio->queued, aio->queued + started, aio->numQueued * sizeof (int));
+
+	if (aio->numQueued)
+	{
+		uringFail (aio);
+		return threadSubmit (aio);
+	}
+
+	return TRUE;
+}
+// uringSubmit
+
+/*********************************************************************
+ *
+ * uringTakeFailed
+ *
+ * SYNOPSIS
+ *		static int uringTakeFailed (EIO_ASYNC *aio)
+ *
+ * PURPOSE
+ *		Hand back one of the requests the kernel had when uringFail
+ *		gave up on the ring.  There must be one (aio->numInRing).
+ *
+ * RETURN VALUE
+ *		Its slot, its result is -1.
+ *
+*/
+static int uringTakeFailed (EIO_ASYNC *aio)
+{
+	int	slot;
+
+	for (slot = 0; !aio->reqs[slot].fInRing; slot++)
+	{
+	}
+	aio->reqs[slot].fInRing = FALSE;
+	aio->numInRing--;
+
+	return slot;
+}
+// uringTakeFailed
+
+/*********************************************************************
+ *
+ * uringComplete
+ *
+ * SYNOPSIS
+ *		static int uringComplete (EIO_ASYNC *aio)
+ *
+ * PURPOSE
+ *		Wait for any running request to finish.  If waiting fails the
+ *		ring is given up on with uringFail.
+ *
+ * RETURN VALUE
+ *		Its slot.  If it came up short before the end of the file
+ *		(the kernel can do that) the rest has been done here so the
+ *		caller doesn't have to care.
+ *
+*/
+static int uringComplete (EIO_ASYNC *aio)
+{
+	unsigned				 head;
+	struct io_uring_cqe		*cqe;
+	EIO_AREQ				*req;
+	int						 slot;
+
+	head = *aio->cqHead;
+	while (head == RING_LOAD(aio->cqTail))
+	{
+		if (uringEnter (aio, 0, 1) < 0)
+		{
+			uringFail (aio);
+			return uringTakeFailed (aio);
+		}
+	}
+
+	cqe  = &aio->cqes[head & *aio->cqMask];
+	slot = (int)cqe->user_data;
+	req  = &aio->reqs[slot];
+	req->result = cqe->res < 0 ? -1 : cqe->res;
+	RING_STORE(aio->cqHead, head + 1);
+
+	req->fInRing = FALSE;
+	aio->numInRing--;
+
+	if (req->result > 0 && req->result < req->size)
+	{
+		EIO_IOVEC	 rest[EIO_ASYNC_MAXIOV];
+		long		 skip = req->result;
+		long		 more;
+		int			 i = 0;
+
+		while ((long)req->iov[i].iov_len <= skip)
+		{
+			skip -= (long)req->iov[i].iov_len;
+			i++;
+		}
+		memcpy (rest, &req->iov[i], (req->count - i) * sizeof (EIO_IOVEC));
+		rest[0].iov_base = (uint8 *)rest[0].iov_base + skip;
+		rest[0].iov_len -= skip;
+
+		more = posIO (req->fh, req->fWrite, rest, req->count - i, req->offset + req->result);
+		req->result = more < 0 ? -1 : req->result + more;
+	}
+
+	return slot;
+}
+// uringComplete
+
+#endif /* EIO_URING */
+
+/*********************************************************************
+ *
+ * runRequest
+ *
+ * SYNOPSIS
+ *		static void runRequest (void *pUserData, int job)
+ *
+ * PURPOSE
+ *		ETHREAD_ParallelFor job that does one request of a batch.
+ *
+*/
+static void runRequest (void *pUserData, int job)
+{
+	EIO_ABATCH	*batch = (EIO_ABATCH *)pUserData;
+	EIO_AREQ	*req   = &batch->aio->reqs[batch->slots[job]];
+
+	req->result = posIO (req->fh, req->fWrite, req->iov, req->count, req->offset);
+}
+// runRequest
+
+/*********************************************************************
+ *
+ * runBatch
+ *
+ * SYNOPSIS
+ *		static void runBatch (void *pUserData, int job)
+ *
+ * PURPOSE
+ *		Background task that spreads a batch over the queue's worker
+ *		threads, or does it itself if the queue has none.
+ *
+*/
+static void runBatch (void *pUserData, int job)
+{
+	EIO_ABATCH	*batch = (EIO_ABATCH *)pUserData;
+	int			 i;
+
+	if (batch->aio->pool)
+	{
+		ETHREAD_ParallelFor (batch->aio->pool, batch->count, runRequest, batch);
+	}
+	else
+	{
+		for (i = 0; i < batch->count; i++)
+		{
+			runRequest (batch, i);
+		}
+	}
+}
+// runBatch
+
+/*********************************************************************
+ *
+ * threadSubmit
+ *
+ * SYNOPSIS
+ *		static int threadSubmit (EIO_ASYNC *aio)
+ *
+ * PURPOSE
+ *		Start the queued requests as a batch on the worker threads.
+ *		A queue of depth 1 never has more than one request to run so
+ *		it has no pool, the batch's own thread does it.
+ *
+ * RETURN VALUE
+ *		FALSE if out of memory (GlobalErr is set).
+ *
+*/
+static int threadSubmit (EIO_ASYNC *aio)
+{
+	EIO_ABATCH	*batch;
+
+	if (!aio->pool && aio->depth > 1)
+	{
+		int	numThreads = aio->depth < EIO_ASYNC_MAXTHREADS ? aio->depth : EIO_ASYNC_MAXTHREADS;
+
+		// the thread running the batch does requests too
+		aio->pool = ETHREAD_CreatePool (numThreads - 1);
+	}
+	batch = (EIO_ABATCH *)calloc (1, sizeof (EIO_ABATCH) + (aio->numQueued - 1) * sizeof (int));
+	if ((!aio->pool && aio->depth > 1) || !batch)
+	{
+		free (batch);
+		SetGlobalErr (ERR_OUT_OF_MEMORY);
+		GEprintf ("EIO_AsyncSubmit:Out of memory");
+		return FALSE;
+	}
+
+	batch->aio   = aio;
+	batch->count = aio->numQueued;
+	memcpy (batch->slots, aio->queued, aio->numQueued * sizeof (int));
+
+	if (aio->lastBatch)
+	{
+		aio->lastBatch->next = batch;
+	}
+	else
+	{
+		aio->batches = batch;
+	}
+	aio->lastBatch = batch;
+
+	aio->numRunning += aio->numQueued;
+	aio->numQueued   = 0;
+
+	batch->task = ETHREAD_StartTask (runBatch, batch, 0);
+
+	return TRUE;
+}
+// threadSubmit
+
+/*********************************************************************
+ *
+ * threadComplete
+ *
+ * SYNOPSIS
+ *		static int threadComplete (EIO_ASYNC *aio)
+ *
+ * PURPOSE
+ *		Wait for the oldest batch to finish if it hasn't and hand
+ *		back its next request.
+ *
+ * RETURN VALUE
+ *		The request's slot.
+ *
+*/
+static int threadComplete (EIO_ASYNC *aio)
+{
+	EIO_ABATCH	*batch = aio->batches;
+	int			 slot;
+
+	if (!batch->fFinished)
+	{
+		ETHREAD_FinishTask (batch->task);
+		batch->fFinished = TRUE;
+	}
+
+	slot = batch->slots[batch->nextDone++];
+	if (batch->nextDone == batch->count)
+	{
+		aio->batches = batch->next;
+		if (!aio->batches)
+		{
+			aio->lastBatch = NULL;
+		}
+		free (batch);
+	}
+
+	return slot;
+}
+// threadComplete
+
+/*********************************************************************
+ *
+ * EIO_AsyncCreate
+ *
+ * SYNOPSIS
+ *		EIO_ASYNC *EIO_AsyncCreate (int depth)
+ *
+ * PURPOSE
+ *		Make a queue that can have up to depth reads and writes
+ *		queued or running at once.  For a disk that's slow to answer
+ *		but can answer many requests at the same time, the deeper the
+ *		better up to a point, 8 to 32 is usually plenty.
+ *
+ * RETURN VALUE
+ *		The queue or NULL if out of memory (GlobalErr is set).
+ *
+*/
+EIO_ASYNC *EIO_AsyncCreate (int depth)
+{
+	EIO_ASYNC	*aio;
+	int			 i;
+
+	if (depth < 1)
+	{
+		depth = 1;
+	}
+	if (depth > EIO_ASYNC_MAXDEPTH)
+	{
+		depth = EIO_ASYNC_MAXDEPTH;
+	}
+
+	aio = (EIO_ASYNC *)calloc (1, sizeof (EIO_ASYNC));
+	if (aio)
+	{
+		aio->depth     = depth;
+		aio->reqs      = (EIO_AREQ *)calloc (depth, sizeof (EIO_AREQ));
+		aio->freeSlots = (int *)malloc (depth * sizeof (int));
+		aio->queued    = (int *)malloc (depth * sizeof (int));
+	}
+	if (!aio || !aio->reqs || !aio->freeSlots || !aio->queued)
+	{
+		if (aio)
+		{
+			free (aio->reqs);
+			free (aio->freeSlots);
+			free (aio->queued);
+			free (aio);
+		}
+		SetGlobalErr (ERR_OUT_OF_MEMORY);
+		GEprintf ("EIO_AsyncCreate:Out of memory");
+		return NULL;
+	}
+
+	for (i = 0; i < depth; i++)
+	{
+		aio->freeSlots[i] = depth - 1 - i;
+	}
+	aio->numFree = depth;
+
+	#if EIO_URING
+		aio->ringFd = -1;
+		uringOpen (aio);
+	#endif
+
+	return aio;
+}
+// EIO_AsyncCreate
+
+/*********************************************************************
+ *
+ * EIO_AsyncDestroy
+ *
+ * SYNOPSIS
+ *		void EIO_AsyncDestroy (EIO_ASYNC *aio)
+ *
+ * PURPOSE
+ *		Wait for anything still running, throw away anything still
+ *		queued and free the queue.  NULL is ignored.
+ *
+*/
+void EIO_AsyncDestroy (EIO_ASYNC *aio)
+{
+	EIO_ASYNCDONE	done;
+
+	if (!aio)
+	{
+		return;
+	}
+
+	aio->numQueued = 0;
+	while (EIO_AsyncComplete (aio, &done))
+	{
+	}
+
+	#if EIO_URING
+		if (aio->ringFd >= 0)
+		{
+			uringClose (aio);
+		}
+	#endif
+	if (aio->pool)
+	{
+		ETHREAD_DestroyPool (aio->pool);
+	}
+	free (aio->reqs);
+	free (aio->freeSlots);
+	free (aio->queued);
+	free (aio);
+}
+// EIO_AsyncDestroy
+
+/*********************************************************************
+ *
+ * queueRequest
+ *
+ * SYNOPSIS
+ *		static int queueRequest (EIO_ASYNC *aio, int fh, int fWrite, const EIO_IOVEC *iov, int count, long offset, void *pUserData)
+ *
+ * PURPOSE
+ *		Take a free slot and fill it in for EIO_AsyncReadV and friends.
+ *
+ * RETURN VALUE
+ *		FALSE if there are no free slots or count is out of range.
+ *
+*/
+static int queueRequest (EIO_ASYNC *aio, int fh, int fWrite, const EIO_IOVEC *iov, int count, long offset, void *pUserData)
+{
+	EIO_AREQ	*req;
+	int			 slot;
+	int			 i;
+
+	if (!aio->numFree || count < 1 || count > EIO_ASYNC_MAXIOV)
+	{
+		return FALSE;
+	}
+
+	slot = aio->freeSlots[--aio->numFree];
+	req  = &aio->reqs[slot];
+
+	req->fh        = fh;
+	req->fWrite    = fWrite;
+	req->offset    = offset;
+	req->count     = count;
+	req->pUserData = pUserData;
+	req->result    = 0;
+	req->size      = 0;
+	for (i = 0; i < count; i++)
+	{
+		req->iov[i]  = iov[i];
+		req->size   += (long)iov[i].iov_len;
+	}
+
+	aio->queued[aio->numQueued++] = slot;
+
+	return TRUE;
+}
+// queueRequest
+
+/*********************************************************************
+ *
+ * EIO_AsyncReadV
+ *
+ * SYNOPSIS
+ *		int EIO_AsyncReadV (EIO_ASYNC *aio, int fh, const EIO_IOVEC *iov, int count, long offset, void *pUserData)
+ *
+ * PURPOSE
+ *		Queue a read from offset in fh into count (up to
+ *		EIO_ASYNC_MAXIOV) buffers one after the other.  Nothing
+ *		happens until EIO_AsyncSubmit.  iov is copied but the buffers
+ *		must stay put until EIO_AsyncComplete hands back pUserData.
+ *		The file position isn't used or changed.
+ *
+ * RETURN VALUE
+ *		FALSE if the queue already has depth requests queued or
+ *		running, complete one first.
+ *
+*/
+int EIO_AsyncReadV (EIO_ASYNC *aio, int fh, const EIO_IOVEC *iov, int count, long offset, void *pUserData)
+{
+	return queueRequest (aio, fh, FALSE, iov, count, offset, pUserData);
+}
+// EIO_AsyncReadV
+
+/*********************************************************************
+ *
+ * EIO_AsyncWriteV
+ *
+ * SYNOPSIS
+ *		int EIO_AsyncWriteV (EIO_ASYNC *aio, int fh, const EIO_IOVEC *iov, int count, long offset, void *pUserData)
+ *
+ * PURPOSE
+ *		Queue a write of count buffers to offset in fh.  The same
+ *		rules as EIO_AsyncReadV.
+ *
+*/
+int EIO_AsyncWriteV (EIO_ASYNC *aio, int fh, const EIO_IOVEC *iov, int count, long offset, void *pUserData)
+{
+	return queueRequest (aio, fh, TRUE, iov, count, offset, pUserData);
+}
+// EIO_AsyncWriteV
+
+/*********************************************************************
+ *
+ * EIO_AsyncRead
+ *
+ * SYNOPSIS
+ *		int EIO_AsyncRead (EIO_ASYNC *aio, int fh, void *buf, long size, long offset, void *pUserData)
+ *
+ * PURPOSE
+ *		EIO_AsyncReadV into one buffer.
+ *
+*/
+int EIO_AsyncRead (EIO_ASYNC *aio, int fh, void *buf, long size, long offset, void *pUserData)
+{
+	EIO_IOVEC	iov;
+
+	iov.iov_base = buf;
+	iov.iov_len  = size;
+
+	return queueRequest (aio, fh, FALSE, &iov, 1, offset, pUserData);
+}
+// EIO_AsyncRead
+
+/*********************************************************************
+ *
+ * EIO_AsyncWrite
+ *
+ * SYNOPSIS
+ *		int EIO_AsyncWrite (EIO_ASYNC *aio, int fh, const void *buf, long size, long offset, void *pUserData)
+ *
+ * PURPOSE
+ *		EIO_AsyncWriteV from one buffer.
+ *
+*/
+int EIO_AsyncWrite (EIO_ASYNC *aio, int fh, const void *buf, long size, long offset, void *pUserData)
+{
+	EIO_IOVEC	iov;
+
+	iov.iov_base = (void *)buf;
+	iov.iov_len  = size;
+
+	return queueRequest (aio, fh, TRUE, &iov, 1, offset, pUserData);
+}
+// EIO_AsyncWrite
+
+/*********************************************************************
+ *
+ * EIO_AsyncSubmit
+ *
+ * SYNOPSIS
+ *		int EIO_AsyncSubmit (EIO_ASYNC *aio)
+ *
+ * PURPOSE
+ *		Start everything queued since the last submit.  With io_uring
+ *		that's a single system call however many there are.
+ *
+ * RETURN VALUE
+ *		FALSE on error (GlobalErr is set).
+ *
+*/
+int EIO_AsyncSubmit (EIO_ASYNC *aio)
+{
+	if (!aio->numQueued)
+	{
+		return TRUE;
+	}
+
+	#if EIO_URING
+		if (aio->ringFd >= 0)
+		{
+			return uringSubmit (aio);
+		}
+	#endif
+
+	return threadSubmit (aio);
+}
+// EIO_AsyncSubmit
+
+/*********************************************************************
+ *
+ * EIO_AsyncComplete
+ *
+ * SYNOPSIS
+ *		int EIO_AsyncComplete (EIO_ASYNC *aio, EIO_ASYNCDONE *pDone)
+ *
+ * PURPOSE
+ *		Wait for a request to finish and say how it went.  Submits
+ *		anything still queued first.  Requests may finish in any
+ *		order.  A read only comes up short at the end of the file.
+ *
+ * RETURN VALUE
+ *		FALSE if there's nothing left to wait for.
+ *
+*/
+int EIO_AsyncComplete (EIO_ASYNC *aio, EIO_ASYNCDONE *pDone)
+{
+	int	slot;
+
+	if (aio->numQueued && !EIO_AsyncSubmit (aio))
+	{
+		// they're never going to run
+		while (aio->numQueued)
+		{
+			slot = aio->queued[--aio->numQueued];
+			aio->freeSlots[aio->numFree++] = slot;
+		}
+	}
+
+	if (!aio->numRunning)
+	{
+		return FALSE;
+	}
+
+	#if EIO_URING
+		if (aio->ringFd >= 0)
+		{
+			slot = uringComplete (aio);
+		}
+		else if (aio->numInRing)
+		{
+			slot = uringTakeFailed (aio);
+		}
+		else
+	#endif
+		{
+			slot = threadComplete (aio);
+		}
+
+	aio->numRunning--;
+	aio->freeSlots[aio->numFree++] = slot;
+
+	pDone->pUserData = aio->reqs[slot].pUserData;
+	pDone->result    = aio->reqs[slot].result;
+
+	return TRUE;
+}
+// EIO_AsyncComplete
+
+/*********************************************************************
+ *
+ * EIO_AsyncPending
+ *
+ * SYNOPSIS
+ *		int EIO_AsyncPending (EIO_ASYNC *aio)
+ *
+ * PURPOSE
+ *		How many requests are queued or running.
+ *
+*/
+int EIO_AsyncPending (EIO_ASYNC *aio)
+{
+	return aio->numQueued + aio->numRunning;
+}
+// EIO_AsyncPending
+
+/*********************************************************************
+ *
+ * EIO_CopyData
+ *
+ * SYNOPSIS
+ *		long EIO_CopyData (int outfh, int infh, long size)
+ *
+ * PURPOSE
+ *		Copy size bytes from infh to outfh, each from its current
+ *		position, and leave both positions after what was copied.
+ *		Big copies keep several reads going at once and write
+ *		whatever has arrived in order with one writev.  Writes mostly
+ *		just land in the cache, it's waiting for reads that's slow.
+ *		A size less than 0 copies to the end of infh.
+ *
+ * RETURN VALUE
+ *		Bytes copied, less than size if infh ended first.  -1 on error
+ *		(GlobalErr is set).
+ *
+*/
+long EIO_CopyData (int outfh, int infh, long size)
+{
+	EIO_ASYNC		*aio = NULL;
+	uint8			*buf;
+	long			 start;
+	long			 copied = 0;
+	long			 bufSize;
+	long			 chunkLen[EIO_COPY_DEPTH];
+	int				 fDone[EIO_COPY_DEPTH];
+	long			 nextRead;		// chunk numbers
+	long			 nextWrite;
+	long			 numChunks;
+	int				 fEOF = FALSE;
+	int				 fError = FALSE;
+
+	start = EIO_Seek (infh, 0, EIO_SEEK_CURRENT);
+	if (size < 0)
+	{
+		size = 0x7FFFFFFFL;
+	}
+	else if (size > EIO_COPY_CHUNK && start != -1)
+	{
+		aio = EIO_AsyncCreate (EIO_COPY_DEPTH);
+	}
+	bufSize = aio ? EIO_COPY_CHUNK * EIO_COPY_DEPTH : (size < EIO_COPY_CHUNK ? size : EIO_COPY_CHUNK);
+
+	buf = (uint8 *)malloc (bufSize ? bufSize : 1);
+	if (!buf)
+	{
+		EIO_AsyncDestroy (aio);
+		SetGlobalErr (ERR_OUT_OF_MEMORY);
+		GEprintf ("EIO_CopyData:OOM copy buffer");
+		return -1;
+	}
+
+	if (!aio)
+	{
+		while (copied < size)
+		{
+			long	want = size - copied < bufSize ? size - copied : bufSize;
+			long	len  = EIO_Read (infh, buf, want);
+
+			if (len < 0)
+			{
+				SetGlobalErr (ERR_GENERIC);
+				GEprintf ("EIO_CopyData:Error reading");
+				copied = -1;
+				break;
+			}
+			if (len == 0)
+			{
+				break;
+			}
+			if (EIO_Write (outfh, buf, len) != len)
+			{
+				SetGlobalErr (ERR_GENERIC);
+				GEprintf ("EIO_CopyData:Error writing");
+				copied = -1;
+				break;
+			}
+			copied += len;
+		}
+		free (buf);
+		return copied;
+	}
+
+	// chunk n goes in buf slot n % EIO_COPY_DEPTH
+	numChunks = (size + EIO_COPY_CHUNK - 1) / EIO_COPY_CHUNK;
+	nextRead  = 0;
+	nextWrite = 0;
+	while (nextWrite < numChunks && !fError)
+	{
+		EIO_ASYNCDONE	done;
+		EIO_IOVEC		iov[EIO_COPY_DEPTH];
+		int				numIov = 0;
+		long			total  = 0;
+
+		// keep every free buffer reading
+		while (!fEOF && nextRead < numChunks && nextRead - nextWrite < EIO_COPY_DEPTH)
+		{
+			int		b   = (int)(nextRead % EIO_COPY_DEPTH);
+			long	len = size - nextRead * EIO_COPY_CHUNK;
+
+			if (len > EIO_COPY_CHUNK)
+			{
+				len = EIO_COPY_CHUNK;
+			}
+			chunkLen[b] = len;
+			fDone[b]    = FALSE;
+			EIO_AsyncRead (aio, infh, buf + b * EIO_COPY_CHUNK, len, start + nextRead * EIO_COPY_CHUNK, (void *)(buf + b * EIO_COPY_CHUNK));
+			nextRead++;
+		}
+
+		if (!EIO_AsyncComplete (aio, &done))
+		{
+			break;
+		}
+		{
+			int	b = (int)(((uint8 *)done.pUserData - buf) / EIO_COPY_CHUNK);
+
+			if (done.result < 0)
+			{
+				SetGlobalErr (ERR_GENERIC);
+				GEprintf ("EIO_CopyData:Error reading");
+				fError = TRUE;
+				break;
+			}
+			if (done.result < chunkLen[b])
+			{
+				// the file's shorter than it was, nothing past here
+				chunkLen[b] = done.result;
+				fEOF = TRUE;
+			}
+			fDone[b] = TRUE;
+		}
+
+		// write out everything that's arrived in order
+		while (nextWrite + numIov < nextRead && fDone[(nextWrite + numIov) % EIO_COPY_DEPTH])
+		{
+			int	b = (int)((nextWrite + numIov) % EIO_COPY_DEPTH);
+
+			iov[numIov].iov_base = buf + b * EIO_COPY_CHUNK;
+			iov[numIov].iov_len  = chunkLen[b];
+			total += chunkLen[b];
+			numIov++;
+			if (chunkLen[b] < EIO_COPY_CHUNK && nextWrite + numIov < numChunks)
+			{
+				// short so it's the last
+				numChunks = nextWrite + numIov;
+				break;
+			}
+		}
+		if (numIov)
+		{
+			if (EIO_WriteV (outfh, iov, numIov) != total)
+			{
+				SetGlobalErr (ERR_GENERIC);
+				GEprintf ("EIO_CopyData:Error writing");
+				fError = TRUE;
+				break;
+			}
+			copied    += total;
+			nextWrite += numIov;
+		}
+	}
+
+	// reads past a short chunk have to finish before buf goes away
+	EIO_AsyncDestroy (aio);
+	free (buf);
+
+	if (fError)
+	{
+		return -1;
+	}
+
+	EIO_Seek (infh, start + copied, EIO_SEEK_BEGINNING);
+	return copied;
+}
+// EIO_CopyData
@@ -206,10 +206,22 @@ SOURCE=.\eio.c
 # End Source File
 # Begin Source File
 
+SOURCE=.\eioasync.c
+# End Source File
+# Begin Source File
+
+SOURCE=.\elz.c
+# End Source File
+# Begin Source File
+
 SOURCE=.\ensure.c
 # End Source File
 # Begin Source File
 
+SOURCE=.\ethread.c
+# End Source File
+# Begin Source File
+
 SOURCE=.\exit.c
 # End Source File
 # Begin Source File
@@ -242,6 +254,22 @@ SOURCE=.\photoshp.c
 # End Source File
 # Begin Source File
 
+SOURCE=.\piccache.c
+# End Source File
+# Begin Source File
+
+SOURCE=.\picpool.c
+# End Source File
+# Begin Source File
+
+SOURCE=.\pixconv.c
+# End Source File
+# Begin Source File
+
+SOURCE=.\planar.c
+# End Source File
+# Begin Source File
+
 SOURCE=.\readgff.c
 # End Source File
 # Begin Source File
@@ -0,0 +1,408 @@
+/*************************************************************************
+ *                                                                       *
+ *                                 ELZ.C                                 *
+ *                                                                       *
+ *************************************************************************
+
+		Copyright (c) 1996-2008, Echidna
+
+		All rights reserved.
+
+		Redistribution and use in source and binary forms, with or
+		without modification, are permitted provided that the following
+		conditions are met:
+
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer. 
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer
+		  in the documentation and/or other materials provided with the
+		  distribution. 
+
+		THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+		CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+		INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+		MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+		DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+		BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+		EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+		TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+		DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+		ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+		OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+		OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+		POSSIBILITY OF SUCH DAMAGE.
+
+
+   DESCRIPTION
+		LZ77 block compression in the style of LZ4.  A block is a
+		list of sequences, each a token byte, some literal bytes and a
+		match copied from up to 64K back in the output:
+
+			token		high 4 bits literal count, low 4 bits match
+						length - 4.  15 means more follows.
+			[count]		255s then a last byte < 255 added on to a 15
+			literals
+			offset		2 bytes, least significant first, 1 to 65535
+			[count]		same again for the match length
+
+		The last sequence is just a token and literals and ends the
+		block.  Matches are found with one probe of a hash of the next
+		4 bytes which is fast rather than thorough.
+
+		Compressed data can come from a file so ELZ_Decompress checks
+		every length and offset and never reads or writes outside the
+		buffers it is given.
+
+   PROGRAMMERS
+
+
+   FUNCTIONS
+
+   TABS : 5 9
+
+   HISTORY
+		10/17/26 : Created.
+
+ *************************************************************************/
+
+/**************************** I N C L U D E S ****************************/
+
+#include "platform.h"
+#include "switches.h"
+#include "echidna/ensure.h"
+
+#include <string.h>
+
+#include "echidna/elz.h"
+
+/*************************** C O N S T A N T S ***************************/
+
+#define ELZ_MIN_MATCH		4
+#define ELZ_MAX_OFFSET		65535
+#define ELZ_HASH_BITS		12
+#define ELZ_HASH_SIZE		(1 << ELZ_HASH_BITS)
+#define ELZ_LAST_LITERALS	5		// a block always ends with this many literals
+#define ELZ_MATCH_LIMIT		12		// no match starts this close to the end
+
+/******************************* T Y P E S *******************************/
+
+
+/****************************** M A C R O S ******************************/
+
+#define ELZ_HASH(v)	(((v) * 2654435761U) >> (32 - ELZ_HASH_BITS))
+
+/************************** P R O T O T Y P E S **************************/
+
+
+/***************************** G L O B A L S *****************************/
+
+
+/**************************** R O U T I N E S ****************************/
+
+/*********************************************************************
+ *
+ * read32
+ *
+ * SYNOPSIS
+ *		static unsigned int read32 (const uint8 *p)
+ *
+ * PURPOSE
+ *		4 bytes from anywhere.  Only used to compare bytes so the byte
+ *		order doesn't matter.
+ *
+*/
+static unsigned int read32 (const uint8 *p)
+{
+	unsigned int	v;
+
+	memcpy (&v, p, 4);
+	return v;
+}
+// read32
+
+/*********************************************************************
+ *
+ * putCount
+ *
+ * SYNOPSIS
+ *		static uint8 *putCount (uint8 *op, long count)
+ *
+ * PURPOSE
+ *		Write the part of a literal or match count that didn't fit
+ *		in the token.  count has already had 15 taken off.
+ *
+*/
+static uint8 *putCount (uint8 *op, long count)
+{
+	while (count >= 255)
+	{
+		*op++ = 255;
+		count -= 255;
+	}
+	*op++ = (uint8)count;
+	return op;
+}
+// putCount
+
+/*********************************************************************
+ *
+ * putSequence
+ *
+ * SYNOPSIS
+ *		static uint8 *putSequence (uint8 *op, uint8 *oend, const uint8 *lit, long numLit, long offset, long matchLen)
+ *
+ * PURPOSE
+ *		Write one sequence.  matchLen is 0 for the last one which has
+ *		no offset.
+ *
+ * RETURN VALUE
+ *		The end of what was written or NULL if it wouldn't fit.
+ *
+*/
+static uint8 *putSequence (uint8 *op, uint8 *oend, const uint8 *lit, long numLit, long offset, long matchLen)
+{
+	uint8	*token;
+	long	 ml = matchLen - ELZ_MIN_MATCH;
+
+	// worst case for the token, counts and offset
+	if (oend - op < numLit + numLit / 255 + (matchLen ? matchLen / 255 : 0) + 8)
+	{
+		return NULL;
+	}
+
+	token = op++;
+	if (numLit >= 15)
+	{
+		*token = 15 << 4;
+		op = putCount (op, numLit - 15);
+	}
+	else
+	{
+		*token = (uint8)(numLit << 4);
+	}
+	memcpy (op, lit, numLit);
+	op += numLit;
+
+	if (matchLen)
+	{
+		*op++ = (uint8)offset;
+		*op++ = (uint8)(offset >> 8);
+		if (ml >= 15)
+		{
+			*token |= 15;
+			op = putCount (op, ml - 15);
+		}
+		else
+		{
+			*token |= (uint8)ml;
+		}
+	}
+	return op;
+}
+// putSequence
+
+/*********************************************************************
+ *
+ * ELZ_Compress
+ *
+ * SYNOPSIS
+ *		long ELZ_Compress (const void *src, long srcLen, void *dst, long dstMax)
+ *
+ * PURPOSE
+ *		Compress srcLen bytes into one block.  dst needs to be
+ *		ELZ_COMPRESS_BOUND(srcLen) bytes to be sure it fits.  Safe to
+ *		call from many threads at once.
+ *
+ * RETURN VALUE
+ *		Size of the block, 0 if it didn't fit in dstMax bytes.
+ *
+*/
+long ELZ_Compress (const void *src, long srcLen, void *dst, long dstMax)
+{
+	const uint8	*s      = (const uint8 *)src;
+	uint8		*op     = (uint8 *)dst;
+	uint8		*oend   = op + dstMax;
+	long		 anchor = 0;
+	long		 ip     = 0;
+	long		 limit  = srcLen - ELZ_MATCH_LIMIT;
+	long		 table[ELZ_HASH_SIZE];
+	int			 i;
+
+	for (i = 0; i < ELZ_HASH_SIZE; i++)
+	{
+		table[i] = -1;
+	}
+
+	while (ip < limit)
+	{
+		unsigned int	v   = read32 (s + ip);
+		unsigned int	h   = ELZ_HASH (v);
+		long			ref = table[h];
+
+		table[h] = ip;
+		if (ref < 0 || ip - ref > ELZ_MAX_OFFSET || read32 (s + ref) != v)
+		{
+			// step faster through data that isn't matching
+			ip += 1 + ((ip - anchor) >> 6);
+			continue;
+		}
+
+		// grow the match back over literals then forward
+		while (ip > anchor && ref > 0 && s[ip - 1] == s[ref - 1])
+		{
+			ip--;
+			ref--;
+		}
+		{
+			long	len = ELZ_MIN_MATCH;
+			long	max = srcLen - ELZ_LAST_LITERALS - ip;
+
+			while (len + 4 <= max && read32 (s + ip + len) == read32 (s + ref + len))
+			{
+				len += 4;
+			}
+			while (len < max && s[ip + len] == s[ref + len])
+			{
+				len++;
+			}
+
+			op = putSequence (op, oend, s + anchor, ip - anchor, ip - ref, len);
+			if (!op)
+			{
+				return 0;
+			}
+			ip += len;
+			anchor = ip;
+		}
+
+		if (ip < limit)
+		{
+			table[ELZ_HASH (read32 (s + ip - 2))] = ip - 2;
+		}
+	}
+
+	op = putSequence (op, oend, s + anchor, srcLen - anchor, 0, 0);
+	return op ? op - (uint8 *)dst : 0;
+}
+// ELZ_Compress
+
+/*********************************************************************
+ *
+ * getCount
+ *
+ * SYNOPSIS
+ *		static int getCount (const uint8 **pip, const uint8 *iend, long *pCount)
+ *
+ * PURPOSE
+ *		Add on the bytes of a count that didn't fit in the token.
+ *
+ * RETURN VALUE
+ *		FALSE if the block ends first.
+ *
+*/
+static int getCount (const uint8 **pip, const uint8 *iend, long *pCount)
+{
+	const uint8	*ip = *pip;
+	uint8		 b;
+
+	do
+	{
+		if (ip >= iend)
+		{
+			return FALSE;
+		}
+		b = *ip++;
+		*pCount += b;
+	}
+	while (b == 255);
+
+	*pip = ip;
+	return TRUE;
+}
+// getCount
+
+/*********************************************************************
+ *
+ * ELZ_Decompress
+ *
+ * SYNOPSIS
+ *		int ELZ_Decompress (const void *src, long srcLen, void *dst, long dstLen)
+ *
+ * PURPOSE
+ *		Decompress a block made by ELZ_Compress that should come to
+ *		exactly dstLen bytes.  Safe to call from many threads at once.
+ *
+ * RETURN VALUE
+ *		TRUE if the block was good and was dstLen bytes, FALSE if not.
+ *		dst may be partly written either way.
+ *
+*/
+int ELZ_Decompress (const void *src, long srcLen, void *dst, long dstLen)
+{
+	const uint8	*ip   = (const uint8 *)src;
+	const uint8	*iend = ip + srcLen;
+	uint8		*op   = (uint8 *)dst;
+	uint8		*oend = op + dstLen;
+
+	while (ip < iend)
+	{
+		unsigned int	token  = *ip++;
+		long			numLit = token >> 4;
+		long			len;
+		long			offset;
+		const uint8		*ref;
+
+		if (numLit == 15 && !getCount (&ip, iend, &numLit))
+		{
+			return FALSE;
+		}
+		if (numLit > iend - ip || numLit > oend - op)
+		{
+			return FALSE;
+		}
+		memcpy (op, ip, numLit);
+		op += numLit;
+		ip += numLit;
+
+		if (ip == iend)
+		{
+			break;
+		}
+
+		if (iend - ip < 2)
+		{
+			return FALSE;
+		}
+		offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+		len = token & 15;
+		if (len == 15 && !getCount (&ip, iend, &len))
+		{
+			return FALSE;
+		}
+		len += ELZ_MIN_MATCH;
+		if (offset == 0 || offset > op - (uint8 *)dst || len > oend - op)
+		{
+			return FALSE;
+		}
+
+		ref = op - offset;
+		if (offset >= len)
+		{
+			memcpy (op, ref, len);
+			op += len;
+		}
+		else
+		{
+			// overlapping, a repeating pattern
+			while (len--)
+			{
+				*op++ = *ref++;
+			}
+		}
+	}
+
+	return op == oend;
+}
+// ELZ_Decompress
@@ -101,7 +101,7 @@ BOOL EL_fPrintOnlySpecial;
 
 /**************************** R O U T I N E S ****************************/
 
-#if  _EL_PLAT_SONY__ || _EL_PLAT_SGI__
+#if  _EL_PLAT_SONY__ || _EL_PLAT_SGI__ || _EL_PLAT_LINUX__
 static int _vsnprintf(char *out, unsigned int maxchars, const char *fmt, va_list ap)
 BEGINERRFUNC (_vsnprintf)
 {
@@ -173,7 +173,7 @@ BEGINERRFUNC (_vsnprintf)
                   lval = va_arg(ap, long);
                   sprintf (temp, format, lval);
                } else if (ShOrT) {
-                  hval = va_arg(ap, short);
+                  hval = (unsigned short)va_arg(ap, int);   // shorts are passed as ints
                   sprintf (temp, format, hval);
                } else {
                   ival = va_arg(ap, int);
@@ -371,7 +371,7 @@ BEGINERRFUNC (EL_vprintf)
 		#endif
    #elif _EL_PLAT_SONY__
       printf(szTemp);
-   #elif _EL_PLAT_SGI__
+   #elif _EL_PLAT_SGI__ || _EL_PLAT_LINUX__
       printf(szTemp);
    #else
       #error Need code for this platform
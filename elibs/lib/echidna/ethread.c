@@ -0,0 +1,1023 @@
+/*************************************************************************
+ *                                                                       *
+ *                               ETHREAD.C                               *
+ *                                                                       *
+ *************************************************************************
+
+		Copyright (c) 1996-2008, Echidna
+
+		All rights reserved.
+
+		Redistribution and use in source and binary forms, with or
+		without modification, are permitted provided that the following
+		conditions are met:
+
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer. 
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer
+		  in the documentation and/or other materials provided with the
+		  distribution. 
+
+		THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+		CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+		INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+		MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+		DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+		BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+		EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+		TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+		DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+		ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+		OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+		OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+		POSSIBILITY OF SUCH DAMAGE.
+
+
+   DESCRIPTION
+		A pool of worker threads for splitting work like decoding the
+		bands of an image.  The thread that calls ETHREAD_ParallelFor
+		runs jobs too so a pool of N threads keeps N + 1 CPUs busy.
+
+		Tasks are single jobs run on a thread of their own so the
+		caller can get on with something else, like reading the next
+		picture while this one is used.  Pool tasks are the same but
+		queue for one of a pool's threads, so however many are started
+		no more than the pool's threads run at once.
+
+		Win32 uses native threads, IRIX/Unix uses pthreads, anything
+		else just runs the jobs one after the other.
+
+   PROGRAMMERS
+
+
+   FUNCTIONS
+
+   TABS : 5 9
+
+   HISTORY
+		10/17/26 : Created.
+
+ *************************************************************************/
+
+/**************************** I N C L U D E S ****************************/
+
+#include "platform.h"
+#include "switches.h"
+#include "echidna/ensure.h"
+
+#include "echidna/ethread.h"
+
+#if _EL_OS_WIN32__
+	#define ETHREAD_WIN32	1
+	#define ETHREAD_PTHREAD	0
+#elif _EL_OS_IRIX53__
+	#define ETHREAD_WIN32	0
+	#define ETHREAD_PTHREAD	1
+	#include <pthread.h>
+	#include <unistd.h>
+#else
+	#define ETHREAD_WIN32	0
+	#define ETHREAD_PTHREAD	0
+#endif
+
+/*************************** C O N S T A N T S ***************************/
+
+// most worker threads a pool will make
+#define ETHREAD_MAX_THREADS	64
+
+/******************************* T Y P E S *******************************/
+
+struct ETHREAD_POOL
+{
+	int				 numThreads;
+
+	// the batch being run.  Everything below is protected by lock.
+	PFNETHREADJOB	 pfnJob;
+	void			*pUserData;
+	int				 numJobs;
+	int				 nextJob;
+	int				 jobsDone;
+	unsigned long	 batch;
+	int				 quit;
+	ETHREAD_TASK	*pTaskHead;	// pool tasks waiting for a thread
+	ETHREAD_TASK	*pTaskTail;
+
+	#if ETHREAD_WIN32
+		HANDLE				 threads[ETHREAD_MAX_THREADS];
+		CRITICAL_SECTION	 lock;
+		CRITICAL_SECTION	 runLock;	// one batch at a time
+		HANDLE				 workSem;	// released once per worker per batch
+		HANDLE				 doneEvent;	// set when the last job of a batch finishes
+	#elif ETHREAD_PTHREAD
+		pthread_t			 threads[ETHREAD_MAX_THREADS];
+		pthread_mutex_t		 lock;
+		pthread_mutex_t		 runLock;	// one batch at a time
+		pthread_cond_t		 workCond;
+		pthread_cond_t		 doneCond;
+	#endif
+};
+
+struct ETHREAD_TASK
+{
+	PFNETHREADJOB	 pfnJob;
+	void			*pUserData;
+	int				 job;
+
+	#if ETHREAD_WIN32
+		HANDLE			 thread;
+		HANDLE			 doneEvent;	// pool tasks, set when the job has run
+	#elif ETHREAD_PTHREAD
+		pthread_t		 thread;
+	#endif
+	int				 fThread;	// FALSE if the job already ran on the caller
+
+	// pool tasks only, protected by the pool's lock
+	ETHREAD_POOL	*pool;
+	ETHREAD_TASK	*pNext;
+	int				 fDone;
+};
+
+struct ETHREAD_LOCK
+{
+	#if ETHREAD_WIN32
+		CRITICAL_SECTION	 cs;
+	#elif ETHREAD_PTHREAD
+		pthread_mutex_t		 mutex;
+	#else
+		int					 unused;
+	#endif
+};
+
+/****************************** M A C R O S ******************************/
+
+#if ETHREAD_WIN32
+	#define POOL_LOCK(p)	EnterCriticalSection (&(p)->lock)
+	#define POOL_UNLOCK(p)	LeaveCriticalSection (&(p)->lock)
+#elif ETHREAD_PTHREAD
+	#define POOL_LOCK(p)	pthread_mutex_lock (&(p)->lock)
+	#define POOL_UNLOCK(p)	pthread_mutex_unlock (&(p)->lock)
+#else
+	#define POOL_LOCK(p)
+	#define POOL_UNLOCK(p)
+#endif
+
+/***************************** G L O B A L S *****************************/
+
+static ETHREAD_POOL	*s_pDefaultPool = NULL;
+
+// ETHREAD_LockGlobals' lock, it can't need setting up
+#if ETHREAD_WIN32
+	static volatile LONG	 s_globalsLock = 0;
+#elif ETHREAD_PTHREAD
+	static pthread_mutex_t	 s_globalsLock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+/**************************** R O U T I N E S ****************************/
+
+/*********************************************************************
+ *
+ * ETHREAD_NumCPUs
+ *
+ * SYNOPSIS
+ *		int ETHREAD_NumCPUs (void)
+ *
+ * PURPOSE
+ *		How many CPUs the machine has (at least 1).
+ *
+*/
+int ETHREAD_NumCPUs (void)
+{
+	long	num = 1;
+
+	#if ETHREAD_WIN32
+	{
+		SYSTEM_INFO	si;
+
+		GetSystemInfo (&si);
+		num = (long)si.dwNumberOfProcessors;
+	}
+	#elif ETHREAD_PTHREAD && defined(_SC_NPROCESSORS_ONLN)
+		num = sysconf (_SC_NPROCESSORS_ONLN);
+	#endif
+
+	return num < 1 ? 1 : (int)num;
+}
+// ETHREAD_NumCPUs
+
+/*********************************************************************
+ *
+ * runJobs
+ *
+ * SYNOPSIS
+ *		static void runJobs (ETHREAD_POOL *pool)
+ *
+ * PURPOSE
+ *		Take jobs from the current batch until there are none left.
+ *		Whoever finishes the last job wakes the thread waiting in
+ *		ETHREAD_ParallelFor.  doneCond is shared with ETHREAD_FinishTask
+ *		so it's broadcast, not signalled.
+ *
+*/
+static void runJobs (ETHREAD_POOL *pool)
+{
+	POOL_LOCK(pool);
+	while (pool->nextJob < pool->numJobs)
+	{
+		PFNETHREADJOB	 pfnJob    = pool->pfnJob;
+		void			*pUserData = pool->pUserData;
+		int				 job       = pool->nextJob++;
+
+		POOL_UNLOCK(pool);
+		pfnJob (pUserData, job);
+		POOL_LOCK(pool);
+
+		if (++pool->jobsDone == pool->numJobs)
+		{
+			#if ETHREAD_WIN32
+				SetEvent (pool->doneEvent);
+			#elif ETHREAD_PTHREAD
+				pthread_cond_broadcast (&pool->doneCond);
+			#endif
+		}
+	}
+	POOL_UNLOCK(pool);
+}
+// runJobs
+
+/*********************************************************************
+ *
+ * runPoolTask
+ *
+ * SYNOPSIS
+ *		static void runPoolTask (ETHREAD_POOL *pool, ETHREAD_TASK *task)
+ *
+ * PURPOSE
+ *		Run a pool task taken off the queue and wake whoever is
+ *		waiting for it in ETHREAD_FinishTask.  Called without the lock.
+ *
+*/
+static void runPoolTask (ETHREAD_POOL *pool, ETHREAD_TASK *task)
+{
+	task->pfnJob (task->pUserData, task->job);
+
+	POOL_LOCK(pool);
+	task->fDone = TRUE;
+	#if ETHREAD_WIN32
+		SetEvent (task->doneEvent);
+	#elif ETHREAD_PTHREAD
+		pthread_cond_broadcast (&pool->doneCond);
+	#endif
+	POOL_UNLOCK(pool);
+}
+// runPoolTask
+
+/*********************************************************************
+ *
+ * takePoolTask
+ *
+ * SYNOPSIS
+ *		static ETHREAD_TASK *takePoolTask (ETHREAD_POOL *pool)
+ *
+ * PURPOSE
+ *		Take the oldest waiting pool task off the queue, NULL if there
+ *		isn't one.  Called with the lock held.
+ *
+*/
+static ETHREAD_TASK *takePoolTask (ETHREAD_POOL *pool)
+{
+	ETHREAD_TASK	*task = pool->pTaskHead;
+
+	if (task)
+	{
+		pool->pTaskHead = task->pNext;
+		if (!pool->pTaskHead)
+		{
+			pool->pTaskTail = NULL;
+		}
+	}
+	return task;
+}
+// takePoolTask
+
+#if ETHREAD_WIN32 || ETHREAD_PTHREAD
+
+/*********************************************************************
+ *
+ * workerThread
+ *
+ * SYNOPSIS
+ *		static workerThread (void *pData)
+ *
+ * PURPOSE
+ *		Body of each worker.  Wait for a batch or a pool task, run
+ *		it, repeat until the pool is destroyed.
+ *
+*/
+#if ETHREAD_WIN32
+static DWORD WINAPI workerThread (LPVOID pData)
+{
+	ETHREAD_POOL	*pool = (ETHREAD_POOL *)pData;
+
+	for (;;)
+	{
+		ETHREAD_TASK	*task = NULL;
+		int				 quit;
+
+		// one release per pool task too, whichever worker wakes takes
+		// the task and the other release runs the batch
+		WaitForSingleObject (pool->workSem, INFINITE);
+
+		POOL_LOCK(pool);
+		quit = pool->quit;
+		if (!quit)
+		{
+			task = takePoolTask (pool);
+		}
+		POOL_UNLOCK(pool);
+
+		if (quit)
+		{
+			break;
+		}
+		if (task)
+		{
+			runPoolTask (pool, task);
+		}
+		else
+		{
+			runJobs (pool);
+		}
+	}
+	return 0;
+}
+#else
+static void *workerThread (void *pData)
+{
+	ETHREAD_POOL	*pool = (ETHREAD_POOL *)pData;
+	unsigned long	 seen = 0;
+
+	POOL_LOCK(pool);
+	for (;;)
+	{
+		ETHREAD_TASK	*task;
+
+		while (pool->batch == seen && !pool->pTaskHead && !pool->quit)
+		{
+			pthread_cond_wait (&pool->workCond, &pool->lock);
+		}
+		if (pool->quit)
+		{
+			break;
+		}
+
+		task = takePoolTask (pool);
+		if (task)
+		{
+			POOL_UNLOCK(pool);
+			runPoolTask (pool, task);
+			POOL_LOCK(pool);
+			continue;
+		}
+		seen = pool->batch;
+
+		POOL_UNLOCK(pool);
+		runJobs (pool);
+		POOL_LOCK(pool);
+	}
+	POOL_UNLOCK(pool);
+	return NULL;
+}
+#endif
+// workerThread
+
+#endif /* ETHREAD_WIN32 || ETHREAD_PTHREAD */
+
+/*********************************************************************
+ *
+ * ETHREAD_CreatePool
+ *
+ * SYNOPSIS
+ *		ETHREAD_POOL *ETHREAD_CreatePool (int numThreads)
+ *
+ * PURPOSE
+ *		Make a pool of worker threads.  Pass 0 for one less than the
+ *		number of CPUs (the calling thread is the other one).  A pool
+ *		of 0 threads is fine, jobs just run on the calling thread.
+ *
+ * RETURN VALUE
+ *		The pool or NULL if out of memory.
+ *
+*/
+ETHREAD_POOL *ETHREAD_CreatePool (int numThreads)
+{
+	ETHREAD_POOL	*pool;
+
+	if (numThreads <= 0)
+	{
+		numThreads = ETHREAD_NumCPUs () - 1;
+	}
+	if (numThreads > ETHREAD_MAX_THREADS)
+	{
+		numThreads = ETHREAD_MAX_THREADS;
+	}
+	#if !ETHREAD_WIN32 && !ETHREAD_PTHREAD
+		numThreads = 0;
+	#endif
+
+	pool = (ETHREAD_POOL *)calloc (1, sizeof (ETHREAD_POOL));
+	if (!pool)
+	{
+		return NULL;
+	}
+
+	#if ETHREAD_WIN32
+	{
+		InitializeCriticalSection (&pool->lock);
+		InitializeCriticalSection (&pool->runLock);
+		pool->workSem   = CreateSemaphore (NULL, 0, 0x7FFFFFFF, NULL);
+		pool->doneEvent = CreateEvent (NULL, FALSE, FALSE, NULL);
+
+		for (pool->numThreads = 0; pool->numThreads < numThreads; pool->numThreads++)
+		{
+			DWORD	id;
+			HANDLE	h = CreateThread (NULL, 0, workerThread, pool, 0, &id);
+
+			if (!h)
+			{
+				break;
+			}
+			pool->threads[pool->numThreads] = h;
+		}
+	}
+	#elif ETHREAD_PTHREAD
+	{
+		pthread_mutex_init (&pool->lock, NULL);
+		pthread_mutex_init (&pool->runLock, NULL);
+		pthread_cond_init (&pool->workCond, NULL);
+		pthread_cond_init (&pool->doneCond, NULL);
+
+		for (pool->numThreads = 0; pool->numThreads < numThreads; pool->numThreads++)
+		{
+			if (pthread_create (&pool->threads[pool->numThreads], NULL, workerThread, pool))
+			{
+				break;
+			}
+		}
+	}
+	#endif
+
+	return pool;
+}
+// ETHREAD_CreatePool
+
+/*********************************************************************
+ *
+ * ETHREAD_DestroyPool
+ *
+ * SYNOPSIS
+ *		void ETHREAD_DestroyPool (ETHREAD_POOL *pool)
+ *
+ * PURPOSE
+ *		Stop the worker threads and free the pool.  Must not be called
+ *		while a batch is running or before every pool task started on
+ *		it has been passed to ETHREAD_FinishTask.
+ *
+*/
+void ETHREAD_DestroyPool (ETHREAD_POOL *pool)
+{
+	int	i;
+
+	if (!pool)
+	{
+		return;
+	}
+
+	POOL_LOCK(pool);
+	pool->quit = TRUE;
+	POOL_UNLOCK(pool);
+
+	#if ETHREAD_WIN32
+	{
+		ReleaseSemaphore (pool->workSem, pool->numThreads, NULL);
+		for (i = 0; i < pool->numThreads; i++)
+		{
+			WaitForSingleObject (pool->threads[i], INFINITE);
+			CloseHandle (pool->threads[i]);
+		}
+		CloseHandle (pool->workSem);
+		CloseHandle (pool->doneEvent);
+		DeleteCriticalSection (&pool->runLock);
+		DeleteCriticalSection (&pool->lock);
+	}
+	#elif ETHREAD_PTHREAD
+	{
+		pthread_mutex_lock (&pool->lock);
+		pthread_cond_broadcast (&pool->workCond);
+		pthread_mutex_unlock (&pool->lock);
+		for (i = 0; i < pool->numThreads; i++)
+		{
+			pthread_join (pool->threads[i], NULL);
+		}
+		pthread_cond_destroy (&pool->doneCond);
+		pthread_cond_destroy (&pool->workCond);
+		pthread_mutex_destroy (&pool->runLock);
+		pthread_mutex_destroy (&pool->lock);
+	}
+	#else
+		(void)i;
+	#endif
+
+	if (pool == s_pDefaultPool)
+	{
+		s_pDefaultPool = NULL;
+	}
+
+	free (pool);
+}
+// ETHREAD_DestroyPool
+
+/*********************************************************************
+ *
+ * ETHREAD_DefaultPool
+ *
+ * SYNOPSIS
+ *		ETHREAD_POOL *ETHREAD_DefaultPool (void)
+ *
+ * PURPOSE
+ *		The pool the library uses when it isn't given one.  Made the
+ *		first time it's asked for, with one thread per extra CPU.
+ *		The first call should come from the main thread.
+ *
+*/
+ETHREAD_POOL *ETHREAD_DefaultPool (void)
+{
+	if (!s_pDefaultPool)
+	{
+		s_pDefaultPool = ETHREAD_CreatePool (0);
+	}
+	return s_pDefaultPool;
+}
+// ETHREAD_DefaultPool
+
+/*********************************************************************
+ *
+ * ETHREAD_PoolThreads
+ *
+ * SYNOPSIS
+ *		int ETHREAD_PoolThreads (ETHREAD_POOL *pool)
+ *
+ * PURPOSE
+ *		How many threads will run a batch, including the caller.  Use
+ *		it to decide how many jobs to split work into.  NULL means the
+ *		default pool.
+ *
+*/
+int ETHREAD_PoolThreads (ETHREAD_POOL *pool)
+{
+	if (!pool)
+	{
+		pool = ETHREAD_DefaultPool ();
+	}
+	return pool ? pool->numThreads + 1 : 1;
+}
+// ETHREAD_PoolThreads
+
+/*********************************************************************
+ *
+ * ETHREAD_ParallelFor
+ *
+ * SYNOPSIS
+ *		void ETHREAD_ParallelFor (ETHREAD_POOL *pool, int numJobs, PFNETHREADJOB pfnJob, void *pUserData)
+ *
+ * PURPOSE
+ *		Call pfnJob (pUserData, job) for job 0 to numJobs - 1 spread
+ *		over the pool's threads and this one.  Returns when they have
+ *		all finished.  NULL means the default pool.  Jobs must not call
+ *		ETHREAD_ParallelFor on the same pool.
+ *
+*/
+void ETHREAD_ParallelFor (ETHREAD_POOL *pool, int numJobs, PFNETHREADJOB pfnJob, void *pUserData)
+{
+	int	i;
+
+	if (!pool)
+	{
+		pool = ETHREAD_DefaultPool ();
+	}
+
+	if (!pool || !pool->numThreads || numJobs <= 1)
+	{
+		for (i = 0; i < numJobs; i++)
+		{
+			pfnJob (pUserData, i);
+		}
+		return;
+	}
+
+	#if ETHREAD_WIN32
+		EnterCriticalSection (&pool->runLock);
+	#elif ETHREAD_PTHREAD
+		pthread_mutex_lock (&pool->runLock);
+	#endif
+
+	POOL_LOCK(pool);
+	pool->pfnJob    = pfnJob;
+	pool->pUserData = pUserData;
+	pool->numJobs   = numJobs;
+	pool->nextJob   = 0;
+	pool->jobsDone  = 0;
+	pool->batch++;
+	POOL_UNLOCK(pool);
+
+	#if ETHREAD_WIN32
+		ReleaseSemaphore (pool->workSem, numJobs - 1 < pool->numThreads ? numJobs - 1 : pool->numThreads, NULL);
+	#elif ETHREAD_PTHREAD
+		pthread_mutex_lock (&pool->lock);
+		pthread_cond_broadcast (&pool->workCond);
+		pthread_mutex_unlock (&pool->lock);
+	#endif
+
+	runJobs (pool);
+
+	// exactly one doneEvent/doneCond per batch, from the last job
+	#if ETHREAD_WIN32
+		WaitForSingleObject (pool->doneEvent, INFINITE);
+	#elif ETHREAD_PTHREAD
+		pthread_mutex_lock (&pool->lock);
+		while (pool->jobsDone < pool->numJobs)
+		{
+			pthread_cond_wait (&pool->doneCond, &pool->lock);
+		}
+		pthread_mutex_unlock (&pool->lock);
+	#endif
+
+	#if ETHREAD_WIN32
+		LeaveCriticalSection (&pool->runLock);
+	#elif ETHREAD_PTHREAD
+		pthread_mutex_unlock (&pool->runLock);
+	#endif
+}
+// ETHREAD_ParallelFor
+
+/*********************************************************************
+ *
+ * taskThread
+ *
+ * SYNOPSIS
+ *		static taskThread (void *pData)
+ *
+ * PURPOSE
+ *		Body of the thread of an ETHREAD_TASK.
+ *
+*/
+#if ETHREAD_WIN32
+static DWORD WINAPI taskThread (LPVOID pData)
+{
+	ETHREAD_TASK	*task = (ETHREAD_TASK *)pData;
+
+	task->pfnJob (task->pUserData, task->job);
+	return 0;
+}
+#elif ETHREAD_PTHREAD
+static void *taskThread (void *pData)
+{
+	ETHREAD_TASK	*task = (ETHREAD_TASK *)pData;
+
+	task->pfnJob (task->pUserData, task->job);
+	return NULL;
+}
+#endif
+// taskThread
+
+/*********************************************************************
+ *
+ * ETHREAD_StartTask
+ *
+ * SYNOPSIS
+ *		ETHREAD_TASK *ETHREAD_StartTask (PFNETHREADJOB pfnJob, void *pUserData, int job)
+ *
+ * PURPOSE
+ *		Call pfnJob (pUserData, job) on a thread of its own and return
+ *		without waiting for it.  Every task must be passed to
+ *		ETHREAD_FinishTask.  If a thread can't be made the job is run
+ *		before this returns so the caller never has to care.
+ *
+ * RETURN VALUE
+ *		The task.  NULL if out of memory, the job has still been run.
+ *
+*/
+ETHREAD_TASK *ETHREAD_StartTask (PFNETHREADJOB pfnJob, void *pUserData, int job)
+{
+	ETHREAD_TASK	*task;
+
+	task = (ETHREAD_TASK *)calloc (1, sizeof (ETHREAD_TASK));
+	if (!task)
+	{
+		pfnJob (pUserData, job);
+		return NULL;
+	}
+	task->pfnJob    = pfnJob;
+	task->pUserData = pUserData;
+	task->job       = job;
+
+	#if ETHREAD_WIN32
+	{
+		DWORD	id;
+
+		task->thread  = CreateThread (NULL, 0, taskThread, task, 0, &id);
+		task->fThread = task->thread != NULL;
+	}
+	#elif ETHREAD_PTHREAD
+		task->fThread = !pthread_create (&task->thread, NULL, taskThread, task);
+	#endif
+
+	if (!task->fThread)
+	{
+		pfnJob (pUserData, job);
+	}
+	return task;
+}
+// ETHREAD_StartTask
+
+/*********************************************************************
+ *
+ * ETHREAD_StartPoolTask
+ *
+ * SYNOPSIS
+ *		ETHREAD_TASK *ETHREAD_StartPoolTask (ETHREAD_POOL *pool, PFNETHREADJOB pfnJob, void *pUserData, int job)
+ *
+ * PURPOSE
+ *		Like ETHREAD_StartTask but the job waits for one of the pool's
+ *		threads instead of getting a thread of its own.  Tasks run in
+ *		the order they were started.  NULL means the default pool.
+ *		A pool with no threads runs the job before this returns.
+ *
+ *		A task holds its thread until it's done, so a pool that
+ *		ETHREAD_ParallelFor is also used on runs those batches with
+ *		fewer threads meanwhile.
+ *
+ * RETURN VALUE
+ *		The task.  NULL if out of memory, the job has still been run.
+ *
+*/
+ETHREAD_TASK *ETHREAD_StartPoolTask (ETHREAD_POOL *pool, PFNETHREADJOB pfnJob, void *pUserData, int job)
+{
+	ETHREAD_TASK	*task;
+
+	if (!pool)
+	{
+		pool = ETHREAD_DefaultPool ();
+	}
+
+	task = (ETHREAD_TASK *)calloc (1, sizeof (ETHREAD_TASK));
+	if (!task)
+	{
+		pfnJob (pUserData, job);
+		return NULL;
+	}
+	task->pfnJob    = pfnJob;
+	task->pUserData = pUserData;
+	task->job       = job;
+
+	#if ETHREAD_WIN32
+		if (pool && pool->numThreads)
+		{
+			task->doneEvent = CreateEvent (NULL, TRUE, FALSE, NULL);
+		}
+		if (!task->doneEvent)
+		{
+			pool = NULL;
+		}
+	#endif
+
+	if (!pool || !pool->numThreads)
+	{
+		pfnJob (pUserData, job);
+		return task;
+	}
+	task->pool = pool;
+
+	POOL_LOCK(pool);
+	if (pool->pTaskTail)
+	{
+		pool->pTaskTail->pNext = task;
+	}
+	else
+	{
+		pool->pTaskHead = task;
+	}
+	pool->pTaskTail = task;
+	#if ETHREAD_PTHREAD
+		pthread_cond_signal (&pool->workCond);
+	#endif
+	POOL_UNLOCK(pool);
+
+	#if ETHREAD_WIN32
+		ReleaseSemaphore (pool->workSem, 1, NULL);
+	#endif
+
+	return task;
+}
+// ETHREAD_StartPoolTask
+
+/*********************************************************************
+ *
+ * ETHREAD_FinishTask
+ *
+ * SYNOPSIS
+ *		void ETHREAD_FinishTask (ETHREAD_TASK *task)
+ *
+ * PURPOSE
+ *		Wait for a task's job to finish and free the task.  Whatever
+ *		the job wrote is safe to read once this returns.  Works for
+ *		both kinds of task.  NULL is ignored.
+ *
+*/
+void ETHREAD_FinishTask (ETHREAD_TASK *task)
+{
+	if (!task)
+	{
+		return;
+	}
+
+	#if ETHREAD_WIN32
+		if (task->pool)
+		{
+			WaitForSingleObject (task->doneEvent, INFINITE);
+			CloseHandle (task->doneEvent);
+		}
+		else if (task->fThread)
+		{
+			WaitForSingleObject (task->thread, INFINITE);
+			CloseHandle (task->thread);
+		}
+	#elif ETHREAD_PTHREAD
+		if (task->pool)
+		{
+			pthread_mutex_lock (&task->pool->lock);
+			while (!task->fDone)
+			{
+				pthread_cond_wait (&task->pool->doneCond, &task->pool->lock);
+			}
+			pthread_mutex_unlock (&task->pool->lock);
+		}
+		else if (task->fThread)
+		{
+			pthread_join (task->thread, NULL);
+		}
+	#endif
+
+	free (task);
+}
+// ETHREAD_FinishTask
+
+
+/*********************************************************************
+ *
+ * ETHREAD_CreateLock
+ *
+ * SYNOPSIS
+ *		ETHREAD_LOCK *ETHREAD_CreateLock (void)
+ *
+ * PURPOSE
+ *		Make a lock for state shared by jobs or tasks.  Locks don't
+ *		nest, a thread must not take one it already has.
+ *
+ * RETURN VALUE
+ *		The lock or NULL if out of memory.
+ *
+*/
+ETHREAD_LOCK *ETHREAD_CreateLock (void)
+{
+	ETHREAD_LOCK	*lock;
+
+	lock = (ETHREAD_LOCK *)calloc (1, sizeof (ETHREAD_LOCK));
+	if (lock)
+	{
+		#if ETHREAD_WIN32
+			InitializeCriticalSection (&lock->cs);
+		#elif ETHREAD_PTHREAD
+			pthread_mutex_init (&lock->mutex, NULL);
+		#endif
+	}
+	return lock;
+}
+// ETHREAD_CreateLock
+
+/*********************************************************************
+ *
+ * ETHREAD_DestroyLock
+ *
+ * SYNOPSIS
+ *		void ETHREAD_DestroyLock (ETHREAD_LOCK *lock)
+ *
+ * PURPOSE
+ *		Free a lock.  Nobody may be holding it.  NULL is ignored.
+ *
+*/
+void ETHREAD_DestroyLock (ETHREAD_LOCK *lock)
+{
+	if (!lock)
+	{
+		return;
+	}
+
+	#if ETHREAD_WIN32
+		DeleteCriticalSection (&lock->cs);
+	#elif ETHREAD_PTHREAD
+		pthread_mutex_destroy (&lock->mutex);
+	#endif
+
+	free (lock);
+}
+// ETHREAD_DestroyLock
+
+/*********************************************************************
+ *
+ * ETHREAD_Lock
+ *
+ * SYNOPSIS
+ *		void ETHREAD_Lock (ETHREAD_LOCK *lock)
+ *
+ * PURPOSE
+ *		Take a lock, waiting for whoever has it.
+ *
+*/
+void ETHREAD_Lock (ETHREAD_LOCK *lock)
+{
+	#if ETHREAD_WIN32
+		EnterCriticalSection (&lock->cs);
+	#elif ETHREAD_PTHREAD
+		pthread_mutex_lock (&lock->mutex);
+	#endif
+}
+// ETHREAD_Lock
+
+/*********************************************************************
+ *
+ * ETHREAD_Unlock
+ *
+ * SYNOPSIS
+ *		void ETHREAD_Unlock (ETHREAD_LOCK *lock)
+ *
+ * PURPOSE
+ *		Give back a lock taken with ETHREAD_Lock.
+ *
+*/
+void ETHREAD_Unlock (ETHREAD_LOCK *lock)
+{
+	#if ETHREAD_WIN32
+		LeaveCriticalSection (&lock->cs);
+	#elif ETHREAD_PTHREAD
+		pthread_mutex_unlock (&lock->mutex);
+	#endif
+}
+// ETHREAD_Unlock
+
+/*********************************************************************
+ *
+ * ETHREAD_LockGlobals
+ *
+ * SYNOPSIS
+ *		void ETHREAD_LockGlobals (void)
+ *
+ * PURPOSE
+ *		Take the one lock for old code that keeps its state in globals,
+ *		like the error message buffer.  It needs no setup so it can be
+ *		taken before there are any threads.  Don't nest it.
+ *
+*/
+void ETHREAD_LockGlobals (void)
+{
+	#if ETHREAD_WIN32
+		while (InterlockedCompareExchange (&s_globalsLock, 1, 0))
+		{
+			Sleep (0);
+		}
+	#elif ETHREAD_PTHREAD
+		pthread_mutex_lock (&s_globalsLock);
+	#endif
+}
+// ETHREAD_LockGlobals
+
+/*********************************************************************
+ *
+ * ETHREAD_UnlockGlobals
+ *
+ * SYNOPSIS
+ *		void ETHREAD_UnlockGlobals (void)
+ *
+ * PURPOSE
+ *		Give back the lock taken with ETHREAD_LockGlobals.
+ *
+*/
+void ETHREAD_UnlockGlobals (void)
+{
+	#if ETHREAD_WIN32
+		InterlockedExchange (&s_globalsLock, 0);
+	#elif ETHREAD_PTHREAD
+		pthread_mutex_unlock (&s_globalsLock);
+	#endif
+}
+// ETHREAD_UnlockGlobals
@@ -59,6 +59,7 @@
 
 #include "echidna/listapi.h"
 #include "echidna/hash.h"
+#include "echidna/strings.h"
 
 /**************************** C O N S T A N T S ***************************/
 
@@ -54,11 +54,20 @@
 #include "switches.h"
 #include "echidna/ensure.h"
 
+#include <string.h>
+
 #include "echidna/memfile.h"
 #include "echidna/eio.h"
 
+#if _EL_OS_IRIX53__
+	#include <sys/mman.h>
+#endif
+
 /*************************** C O N S T A N T S ***************************/
 
+// files at least this big are read in MEMFILE_READ_DEPTH pieces at once
+#define MEMFILE_ASYNC_MIN	(1024 * 1024)
+#define MEMFILE_READ_DEPTH	8
 
 /******************************* T Y P E S *******************************/
 
@@ -85,6 +94,66 @@ void MEMFILE_Init(MEMFILE* mf, void* buf, long len)
     mf->bytesLeft = len;
 }
 
+/*********************************************************************
+ *
+ * readWholeFile
+ *
+ * SYNOPSIS
+ *		static int readWholeFile (int fh, uint8 *buf, long len)
+ *
+ * PURPOSE
+ *		Read the first len bytes of fh.  A big file is read as several
+ *		pieces at once so a disk that's slow to answer but can answer
+ *		lots of requests together isn't waited on one at a time.
+ *
+ * RETURN VALUE
+ *		FALSE if it couldn't all be read.
+ *
+*/
+static int readWholeFile (int fh, uint8 *buf, long len)
+{
+    EIO_ASYNC*  aio = NULL;
+    long        got = 0;
+
+    if (len >= MEMFILE_ASYNC_MIN)
+    {
+        aio = EIO_AsyncCreate (MEMFILE_READ_DEPTH);
+    }
+
+    if (aio)
+    {
+        EIO_ASYNCDONE   done;
+        long            piece = (len + MEMFILE_READ_DEPTH - 1) / MEMFILE_READ_DEPTH;
+        long            offset;
+
+        for (offset = 0; offset < len; offset += piece)
+        {
+            EIO_AsyncRead (aio, fh, buf + offset, len - offset < piece ? len - offset : piece, offset, NULL);
+        }
+        while (EIO_AsyncComplete (aio, &done))
+        {
+            got = (got < 0 || done.result < 0) ? -1 : got + done.result;
+        }
+        EIO_AsyncDestroy (aio);
+    }
+    else
+    {
+        while (got < len)
+        {
+            long    bytes = EIO_Read (fh, buf + got, len - got);
+
+            if (bytes <= 0)
+            {
+                break;
+            }
+            got += bytes;
+        }
+    }
+
+    return got == len;
+}
+// readWholeFile
+
 MEMFILE *MEMFILE_Load (const char *filename)
 {
     MEMFILE* mf = NULL;
@@ -102,7 +171,11 @@ MEMFILE *MEMFILE_Load (const char *filename)
             {
                 MEMFILE_Init(mf, ((uint8*)mf)+sizeof (MEMFILE), len);
 
-                EIO_Read (fh, mf->buffer, len);
+                if (!readWholeFile (fh, mf->buffer, len))
+                {
+                    free (mf);
+                    mf = NULL;
+                }
             }
         }
         EIO_Close (fh);
@@ -110,11 +183,174 @@ MEMFILE *MEMFILE_Load (const char *filename)
     return mf;
 }
 
-void MEMFILE_Close (MEMFILE *mf)
+/*********************************************************************
+ *
+ * MEMFILE_Map
+ *
+ * SYNOPSIS
+ *		MEMFILE *MEMFILE_Map (const char *filename)
+ *
+ * PURPOSE
+ *		Like MEMFILE_Load except the file is mapped into memory instead
+ *		of being copied into a malloced buffer.  The mapping is private
+ *		(copy on write) so loaders that poke at mf->buffer still work.
+ *		Falls back to MEMFILE_Load on platforms that can't map files.
+ *
+ * RETURN VALUE
+ *		MEMFILE or NULL on failure.  Free with MEMFILE_Close or
+ *		MEMFILE_Unmap.
+ *
+*/
+MEMFILE *MEMFILE_Map (const char *filename)
+{
+#if _EL_OS_WIN32__ || _EL_OS_IRIX53__
+    MEMFILE* mf = NULL;
+    void*    view = NULL;
+    void*    mapHandle = NULL;
+    int      fh;
+    long     len;
+
+    fh = EIO_ReadOpen(filename);
+    if (fh == (-1))
+    {
+        return NULL;
+    }
+
+    len = EIO_FileLength(fh);
+    if (len > 0)
+    {
+        #if _EL_OS_WIN32__
+        {
+            HANDLE hMap;
+
+            hMap = CreateFileMapping ((HANDLE)_get_osfhandle(fh), NULL, PAGE_WRITECOPY, 0, 0, NULL);
+            if (hMap)
+            {
+                view = MapViewOfFile (hMap, FILE_MAP_COPY, 0, 0, 0);
+                if (view)
+                {
+                    mapHandle = hMap;
+                }
+                else
+                {
+                    CloseHandle (hMap);
+                }
+            }
+        }
+        #else
+        {
+            view = mmap (NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE, fh, 0);
+            if (view == MAP_FAILED)
+            {
+                view = NULL;
+            }
+            else
+            {
+                madvise (view, len, MADV_SEQUENTIAL);
+            }
+        }
+        #endif
+    }
+    EIO_Close (fh);
+
+    if (!view)
+    {
+        // can't map it (pipe, special file, out of address space...)
+        return MEMFILE_Load (filename);
+    }
+
+    mf = (MEMFILE*)malloc (sizeof (MEMFILE));
+    if (!mf)
+    {
+        #if _EL_OS_WIN32__
+            UnmapViewOfFile (view);
+            CloseHandle ((HANDLE)mapHandle);
+        #else
+            munmap (view, len);
+        #endif
+        return NULL;
+    }
+
+    MEMFILE_Init (mf, view, len);
+    mf->mapped    = TRUE;
+    mf->mapHandle = mapHandle;
+
+    return mf;
+#else
+    return MEMFILE_Load (filename);
+#endif
+}
+
+/*********************************************************************
+ *
+ * MEMFILE_Unmap
+ *
+ * SYNOPSIS
+ *		void MEMFILE_Unmap (MEMFILE *mf)
+ *
+ * PURPOSE
+ *		Release a MEMFILE returned by MEMFILE_Map.  Safe to call on a
+ *		loaded MEMFILE as well (MEMFILE_Map may have fallen back to
+ *		MEMFILE_Load).
+ *
+*/
+void MEMFILE_Unmap (MEMFILE *mf)
 {
+    if (mf->mapped)
+    {
+        #if _EL_OS_WIN32__
+            UnmapViewOfFile (mf->buffer);
+            CloseHandle ((HANDLE)mf->mapHandle);
+        #elif _EL_OS_IRIX53__
+            munmap (mf->buffer, mf->size);
+        #endif
+    }
     free (mf);
 }
 
+/*********************************************************************
+ *
+ * MEMFILE_Open
+ *
+ * SYNOPSIS
+ *		MEMFILE *MEMFILE_Open (const char *filename)
+ *
+ * PURPOSE
+ *		Map the file if it's at least MEMFILE_MAP_THRESHOLD bytes,
+ *		otherwise load it.  Small files are cheaper to just read.
+ *
+*/
+MEMFILE *MEMFILE_Open (const char *filename)
+{
+    int     fh;
+    long    len = 0;
+
+    fh = EIO_ReadOpen(filename);
+    if (fh != (-1))
+    {
+        len = EIO_FileLength(fh);
+        EIO_Close (fh);
+    }
+
+    if (len >= MEMFILE_MAP_THRESHOLD)
+    {
+        return MEMFILE_Map (filename);
+    }
+    return MEMFILE_Load (filename);
+}
+
+void MEMFILE_Close (MEMFILE *mf)
+{
+    if (mf->mapped)
+    {
+        MEMFILE_Unmap (mf);
+    }
+    else
+    {
+        free (mf);
+    }
+}
+
 int MEMFILE_Read(MEMFILE *mf, void *buf, long len)
 {
     if (mf->bytesLeft)
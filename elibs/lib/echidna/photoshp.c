@@ -54,10 +54,14 @@
 #include "switches.h"
 #include "echidna/ensure.h"
 
+#include <string.h>
+
 #include "echidna/eerrors.h"
 #include "echidna/readgfx.h"
 #include "echidna/memfile.h"
+#include "echidna/ethread.h"
 #include "photoshp.h"
+#include "picpool.h"
 
 /**************************** C O N S T A N T S ***************************/
 
@@ -77,52 +81,98 @@ typedef struct
 }
 PSHeader;
 
+// where every channel row of the image data starts
+typedef struct
+{
+	const uint8	*buffer;		// the whole file
+	long		 size;
+	long		*rowStart;		// planes * height offsets into buffer
+	long		 width;
+	long		 height;
+	long		 planes;		// 3 or 4, extra channels past alpha are skipped
+	short		 compress;
+}
+PSPlanes;
+
+// one band-parallel decode in loadPhotoshop32Bit
+typedef struct
+{
+	const PSPlanes	*pp;
+	pixel32			*rgba;
+	long			 rowsPerJob;
+	int				 failed;
+}
+PSJob;
+
 /****************************** G L O B A L S *****************************/
 
 
 /******************************* M A C R O S ******************************/
 
+// images smaller than this aren't worth handing to other threads
+#define PS_MIN_PARALLEL_PIXELS	(64 * 1024)
+// jobs per thread so a slow band doesn't hold everyone up
+#define PS_JOBS_PER_THREAD		4
+
 
 /***************************** R O U T I N E S ****************************/
 
+/*********************************************************************
+ *
+ * unpack
+ *
+ * SYNOPSIS
+ *		static short unpack (uint8 *buffer, MEMFILE *mf, long width, long lines, long mod)
+ *
+ * PURPOSE
+ *		Decode lines packbits rows of width bytes, writing every mod'th
+ *		byte of buffer.  A run that goes past the end of a row is still
+ *		read but only the part inside the row is written.
+ *
+ * RETURN VALUE
+ *		0 on success, 1 if the data ran out.
+ *
+*/
 static short unpack (uint8 *buffer, MEMFILE *mf, long width, long lines, long mod)
 {
-	char	 i;
-	short	 j;
-	long	 bytecount;
-	long	 d;
-	long	 count;
-	long	 line;
+	const uint8	*s    = mf->curPtr;
+	const uint8	*sEnd = mf->curPtr + mf->bytesLeft;
+	long		 bytecount;
+	long		 count;
+	long		 keep;
+	long		 line;
+	long		 j;
 
 	for (line = 0; line < lines; line++)
 	{
 		bytecount = 0;
 		while (bytecount < width)
 		{
-		// read a char & check for eof
+			int	i;
 
-			d = MEMFILE_getc(mf);
-			if (d == EOF)
+			if (s >= sEnd)
 			{
-				return(1);
+				goto eof;
 			}
-			i = (char)d;
+			i = (signed char)*s++;
 
-			if(i < 0)
+			if (i < 0)
 			{
 			// run data
 
-				count = -i + 1;
+				uint8	d;
 
-				d = MEMFILE_getc(mf);
-				if(d == EOF)
+				count = -i + 1;
+				if (s >= sEnd)
 				{
-					return(1);
+					goto eof;
 				}
+				d    = *s++;
+				keep = (width - bytecount) < count ? (width - bytecount) : count;
 
-				for(j = 0; j < count; j++)
+				for (j = 0; j < keep; j++)
 				{
-					*buffer = (uint8)d;
+					*buffer = d;
 					buffer += mod;
 				}
 			}
@@ -131,65 +181,53 @@ static short unpack (uint8 *buffer, MEMFILE *mf, long width, long lines, long mo
 			// dump data
 
 				count = i + 1;
+				if (sEnd - s < count)
+				{
+					goto eof;
+				}
+				keep = (width - bytecount) < count ? (width - bytecount) : count;
 
-				for (j = 0; j < count; j++)
+				for (j = 0; j < keep; j++)
 				{
-					d = MEMFILE_getc(mf);
-					if(d == EOF)
-					{
-						return(1);
-					}
-					*buffer = (uint8)d;
+					*buffer = s[j];
 					buffer += mod;
 				}
+				s += count;
 			}
 
 			bytecount += count;
 		}
 	}
+
+	mf->bytesLeft -= (long)(s - mf->curPtr);
+	mf->curPtr     = (uint8 *)s;
 	return 0;
+
+eof:
+	mf->bytesLeft -= (long)(s - mf->curPtr);
+	mf->curPtr     = (uint8 *)s;
+	return 1;
 }
 // unpack
 
 /*********************************************************************
  *
- * loadPhotoshop32Bit
+ * readPSHeader
  *
  * SYNOPSIS
- *		void  loadPhotoshop32Bit (BlockO24BitPixels *blockPtr, char *fileName)
+ *		static int readPSHeader (PSHeader *psh, MEMFILE *mf)
  *
  * PURPOSE
- *		Attempts to load the specified photoshop 2.5 file.
- *		
- *
- * INPUT
- *
- *
- * EFFECTS
- *
+ *		Read and verify the 26 byte photoshop file header.  Leaves mf
+ *		pointing at the mode data section.
  *
  * RETURN VALUE
- *
- *
- * HISTORY
- *
- *
- * SEE ALSO
+ *		TRUE if it's an RGB 8 bit per channel file we can read.
  *
 */
-int loadPhotoshop32Bit (BlockO32BitPixels *blockPtr, MEMFILE *mf)
+static int readPSHeader (PSHeader *psh, MEMFILE *mf)
 {
 	uint8		 header[4+2+6+2+4+4+2+2];
-	uint8		**channelBufs = NULL;
-	short		 r;
-	short		 compress;
-	short		 i;
-	short		 line;
-	long		 width;
-	long		 height;
-	long		 channels;
-	long		 dsize;
-	PSHeader	 psh;
 
 // read the header
 
@@ -197,55 +235,79 @@ int loadPhotoshop32Bit (BlockO32BitPixels *blockPtr, MEMFILE *mf)
 	{
 		SetGlobalErr (ERR_GENERIC);
 		GEcatf ("loadPhotoshop:Bad Header");
-		goto cleanup;
+		return FALSE;
 	}
 
-	psh.signature = ((uint32)header[ 0] << 24) | ((uint32)header[ 1] << 16) | ((uint32)header[ 2] << 8) | ((uint32)header[ 3]);
-	psh.version   = ((uint16)header[ 4] <<  8) | ((uint16)header[ 5]);
-	psh.channels  = ((uint16)header[12] <<  8) | ((uint16)header[13]);
-	psh.rows      = ((uint32)header[14] << 24) | ((uint32)header[15] << 16) | ((uint32)header[16] << 8) | ((uint32)header[17]);
-	psh.columns   = ((uint32)header[18] << 24) | ((uint32)header[19] << 16) | ((uint32)header[20] << 8) | ((uint32)header[21]);
-	psh.depth     = ((uint16)header[22] <<  8) | ((uint16)header[23]);
-	psh.mode      = ((uint16)header[24] <<  8) | ((uint16)header[25]);
+	psh->signature = ((uint32)header[ 0] << 24) | ((uint32)header[ 1] << 16) | ((uint32)header[ 2] << 8) | ((uint32)header[ 3]);
+	psh->version   = ((uint16)header[ 4] <<  8) | ((uint16)header[ 5]);
+	psh->channels  = ((uint16)header[12] <<  8) | ((uint16)header[13]);
+	psh->rows      = ((uint32)header[14] << 24) | ((uint32)header[15] << 16) | ((uint32)header[16] << 8) | ((uint32)header[17]);
+	psh->columns   = ((uint32)header[18] << 24) | ((uint32)header[19] << 16) | ((uint32)header[20] << 8) | ((uint32)header[21]);
+	psh->depth     = ((uint16)header[22] <<  8) | ((uint16)header[23]);
+	psh->mode      = ((uint16)header[24] <<  8) | ((uint16)header[25]);
 
 // Verify the format
 
-	if (psh.signature != 0x38425053)
+	if (psh->signature != 0x38425053)
 	{
 		SetGlobalErr (ERR_GENERIC);
-		GEcatf1 ("loadPhotoshop:Cannot identify signature (%08lx)", psh.signature);
-		goto cleanup;
+		GEcatf1 ("loadPhotoshop:Cannot identify signature (%08lx)", psh->signature);
+		return FALSE;
 	}
-	if (psh.version != 1)
+	if (psh->version != 1)
 	{
 		SetGlobalErr (ERR_GENERIC);
-		GEcatf1 ("loadPhotoshop:Bad version number (%d)", psh.version);
-		goto cleanup;
+		GEcatf1 ("loadPhotoshop:Bad version number (%d)", psh->version);
+		return FALSE;
 	}
-	if (psh.channels < 3)
+	if (psh->channels < 3)
 	{
 		SetGlobalErr (ERR_GENERIC);
-		GEcatf1 ("loadPhotoshop:Wrong number of channels (%d)", psh.channels);
-		goto cleanup;
+		GEcatf1 ("loadPhotoshop:Wrong number of channels (%d)", psh->channels);
+		return FALSE;
 	}
-	if (psh.depth != 8)
+	if (psh->depth != 8)
 	{
 		SetGlobalErr (ERR_GENERIC);
-		GEcatf1 ("loadPhotoshop:Wrong depth (%d)", psh.depth);
-		goto cleanup;
+		GEcatf1 ("loadPhotoshop:Wrong depth (%d)", psh->depth);
+		return FALSE;
 	}
-	if (psh.mode != 3)
+	if (psh->mode != 3)
 	{
 		SetGlobalErr (ERR_GENERIC);
-		GEcatf1 ("loadPhotoshop:Wrong Mode (not RGB(%d))", psh.mode);
-		goto cleanup;
+		GEcatf1 ("loadPhotoshop:Wrong Mode (not RGB(%d))", psh->mode);
+		return FALSE;
 	}
 
+	return TRUE;
+}
+// readPSHeader
+
+/*********************************************************************
+ *
+ * seekPSImageData
+ *
+ * SYNOPSIS
+ *		static int seekPSImageData (MEMFILE *mf, short *pCompress)
+ *
+ * PURPOSE
+ *		Skip the mode, resource and reserved sections that follow the
+ *		header and read the compression type.  Leaves mf pointing at
+ *		the image data.
+ *
+ * RETURN VALUE
+ *		TRUE on success.
+ *
+*/
+static int seekPSImageData (MEMFILE *mf, short *pCompress)
+{
+	long		 dsize;
+
 	if (MEMFILE_Read(mf, &dsize, 4) != 4)
 	{
 		SetGlobalErr (ERR_GENERIC);
 		GEcatf ("Error reading mode data");
-		goto cleanup;
+		return FALSE;
 	}
 	BigLong2Native (dsize);
 	MEMFILE_Seek(mf, dsize, SEEK_CUR);
@@ -254,7 +316,7 @@ int loadPhotoshop32Bit (BlockO32BitPixels *blockPtr, MEMFILE *mf)
 	{
 		SetGlobalErr (ERR_GENERIC);
 		GEcatf ("Error reading resource data");
-		goto cleanup;
+		return FALSE;
 	}
 	BigLong2Native (dsize);
 	MEMFILE_Seek(mf, dsize, SEEK_CUR);
@@ -263,110 +325,302 @@ int loadPhotoshop32Bit (BlockO32BitPixels *blockPtr, MEMFILE *mf)
 	{
 		SetGlobalErr (ERR_GENERIC);
 		GEcatf ("Error reading reserved data");
-		goto cleanup;
+		return FALSE;
 	}
 	BigLong2Native (dsize);
 	MEMFILE_Seek(mf, dsize, SEEK_CUR);
 
 // check compression
 
-	if (MEMFILE_Read(mf, &compress, 2) != 2)
+	if (MEMFILE_Read(mf, pCompress, 2) != 2)
 	{
 		SetGlobalErr (ERR_GENERIC);
 		GEcatf ("Error reading compression type");
-		goto cleanup;
+		return FALSE;
 	}
-	BigWord2Native (compress);
-
-	width    = psh.columns;
-	height   = psh.rows;
-	channels = psh.channels - 3;
+	BigWord2Native (*pCompress);
 
-	blockPtr->width    = width;
-	blockPtr->height   = height;
-	blockPtr->channels = channels;
+	return TRUE;
+}
+// seekPSImageData
 
+/*********************************************************************
+ *
+ * readPSPlanes
+ *
+ * SYNOPSIS
+ *		static int readPSPlanes (PSPlanes *pp, const PSHeader *psh, short compress, MEMFILE *mf)
+ *
+ * PURPOSE
+ *		Work out where each row of each channel starts.  The channels
+ *		are stored one after the other so this is what lets a band of
+ *		rows be decoded on its own.  mf must be at the image data
+ *		(just past the compression type).
+ *
+ * RETURN VALUE
+ *		TRUE on success.  pp->rowStart must be freed by the caller.
+ *
+*/
+static int readPSPlanes (PSPlanes *pp, const PSHeader *psh, short compress, MEMFILE *mf)
+{
+	long	pos;
+	long	numRows;
+	long	row;
+
+	pp->buffer   = mf->buffer;
+	pp->size     = mf->size;
+	pp->width    = psh->columns;
+	pp->height   = psh->rows;
+	pp->planes   = psh->channels > 3 ? 4 : 3;
+	pp->compress = compress;
+
+	numRows      = pp->planes * pp->height;
+	pp->rowStart = (long *)malloc ((numRows ? numRows : 1) * sizeof (long));
+	if (!pp->rowStart)
 	{
-		long	channelSize;
-		
-		channelBufs = (uint8 **)malloc ((channels + 3) * sizeof (uint8 *));
-		if (!channelBufs)
-		{
-			SetGlobalErr (ERR_GENERIC);
-			GEcatf ("Out of memory reading photoshop file");
-			goto cleanup;
-		}
+		SetGlobalErr (ERR_GENERIC);
+		GEcatf ("Out of memory reading photoshop file");
+		return FALSE;
+	}
 
-		channelSize = width * height;
+	pos = MEMFILE_Seek (mf, 0, SEEK_CUR);
 
-		blockPtr->rgba = (pixel32 *)malloc (channelSize * 4);
-		if (!blockPtr->rgba)
+	if (!compress)
+	{
+		for (row = 0; row < numRows; row++)
 		{
-			SetGlobalErr (ERR_GENERIC);
-			GEcatf ("Out of memory reading photoshop file");
-			goto cleanup;
+			pp->rowStart[row] = pos + row * pp->width;
 		}
+	}
+	else
+	{
+		// row sizes are stored for every channel, even ones we skip
+		pos += psh->rows * psh->channels * 2;
 
-		memset (blockPtr->rgba, 255, channelSize * 4);
-
-		channelBufs[0] = &blockPtr->rgba[0].red;
-		channelBufs[1] = &blockPtr->rgba[0].green;
-		channelBufs[2] = &blockPtr->rgba[0].blue;
-
-		if (channels)
+		for (row = 0; row < numRows; row++)
 		{
-			channelBufs[3] = &blockPtr->rgba[0].alpha;
-			channels = 1;
+			int	hi = MEMFILE_getc(mf);
+			int	lo = MEMFILE_getc(mf);
+
+			if (lo == EOF)
+			{
+				SetGlobalErr (ERR_GENERIC);
+				GEcatf ("Error reading pic data");
+				return FALSE;
+			}
+			pp->rowStart[row] = pos;
+			pos += (hi << 8) | lo;
 		}
 	}
 
-// uncompress the body
+	return TRUE;
+}
+// readPSPlanes
 
-	if (!compress)
+/*********************************************************************
+ *
+ * decodePSRows
+ *
+ * SYNOPSIS
+ *		static int decodePSRows (const PSPlanes *pp, pixel32 *pDst, long y, long numRows)
+ *
+ * PURPOSE
+ *		Decode rows y to y + numRows - 1 of every channel straight
+ *		into the interleaved pixels at pDst (which is row y).  Only
+ *		reads pp so several threads can call it at once on different
+ *		rows.  Doesn't touch the global error.
+ *
+ * RETURN VALUE
+ *		TRUE on success, FALSE if the data is short.
+ *
+*/
+static int decodePSRows (const PSPlanes *pp, pixel32 *pDst, long y, long numRows)
+{
+	long	width = pp->width;
+	long	row;
+	long	plane;
+
+	if (pp->planes < 4)
 	{
-	// load uncompressed
+		memset (pDst, 255, width * numRows * sizeof (pixel32));
+	}
 
-		long	channel;
+	for (row = 0; row < numRows; row++)
+	{
+		pixel32	*pRow = pDst + row * width;
 
-		for (channel = 0; channel < channels + 3; channel++)
+		for (plane = 0; plane < pp->planes; plane++)
 		{
-			for(line = 0; line < height; line++)
+			MEMFILE	 mf;
+			long	 start = pp->rowStart[plane * pp->height + y + row];
+			uint8	*d;
+
+			switch (plane)
+			{
+			case 0:  d = &pRow->red;   break;
+			case 1:  d = &pRow->green; break;
+			case 2:  d = &pRow->blue;  break;
+			default: d = &pRow->alpha; break;
+			}
+
+			if (start < 0 || start > pp->size)
+			{
+				return FALSE;
+			}
+			MEMFILE_Init (&mf, (uint8 *)pp->buffer + start, pp->size - start);
+
+			if (!pp->compress)
 			{
-				for(i = 0; i < width; i++)
+				const uint8	*s = mf.curPtr;
+				long		 x;
+
+				if (mf.bytesLeft < width)
+				{
+					return FALSE;
+				}
+				for (x = 0; x < width; x++)
 				{
-					if (EOF == (r = MEMFILE_getc(mf)))
-					{
-						SetGlobalErr (ERR_GENERIC);
-						GEcatf ("Error reading pic data");
-						goto cleanup;
-					}
-					*channelBufs[channel] = (uint8)r;
-					channelBufs[channel] += 4;
+					*d = s[x];
+					d += 4;
 				}
 			}
+			else if (unpack (d, &mf, width, 1, 4))
+			{
+				return FALSE;
+			}
 		}
 	}
-	else
+
+	return TRUE;
+}
+// decodePSRows
+
+/*********************************************************************
+ *
+ * decodePSJob
+ *
+ * SYNOPSIS
+ *		static void decodePSJob (void *pUserData, int job)
+ *
+ * PURPOSE
+ *		ETHREAD job for loadPhotoshop32Bit.  Decodes one band of rows.
+ *
+*/
+static void decodePSJob (void *pUserData, int job)
+{
+	PSJob	*pj = (PSJob *)pUserData;
+	long	 y  = job * pj->rowsPerJob;
+	long	 numRows;
+
+	numRows = pj->pp->height - y;
+	if (numRows > pj->rowsPerJob)
 	{
-	// load compressed
-		long	junk;
-		long	channel;
+		numRows = pj->rowsPerJob;
+	}
 
-		junk = psh.rows*psh.channels*2;
-		MEMFILE_Seek (mf, junk, SEEK_CUR);	// Skip line size info
+	if (numRows > 0 && !decodePSRows (pj->pp, pj->rgba + y * pj->pp->width, y, numRows))
+	{
+		pj->failed = TRUE;
+	}
+}
+// decodePSJob
 
-		for (channel = 0; channel < channels + 3; channel++)
-		{
-			if (unpack(channelBufs[channel], mf, width, height, 4))
-			{
-				SetGlobalErr (ERR_GENERIC);
-				GEcatf ("Error reading pic data");
-				goto cleanup;
-			}
-		}
+/*********************************************************************
+ *
+ * loadPhotoshop32Bit
+ *
+ * SYNOPSIS
+ *		void  loadPhotoshop32Bit (BlockO24BitPixels *blockPtr, char *fileName)
+ *
+ * PURPOSE
+ *		Attempts to load the specified photoshop 2.5 file.
+ *
+ *		The picture is split into bands of rows that are decoded on
+ *		the default ETHREAD pool.  Each band decodes all its channels
+ *		straight into the interleaved pixels so there is no separate
+ *		interleave pass and no two threads write the same cache lines.
+ *
+ * INPUT
+ *
+ *
+ * EFFECTS
+ *
+ *
+ * RETURN VALUE
+ *
+ *
+ * HISTORY
+ *
+ *
+ * SEE ALSO
+ *
+*/
+int loadPhotoshop32Bit (BlockO32BitPixels *blockPtr, MEMFILE *mf)
+{
+	short		 compress;
+	long		 width;
+	long		 height;
+	PSHeader	 psh;
+	PSPlanes	 pp;
+	PSJob		 pj;
+	int			 numJobs;
+
+	pp.rowStart = NULL;
+
+	if (!readPSHeader (&psh, mf))
+	{
+		goto cleanup;
+	}
+
+	if (!seekPSImageData (mf, &compress))
+	{
+		goto cleanup;
+	}
+
+	width    = psh.columns;
+	height   = psh.rows;
+
+	blockPtr->width    = width;
+	blockPtr->height   = height;
+	blockPtr->channels = psh.channels - 3;
+
+	if (!AllocPicturePixels (blockPtr, width * height))
+	{
+		SetGlobalErr (ERR_GENERIC);
+		GEcatf ("Out of memory reading photoshop file");
+		goto cleanup;
+	}
+
+	if (!readPSPlanes (&pp, &psh, compress, mf))
+	{
+		goto cleanup;
+	}
+
+// uncompress the body
+
+	pj.pp         = &pp;
+	pj.rgba       = blockPtr->rgba;
+	pj.rowsPerJob = height ? height : 1;
+	pj.failed     = FALSE;
+
+	if (width * height >= PS_MIN_PARALLEL_PIXELS)
+	{
+		long	maxJobs = ETHREAD_PoolThreads (NULL) * PS_JOBS_PER_THREAD;
+
+		pj.rowsPerJob = (height + maxJobs - 1) / maxJobs;
+	}
+	numJobs = (int)((height + pj.rowsPerJob - 1) / pj.rowsPerJob);
+
+	ETHREAD_ParallelFor (NULL, numJobs, decodePSJob, &pj);
+
+	if (pj.failed)
+	{
+		SetGlobalErr (ERR_GENERIC);
+		GEcatf ("Error reading pic data");
+		goto cleanup;
 	}
 
-	free (channelBufs);
+	free (pp.rowStart);
 
 //	flipBuffer (blockPtr->rgba, blockPtr->width * 4, blockPtr->height);
 
@@ -374,11 +628,152 @@ int loadPhotoshop32Bit (BlockO32BitPixels *blockPtr, MEMFILE *mf)
 
 cleanup:
 
-	if (channelBufs)	free (channelBufs);
-	if (blockPtr->rgba)	free (blockPtr->rgba);
+	if (pp.rowStart)	free (pp.rowStart);
+	FreePicturePixels (blockPtr);
 
 	return FALSE;
 }
 // loadPhotoshop32Bit
 
 
+
+/*********************************************************************
+ *
+ * loadPhotoshopInfo
+ *
+ * SYNOPSIS
+ *		int loadPhotoshopInfo (PictureInfo *pInfo, MEMFILE *mf)
+ *
+ * PURPOSE
+ *		Fill out pInfo from the photoshop header without reading any
+ *		channel data.
+ *
+ * RETURN VALUE
+ *		TRUE on success, FALSE if not a photoshop file we can read.
+ *
+*/
+int loadPhotoshopInfo (PictureInfo *pInfo, MEMFILE *mf)
+{
+	PSHeader	 psh;
+
+	if (!readPSHeader (&psh, mf))
+	{
+		return FALSE;
+	}
+
+	pInfo->format       = PICFMT_PSD;
+	pInfo->width        = psh.columns;
+	pInfo->height       = psh.rows;
+	pInfo->channels     = psh.channels > 4 ? 4 : psh.channels;
+	pInfo->bitsPerPixel = psh.depth * pInfo->channels;
+	pInfo->hasAlpha     = psh.channels > 3;
+
+	return TRUE;
+}
+// loadPhotoshopInfo
+
+/*********************************************************************
+ *
+ * streamPhotoshop32Bit
+ *
+ * SYNOPSIS
+ *		int streamPhotoshop32Bit (MEMFILE *mf, long bandRows, PFNPICTUREROWS pfnRows, void *pUserData)
+ *
+ * PURPOSE
+ *		Decode a photoshop file bandRows rows at a time handing each
+ *		band to pfnRows.  Uses the same row table as the full loader
+ *		so each band is built by seeking to its rows in each channel.
+ *
+ * RETURN VALUE
+ *		TRUE if the whole picture was decoded and pfnRows never
+ *		returned FALSE.
+ *
+*/
+int streamPhotoshop32Bit (MEMFILE *mf, long bandRows, PFNPICTUREROWS pfnRows, void *pUserData)
+{
+	PictureInfo	 info;
+	PSHeader	 psh;
+	PSPlanes	 pp;
+	pixel32		*band   = NULL;
+	short		 compress;
+	int			 result = FALSE;
+	long		 width;
+	long		 height;
+	long		 planes;
+	long		 y;
+
+	pp.rowStart = NULL;
+
+	if (!readPSHeader (&psh, mf))
+	{
+		goto cleanup;
+	}
+
+	if (!seekPSImageData (mf, &compress))
+	{
+		goto cleanup;
+	}
+
+	width  = psh.columns;
+	height = psh.rows;
+	planes = psh.channels > 3 ? 4 : 3;
+
+	info.format       = PICFMT_PSD;
+	info.width        = width;
+	info.height       = height;
+	info.channels     = planes;
+	info.bitsPerPixel = psh.depth * planes;
+	info.hasAlpha     = psh.channels > 3;
+
+	if (!width || !height)
+	{
+		result = TRUE;
+		goto cleanup;
+	}
+
+	if (bandRows > height)
+	{
+		bandRows = height;
+	}
+
+	band = (pixel32 *)malloc (width * bandRows * sizeof (pixel32));
+	if (!band)
+	{
+		SetGlobalErr (ERR_GENERIC);
+		GEcatf ("Out of memory reading photoshop file");
+		goto cleanup;
+	}
+
+	if (!readPSPlanes (&pp, &psh, compress, mf))
+	{
+		goto cleanup;
+	}
+
+	for (y = 0; y < height; y += bandRows)
+	{
+		long	numRows = (height - y) < bandRows ? (height - y) : bandRows;
+
+		if (!decodePSRows (&pp, band, y, numRows))
+		{
+			SetGlobalErr (ERR_GENERIC);
+			GEcatf ("Error reading pic data");
+			goto cleanup;
+		}
+
+		if (!pfnRows (pUserData, &info, band, y, numRows))
+		{
+			goto cleanup;
+		}
+	}
+
+	result = TRUE;
+
+cleanup:
+
+	if (pp.rowStart)	free (pp.rowStart);
+	if (band)			free (band);
+
+	return result;
+}
+// streamPhotoshop32Bit
+
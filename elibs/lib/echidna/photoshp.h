@@ -78,6 +78,8 @@ extern "C" {
 /****************** F U N C T I O N   P R O T O T Y P E S *****************/
 
 int loadPhotoshop32Bit (BlockO32BitPixels *blockPtr, MEMFILE *mf);
+int loadPhotoshopInfo (PictureInfo *pInfo, MEMFILE *mf);
+int streamPhotoshop32Bit (MEMFILE *mf, long bandRows, PFNPICTUREROWS pfnRows, void *pUserData);
 
 #ifdef __cplusplus
 }
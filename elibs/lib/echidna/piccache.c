@@ -0,0 +1,461 @@
+/*************************************************************************
+ *                                                                       *
+ *                               PICCACHE.C                              *
+ *                                                                       *
+ *************************************************************************
+
+		Copyright (c) 1996-2008, Echidna
+
+		All rights reserved.
+
+		Redistribution and use in source and binary forms, with or
+		without modification, are permitted provided that the following
+		conditions are met:
+
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer. 
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer
+		  in the documentation and/or other materials provided with the
+		  distribution. 
+
+		THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+		CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+		INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+		MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+		DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+		BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+		EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+		TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+		DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+		ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+		OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+		OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+		POSSIBILITY OF SUCH DAMAGE.
+
+
+   DESCRIPTION
+		An on disk cache of decoded 32 bit pictures so a pipeline of
+		tools reading the same source files only decodes each once.
+
+		It's off unless SetPictureCacheDir is called or the
+		ECHIDNA_PICCACHE environment variable names a directory.
+		Each entry is named after a hash of the source file's bytes,
+		its size and PICCACHE_LOADER_VERSION, so a changed file or
+		loader just misses and old entries can be deleted whenever.
+
+		An entry is a header then the pixels as pixel32s, starting
+		PICCACHE_HEADER_SIZE bytes in so the file can be mapped and
+		used in place.  Entries are only good on machines with the
+		same pixel32 layout and word size, the header says which.
+
+		Nothing here ever makes a read fail.  Any trouble with the
+		cache is treated as a miss.
+
+   PROGRAMMERS
+
+
+   FUNCTIONS
+
+   TABS : 5 9
+
+   HISTORY
+		10/17/26 : Created.
+
+ *************************************************************************/
+
+/**************************** I N C L U D E S ****************************/
+
+#include "platform.h"
+#include "switches.h"
+#include "echidna/ensure.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#if _EL_OS_WIN32__
+	#include <process.h>
+	#define getpid	_getpid
+#else
+	#include <unistd.h>
+#endif
+
+#include "echidna/readgfx.h"
+#include "echidna/eio.h"
+#include "piccache.h"
+#include "picpool.h"
+
+/*************************** C O N S T A N T S ***************************/
+
+#define PICCACHE_ENV			"ECHIDNA_PICCACHE"
+#define PICCACHE_MAGIC			0x45504333UL	// 'EPC3'
+#define PICCACHE_HEADER_SIZE	128				// pixels start here
+#define PICCACHE_EXT			".p32"
+
+// hash primes
+#define PRIME1	2654435761UL
+#define PRIME2	2246822519UL
+#define PRIME3	3266489917UL
+#define PRIME4	668265263UL
+#define PRIME5	374761393UL
+
+/******************************* T Y P E S *******************************/
+
+typedef struct
+{
+	UINT32	magic;
+	UINT32	version;		// PICCACHE_LOADER_VERSION
+	UINT32	layout;			// pixel32 {1,2,3,4} read as a word
+	UINT32	wordSize;		// sizeof (UINT32)
+	UINT32	hash[2];
+	UINT32	size;
+	UINT32	width;
+	UINT32	height;
+	UINT32	channels;
+} PICCACHEHEADER;
+
+/***************************** G L O B A L S *****************************/
+
+static int	s_fInited = FALSE;
+static char	s_dir[EIO_MAXPATH];		// "" for no cache
+
+/****************************** M A C R O S ******************************/
+
+// UINT32 can be bigger than 32 bits so keep the hash in 32
+#define MASK32(x)		((x) & 0xFFFFFFFFUL)
+#define ROTL32(x,r)		MASK32(((x) << (r)) | ((x) >> (32 - (r))))
+#define ROUND(acc,in)	(acc = MASK32 (ROTL32 (MASK32 ((acc) + (in) * PRIME2), 13) * PRIME1))
+
+/**************************** R O U T I N E S ****************************/
+
+/*********************************************************************
+ *
+ * read32
+ *
+ * SYNOPSIS
+ *		static UINT32 read32 (const UINT8 *p)
+ *
+ * PURPOSE
+ *		Little endian 32 bit word from anywhere.
+ *
+*/
+static UINT32 read32 (const UINT8 *p)
+{
+	return (UINT32)p[0] | ((UINT32)p[1] << 8) | ((UINT32)p[2] << 16) | ((UINT32)p[3] << 24);
+}
+// read32
+
+/*********************************************************************
+ *
+ * hashBytes
+ *
+ * SYNOPSIS
+ *		static UINT32 hashBytes (const UINT8 *p, long size, UINT32 seed)
+ *
+ * PURPOSE
+ *		A fast 32 bit hash in the style of xxHash32.  Four lanes of 4
+ *		bytes so the multiplies overlap.
+ *
+*/
+static UINT32 hashBytes (const UINT8 *p, long size, UINT32 seed)
+{
+	const UINT8	*pEnd = p + size;
+	UINT32		 h;
+
+	if (size >= 16)
+	{
+		const UINT8	*pLimit = pEnd - 16;
+		UINT32		 v1 = MASK32 (seed + PRIME1 + PRIME2);
+		UINT32		 v2 = MASK32 (seed + PRIME2);
+		UINT32		 v3 = seed;
+		UINT32		 v4 = MASK32 (seed - PRIME1);
+
+		do
+		{
+			ROUND (v1, read32 (p));
+			ROUND (v2, read32 (p + 4));
+			ROUND (v3, read32 (p + 8));
+			ROUND (v4, read32 (p + 12));
+			p += 16;
+		}
+		while (p <= pLimit);
+
+		h = MASK32 (ROTL32 (v1, 1) + ROTL32 (v2, 7) + ROTL32 (v3, 12) + ROTL32 (v4, 18));
+	}
+	else
+	{
+		h = MASK32 (seed + PRIME5);
+	}
+
+	h = MASK32 (h + (UINT32)size);
+
+	for (; p + 4 <= pEnd; p += 4)
+	{
+		h = MASK32 (ROTL32 (MASK32 (h + read32 (p) * PRIME3), 17) * PRIME4);
+	}
+	for (; p < pEnd; p++)
+	{
+		h = MASK32 (ROTL32 (MASK32 (h + *p * PRIME5), 11) * PRIME1);
+	}
+
+	h ^= h >> 15;
+	h  = MASK32 (h * PRIME2);
+	h ^= h >> 13;
+	h  = MASK32 (h * PRIME3);
+	h ^= h >> 16;
+
+	return h;
+}
+// hashBytes
+
+/*********************************************************************
+ *
+ * layoutWord
+ *
+ * SYNOPSIS
+ *		static UINT32 layoutWord (void)
+ *
+ * PURPOSE
+ *		Something that's different on machines that lay pixel32 out
+ *		differently.
+ *
+*/
+static UINT32 layoutWord (void)
+{
+	pixel32	p;
+
+	p.red   = 1;
+	p.green = 2;
+	p.blue  = 3;
+	p.alpha = 4;
+
+	return read32 ((const UINT8 *)&p);
+}
+// layoutWord
+
+/*********************************************************************
+ *
+ * entryName
+ *
+ * SYNOPSIS
+ *		static void entryName (char *name, const PICCACHEKEY *pKey)
+ *
+ * PURPOSE
+ *		Path of the cache entry for a key.  name must hold EIO_MAXPATH.
+ *
+*/
+static void entryName (char *name, const PICCACHEKEY *pKey)
+{
+	char	file[64];
+
+	sprintf (file, "%08lx%08lx%08lxv%d", (unsigned long)pKey->hash[0], (unsigned long)pKey->hash[1],
+		(unsigned long)pKey->size, PICCACHE_LOADER_VERSION);
+	EIO_fnmerge (name, s_dir, file, PICCACHE_EXT);
+}
+// entryName
+
+/*********************************************************************
+ *
+ * PicCache_Init
+ *
+ * SYNOPSIS
+ *		void PicCache_Init (void)
+ *
+ * PURPOSE
+ *		Look at ECHIDNA_PICCACHE if SetPictureCacheDir hasn't been
+ *		called.  Done the first time the cache is used, call it from
+ *		the main thread before reading on others.
+ *
+*/
+void PicCache_Init (void)
+{
+	if (!s_fInited)
+	{
+		const char	*dir = getenv (PICCACHE_ENV);
+
+		SetPictureCacheDir (dir);
+	}
+}
+// PicCache_Init
+
+/*********************************************************************
+ *
+ * SetPictureCacheDir
+ *
+ * SYNOPSIS
+ *		void SetPictureCacheDir (const char *dir)
+ *
+ * PURPOSE
+ *		Turn the decoded picture cache on, keeping it in dir, or off
+ *		if dir is NULL or "".  The directory is made when the first
+ *		entry is written.  This beats ECHIDNA_PICCACHE.
+ *
+*/
+void SetPictureCacheDir (const char *dir)
+{
+	s_fInited = TRUE;
+	s_dir[0]  = '\0';
+
+	if (dir && *dir && strlen (dir) < sizeof (s_dir) - 1)
+	{
+		strcpy (s_dir, dir);
+		EIO_FixDirSeps (s_dir);
+	}
+}
+// SetPictureCacheDir
+
+/*********************************************************************
+ *
+ * PicCache_Load
+ *
+ * SYNOPSIS
+ *		int PicCache_Load (const void *pData, long size, PICCACHEKEY *pKey, BlockO32BitPixels *pBOP)
+ *
+ * PURPOSE
+ *		Make the key for a source file and look it up.
+ *
+ * INPUT
+ *		pData : source file's bytes
+ *		size  : how many
+ *		pKey  : filled in for PicCache_Save on a miss
+ *		pBOP  : filled in on a hit, the pixels come from
+ *		        AllocPicturePixels
+ *
+ * RETURN VALUE
+ *		FALSE if it's not in the cache or there is no cache.
+ *
+*/
+int PicCache_Load (const void *pData, long size, PICCACHEKEY *pKey, BlockO32BitPixels *pBOP)
+{
+	char			 name[EIO_MAXPATH];
+	PICCACHEHEADER	 header;
+	long			 bytes;
+	int				 fh;
+	int				 result;
+
+	PicCache_Init ();
+
+	pKey->fEnabled = s_dir[0] != '\0';
+	if (!pKey->fEnabled)
+	{
+		return FALSE;
+	}
+	pKey->hash[0] = hashBytes ((const UINT8 *)pData, size, 0);
+	pKey->hash[1] = hashBytes ((const UINT8 *)pData, size, PRIME3);
+	pKey->size    = size;
+
+	entryName (name, pKey);
+	fh = EIO_ReadOpen (name);
+	if (fh == -1)
+	{
+		return FALSE;
+	}
+
+	result = FALSE;
+	if (EIO_Read (fh, &header, sizeof (header)) == sizeof (header)
+		&& header.magic    == PICCACHE_MAGIC
+		&& header.version  == PICCACHE_LOADER_VERSION
+		&& header.layout   == layoutWord ()
+		&& header.wordSize == sizeof (UINT32)
+		&& header.hash[0]  == pKey->hash[0]
+		&& header.hash[1]  == pKey->hash[1]
+		&& header.size     == (UINT32)size)
+	{
+		bytes = header.width * header.height * sizeof (pixel32);
+		// a caller's buffer that's too small is left for the loader
+		// to complain about
+		if (EIO_FileLength (fh) == PICCACHE_HEADER_SIZE + bytes
+			&& (pBOP->pool || !pBOP->capacity || pBOP->capacity >= (long)(header.width * header.height))
+			&& EIO_Seek (fh, PICCACHE_HEADER_SIZE, SEEK_SET) == PICCACHE_HEADER_SIZE
+			&& AllocPicturePixels (pBOP, header.width * header.height))
+		{
+			result = EIO_Read (fh, pBOP->rgba, bytes) == bytes;
+			if (result)
+			{
+				pBOP->width    = header.width;
+				pBOP->height   = header.height;
+				pBOP->channels = header.channels;
+			}
+			else
+			{
+				FreePicturePixels (pBOP);
+			}
+		}
+	}
+	EIO_Close (fh);
+
+	return result;
+}
+// PicCache_Load
+
+/*********************************************************************
+ *
+ * PicCache_Save
+ *
+ * SYNOPSIS
+ *		void PicCache_Save (const PICCACHEKEY *pKey, const BlockO32BitPixels *pBOP)
+ *
+ * PURPOSE
+ *		Put a decoded picture in the cache.  It's written to a
+ *		temporary file and renamed so other programs reading the
+ *		cache never see half an entry.
+ *
+ * INPUT
+ *		pKey : from the PicCache_Load that missed
+ *		pBOP : the picture decoded from the source
+ *
+*/
+void PicCache_Save (const PICCACHEKEY *pKey, const BlockO32BitPixels *pBOP)
+{
+	char			name[EIO_MAXPATH];
+	char			temp[EIO_MAXPATH + 32];
+	UINT8			header[PICCACHE_HEADER_SIZE];
+	PICCACHEHEADER	info;
+	long			bytes;
+	int				fh;
+	int				fOK;
+
+	if (!pKey->fEnabled)
+	{
+		return;
+	}
+	if (!EIO_DirExists (s_dir))
+	{
+		EIO_MakeDir (s_dir);
+	}
+
+	entryName (name, pKey);
+	sprintf (temp, "%s.%lx.%lx", name, (unsigned long)getpid (), (unsigned long)pBOP);
+	fh = EIO_WriteOpen (temp);
+	if (fh == -1)
+	{
+		return;
+	}
+
+	memset (&info, 0, sizeof (info));
+	info.magic    = PICCACHE_MAGIC;
+	info.version  = PICCACHE_LOADER_VERSION;
+	info.layout   = layoutWord ();
+	info.wordSize = sizeof (UINT32);
+	info.hash[0]  = pKey->hash[0];
+	info.hash[1]  = pKey->hash[1];
+	info.size     = pKey->size;
+	info.width    = pBOP->width;
+	info.height   = pBOP->height;
+	info.channels = pBOP->channels;
+	memset (header, 0, sizeof (header));
+	memcpy (header, &info, sizeof (info));
+
+	bytes = pBOP->width * pBOP->height * sizeof (pixel32);
+	fOK = EIO_Write (fh, header, sizeof (header)) == sizeof (header)
+	   && EIO_Write (fh, pBOP->rgba, bytes) == bytes;
+	EIO_Close (fh);
+
+	// On Win32 rename fails if another program got there first which
+	// is fine, it's the same picture.
+	if (!fOK || rename (temp, name))
+	{
+		remove (temp);
+	}
+}
+// PicCache_Save
@@ -0,0 +1,102 @@
+/*************************************************************************
+ *                                                                       *
+ *                               PICCACHE.H                              *
+ *                                                                       *
+ *************************************************************************
+
+		Copyright (c) 1996-2008, Echidna
+
+		All rights reserved.
+
+		Redistribution and use in source and binary forms, with or
+		without modification, are permitted provided that the following
+		conditions are met:
+
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer. 
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer
+		  in the documentation and/or other materials provided with the
+		  distribution. 
+
+		THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+		CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+		INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+		MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+		DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+		BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+		EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+		TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+		DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+		ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+		OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+		OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+		POSSIBILITY OF SUCH DAMAGE.
+
+
+   DESCRIPTION
+		On disk cache of decoded pictures.  See piccache.c.
+
+   PROGRAMMERS
+
+
+   FUNCTIONS
+
+   TABS : 5 9
+
+   HISTORY
+		10/17/26 : Created.
+
+ *************************************************************************/
+
+#ifndef PICCACHE_H
+#define PICCACHE_H
+
+#include "platform.h"
+#include "switches.h"
+#include "echidna/ensure.h"
+
+#include "echidna/readgfx.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**************************** I N C L U D E S ****************************/
+
+
+/*************************** C O N S T A N T S ***************************/
+
+/*
+ * Goes in the key of every cached picture.  Bump it whenever any 32 bit
+ * loader starts making different pixels from the same file so old
+ * entries stop being used.
+ */
+#define PICCACHE_LOADER_VERSION	1
+
+/******************************* T Y P E S *******************************/
+
+typedef struct
+{
+	int		fEnabled;	// FALSE if there's no cache, nothing else is set
+	UINT32	hash[2];	// of the source file
+	long	size;		// of the source file
+} PICCACHEKEY;
+
+/***************************** G L O B A L S *****************************/
+
+
+/****************************** M A C R O S ******************************/
+
+
+/************************** P R O T O T Y P E S **************************/
+
+extern void PicCache_Init (void);
+extern int PicCache_Load (const void *pData, long size, PICCACHEKEY *pKey, BlockO32BitPixels *pBOP);
+extern void PicCache_Save (const PICCACHEKEY *pKey, const BlockO32BitPixels *pBOP);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PICCACHE_H */
@@ -0,0 +1,332 @@
+/*************************************************************************
+ *                                                                       *
+ *                               PICPOOL.C                               *
+ *                                                                       *
+ *************************************************************************
+
+		Copyright (c) 1996-2008, Echidna
+
+		All rights reserved.
+
+		Redistribution and use in source and binary forms, with or
+		without modification, are permitted provided that the following
+		conditions are met:
+
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer. 
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer
+		  in the documentation and/or other materials provided with the
+		  distribution. 
+
+		THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+		CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+		INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+		MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+		DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+		BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+		EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+		TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+		DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+		ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+		OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+		OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+
+
+   DESCRIPTION
+		Where the 32 bit loaders get the memory for their pixels.  By
+		default it's malloced, but a BlockO32BitPixels can instead say
+		the pixels go in a buffer the caller already has (capacity set,
+		no pool) or come from a PicturePool (pool set).
+
+		A PicturePool keeps freed pixel buffers to hand out again so a
+		program reading lots of pictures of a few sizes stops going to
+		the heap for every one.  Buffers are sized in classes, four to
+		each doubling, so a picture gets a buffer no more than a
+		quarter bigger than it needs and pictures of near enough the
+		same size share buffers.
+
+   PROGRAMMERS
+
+
+   FUNCTIONS
+
+   TABS : 5 9
+
+   HISTORY
+		10/17/26 : Created.
+
+ *************************************************************************/
+
+/**************************** I N C L U D E S ****************************/
+
+#include "platform.h"
+#include "switches.h"
+#include "echidna/ensure.h"
+
+#include "echidna/readgfx.h"
+#include "echidna/eerrors.h"
+#include "echidna/ethread.h"
+#include "picpool.h"
+
+/*************************** C O N S T A N T S ***************************/
+
+// smallest buffer a pool hands out
+#define PICPOOL_MIN_PIXELS	4096L
+
+// classes go up to (7 << 15) * PICPOOL_MIN_PIXELS / 4 pixels, bigger
+// pictures are just malloced
+#define PICPOOL_NUM_CLASSES	64
+
+/******************************* T Y P E S *******************************/
+
+// a free buffer, the link is kept in the buffer itself
+typedef struct PoolBuffer
+{
+	struct PoolBuffer	*next;
+} PoolBuffer;
+
+struct PicturePool
+{
+	ETHREAD_LOCK	*lock;		// loaders run on the batch threads
+	long			 maxBytes;	// most bytes to keep free, 0 for no limit
+	long			 freeBytes;
+	PoolBuffer		*free[PICPOOL_NUM_CLASSES];
+};
+
+/***************************** G L O B A L S *****************************/
+
+
+/****************************** M A C R O S ******************************/
+
+#define CLASS_PIXELS(c)	(((4 + ((c) & 3)) * PICPOOL_MIN_PIXELS / 4) << ((c) >> 2))
+
+/**************************** R O U T I N E S ****************************/
+
+/*********************************************************************
+ *
+ * classOfPixels
+ *
+ * SYNOPSIS
+ *		static int classOfPixels (long numPixels)
+ *
+ * PURPOSE
+ *		Find the smallest size class that holds numPixels.
+ *
+ * RETURN VALUE
+ *		The class or -1 if numPixels is too big for any.
+ *
+*/
+static int classOfPixels (long numPixels)
+{
+	int	c;
+
+	for (c = 0; c < PICPOOL_NUM_CLASSES; c++)
+	{
+		if (CLASS_PIXELS (c) >= numPixels)
+		{
+			return c;
+		}
+	}
+	return -1;
+}
+// classOfPixels
+
+/*********************************************************************
+ *
+ * CreatePicturePool
+ *
+ * SYNOPSIS
+ *		PicturePool *CreatePicturePool (long maxBytes)
+ *
+ * PURPOSE
+ *		Make a pool to read pictures with.  See Read32BitPictureFromPool.
+ *		It's safe to use from several threads at once.
+ *
+ * INPUT
+ *		maxBytes : most bytes of freed buffers to keep for reuse, more
+ *		           than that go back to the heap.  0 for no limit.
+ *
+ * RETURN VALUE
+ *		The pool or NULL if out of memory (GlobalErr is set).  Free it
+ *		with DestroyPicturePool.
+ *
+*/
+PicturePool *CreatePicturePool (long maxBytes)
+{
+	PicturePool	*pool;
+
+	pool = (PicturePool *)calloc (1, sizeof (PicturePool));
+	if (pool)
+	{
+		pool->lock = ETHREAD_CreateLock ();
+		if (!pool->lock)
+		{
+			free (pool);
+			pool = NULL;
+		}
+	}
+	if (!pool)
+	{
+		SetGlobalErr (ERR_GENERIC);
+		GEcatf ("Out of memory");
+		return NULL;
+	}
+	pool->maxBytes = maxBytes;
+
+	return pool;
+}
+// CreatePicturePool
+
+/*********************************************************************
+ *
+ * DestroyPicturePool
+ *
+ * SYNOPSIS
+ *		void DestroyPicturePool (PicturePool *pool)
+ *
+ * PURPOSE
+ *		Free a pool and the buffers it's keeping.  Every picture read
+ *		from it must have been freed first.  NULL is ignored.
+ *
+*/
+void DestroyPicturePool (PicturePool *pool)
+{
+	int	c;
+
+	if (!pool)
+	{
+		return;
+	}
+
+	for (c = 0; c < PICPOOL_NUM_CLASSES; c++)
+	{
+		while (pool->free[c])
+		{
+			PoolBuffer	*pBuf = pool->free[c];
+
+			pool->free[c] = pBuf->next;
+			free (pBuf);
+		}
+	}
+	ETHREAD_DestroyLock (pool->lock);
+	free (pool);
+}
+// DestroyPicturePool
+
+/*********************************************************************
+ *
+ * AllocPicturePixels
+ *
+ * SYNOPSIS
+ *		pixel32 *AllocPicturePixels (BlockO32BitPixels *pBOP, long numPixels)
+ *
+ * PURPOSE
+ *		Get the memory for a picture's pixels, from wherever pBOP says
+ *		they come from, and set pBOP->rgba to it.  Loaders use this
+ *		instead of malloc and FreePicturePixels instead of free.
+ *
+ *		If pBOP has a buffer of the caller's it's used as is so it
+ *		must have room for numPixels.
+ *
+ * RETURN VALUE
+ *		pBOP->rgba or NULL if there's no memory (GlobalErr is set if
+ *		it's the caller's buffer that's too small).
+ *
+*/
+pixel32 *AllocPicturePixels (BlockO32BitPixels *pBOP, long numPixels)
+{
+	if (pBOP->pool)
+	{
+		PicturePool	*pool = pBOP->pool;
+		int			 c    = classOfPixels (numPixels);
+
+		if (c < 0)
+		{
+			// too big to pool, it's just freed when done
+			pBOP->pool     = NULL;
+			pBOP->capacity = 0;
+			pBOP->rgba     = (pixel32 *)malloc (numPixels * sizeof (pixel32));
+			return pBOP->rgba;
+		}
+
+		ETHREAD_Lock (pool->lock);
+		pBOP->rgba = (pixel32 *)pool->free[c];
+		if (pBOP->rgba)
+		{
+			pool->free[c]    = pool->free[c]->next;
+			pool->freeBytes -= CLASS_PIXELS (c) * sizeof (pixel32);
+		}
+		ETHREAD_Unlock (pool->lock);
+
+		if (!pBOP->rgba)
+		{
+			pBOP->rgba = (pixel32 *)malloc (CLASS_PIXELS (c) * sizeof (pixel32));
+		}
+		pBOP->capacity = pBOP->rgba ? CLASS_PIXELS (c) : 0;
+	}
+	else if (pBOP->capacity)
+	{
+		if (numPixels > pBOP->capacity)
+		{
+			SetGlobalErr (ERR_GENERIC);
+			GEcatf2 ("Picture needs %ld pixels but the buffer only holds %ld", numPixels, pBOP->capacity);
+			return NULL;
+		}
+	}
+	else
+	{
+		pBOP->rgba = (pixel32 *)malloc ((numPixels ? numPixels : 1) * sizeof (pixel32));
+	}
+
+	return pBOP->rgba;
+}
+// AllocPicturePixels
+
+/*********************************************************************
+ *
+ * FreePicturePixels
+ *
+ * SYNOPSIS
+ *		void FreePicturePixels (BlockO32BitPixels *pBOP)
+ *
+ * PURPOSE
+ *		Give back pixels got with AllocPicturePixels.  A pool's go back
+ *		to the pool, the caller's own buffer is left alone.  pBOP->rgba
+ *		is set to NULL unless it's the caller's.
+ *
+*/
+void FreePicturePixels (BlockO32BitPixels *pBOP)
+{
+	if (!pBOP->rgba)
+	{
+		return;
+	}
+
+	if (pBOP->pool)
+	{
+		PicturePool	*pool  = pBOP->pool;
+		long		 bytes = pBOP->capacity * sizeof (pixel32);
+		int			 c     = classOfPixels (pBOP->capacity);
+
+		ETHREAD_Lock (pool->lock);
+		if (!pool->maxBytes || pool->freeBytes + bytes <= pool->maxBytes)
+		{
+			PoolBuffer	*pBuf = (PoolBuffer *)pBOP->rgba;
+
+			pBuf->next       = pool->free[c];
+			pool->free[c]    = pBuf;
+			pool->freeBytes += bytes;
+			pBOP->rgba       = NULL;
+		}
+		ETHREAD_Unlock (pool->lock);
+	}
+	else if (pBOP->capacity)
+	{
+		return;
+	}
+
+	free (pBOP->rgba);
+	pBOP->rgba = NULL;
+}
+// FreePicturePixels
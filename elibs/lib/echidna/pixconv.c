@@ -0,0 +1,1364 @@
+/*************************************************************************
+ *                                                                       *
+ *                               PIXCONV.C                               *
+ *                                                                       *
+ *************************************************************************
+
+		Copyright (c) 1996-2008, Echidna
+
+		All rights reserved.
+
+		Redistribution and use in source and binary forms, with or
+		without modification, are permitted provided that the following
+		conditions are met:
+
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer. 
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer
+		  in the documentation and/or other materials provided with the
+		  distribution. 
+
+		THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+		CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+		INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+		MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+		DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+		BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+		EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+		TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+		DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+		ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+		OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+		OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+		POSSIBILITY OF SUCH DAMAGE.
+
+
+   DESCRIPTION
+		Pixel conversion kernels.  Every kernel has a plain C version
+		that always works.  On x86 the SSE2/SSSE3/AVX2 versions are
+		chosen the first time a kernel is called, based on what the CPU
+		says it can do.  On ARM the NEON versions are used if the
+		compiler targets NEON.
+
+		Source pixels are in targa order (B,G,R[,A] or 16 bit
+		A1R5G5B5).  pixel32 is BGRA on Win32 and RGBA everywhere else
+		so the shuffles differ.
+
+   PROGRAMMERS
+
+
+   FUNCTIONS
+
+   TABS : 5 9
+
+   HISTORY
+		10/17/26 : Created.
+
+ *************************************************************************/
+
+/**************************** I N C L U D E S ****************************/
+
+#include "platform.h"
+#include "switches.h"
+#include "echidna/ensure.h"
+
+#include <string.h>
+
+#include "echidna/pixconv.h"
+
+#if EL_USE_SIMD && (defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)) && (!defined(_MSC_VER) || _MSC_VER >= 1500)
+	#define PIXCONV_X86	1
+#else
+	#define PIXCONV_X86	0
+#endif
+
+// VC++ got AVX2 intrinsics in VS2012
+#if PIXCONV_X86 && (!defined(_MSC_VER) || _MSC_VER >= 1700)
+	#define PIXCONV_AVX2	1
+#else
+	#define PIXCONV_AVX2	0
+#endif
+
+#if EL_USE_SIMD && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+	#define PIXCONV_NEON	1
+#else
+	#define PIXCONV_NEON	0
+#endif
+
+#if PIXCONV_X86
+	#include <emmintrin.h>
+	#include <tmmintrin.h>
+	#if PIXCONV_AVX2
+		#include <immintrin.h>
+	#endif
+	#if defined(_MSC_VER)
+		#include <intrin.h>
+	#else
+		#include <cpuid.h>
+	#endif
+#endif
+
+#if PIXCONV_NEON
+	#include <arm_neon.h>
+#endif
+
+/*************************** C O N S T A N T S ***************************/
+
+
+/******************************* T Y P E S *******************************/
+
+typedef void (*PFNPIXCONV) (pixel32 *d, const uint8 *s, long count);
+typedef void (*PFNPIXFILL) (pixel32 *d, pixel32 p, long count);
+typedef void (*PFNPIX555) (pixel32 *d, const uint8 *s, long count, int fAlpha);
+typedef void (*PFNPIXINDEX) (pixel32 *d, const uint8 *s, long count, const pixel32 *colorMap);
+typedef long (*PFNPIXRUN32) (const pixel32 *p, long count);
+typedef long (*PFNPIXRUN8) (const uint8 *p, long count);
+typedef void (*PFNPIXSWAP) (uint8 *p, long count);
+
+/****************************** M A C R O S ******************************/
+
+// gcc needs to be told it may use the instructions in a function,
+// VC++ always lets you use the intrinsics
+#if PIXCONV_X86 && !defined(_MSC_VER)
+	#define PIXCONV_SSE2	__attribute__((target("sse2")))
+	#define PIXCONV_SSSE3	__attribute__((target("ssse3")))
+	#define PIXCONV_TGTAVX2	__attribute__((target("avx2")))
+#else
+	#define PIXCONV_SSE2
+	#define PIXCONV_SSSE3
+	#define PIXCONV_TGTAVX2
+#endif
+
+// 5 bit to 8 bit the same way the C version does it
+#define EXPAND5(x)	(uint8)(((x) << 3) | ((x) >> 2))
+
+/************************** P R O T O T Y P E S **************************/
+
+static void PixConv_Init (void);
+
+/***************************** G L O B A L S *****************************/
+
+static int			s_fInit     = FALSE;
+static int			s_features  = 0;
+static PFNPIXFILL	s_pfnFill32;
+static PFNPIXCONV	s_pfnBGR24;
+static PFNPIXCONV	s_pfnBGRA32;
+static PFNPIXCONV	s_pfnGrey8;
+static PFNPIX555	s_pfnBGR555;
+static PFNPIXINDEX	s_pfnIndex8;
+static PFNPIXRUN32	s_pfnRunLength32;
+static PFNPIXRUN32	s_pfnFindRepeat32;
+static PFNPIXRUN8	s_pfnRunLength8;
+static PFNPIXRUN8	s_pfnFindRepeat8;
+static PFNPIXSWAP	s_pfnSwap16;
+static PFNPIXSWAP	s_pfnSwap32;
+
+/**************************** R O U T I N E S ****************************/
+
+/*
+ * Plain C versions
+ */
+
+static void fill32C (pixel32 *d, pixel32 p, long count)
+{
+	while (count--)
+	{
+		*d++ = p;
+	}
+}
+
+static void bgr24C (pixel32 *d, const uint8 *s, long count)
+{
+	while (count--)
+	{
+		d->blue  = s[0];
+		d->green = s[1];
+		d->red   = s[2];
+		d->alpha = 255;
+		d++;
+		s += 3;
+	}
+}
+
+static void bgra32C (pixel32 *d, const uint8 *s, long count)
+{
+	#if _EL_OS_WIN32__
+		memcpy (d, s, count * sizeof (pixel32));
+	#else
+		while (count--)
+		{
+			d->blue  = s[0];
+			d->green = s[1];
+			d->red   = s[2];
+			d->alpha = s[3];
+			d++;
+			s += 4;
+		}
+	#endif
+}
+
+static void grey8C (pixel32 *d, const uint8 *s, long count)
+{
+	while (count--)
+	{
+		uint8	k = *s++;
+
+		d->red   = k;
+		d->green = k;
+		d->blue  = k;
+		d->alpha = 255;
+		d++;
+	}
+}
+
+static void bgr555C (pixel32 *d, const uint8 *s, long count, int fAlpha)
+{
+	while (count--)
+	{
+		unsigned int	v = s[0] | (s[1] << 8);
+
+		d->red   = EXPAND5((v >> 10) & 0x1F);
+		d->green = EXPAND5((v >>  5) & 0x1F);
+		d->blue  = EXPAND5( v        & 0x1F);
+		d->alpha = (!fAlpha || (v & 0x8000)) ? 255 : 0;
+		d++;
+		s += 2;
+	}
+}
+
+static void index8C (pixel32 *d, const uint8 *s, long count, const pixel32 *colorMap)
+{
+	while (count >= 4)
+	{
+		d[0] = colorMap[s[0]];
+		d[1] = colorMap[s[1]];
+		d[2] = colorMap[s[2]];
+		d[3] = colorMap[s[3]];
+		d     += 4;
+		s     += 4;
+		count -= 4;
+	}
+	while (count--)
+	{
+		*d++ = colorMap[*s++];
+	}
+}
+
+/*
+ * Pixels are compared as 32 bit words (not uint32, that's a long on
+ * some compilers), byte order doesn't matter for equality.
+ */
+
+static long runLength32C (const pixel32 *p, long count)
+{
+	const unsigned int	*w = (const unsigned int *)p;
+	long				 i;
+
+	for (i = 1; i < count && w[i] == w[0]; i++)
+	{
+	}
+	return count ? i : 0;
+}
+
+static long findRepeat32C (const pixel32 *p, long count)
+{
+	const unsigned int	*w = (const unsigned int *)p;
+	long				 i;
+
+	for (i = 0; i + 1 < count; i++)
+	{
+		if (w[i] == w[i + 1])
+		{
+			return i;
+		}
+	}
+	return count;
+}
+
+static long runLength8C (const uint8 *p, long count)
+{
+	long	i;
+
+	for (i = 1; i < count && p[i] == p[0]; i++)
+	{
+	}
+	return count ? i : 0;
+}
+
+static long findRepeat8C (const uint8 *p, long count)
+{
+	long	i;
+
+	for (i = 0; i + 1 < count; i++)
+	{
+		if (p[i] == p[i + 1])
+		{
+			return i;
+		}
+	}
+	return count;
+}
+
+static void swap16C (uint8 *p, long count)
+{
+	while (count--)
+	{
+		uint8	t = p[0];
+
+		p[0] = p[1];
+		p[1] = t;
+		p += 2;
+	}
+}
+
+static void swap32C (uint8 *p, long count)
+{
+	while (count--)
+	{
+		uint8	t0 = p[0];
+		uint8	t1 = p[1];
+
+		p[0] = p[3];
+		p[1] = p[2];
+		p[2] = t1;
+		p[3] = t0;
+		p += 4;
+	}
+}
+
+#if PIXCONV_X86
+
+/*
+ * x86 versions.  Each does as many whole vectors as it can then lets
+ * the C version finish the last few pixels.
+ */
+
+#if _EL_OS_WIN32__
+	#define BGR24_SHUFFLE	0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1
+#else
+	#define BGR24_SHUFFLE	2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1
+#endif
+
+PIXCONV_SSE2 static void fill32SSE2 (pixel32 *d, pixel32 p, long count)
+{
+	int		 v;
+	__m128i	 vp;
+
+	memcpy (&v, &p, sizeof (v));
+	vp = _mm_set1_epi32 (v);
+
+	while (count >= 4)
+	{
+		_mm_storeu_si128 ((__m128i *)d, vp);
+		d     += 4;
+		count -= 4;
+	}
+	fill32C (d, p, count);
+}
+
+PIXCONV_SSSE3 static void bgr24SSSE3 (pixel32 *d, const uint8 *s, long count)
+{
+	const __m128i	shuf  = _mm_setr_epi8 (BGR24_SHUFFLE);
+	const __m128i	alpha = _mm_set1_epi32 ((int)0xFF000000);
+
+	// 4 pixels are 12 bytes but each load reads 16 so stop while there
+	// are still 16 bytes left
+	while (count >= 6)
+	{
+		__m128i	v = _mm_loadu_si128 ((const __m128i *)s);
+
+		v = _mm_or_si128 (_mm_shuffle_epi8 (v, shuf), alpha);
+		_mm_storeu_si128 ((__m128i *)d, v);
+		d     += 4;
+		s     += 12;
+		count -= 4;
+	}
+	bgr24C (d, s, count);
+}
+
+PIXCONV_SSE2 static void bgra32SSE2 (pixel32 *d, const uint8 *s, long count)
+{
+	#if _EL_OS_WIN32__
+		memcpy (d, s, count * sizeof (pixel32));
+	#else
+		const __m128i	ga = _mm_set1_epi32 ((int)0xFF00FF00);
+		const __m128i	lo = _mm_set1_epi32 (0x000000FF);
+
+		// swap bytes 0 and 2 of each pixel
+		while (count >= 4)
+		{
+			__m128i	v  = _mm_loadu_si128 ((const __m128i *)s);
+			__m128i	rb = _mm_or_si128 (_mm_slli_epi32 (_mm_and_si128 (v, lo), 16),
+									   _mm_and_si128 (_mm_srli_epi32 (v, 16), lo));
+
+			_mm_storeu_si128 ((__m128i *)d, _mm_or_si128 (_mm_and_si128 (v, ga), rb));
+			d     += 4;
+			s     += 16;
+			count -= 4;
+		}
+		bgra32C (d, s, count);
+	#endif
+}
+
+PIXCONV_SSE2 static void grey8SSE2 (pixel32 *d, const uint8 *s, long count)
+{
+	const __m128i	alpha = _mm_set1_epi32 ((int)0xFF000000);
+
+	while (count >= 16)
+	{
+		__m128i	v  = _mm_loadu_si128 ((const __m128i *)s);
+		__m128i	lo = _mm_unpacklo_epi8 (v, v);
+		__m128i	hi = _mm_unpackhi_epi8 (v, v);
+
+		_mm_storeu_si128 ((__m128i *)(d +  0), _mm_or_si128 (_mm_unpacklo_epi16 (lo, lo), alpha));
+		_mm_storeu_si128 ((__m128i *)(d +  4), _mm_or_si128 (_mm_unpackhi_epi16 (lo, lo), alpha));
+		_mm_storeu_si128 ((__m128i *)(d +  8), _mm_or_si128 (_mm_unpacklo_epi16 (hi, hi), alpha));
+		_mm_storeu_si128 ((__m128i *)(d + 12), _mm_or_si128 (_mm_unpackhi_epi16 (hi, hi), alpha));
+		d     += 16;
+		s     += 16;
+		count -= 16;
+	}
+	grey8C (d, s, count);
+}
+
+PIXCONV_SSE2 static void bgr555SSE2 (pixel32 *d, const uint8 *s, long count, int fAlpha)
+{
+	const __m128i	mask5 = _mm_set1_epi16 (0x1F);
+	const __m128i	zero  = _mm_setzero_si128 ();
+	const __m128i	opaque = _mm_set1_epi16 (-1);
+
+	// 8 pixels at a time.  Each channel is pulled out into its own 16
+	// bit lanes, widened to 8 bits, packed to bytes then interleaved.
+	while (count >= 8)
+	{
+		__m128i	v = _mm_loadu_si128 ((const __m128i *)s);
+		__m128i	r = _mm_and_si128 (_mm_srli_epi16 (v, 10), mask5);
+		__m128i	g = _mm_and_si128 (_mm_srli_epi16 (v,  5), mask5);
+		__m128i	b = _mm_and_si128 (v, mask5);
+		__m128i	a = fAlpha ? _mm_srai_epi16 (v, 15) : opaque;
+		__m128i	lo;
+		__m128i	hi;
+
+		r = _mm_packus_epi16 (_mm_or_si128 (_mm_slli_epi16 (r, 3), _mm_srli_epi16 (r, 2)), zero);
+		g = _mm_packus_epi16 (_mm_or_si128 (_mm_slli_epi16 (g, 3), _mm_srli_epi16 (g, 2)), zero);
+		b = _mm_packus_epi16 (_mm_or_si128 (_mm_slli_epi16 (b, 3), _mm_srli_epi16 (b, 2)), zero);
+		a = _mm_packs_epi16 (a, zero);
+
+		#if _EL_OS_WIN32__
+			lo = _mm_unpacklo_epi8 (b, g);
+			hi = _mm_unpacklo_epi8 (r, a);
+		#else
+			lo = _mm_unpacklo_epi8 (r, g);
+			hi = _mm_unpacklo_epi8 (b, a);
+		#endif
+
+		_mm_storeu_si128 ((__m128i *)(d + 0), _mm_unpacklo_epi16 (lo, hi));
+		_mm_storeu_si128 ((__m128i *)(d + 4), _mm_unpackhi_epi16 (lo, hi));
+		d     += 8;
+		s     += 16;
+		count -= 8;
+	}
+	bgr555C (d, s, count, fAlpha);
+}
+
+// index of the lowest set bit of a non zero movemask
+static int lowestBit (unsigned int mask)
+{
+	int	n = 0;
+
+	while (!(mask & 1))
+	{
+		mask >>= 1;
+		n++;
+	}
+	return n;
+}
+
+PIXCONV_SSE2 static long runLength32SSE2 (const pixel32 *p, long count)
+{
+	const unsigned int	*w = (const unsigned int *)p;
+	__m128i				 v0;
+	long				 i = 0;
+
+	if (!count)
+	{
+		return 0;
+	}
+	v0 = _mm_set1_epi32 ((int)w[0]);
+
+	while (i + 4 <= count)
+	{
+		unsigned int	m = _mm_movemask_ps (_mm_castsi128_ps (_mm_cmpeq_epi32 (_mm_loadu_si128 ((const __m128i *)(w + i)), v0)));
+
+		if (m != 0xF)
+		{
+			return i + lowestBit (~m);
+		}
+		i += 4;
+	}
+	while (i < count && w[i] == w[0])
+	{
+		i++;
+	}
+	return i;
+}
+
+PIXCONV_SSE2 static long findRepeat32SSE2 (const pixel32 *p, long count)
+{
+	const unsigned int	*w = (const unsigned int *)p;
+	long				 i = 0;
+
+	// compares w[i..i+3] with w[i+1..i+4]
+	while (i + 5 <= count)
+	{
+		__m128i			a = _mm_loadu_si128 ((const __m128i *)(w + i));
+		__m128i			b = _mm_loadu_si128 ((const __m128i *)(w + i + 1));
+		unsigned int	m = _mm_movemask_ps (_mm_castsi128_ps (_mm_cmpeq_epi32 (a, b)));
+
+		if (m)
+		{
+			return i + lowestBit (m);
+		}
+		i += 4;
+	}
+	i += findRepeat32C ((const pixel32 *)(w + i), count - i);
+	return i;
+}
+
+PIXCONV_SSE2 static long runLength8SSE2 (const uint8 *p, long count)
+{
+	__m128i	v0;
+	long	i = 0;
+
+	if (!count)
+	{
+		return 0;
+	}
+	v0 = _mm_set1_epi8 ((char)p[0]);
+
+	while (i + 16 <= count)
+	{
+		unsigned int	m = _mm_movemask_epi8 (_mm_cmpeq_epi8 (_mm_loadu_si128 ((const __m128i *)(p + i)), v0));
+
+		if (m != 0xFFFF)
+		{
+			return i + lowestBit (~m);
+		}
+		i += 16;
+	}
+	while (i < count && p[i] == p[0])
+	{
+		i++;
+	}
+	return i;
+}
+
+PIXCONV_SSE2 static long findRepeat8SSE2 (const uint8 *p, long count)
+{
+	long	i = 0;
+
+	while (i + 17 <= count)
+	{
+		__m128i			a = _mm_loadu_si128 ((const __m128i *)(p + i));
+		__m128i			b = _mm_loadu_si128 ((const __m128i *)(p + i + 1));
+		unsigned int	m = _mm_movemask_epi8 (_mm_cmpeq_epi8 (a, b));
+
+		if (m)
+		{
+			return i + lowestBit (m);
+		}
+		i += 16;
+	}
+	i += findRepeat8C (p + i, count - i);
+	return i;
+}
+
+PIXCONV_SSE2 static void swap16SSE2 (uint8 *p, long count)
+{
+	while (count >= 8)
+	{
+		__m128i	v = _mm_loadu_si128 ((const __m128i *)p);
+
+		_mm_storeu_si128 ((__m128i *)p, _mm_or_si128 (_mm_slli_epi16 (v, 8), _mm_srli_epi16 (v, 8)));
+		p     += 16;
+		count -= 8;
+	}
+	swap16C (p, count);
+}
+
+PIXCONV_SSE2 static void swap32SSE2 (uint8 *p, long count)
+{
+	while (count >= 4)
+	{
+		__m128i	v = _mm_loadu_si128 ((const __m128i *)p);
+
+		// swap the bytes of each half then swap the halves
+		v = _mm_or_si128 (_mm_slli_epi16 (v, 8), _mm_srli_epi16 (v, 8));
+		v = _mm_shufflehi_epi16 (_mm_shufflelo_epi16 (v, 0xB1), 0xB1);
+		_mm_storeu_si128 ((__m128i *)p, v);
+		p     += 16;
+		count -= 4;
+	}
+	swap32C (p, count);
+}
+
+PIXCONV_SSSE3 static void swap32SSSE3 (uint8 *p, long count)
+{
+	const __m128i	shuf = _mm_setr_epi8 (3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+
+	while (count >= 4)
+	{
+		_mm_storeu_si128 ((__m128i *)p, _mm_shuffle_epi8 (_mm_loadu_si128 ((const __m128i *)p), shuf));
+		p     += 16;
+		count -= 4;
+	}
+	swap32C (p, count);
+}
+
+#if PIXCONV_AVX2
+
+PIXCONV_TGTAVX2 static void bgr24AVX2 (pixel32 *d, const uint8 *s, long count)
+{
+	const __m256i	shuf  = _mm256_setr_epi8 (BGR24_SHUFFLE, BGR24_SHUFFLE);
+	const __m256i	alpha = _mm256_set1_epi32 ((int)0xFF000000);
+
+	// 8 pixels per pass, 4 in each 128 bit lane.  The high lane loads
+	// 16 bytes starting 12 in so stop while 28 bytes are left.
+	while (count >= 10)
+	{
+		__m256i	v = _mm256_inserti128_si256 (_mm256_castsi128_si256 (_mm_loadu_si128 ((const __m128i *)s)),
+											 _mm_loadu_si128 ((const __m128i *)(s + 12)), 1);
+
+		v = _mm256_or_si256 (_mm256_shuffle_epi8 (v, shuf), alpha);
+		_mm256_storeu_si256 ((__m256i *)d, v);
+		d     += 8;
+		s     += 24;
+		count -= 8;
+	}
+	bgr24C (d, s, count);
+}
+
+PIXCONV_TGTAVX2 static void index8AVX2 (pixel32 *d, const uint8 *s, long count, const pixel32 *colorMap)
+{
+	while (count >= 8)
+	{
+		__m128i	k = _mm_loadl_epi64 ((const __m128i *)s);
+
+		_mm256_storeu_si256 ((__m256i *)d, _mm256_i32gather_epi32 ((const int *)colorMap, _mm256_cvtepu8_epi32 (k), 4));
+		d     += 8;
+		s     += 8;
+		count -= 8;
+	}
+	index8C (d, s, count, colorMap);
+}
+
+PIXCONV_TGTAVX2 static long runLength32AVX2 (const pixel32 *p, long count)
+{
+	const unsigned int	*w = (const unsigned int *)p;
+	__m256i				 v0;
+	long				 i = 0;
+
+	if (!count)
+	{
+		return 0;
+	}
+	v0 = _mm256_set1_epi32 ((int)w[0]);
+
+	while (i + 8 <= count)
+	{
+		unsigned int	m = _mm256_movemask_ps (_mm256_castsi256_ps (_mm256_cmpeq_epi32 (_mm256_loadu_si256 ((const __m256i *)(w + i)), v0)));
+
+		if (m != 0xFF)
+		{
+			return i + lowestBit (~m);
+		}
+		i += 8;
+	}
+	while (i < count && w[i] == w[0])
+	{
+		i++;
+	}
+	return i;
+}
+
+PIXCONV_TGTAVX2 static long findRepeat32AVX2 (const pixel32 *p, long count)
+{
+	const unsigned int	*w = (const unsigned int *)p;
+	long				 i = 0;
+
+	while (i + 9 <= count)
+	{
+		__m256i			a = _mm256_loadu_si256 ((const __m256i *)(w + i));
+		__m256i			b = _mm256_loadu_si256 ((const __m256i *)(w + i + 1));
+		unsigned int	m = _mm256_movemask_ps (_mm256_castsi256_ps (_mm256_cmpeq_epi32 (a, b)));
+
+		if (m)
+		{
+			return i + lowestBit (m);
+		}
+		i += 8;
+	}
+	i += findRepeat32C ((const pixel32 *)(w + i), count - i);
+	return i;
+}
+
+PIXCONV_TGTAVX2 static void swap16AVX2 (uint8 *p, long count)
+{
+	const __m256i	shuf = _mm256_setr_epi8 (1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+											 1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+
+	while (count >= 16)
+	{
+		_mm256_storeu_si256 ((__m256i *)p, _mm256_shuffle_epi8 (_mm256_loadu_si256 ((const __m256i *)p), shuf));
+		p     += 32;
+		count -= 16;
+	}
+	swap16SSE2 (p, count);
+}
+
+PIXCONV_TGTAVX2 static void swap32AVX2 (uint8 *p, long count)
+{
+	const __m256i	shuf = _mm256_setr_epi8 (3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+											 3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+
+	while (count >= 8)
+	{
+		_mm256_storeu_si256 ((__m256i *)p, _mm256_shuffle_epi8 (_mm256_loadu_si256 ((const __m256i *)p), shuf));
+		p     += 32;
+		count -= 8;
+	}
+	swap32SSSE3 (p, count);
+}
+
+#endif /* PIXCONV_AVX2 */
+
+/*********************************************************************
+ *
+ * readCPUFeatures
+ *
+ * SYNOPSIS
+ *		static int readCPUFeatures (void)
+ *
+ * PURPOSE
+ *		Ask the CPU which of the instruction sets we use it has.  AVX2
+ *		also needs the OS to save the YMM registers.
+ *
+ * RETURN VALUE
+ *		PIXCONV_CPU_??? flags
+ *
+*/
+static int readCPUFeatures (void)
+{
+	unsigned int	ecx;
+	unsigned int	edx;
+	unsigned int	ebx7 = 0;
+	int				features = 0;
+
+	#if defined(_MSC_VER)
+	{
+		int	info[4];
+
+		__cpuid (info, 0);
+		if (info[0] >= 7)
+		{
+			__cpuidex (info, 7, 0);
+			ebx7 = (unsigned int)info[1];
+		}
+		__cpuid (info, 1);
+		ecx = (unsigned int)info[2];
+		edx = (unsigned int)info[3];
+	}
+	#else
+	{
+		unsigned int	eax;
+		unsigned int	ebx;
+
+		if (!__get_cpuid (1, &eax, &ebx, &ecx, &edx))
+		{
+			return 0;
+		}
+		if (__get_cpuid_max (0, NULL) >= 7)
+		{
+			unsigned int	ecx7;
+			unsigned int	edx7;
+
+			__cpuid_count (7, 0, eax, ebx7, ecx7, edx7);
+		}
+	}
+	#endif
+
+	if (edx & (1 << 26))
+	{
+		features |= PIXCONV_CPU_SSE2;
+	}
+	if (ecx & (1 << 9))
+	{
+		features |= PIXCONV_CPU_SSSE3;
+	}
+
+	#if PIXCONV_AVX2
+		// OSXSAVE and AVX, then check the OS saves XMM and YMM state
+		if ((ecx & (1 << 27)) && (ecx & (1 << 28)) && (ebx7 & (1 << 5)))
+		{
+			unsigned int	xcr0;
+
+			#if defined(_MSC_VER)
+				xcr0 = (unsigned int)_xgetbv (0);
+			#else
+				__asm__ ("xgetbv" : "=a" (xcr0) : "c" (0) : "edx");
+			#endif
+
+			if ((xcr0 & 6) == 6)
+			{
+				features |= PIXCONV_CPU_AVX2;
+			}
+		}
+	#endif
+
+	return features;
+}
+// readCPUFeatures
+
+#endif /* PIXCONV_X86 */
+
+#if PIXCONV_NEON
+
+/*
+ * NEON versions.  The structure loads and stores do the interleaving.
+ */
+
+static void bgr24NEON (pixel32 *d, const uint8 *s, long count)
+{
+	uint8x16_t	alpha = vdupq_n_u8 (255);
+
+	while (count >= 16)
+	{
+		uint8x16x3_t	bgr = vld3q_u8 (s);
+		uint8x16x4_t	out;
+
+		#if _EL_OS_WIN32__
+			out.val[0] = bgr.val[0];
+			out.val[2] = bgr.val[2];
+		#else
+			out.val[0] = bgr.val[2];
+			out.val[2] = bgr.val[0];
+		#endif
+		out.val[1] = bgr.val[1];
+		out.val[3] = alpha;
+		vst4q_u8 ((uint8 *)d, out);
+		d     += 16;
+		s     += 48;
+		count -= 16;
+	}
+	bgr24C (d, s, count);
+}
+
+static void bgra32NEON (pixel32 *d, const uint8 *s, long count)
+{
+	#if _EL_OS_WIN32__
+		memcpy (d, s, count * sizeof (pixel32));
+	#else
+		while (count >= 16)
+		{
+			uint8x16x4_t	v = vld4q_u8 (s);
+			uint8x16_t		t = v.val[0];
+
+			v.val[0] = v.val[2];
+			v.val[2] = t;
+			vst4q_u8 ((uint8 *)d, v);
+			d     += 16;
+			s     += 64;
+			count -= 16;
+		}
+		bgra32C (d, s, count);
+	#endif
+}
+
+static void grey8NEON (pixel32 *d, const uint8 *s, long count)
+{
+	uint8x16x4_t	out;
+
+	out.val[3] = vdupq_n_u8 (255);
+	while (count >= 16)
+	{
+		uint8x16_t	k = vld1q_u8 (s);
+
+		out.val[0] = k;
+		out.val[1] = k;
+		out.val[2] = k;
+		vst4q_u8 ((uint8 *)d, out);
+		d     += 16;
+		s     += 16;
+		count -= 16;
+	}
+	grey8C (d, s, count);
+}
+
+static void bgr555NEON (pixel32 *d, const uint8 *s, long count, int fAlpha)
+{
+	uint16x8_t	mask5 = vdupq_n_u16 (0x1F);
+
+	while (count >= 8)
+	{
+		uint16x8_t	v = vreinterpretq_u16_u8 (vld1q_u8 (s));
+		uint16x8_t	r = vandq_u16 (vshrq_n_u16 (v, 10), mask5);
+		uint16x8_t	g = vandq_u16 (vshrq_n_u16 (v,  5), mask5);
+		uint16x8_t	b = vandq_u16 (v, mask5);
+		uint8x8x4_t	out;
+		uint8x8_t	rr = vmovn_u16 (vorrq_u16 (vshlq_n_u16 (r, 3), vshrq_n_u16 (r, 2)));
+		uint8x8_t	bb = vmovn_u16 (vorrq_u16 (vshlq_n_u16 (b, 3), vshrq_n_u16 (b, 2)));
+
+		#if _EL_OS_WIN32__
+			out.val[0] = bb;
+			out.val[2] = rr;
+		#else
+			out.val[0] = rr;
+			out.val[2] = bb;
+		#endif
+		out.val[1] = vmovn_u16 (vorrq_u16 (vshlq_n_u16 (g, 3), vshrq_n_u16 (g, 2)));
+		out.val[3] = fAlpha ? vmovn_u16 (vreinterpretq_u16_s16 (vshrq_n_s16 (vreinterpretq_s16_u16 (v), 15)))
+							: vdup_n_u8 (255);
+		vst4_u8 ((uint8 *)d, out);
+		d     += 8;
+		s     += 16;
+		count -= 8;
+	}
+	bgr555C (d, s, count, fAlpha);
+}
+
+static void swap16NEON (uint8 *p, long count)
+{
+	while (count >= 8)
+	{
+		vst1q_u8 (p, vrev16q_u8 (vld1q_u8 (p)));
+		p     += 16;
+		count -= 8;
+	}
+	swap16C (p, count);
+}
+
+static void swap32NEON (uint8 *p, long count)
+{
+	while (count >= 4)
+	{
+		vst1q_u8 (p, vrev32q_u8 (vld1q_u8 (p)));
+		p     += 16;
+		count -= 4;
+	}
+	swap32C (p, count);
+}
+
+#endif /* PIXCONV_NEON */
+
+/*********************************************************************
+ *
+ * selectKernels
+ *
+ * SYNOPSIS
+ *		static void selectKernels (int features)
+ *
+ * PURPOSE
+ *		Point each kernel at the best version the given features allow.
+ *
+*/
+static void selectKernels (int features)
+{
+	s_pfnFill32 = fill32C;
+	s_pfnBGR24  = bgr24C;
+	s_pfnBGRA32 = bgra32C;
+	s_pfnGrey8  = grey8C;
+	s_pfnBGR555 = bgr555C;
+	s_pfnIndex8 = index8C;
+
+	s_pfnRunLength32  = runLength32C;
+	s_pfnFindRepeat32 = findRepeat32C;
+	s_pfnRunLength8   = runLength8C;
+	s_pfnFindRepeat8  = findRepeat8C;
+
+	s_pfnSwap16 = swap16C;
+	s_pfnSwap32 = swap32C;
+
+	#if PIXCONV_X86
+		if (features & PIXCONV_CPU_SSE2)
+		{
+			s_pfnFill32 = fill32SSE2;
+			s_pfnBGRA32 = bgra32SSE2;
+			s_pfnGrey8  = grey8SSE2;
+			s_pfnBGR555 = bgr555SSE2;
+
+			s_pfnRunLength32  = runLength32SSE2;
+			s_pfnFindRepeat32 = findRepeat32SSE2;
+			s_pfnRunLength8   = runLength8SSE2;
+			s_pfnFindRepeat8  = findRepeat8SSE2;
+
+			s_pfnSwap16 = swap16SSE2;
+			s_pfnSwap32 = swap32SSE2;
+		}
+		if (features & PIXCONV_CPU_SSSE3)
+		{
+			s_pfnBGR24  = bgr24SSSE3;
+			s_pfnSwap32 = swap32SSSE3;
+		}
+		#if PIXCONV_AVX2
+			if (features & PIXCONV_CPU_AVX2)
+			{
+				s_pfnBGR24  = bgr24AVX2;
+				s_pfnIndex8 = index8AVX2;
+
+				s_pfnRunLength32  = runLength32AVX2;
+				s_pfnFindRepeat32 = findRepeat32AVX2;
+
+				s_pfnSwap16 = swap16AVX2;
+				s_pfnSwap32 = swap32AVX2;
+			}
+		#endif
+	#endif
+
+	#if PIXCONV_NEON
+		if (features & PIXCONV_CPU_NEON)
+		{
+			s_pfnBGR24  = bgr24NEON;
+			s_pfnBGRA32 = bgra32NEON;
+			s_pfnGrey8  = grey8NEON;
+			s_pfnBGR555 = bgr555NEON;
+
+			s_pfnSwap16 = swap16NEON;
+			s_pfnSwap32 = swap32NEON;
+		}
+	#endif
+
+	s_features = features;
+}
+// selectKernels
+
+/*********************************************************************
+ *
+ * availableFeatures
+ *
+ * SYNOPSIS
+ *		static int availableFeatures (void)
+ *
+ * PURPOSE
+ *		All the PIXCONV_CPU_??? kernels this CPU can run.
+ *
+*/
+static int availableFeatures (void)
+{
+	#if PIXCONV_X86
+		return readCPUFeatures ();
+	#elif PIXCONV_NEON
+		return PIXCONV_CPU_NEON;
+	#else
+		return 0;
+	#endif
+}
+// availableFeatures
+
+/*********************************************************************
+ *
+ * PixConv_Init
+ *
+ * SYNOPSIS
+ *		static void PixConv_Init (void)
+ *
+ * PURPOSE
+ *		Pick kernels for this CPU.  Called by the first kernel used.
+ *		Running it twice from two threads is harmless, both pick the
+ *		same kernels.
+ *
+*/
+static void PixConv_Init (void)
+{
+	selectKernels (availableFeatures ());
+	s_fInit = TRUE;
+}
+// PixConv_Init
+
+#define PIXCONV_INIT()	if (!s_fInit) PixConv_Init ()
+
+/*********************************************************************
+ *
+ * PixConv_CPUFeatures
+ *
+ * SYNOPSIS
+ *		int PixConv_CPUFeatures (void)
+ *
+ * PURPOSE
+ *		Which PIXCONV_CPU_??? kernels are in use.
+ *
+*/
+int PixConv_CPUFeatures (void)
+{
+	PIXCONV_INIT();
+	return s_features;
+}
+// PixConv_CPUFeatures
+
+/*********************************************************************
+ *
+ * PixConv_SetCPUFeatures
+ *
+ * SYNOPSIS
+ *		void PixConv_SetCPUFeatures (int features)
+ *
+ * PURPOSE
+ *		Limit the kernels to the given PIXCONV_CPU_??? flags.  Pass 0
+ *		to use only the C versions (for timing or checking results).
+ *		Flags the CPU doesn't have are ignored.
+ *
+*/
+void PixConv_SetCPUFeatures (int features)
+{
+	selectKernels (features & availableFeatures ());
+	s_fInit = TRUE;
+}
+// PixConv_SetCPUFeatures
+
+/*********************************************************************
+ *
+ * PixConv_Fill32
+ *
+ * SYNOPSIS
+ *		void PixConv_Fill32 (pixel32 *d, pixel32 p, long count)
+ *
+ * PURPOSE
+ *		Set count pixels to p.
+ *
+*/
+void PixConv_Fill32 (pixel32 *d, pixel32 p, long count)
+{
+	PIXCONV_INIT();
+	s_pfnFill32 (d, p, count);
+}
+// PixConv_Fill32
+
+/*********************************************************************
+ *
+ * PixConv_BGR24
+ *
+ * SYNOPSIS
+ *		void PixConv_BGR24 (pixel32 *d, const uint8 *s, long count)
+ *
+ * PURPOSE
+ *		Convert count B,G,R pixels to pixel32 with alpha 255.
+ *
+*/
+void PixConv_BGR24 (pixel32 *d, const uint8 *s, long count)
+{
+	PIXCONV_INIT();
+	s_pfnBGR24 (d, s, count);
+}
+// PixConv_BGR24
+
+/*********************************************************************
+ *
+ * PixConv_BGRA32
+ *
+ * SYNOPSIS
+ *		void PixConv_BGRA32 (pixel32 *d, const uint8 *s, long count)
+ *
+ * PURPOSE
+ *		Convert count B,G,R,A pixels to pixel32.
+ *
+*/
+void PixConv_BGRA32 (pixel32 *d, const uint8 *s, long count)
+{
+	PIXCONV_INIT();
+	s_pfnBGRA32 (d, s, count);
+}
+// PixConv_BGRA32
+
+/*********************************************************************
+ *
+ * PixConv_BGR555
+ *
+ * SYNOPSIS
+ *		void PixConv_BGR555 (pixel32 *d, const uint8 *s, long count, int fAlpha)
+ *
+ * PURPOSE
+ *		Convert count little endian A1R5G5B5 pixels to pixel32.  If
+ *		fAlpha is FALSE the top bit is ignored and alpha is 255,
+ *		otherwise alpha is 0 or 255 from the top bit.
+ *
+*/
+void PixConv_BGR555 (pixel32 *d, const uint8 *s, long count, int fAlpha)
+{
+	PIXCONV_INIT();
+	s_pfnBGR555 (d, s, count, fAlpha);
+}
+// PixConv_BGR555
+
+/*********************************************************************
+ *
+ * PixConv_Grey8
+ *
+ * SYNOPSIS
+ *		void PixConv_Grey8 (pixel32 *d, const uint8 *s, long count)
+ *
+ * PURPOSE
+ *		Convert count grey levels to pixel32 with alpha 255.
+ *
+*/
+void PixConv_Grey8 (pixel32 *d, const uint8 *s, long count)
+{
+	PIXCONV_INIT();
+	s_pfnGrey8 (d, s, count);
+}
+// PixConv_Grey8
+
+/*********************************************************************
+ *
+ * PixConv_Index8
+ *
+ * SYNOPSIS
+ *		void PixConv_Index8 (pixel32 *d, const uint8 *s, long count, const pixel32 *colorMap)
+ *
+ * PURPOSE
+ *		Look up count color indices in a 256 entry colorMap.  Uses the
+ *		AVX2 gather if there is one, otherwise unrolled C.
+ *
+*/
+void PixConv_Index8 (pixel32 *d, const uint8 *s, long count, const pixel32 *colorMap)
+{
+	PIXCONV_INIT();
+	s_pfnIndex8 (d, s, count, colorMap);
+}
+// PixConv_Index8
+
+/*********************************************************************
+ *
+ * PixConv_ToBGRA32
+ *
+ * SYNOPSIS
+ *		void PixConv_ToBGRA32 (uint8 *d, const pixel32 *s, long count)
+ *
+ * PURPOSE
+ *		Convert count pixel32s to B,G,R,A bytes for writing.  Swapping
+ *		red and blue is its own inverse so this is PixConv_BGRA32 the
+ *		other way round.
+ *
+*/
+void PixConv_ToBGRA32 (uint8 *d, const pixel32 *s, long count)
+{
+	PIXCONV_INIT();
+	s_pfnBGRA32 ((pixel32 *)d, (const uint8 *)s, count);
+}
+// PixConv_ToBGRA32
+
+/*********************************************************************
+ *
+ * PixConv_RunLength32
+ *
+ * SYNOPSIS
+ *		long PixConv_RunLength32 (const pixel32 *p, long count)
+ *
+ * PURPOSE
+ *		How many of the first count pixels are the same as p[0].
+ *
+ * RETURN VALUE
+ *		1 to count, 0 if count is 0.
+ *
+*/
+long PixConv_RunLength32 (const pixel32 *p, long count)
+{
+	PIXCONV_INIT();
+	return s_pfnRunLength32 (p, count);
+}
+// PixConv_RunLength32
+
+/*********************************************************************
+ *
+ * PixConv_FindRepeat32
+ *
+ * SYNOPSIS
+ *		long PixConv_FindRepeat32 (const pixel32 *p, long count)
+ *
+ * PURPOSE
+ *		Find the first pixel of the first count that is the same as
+ *		the one after it, where a run starts.
+ *
+ * RETURN VALUE
+ *		Its index or count if there isn't one.
+ *
+*/
+long PixConv_FindRepeat32 (const pixel32 *p, long count)
+{
+	PIXCONV_INIT();
+	return s_pfnFindRepeat32 (p, count);
+}
+// PixConv_FindRepeat32
+
+/*********************************************************************
+ *
+ * PixConv_RunLength8
+ *
+ * SYNOPSIS
+ *		long PixConv_RunLength8 (const uint8 *p, long count)
+ *
+ * PURPOSE
+ *		PixConv_RunLength32 for bytes.
+ *
+*/
+long PixConv_RunLength8 (const uint8 *p, long count)
+{
+	PIXCONV_INIT();
+	return s_pfnRunLength8 (p, count);
+}
+// PixConv_RunLength8
+
+/*********************************************************************
+ *
+ * PixConv_FindRepeat8
+ *
+ * SYNOPSIS
+ *		long PixConv_FindRepeat8 (const uint8 *p, long count)
+ *
+ * PURPOSE
+ *		PixConv_FindRepeat32 for bytes.
+ *
+*/
+long PixConv_FindRepeat8 (const uint8 *p, long count)
+{
+	PIXCONV_INIT();
+	return s_pfnFindRepeat8 (p, count);
+}
+// PixConv_FindRepeat8
+
+/*********************************************************************
+ *
+ * PixConv_Swap16
+ *
+ * SYNOPSIS
+ *		void PixConv_Swap16 (void *p, long count)
+ *
+ * PURPOSE
+ *		Reverse the byte order of count 16 bit words in place.  p
+ *		does not need to be aligned.
+ *
+*/
+void PixConv_Swap16 (void *p, long count)
+{
+	PIXCONV_INIT();
+	s_pfnSwap16 ((uint8 *)p, count);
+}
+// PixConv_Swap16
+
+/*********************************************************************
+ *
+ * PixConv_Swap32
+ *
+ * SYNOPSIS
+ *		void PixConv_Swap32 (void *p, long count)
+ *
+ * PURPOSE
+ *		Reverse the byte order of count 32 bit words in place.  p
+ *		does not need to be aligned.
+ *
+*/
+void PixConv_Swap32 (void *p, long count)
+{
+	PIXCONV_INIT();
+	s_pfnSwap32 ((uint8 *)p, count);
+}
+// PixConv_Swap32
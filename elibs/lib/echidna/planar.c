@@ -0,0 +1,1101 @@
+/*************************************************************************
+ *                                                                       *
+ *                               PLANAR.C                                *
+ *                                                                       *
+ *************************************************************************
+
+		Copyright (c) 1996-2008, Echidna
+
+		All rights reserved.
+
+		Redistribution and use in source and binary forms, with or
+		without modification, are permitted provided that the following
+		conditions are met:
+
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer
+		  in the documentation and/or other materials provided with the
+		  distribution.
+
+		THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+		CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+		INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+		MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+		DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+		BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+		EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+		TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+		DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+		ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+		OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+		OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+		POSSIBILITY OF SUCH DAMAGE.
+
+
+   DESCRIPTION
+		Planar pictures.  Each component has its own plane of bytes
+		with every row aligned and padded to PLANAR_ALIGN, so a kernel
+		works on 16 reds (or greens...) per vector with no gathering
+		and no tail loop.  Only the conversions to and from interleaved
+		pixels have to worry about the end of a row.
+
+		gfshrink scales and gf16bit tests transparency and reduces to
+		5 bits with these.  They give the same results as the loops
+		over RGBADATA those tools had.  Like pixconv the x86
+		versions are used if PixConv_CPUFeatures says the CPU has SSE2,
+		so PixConv_SetCPUFeatures (0) checks them against the C.
+
+   PROGRAMMERS
+
+
+   FUNCTIONS
+
+   TABS : 5 9
+
+   HISTORY
+		10/17/26 : Created.
+
+ *************************************************************************/
+
+/**************************** I N C L U D E S ****************************/
+
+#include "platform.h"
+#include "switches.h"
+#include "echidna/ensure.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "echidna/planar.h"
+#include "echidna/pixconv.h"
+#include "echidna/eerrors.h"
+#include "echidna/ethread.h"
+
+#if EL_USE_SIMD && (defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)) && (!defined(_MSC_VER) || _MSC_VER >= 1500)
+	#define PLANAR_X86	1
+#else
+	#define PLANAR_X86	0
+#endif
+
+#if PLANAR_X86
+	#include <emmintrin.h>
+#endif
+
+/*************************** C O N S T A N T S ***************************/
+
+// images smaller than this aren't worth handing to other threads
+#define PLANAR_MIN_PARALLEL_PIXELS	(64 * 1024)
+// jobs per thread so a slow band doesn't hold everyone up
+#define PLANAR_JOBS_PER_THREAD		4
+
+/******************************* T Y P E S *******************************/
+
+typedef struct DitherJob
+{
+	PlanarImage			*d;
+	const PlanarImage	*s;
+	long				*err[3];	// two rows of errors per plane
+} DitherJob;
+
+typedef struct ScaleJob
+{
+	PlanarImage			*d;
+	const PlanarImage	*s;
+	const uint8			*opaque;	// plane like s's, NULL if all opaque
+	const PlanarKey		*pKey;
+	float				 dyStep;
+	float				 dxyArea;
+	const long			*xFirst;	// first source column of each column of d
+	const long			*xCount;	// how many source columns
+	const float			*xWeight;	// their weights, xCount[x] for each x
+	const long			*xWeightStart;
+	long				 rowsPerJob;
+} ScaleJob;
+
+/****************************** M A C R O S ******************************/
+
+// gcc needs to be told it may use the instructions in a function,
+// VC++ always lets you use the intrinsics
+#if PLANAR_X86 && !defined(_MSC_VER)
+	#define PLANAR_SSE2	__attribute__((target("sse2")))
+#else
+	#define PLANAR_SSE2
+#endif
+
+#if PLANAR_X86
+	#define USE_SSE2()	(PixConv_CPUFeatures () & PIXCONV_CPU_SSE2)
+#else
+	#define USE_SSE2()	FALSE
+#endif
+
+// first PLANAR_ALIGN boundary at or after p
+#define ALIGN_PTR(p)	((uint8 *)(((size_t)(p) + PLANAR_ALIGN - 1) & ~(size_t)(PLANAR_ALIGN - 1)))
+
+// round to the nearest, halves up
+#define ROUND(a)	floor((a) + 0.5)
+
+/***************************** G L O B A L S *****************************/
+
+// byte in a pixel each plane comes from
+static const int s_pixel32Offset[4] =
+{
+	offsetof (pixel32, red),
+	offsetof (pixel32, green),
+	offsetof (pixel32, blue),
+	offsetof (pixel32, alpha),
+};
+static const int s_rgbaOffset[4] = { 0, 1, 2, 3, };
+
+/**************************** R O U T I N E S ****************************/
+
+/*
+ * Plain C versions.  s and d are indexed by byte position in the
+ * pixel, not by plane.
+ */
+
+static void splitRowC (uint8 **d, const uint8 *s, long count)
+{
+	long	x;
+
+	for (x = 0; x < count; x++, s += 4)
+	{
+		d[0][x] = s[0];
+		d[1][x] = s[1];
+		d[2][x] = s[2];
+		d[3][x] = s[3];
+	}
+}
+
+static void mergeRowC (uint8 *d, const uint8 **s, long count)
+{
+	long	x;
+
+	for (x = 0; x < count; x++, d += 4)
+	{
+		d[0] = s[0][x];
+		d[1] = s[1][x];
+		d[2] = s[2][x];
+		d[3] = s[3][x];
+	}
+}
+
+// 255 where the pixel is opaque, 0 where pKey says it's transparent.
+// d can be a.
+static void opacityRowC (uint8 *d, const uint8 *r, const uint8 *g, const uint8 *b, const uint8 *a, long count, const PlanarKey *pKey)
+{
+	long	x;
+
+	for (x = 0; x < count; x++)
+	{
+		int	fTrans = FALSE;
+
+		switch (pKey->kind)
+		{
+		case PLANAR_KEY_ALPHALOW:
+			fTrans = a[x] <= pKey->alpha;
+			break;
+		case PLANAR_KEY_ALPHAHIGH:
+			fTrans = a[x] >= pKey->alpha;
+			break;
+		case PLANAR_KEY_RGB:
+			fTrans = r[x] == pKey->red && g[x] == pKey->green && b[x] == pKey->blue;
+			break;
+		}
+		d[x] = fTrans ? 0 : 255;
+	}
+}
+
+// round up the low 3 bits unless that would overflow, then drop them
+static void reduceRowC (uint8 *d, const uint8 *s, long count)
+{
+	long	x;
+
+	for (x = 0; x < count; x++)
+	{
+		d[x] = (uint8)(((s[x] & 0xF8) < 0xF8 ? s[x] + 4 : s[x]) & 0xF8);
+	}
+}
+
+#if PLANAR_X86
+
+/*
+ * x86 versions.  The ones that only touch planes run over the row
+ * padding instead of stopping at count.
+ */
+
+PLANAR_SSE2 static void splitRowSSE2 (uint8 **d, const uint8 *s, long count)
+{
+	long	x;
+
+	// 16 pixels of xyzw become 16 x's, 16 y's... in four rounds of
+	// byte interleaving
+	for (x = 0; x + 16 <= count; x += 16, s += 64)
+	{
+		__m128i	a = _mm_loadu_si128 ((const __m128i *)(s +  0));
+		__m128i	b = _mm_loadu_si128 ((const __m128i *)(s + 16));
+		__m128i	c = _mm_loadu_si128 ((const __m128i *)(s + 32));
+		__m128i	e = _mm_loadu_si128 ((const __m128i *)(s + 48));
+		__m128i	t0 = _mm_unpacklo_epi8 (a, b);
+		__m128i	t1 = _mm_unpackhi_epi8 (a, b);
+		__m128i	t2 = _mm_unpacklo_epi8 (c, e);
+		__m128i	t3 = _mm_unpackhi_epi8 (c, e);
+		__m128i	u0 = _mm_unpacklo_epi8 (t0, t1);
+		__m128i	u1 = _mm_unpackhi_epi8 (t0, t1);
+		__m128i	u2 = _mm_unpacklo_epi8 (t2, t3);
+		__m128i	u3 = _mm_unpackhi_epi8 (t2, t3);
+		__m128i	v0 = _mm_unpacklo_epi8 (u0, u1);
+		__m128i	v1 = _mm_unpackhi_epi8 (u0, u1);
+		__m128i	v2 = _mm_unpacklo_epi8 (u2, u3);
+		__m128i	v3 = _mm_unpackhi_epi8 (u2, u3);
+
+		_mm_store_si128 ((__m128i *)(d[0] + x), _mm_unpacklo_epi64 (v0, v2));
+		_mm_store_si128 ((__m128i *)(d[1] + x), _mm_unpackhi_epi64 (v0, v2));
+		_mm_store_si128 ((__m128i *)(d[2] + x), _mm_unpacklo_epi64 (v1, v3));
+		_mm_store_si128 ((__m128i *)(d[3] + x), _mm_unpackhi_epi64 (v1, v3));
+	}
+	if (x < count)
+	{
+		uint8	*t[4];
+
+		t[0] = d[0] + x;
+		t[1] = d[1] + x;
+		t[2] = d[2] + x;
+		t[3] = d[3] + x;
+		splitRowC (t, s, count - x);
+	}
+}
+
+PLANAR_SSE2 static void mergeRowSSE2 (uint8 *d, const uint8 **s, long count)
+{
+	long	x;
+
+	for (x = 0; x + 16 <= count; x += 16, d += 64)
+	{
+		__m128i	p0 = _mm_load_si128 ((const __m128i *)(s[0] + x));
+		__m128i	p1 = _mm_load_si128 ((const __m128i *)(s[1] + x));
+		__m128i	p2 = _mm_load_si128 ((const __m128i *)(s[2] + x));
+		__m128i	p3 = _mm_load_si128 ((const __m128i *)(s[3] + x));
+		__m128i	t0 = _mm_unpacklo_epi8 (p0, p1);
+		__m128i	t1 = _mm_unpackhi_epi8 (p0, p1);
+		__m128i	t2 = _mm_unpacklo_epi8 (p2, p3);
+		__m128i	t3 = _mm_unpackhi_epi8 (p2, p3);
+
+		_mm_storeu_si128 ((__m128i *)(d +  0), _mm_unpacklo_epi16 (t0, t2));
+		_mm_storeu_si128 ((__m128i *)(d + 16), _mm_unpackhi_epi16 (t0, t2));
+		_mm_storeu_si128 ((__m128i *)(d + 32), _mm_unpacklo_epi16 (t1, t3));
+		_mm_storeu_si128 ((__m128i *)(d + 48), _mm_unpackhi_epi16 (t1, t3));
+	}
+	if (x < count)
+	{
+		const uint8	*t[4];
+
+		t[0] = s[0] + x;
+		t[1] = s[1] + x;
+		t[2] = s[2] + x;
+		t[3] = s[3] + x;
+		mergeRowC (d, t, count - x);
+	}
+}
+
+PLANAR_SSE2 static void opacityRowSSE2 (uint8 *d, const uint8 *r, const uint8 *g, const uint8 *b, const uint8 *a, long count, const PlanarKey *pKey)
+{
+	const __m128i	ones = _mm_set1_epi8 (-1);
+	const __m128i	ka   = _mm_set1_epi8 ((char)pKey->alpha);
+	const __m128i	kr   = _mm_set1_epi8 ((char)pKey->red);
+	const __m128i	kg   = _mm_set1_epi8 ((char)pKey->green);
+	const __m128i	kb   = _mm_set1_epi8 ((char)pKey->blue);
+	long			x;
+
+	for (x = 0; x < count; x += 16)
+	{
+		__m128i	trans;
+
+		switch (pKey->kind)
+		{
+		case PLANAR_KEY_ALPHALOW:
+			{
+				__m128i	va = _mm_load_si128 ((const __m128i *)(a + x));
+
+				trans = _mm_cmpeq_epi8 (_mm_min_epu8 (va, ka), va);
+			}
+			break;
+		case PLANAR_KEY_ALPHAHIGH:
+			{
+				__m128i	va = _mm_load_si128 ((const __m128i *)(a + x));
+
+				trans = _mm_cmpeq_epi8 (_mm_max_epu8 (va, ka), va);
+			}
+			break;
+		case PLANAR_KEY_RGB:
+			trans = _mm_and_si128 (
+						_mm_and_si128 (
+							_mm_cmpeq_epi8 (_mm_load_si128 ((const __m128i *)(r + x)), kr),
+							_mm_cmpeq_epi8 (_mm_load_si128 ((const __m128i *)(g + x)), kg)),
+						_mm_cmpeq_epi8 (_mm_load_si128 ((const __m128i *)(b + x)), kb));
+			break;
+		default:
+			trans = _mm_setzero_si128 ();
+			break;
+		}
+		_mm_store_si128 ((__m128i *)(d + x), _mm_xor_si128 (trans, ones));
+	}
+}
+
+PLANAR_SSE2 static void reduceRowSSE2 (uint8 *d, const uint8 *s, long count)
+{
+	const __m128i	four = _mm_set1_epi8 (4);
+	const __m128i	mask = _mm_set1_epi8 ((char)0xF8);
+	long			x;
+
+	// a saturating add only clips values that already have all 5 high
+	// bits set, which is when the C version doesn't add
+	for (x = 0; x < count; x += 16)
+	{
+		__m128i	v = _mm_load_si128 ((const __m128i *)(s + x));
+
+		_mm_store_si128 ((__m128i *)(d + x), _mm_and_si128 (_mm_adds_epu8 (v, four), mask));
+	}
+}
+
+#endif
+
+/*********************************************************************
+ *
+ * splitPixels
+ *
+ * SYNOPSIS
+ *		static void splitPixels (PlanarImage *pi, const uint8 *s, const int *offset)
+ *
+ * PURPOSE
+ *		Copy interleaved 4 byte pixels into pi's planes.  offset says
+ *		which byte of a pixel each plane gets.
+ *
+*/
+static void splitPixels (PlanarImage *pi, const uint8 *s, const int *offset)
+{
+	int		fSSE2 = USE_SSE2 ();
+	long	y;
+
+	for (y = 0; y < pi->height; y++, s += pi->width * 4)
+	{
+		uint8	*d[4];
+		int		 p;
+
+		for (p = 0; p < 4; p++)
+		{
+			d[offset[p]] = PLANAR_ROW (pi, p, y);
+		}
+
+		#if PLANAR_X86
+			if (fSSE2)
+			{
+				splitRowSSE2 (d, s, pi->width);
+				continue;
+			}
+		#endif
+		splitRowC (d, s, pi->width);
+	}
+}
+// splitPixels
+
+/*********************************************************************
+ *
+ * mergePixels
+ *
+ * SYNOPSIS
+ *		static void mergePixels (uint8 *d, const PlanarImage *pi, const int *offset)
+ *
+ * PURPOSE
+ *		The other way from splitPixels.
+ *
+*/
+static void mergePixels (uint8 *d, const PlanarImage *pi, const int *offset)
+{
+	int		fSSE2 = USE_SSE2 ();
+	long	y;
+
+	for (y = 0; y < pi->height; y++, d += pi->width * 4)
+	{
+		const uint8	*s[4];
+		int			 p;
+
+		for (p = 0; p < 4; p++)
+		{
+			s[offset[p]] = PLANAR_ROW (pi, p, y);
+		}
+
+		#if PLANAR_X86
+			if (fSSE2)
+			{
+				mergeRowSSE2 (d, s, pi->width);
+				continue;
+			}
+		#endif
+		mergeRowC (d, s, pi->width);
+	}
+}
+// mergePixels
+
+/*********************************************************************
+ *
+ * opacityRow
+ *
+ * SYNOPSIS
+ *		static void opacityRow (uint8 *d, const PlanarImage *s, long y, const PlanarKey *pKey, int fSSE2)
+ *
+ * PURPOSE
+ *		Set row y of plane d to 255 for opaque pixels and 0 for ones
+ *		pKey says are transparent.  d must be padded like s's rows
+ *		and can be s's alpha row.
+ *
+*/
+static void opacityRow (uint8 *d, const PlanarImage *s, long y, const PlanarKey *pKey, int fSSE2)
+{
+	const uint8	*r = PLANAR_ROW (s, PLANAR_RED,   y);
+	const uint8	*g = PLANAR_ROW (s, PLANAR_GREEN, y);
+	const uint8	*b = PLANAR_ROW (s, PLANAR_BLUE,  y);
+	const uint8	*a = PLANAR_ROW (s, PLANAR_ALPHA, y);
+
+	#if PLANAR_X86
+		if (fSSE2)
+		{
+			opacityRowSSE2 (d, r, g, b, a, s->width, pKey);
+			return;
+		}
+	#endif
+	opacityRowC (d, r, g, b, a, s->width, pKey);
+}
+// opacityRow
+
+/*********************************************************************
+ *
+ * Planar_Create
+ *
+ * SYNOPSIS
+ *		int Planar_Create (PlanarImage *pi, long width, long height)
+ *
+ * PURPOSE
+ *		Allocate planes for a width by height picture.  The pixels
+ *		aren't cleared.
+ *
+ * RETURN VALUE
+ *		FALSE if out of memory.
+ *
+*/
+int Planar_Create (PlanarImage *pi, long width, long height)
+{
+	long	planeSize;
+	uint8	*p;
+	int		i;
+
+	pi->width  = width;
+	pi->height = height;
+	pi->stride = (width + PLANAR_ALIGN - 1) & ~(long)(PLANAR_ALIGN - 1);
+	if (!pi->stride)
+	{
+		pi->stride = PLANAR_ALIGN;
+	}
+	planeSize = pi->stride * (height ? height : 1);
+
+	pi->pMem = malloc (planeSize * 4 + PLANAR_ALIGN - 1);
+	if (!pi->pMem)
+	{
+		memset (pi->plane, 0, sizeof (pi->plane));
+		SetGlobalErr (ERR_GENERIC);
+		GEcatf ("Out of Memory making planar picture");
+		return FALSE;
+	}
+
+	p = ALIGN_PTR (pi->pMem);
+	for (i = 0; i < 4; i++)
+	{
+		pi->plane[i] = p + i * planeSize;
+	}
+	return TRUE;
+}
+// Planar_Create
+
+/*********************************************************************
+ *
+ * Planar_Destroy
+ *
+ * SYNOPSIS
+ *		void Planar_Destroy (PlanarImage *pi)
+ *
+ * PURPOSE
+ *		Free what Planar_Create allocated.
+ *
+*/
+void Planar_Destroy (PlanarImage *pi)
+{
+	free (pi->pMem);
+	pi->pMem = NULL;
+	memset (pi->plane, 0, sizeof (pi->plane));
+}
+// Planar_Destroy
+
+/*********************************************************************
+ *
+ * Planar_FromPixel32
+ *
+ * SYNOPSIS
+ *		void Planar_FromPixel32 (PlanarImage *pi, const pixel32 *s)
+ *
+ * PURPOSE
+ *		Fill pi from pi->width * pi->height pixel32s, like a
+ *		BlockO32BitPixels's rgba.
+ *
+*/
+void Planar_FromPixel32 (PlanarImage *pi, const pixel32 *s)
+{
+	splitPixels (pi, (const uint8 *)s, s_pixel32Offset);
+}
+// Planar_FromPixel32
+
+/*********************************************************************
+ *
+ * Planar_ToPixel32
+ *
+ * SYNOPSIS
+ *		void Planar_ToPixel32 (pixel32 *d, const PlanarImage *pi)
+ *
+ * PURPOSE
+ *		Copy pi into pi->width * pi->height pixel32s.
+ *
+*/
+void Planar_ToPixel32 (pixel32 *d, const PlanarImage *pi)
+{
+	mergePixels ((uint8 *)d, pi, s_pixel32Offset);
+}
+// Planar_ToPixel32
+
+/*********************************************************************
+ *
+ * Planar_FromRGBA
+ *
+ * SYNOPSIS
+ *		void Planar_FromRGBA (PlanarImage *pi, const uint8 *s)
+ *
+ * PURPOSE
+ *		Fill pi from pixels stored red, green, blue, alpha on every
+ *		platform, the way GFF RGBA chunks are.
+ *
+*/
+void Planar_FromRGBA (PlanarImage *pi, const uint8 *s)
+{
+	splitPixels (pi, s, s_rgbaOffset);
+}
+// Planar_FromRGBA
+
+/*********************************************************************
+ *
+ * Planar_ToRGBA
+ *
+ * SYNOPSIS
+ *		void Planar_ToRGBA (uint8 *d, const PlanarImage *pi)
+ *
+ * PURPOSE
+ *		Copy pi into red, green, blue, alpha pixels.
+ *
+*/
+void Planar_ToRGBA (uint8 *d, const PlanarImage *pi)
+{
+	mergePixels (d, pi, s_rgbaOffset);
+}
+// Planar_ToRGBA
+
+/*********************************************************************
+ *
+ * Planar_AlphaTest
+ *
+ * SYNOPSIS
+ *		void Planar_AlphaTest (PlanarImage *d, const PlanarImage *s, const PlanarKey *pKey)
+ *
+ * PURPOSE
+ *		Set d's alpha to 0 where pKey says s is transparent and 255
+ *		everywhere else.  d can be s.  d's other planes aren't
+ *		touched.
+ *
+*/
+void Planar_AlphaTest (PlanarImage *d, const PlanarImage *s, const PlanarKey *pKey)
+{
+	int		fSSE2 = USE_SSE2 ();
+	long	y;
+
+	for (y = 0; y < s->height; y++)
+	{
+		opacityRow (PLANAR_ROW (d, PLANAR_ALPHA, y), s, y, pKey, fSSE2);
+	}
+}
+// Planar_AlphaTest
+
+/*********************************************************************
+ *
+ * Planar_Reduce555
+ *
+ * SYNOPSIS
+ *		void Planar_Reduce555 (PlanarImage *d, const PlanarImage *s)
+ *
+ * PURPOSE
+ *		Round s's red, green and blue to 5 bits into d without
+ *		dithering.  Values that would round past 0xF8 stay 0xF8.
+ *		d can be s.  d's alpha isn't touched.
+ *
+*/
+void Planar_Reduce555 (PlanarImage *d, const PlanarImage *s)
+{
+	int		fSSE2 = USE_SSE2 ();
+	long	y;
+	int		p;
+
+	for (p = PLANAR_RED; p <= PLANAR_BLUE; p++)
+	{
+		for (y = 0; y < s->height; y++)
+		{
+			#if PLANAR_X86
+				if (fSSE2)
+				{
+					reduceRowSSE2 (PLANAR_ROW (d, p, y), PLANAR_ROW (s, p, y), s->width);
+					continue;
+				}
+			#endif
+			reduceRowC (PLANAR_ROW (d, p, y), PLANAR_ROW (s, p, y), s->width);
+		}
+	}
+}
+// Planar_Reduce555
+
+/*********************************************************************
+ *
+ * ditherJob
+ *
+ * SYNOPSIS
+ *		static void ditherJob (void *pUserData, int job)
+ *
+ * PURPOSE
+ *		Floyd-Steinberg dither plane job of a DitherJob to 5 bits.
+ *		The errors are 16.16 fixed point and 7/16, 3/16, 5/16 and
+ *		1/16 of each go right, down left, down and down right.  Each
+ *		error row has a spare entry at each end for the errors that
+ *		fall off the sides.
+ *
+*/
+static void ditherJob (void *pUserData, int job)
+{
+	DitherJob	*pdj   = (DitherJob *)pUserData;
+	long		 width = pdj->s->width;
+	long		*cur   = pdj->err[job] + 1;
+	long		*next  = cur + width + 2;
+	long		 y;
+
+	memset (pdj->err[job], 0, (width + 2) * 2 * sizeof (long));
+
+	for (y = 0; y < pdj->s->height; y++)
+	{
+		const uint8	*s = PLANAR_ROW (pdj->s, job, y);
+		uint8		*d = PLANAR_ROW (pdj->d, job, y);
+		const uint8	*a = PLANAR_ROW (pdj->d, PLANAR_ALPHA, y);
+		long		*t;
+		long		 x;
+
+		for (x = 0; x < width; x++)
+		{
+			long	value;
+			long	error;
+			uint8	u8Src;
+			uint8	u8Value;
+
+			// transparent pixels neither take nor pass on error
+			if (!a[x])
+			{
+				continue;
+			}
+
+			u8Src = s[x];	// d may be s
+			value = ((long)u8Src << 16) + cur[x];
+			if (value < 0)
+			{
+				u8Value = 0;
+			}
+			else if (value > (0xF8L << 16))
+			{
+				u8Value = 0xF8;
+			}
+			else
+			{
+				u8Value = (uint8)((value + 0x40000L) >> 16);
+			}
+			d[x] = (uint8)(u8Value & 0xF8);
+
+			error = ((long)u8Src - (long)d[x]) * 65536L;
+			cur[x + 1]  += error * 7 / 16;
+			next[x - 1] += error * 3 / 16;
+			next[x]     += error * 5 / 16;
+			next[x + 1] += error * 1 / 16;
+		}
+
+		t    = cur;
+		cur  = next;
+		next = t;
+		memset (next - 1, 0, (width + 2) * sizeof (long));
+	}
+}
+// ditherJob
+
+/*********************************************************************
+ *
+ * Planar_Dither555
+ *
+ * SYNOPSIS
+ *		int Planar_Dither555 (PlanarImage *d, const PlanarImage *s)
+ *
+ * PURPOSE
+ *		Reduce s's red, green and blue to 5 bits into d with error
+ *		diffusion.  Pixels whose alpha in d is 0 are skipped.  d can
+ *		be s.
+ *
+ *		Error diffusion goes pixel by pixel but the planes don't
+ *		depend on each other so they're done on separate threads.
+ *
+ * RETURN VALUE
+ *		FALSE if out of memory.
+ *
+*/
+int Planar_Dither555 (PlanarImage *d, const PlanarImage *s)
+{
+	DitherJob	dj;
+	long		rowErrs = (s->width + 2) * 2;
+	int			p;
+
+	dj.d = d;
+	dj.s = s;
+	dj.err[0] = (long *)malloc (rowErrs * 3 * sizeof (long));
+	if (!dj.err[0])
+	{
+		SetGlobalErr (ERR_GENERIC);
+		GEcatf ("Out of Memory dithering");
+		return FALSE;
+	}
+	dj.err[1] = dj.err[0] + rowErrs;
+	dj.err[2] = dj.err[1] + rowErrs;
+
+	if (s->width * s->height >= PLANAR_MIN_PARALLEL_PIXELS)
+	{
+		ETHREAD_ParallelFor (NULL, 3, ditherJob, &dj);
+	}
+	else
+	{
+		for (p = PLANAR_RED; p <= PLANAR_BLUE; p++)
+		{
+			ditherJob (&dj, p);
+		}
+	}
+
+	free (dj.err[0]);
+	return TRUE;
+}
+// Planar_Dither555
+
+/*********************************************************************
+ *
+ * Planar_ScaledSize
+ *
+ * SYNOPSIS
+ *		void Planar_ScaledSize (long width, long height, long xin, long xout, long yin, long yout, long *pWidth, long *pHeight)
+ *
+ * PURPOSE
+ *		How big Planar_Scale makes a width by height picture.  Any
+ *		part of a destination pixel counts.
+ *
+*/
+void Planar_ScaledSize (long width, long height, long xin, long xout, long yin, long yout, long *pWidth, long *pHeight)
+{
+	*pWidth  = (width  * xout + xin - 1) / xin;
+	*pHeight = (height * yout + yin - 1) / yin;
+}
+// Planar_ScaledSize
+
+/*********************************************************************
+ *
+ * scaleJob
+ *
+ * SYNOPSIS
+ *		static void scaleJob (void *pUserData, int job)
+ *
+ * PURPOSE
+ *		Scale one band of rows of a ScaleJob.  Each destination pixel
+ *		is the area weighted average of the source pixels under it.
+ *
+*/
+static void scaleJob (void *pUserData, int job)
+{
+	ScaleJob			*psj   = (ScaleJob *)pUserData;
+	const PlanarImage	*s     = psj->s;
+	PlanarImage			*d     = psj->d;
+	long				 yDst  = job * psj->rowsPerJob;
+	long				 yEnd  = yDst + psj->rowsPerJob;
+
+	if (yEnd > d->height)
+	{
+		yEnd = d->height;
+	}
+
+	for (; yDst < yEnd; yDst++)
+	{
+		float	yCrnt = yDst * psj->dyStep;
+		float	yNext = yCrnt + psj->dyStep;
+		long	yFirst = (long)floor (yCrnt);
+		long	yLast  = (long)ceil (yNext) - 1;
+		uint8	*dr = PLANAR_ROW (d, PLANAR_RED,   yDst);
+		uint8	*dg = PLANAR_ROW (d, PLANAR_GREEN, yDst);
+		uint8	*db = PLANAR_ROW (d, PLANAR_BLUE,  yDst);
+		uint8	*da = PLANAR_ROW (d, PLANAR_ALPHA, yDst);
+		long	xDst;
+
+		for (xDst = 0; xDst < d->width; xDst++)
+		{
+			long		 xFirst  = psj->xFirst[xDst];
+			long		 xCount  = psj->xCount[xDst];
+			const float	*xWeight = psj->xWeight + psj->xWeightStart[xDst];
+			float		 red   = 0.0f;
+			float		 green = 0.0f;
+			float		 blue  = 0.0f;
+			float		 alpha = 0.0f;
+			float		 nonPixels   = 0.0f;
+			float		 transPixels = 0.0f;
+			float		 actualArea;
+			float		 actualAlphaArea;
+			long		 ySrc;
+
+			for (ySrc = yFirst; ySrc <= yLast; ySrc++)
+			{
+				float	yAliasFactor = 1.0f;
+				long	i;
+
+				if ((float)ySrc < yCrnt)
+				{
+					yAliasFactor = (float)ySrc + 1.0f - yCrnt;
+				}
+				else if ((float)ySrc + 1.0f >= yNext)
+				{
+					yAliasFactor = yNext - (float)ySrc;
+				}
+
+				if (ySrc >= s->height)
+				{
+					for (i = 0; i < xCount; i++)
+					{
+						nonPixels += xWeight[i] * yAliasFactor;
+					}
+					continue;
+				}
+
+				{
+					const uint8	*sr = PLANAR_ROW (s, PLANAR_RED,   ySrc) + xFirst;
+					const uint8	*sg = PLANAR_ROW (s, PLANAR_GREEN, ySrc) + xFirst;
+					const uint8	*sb = PLANAR_ROW (s, PLANAR_BLUE,  ySrc) + xFirst;
+					const uint8	*sa = PLANAR_ROW (s, PLANAR_ALPHA, ySrc) + xFirst;
+					const uint8	*so = psj->opaque ? psj->opaque + ySrc * s->stride + xFirst : NULL;
+
+					for (i = 0; i < xCount; i++)
+					{
+						float	aliasFactor = xWeight[i] * yAliasFactor;
+
+						if (xFirst + i >= s->width)
+						{
+							nonPixels += aliasFactor;
+						}
+						else if (so && !so[i])
+						{
+							transPixels += aliasFactor;
+							alpha += (float)sa[i] * aliasFactor;
+						}
+						else
+						{
+							red   += (float)sr[i] * aliasFactor;
+							green += (float)sg[i] * aliasFactor;
+							blue  += (float)sb[i] * aliasFactor;
+							alpha += (float)sa[i] * aliasFactor;
+						}
+					}
+				}
+			}
+
+			// actualArea can come out a hair under 0 when all of the
+			// pixel is transparent
+			actualAlphaArea = psj->dxyArea - nonPixels;
+			actualArea      = actualAlphaArea - transPixels;
+			if (actualArea > 0.0f)
+			{
+				dr[xDst] = (uint8)ROUND(red   / actualArea);
+				dg[xDst] = (uint8)ROUND(green / actualArea);
+				db[xDst] = (uint8)ROUND(blue  / actualArea);
+			}
+			else
+			{
+				dr[xDst] = 0;
+				dg[xDst] = 0;
+				db[xDst] = 0;
+			}
+			da[xDst] = actualAlphaArea > 0.0f ? (uint8)ROUND(alpha / actualAlphaArea) : 0;
+
+			if (psj->pKey->kind == PLANAR_KEY_RGB && da[xDst] <= 127)
+			{
+				dr[xDst] = psj->pKey->red;
+				dg[xDst] = psj->pKey->green;
+				db[xDst] = psj->pKey->blue;
+			}
+		}
+	}
+}
+// scaleJob
+
+/*********************************************************************
+ *
+ * Planar_Scale
+ *
+ * SYNOPSIS
+ *		int Planar_Scale (PlanarImage *d, const PlanarImage *s, long xin, long xout, long yin, long yout, const PlanarKey *pKey)
+ *
+ * PURPOSE
+ *		Scale s by xout/xin across and yout/yin down into a new
+ *		picture d.  Pixels pKey says are transparent add to the alpha
+ *		but not the colour, and a pixel of d with no opaque area is
+ *		black.  With PLANAR_KEY_RGB pixels of d whose alpha comes out
+ *		127 or less are the key colour.  Free d with Planar_Destroy.
+ *
+ *		Which source columns are under each destination column and
+ *		how much of each is worked out once instead of per pixel, and
+ *		the transparency of the whole source is found up front with
+ *		the vector kernel.  Bands of rows are done on the thread pool.
+ *
+ * RETURN VALUE
+ *		FALSE if out of memory.
+ *
+*/
+int Planar_Scale (PlanarImage *d, const PlanarImage *s, long xin, long xout, long yin, long yout, const PlanarKey *pKey)
+{
+	ScaleJob	 sj;
+	float		 dxStep = (float)xin / (float)xout;
+	long		 width;
+	long		 height;
+	long		 numWeights;
+	long		 xDst;
+	long		*xFirst  = NULL;
+	float		*xWeight = NULL;
+	void		*opaqueMem = NULL;
+	int			 numJobs;
+	int			 result = FALSE;
+
+	Planar_ScaledSize (s->width, s->height, xin, xout, yin, yout, &width, &height);
+	if (!Planar_Create (d, width, height))
+	{
+		return FALSE;
+	}
+
+	// xFirst, xCount and xWeightStart for each column
+	xFirst = (long *)malloc ((width ? width : 1) * 3 * sizeof (long));
+	if (!xFirst)
+	{
+		goto cleanup;
+	}
+
+	numWeights = 0;
+	for (xDst = 0; xDst < width; xDst++)
+	{
+		float	xCrnt = xDst * dxStep;
+		float	xNext = xCrnt + dxStep;
+
+		xFirst[xDst]             = (long)floor (xCrnt);
+		xFirst[width + xDst]     = (long)ceil (xNext) - xFirst[xDst];
+		xFirst[width * 2 + xDst] = numWeights;
+		numWeights += xFirst[width + xDst];
+	}
+
+	xWeight = (float *)malloc ((numWeights ? numWeights : 1) * sizeof (float));
+	if (!xWeight)
+	{
+		goto cleanup;
+	}
+
+	for (xDst = 0; xDst < width; xDst++)
+	{
+		float	xCrnt = xDst * dxStep;
+		float	xNext = xCrnt + dxStep;
+		float	*w    = xWeight + xFirst[width * 2 + xDst];
+		long	 xSrc;
+
+		for (xSrc = xFirst[xDst]; xSrc < xFirst[xDst] + xFirst[width + xDst]; xSrc++)
+		{
+			float	xAliasFactor = 1.0f;
+
+			if ((float)xSrc < xCrnt)
+			{
+				xAliasFactor = (float)xSrc + 1.0f - xCrnt;
+			}
+			else if ((float)xSrc + 1.0f >= xNext)
+			{
+				xAliasFactor = xNext - (float)xSrc;
+			}
+			*w++ = xAliasFactor;
+		}
+	}
+
+	if (pKey->kind != PLANAR_KEY_NONE)
+	{
+		int		fSSE2 = USE_SSE2 ();
+		long	y;
+
+		opaqueMem = malloc (s->stride * (s->height ? s->height : 1) + PLANAR_ALIGN - 1);
+		if (!opaqueMem)
+		{
+			goto cleanup;
+		}
+		for (y = 0; y < s->height; y++)
+		{
+			opacityRow (ALIGN_PTR (opaqueMem) + y * s->stride, s, y, pKey, fSSE2);
+		}
+	}
+
+	sj.d            = d;
+	sj.s            = s;
+	sj.opaque       = opaqueMem ? ALIGN_PTR (opaqueMem) : NULL;
+	sj.pKey         = pKey;
+	sj.dyStep       = (float)yin / (float)yout;
+	sj.dxyArea      = dxStep * sj.dyStep;
+	sj.xFirst       = xFirst;
+	sj.xCount       = xFirst + width;
+	sj.xWeightStart = xFirst + width * 2;
+	sj.xWeight      = xWeight;
+	sj.rowsPerJob   = height ? height : 1;
+
+	if (width * height >= PLANAR_MIN_PARALLEL_PIXELS)
+	{
+		long	maxJobs = ETHREAD_PoolThreads (NULL) * PLANAR_JOBS_PER_THREAD;
+
+		sj.rowsPerJob = (height + maxJobs - 1) / maxJobs;
+	}
+	numJobs = (int)((height + sj.rowsPerJob - 1) / sj.rowsPerJob);
+
+	ETHREAD_ParallelFor (NULL, numJobs, scaleJob, &sj);
+
+	result = TRUE;
+
+cleanup:
+	if (!result)
+	{
+		SetGlobalErr (ERR_GENERIC);
+		GEcatf ("Out of Memory scaling");
+		Planar_Destroy (d);
+	}
+	free (opaqueMem);
+	free (xWeight);
+	free (xFirst);
+
+	return result;
+}
+// Planar_Scale
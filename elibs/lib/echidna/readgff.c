@@ -55,6 +55,8 @@
 #include "switches.h"
 #include "echidna/ensure.h"
 
+#include <string.h>
+
 #include "echidna/eio.h"
 #include "echidna/memsafe.h"
 #include "echidna/readgfx.h"
@@ -63,73 +65,1013 @@
 #include "echidna/memfile.h"
 #include "echidna/gff.h"
 #include "echidna/listapi.h"
+#include "echidna/pixconv.h"
+#include "echidna/ethread.h"
+#include "echidna/elz.h"
+#include "picpool.h"
 
 /*************************** C O N S T A N T S ***************************/
 
+#define GFF_WRITE_BUFFER_SIZE  (256 * 1024)   // most a writer stages before writing
+#define GFF_RGBZ_BAND_BYTES    (64 * 1024)    // about how much RGBA goes in each RGBZ band
 
 /******************************* T Y P E S *******************************/
 
+// Collects small writes so a chunk header and its data go out in one write.
+typedef struct {
+   int      fh;
+   UINT8   *buffer;
+   long     size;
+   long     used;
+   BOOL     fSwap;      // swap the byte order of what's written
+} GFFWRITER;
+
+// Where the bands of an RGBZ chunk are.
+typedef struct {
+   const UINT8 *pBands;       // first band
+   UINT32      *pBandSize;    // size of each band in this machine's order
+   UINT32      *pBandOffset;  // offset of each band from pBands
+   long        bandRows;
+   long        numBands;
+   long        width;
+   long        height;
+} RGBZINDEX;
+
+// One ETHREAD_ParallelFor of RGBZ bands.
+typedef struct {
+   const RGBZINDEX *pindex;
+   const UINT8 *prgba;        // encoding: the image
+   UINT8       *pDest;        // decoding: the image, encoding: band slots
+   long        slotSize;      // encoding: bytes for each band slot
+   BOOL        fPixel32;      // image is pixel32 not RGBADATA
+   int         fFailed;       // set by any job that fails
+} RGBZJOB;
+
+/************************** P R O T O T Y P E S **************************/
+
+void CHK_Write16Bit (int fh, UINT16 u16);
+void CHK_Write32Bit (int fh, UINT32 u32);
+
+/***************************** G L O B A L S *****************************/
+
+
+/****************************** M A C R O S ******************************/
+
+
+/**************************** R O U T I N E S ****************************/
+
+/*************************************************************************
+                             PChunkNodeOfId
+ *************************************************************************
+
+   SYNOPSIS
+		CHUNKNODE *PChunkNodeOfId (GFF *pgff, IDTYPE id)
+
+   PURPOSE
+      To find the chunknode of the chunk with the give id.  If the GFF
+      was read with GFFREAD_LAZY the chunk's data is read in.
+
+   INPUT
+		pgff :   Pointer to GFF struct to search.
+		id   :   id to find.
+
+   OUTPUT
+		None
+
+   EFFECTS
+		None
+
+   RETURNS
+      Pointer to chunknode on success. NULL on failure or if the
+      chunk's data couldn't be read.
+
+   SEE ALSO
+
+
+   HISTORY
+		08/05/96 : Created.
+
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+CHUNKNODE *PChunkNodeOfId (GFF *pgff, IDTYPE id)
+BEGINFUNC (PChunkNodeOfId)
+{
+   CHUNKNODE   *pchunknode;
+
+   for (pchunknode = (CHUNKNODE *)LST_Head(pgff->plistChunkNodes);
+         !LST_IsEOList(pchunknode);
+         pchunknode = (CHUNKNODE *)LST_Next(pchunknode))
+   {
+      CHUNKHEADER *pheader;
+
+      pheader = pchunknode->pchunk ? &pchunknode->pchunk->Header : &pchunknode->Header;
+      // An unread RGBZ chunk becomes RGBA when it's loaded.
+      if (pheader->id == id || (id == IDRGBA && pheader->id == IDRGBZ))
+      {
+         RETURN LoadGFFChunkNode (pgff, pchunknode) ? pchunknode : NULL;  
+      }
+   }
+	RETURN NULL;
+} ENDFUNC (PChunkNodeOfId)
+
+/*************************************************************************
+                              gffByteOrder
+ *************************************************************************
+
+   SYNOPSIS
+		static int gffByteOrder (UINT32 ByteOrder, BOOL *pfSwap)
+
+   PURPOSE
+      Check the ByteOrder field of a GGFF chunk as read and set *pfSwap
+      if the file was written by a machine of the other endian.
+
+   RETURNS
+      TRUE if ByteOrder is GFF_BYTE_ORDER either way round.
+
+   HISTORY
+		10/17/26 : Created.
+
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+static int gffByteOrder (UINT32 ByteOrder, BOOL *pfSwap)
+BEGINFUNC (gffByteOrder)
+{
+   *pfSwap = (ByteOrder == GFF_BYTE_ORDER_SWAPPED);
+   RETURN (*pfSwap || ByteOrder == GFF_BYTE_ORDER);
+} ENDFUNC (gffByteOrder)
+
+/*************************************************************************
+                              swapChunkData
+ *************************************************************************
+
+   SYNOPSIS
+		static void swapChunkData (IDTYPE id, void *pData, UINT32 Size, BOOL fNative)
+
+   PURPOSE
+      Swap the byte order of the words in a chunk's data.  GGFF has
+      some and RGBZ starts with its band index, RGBA, PNDX, PCON, PCN2
+      and INVP are all bytes so only their headers need swapping.
+      Chunks we don't know are left as they are.
+
+   INPUT
+		id      :   Chunk id.
+		pData   :   Chunk data.
+		Size    :   Bytes of data.
+		fNative :   TRUE if the data is in this machine's order now.
+
+   HISTORY
+		10/17/26 : Created.
+
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+static void swapChunkData (IDTYPE id, void *pData, UINT32 Size, BOOL fNative)
+BEGINPROC (swapChunkData)
+{
+   if (id == IDGGFF && Size >= sizeof (GGFFDATA))
+   {
+      GGFFDATA *pggff = (GGFFDATA *)pData;
+
+      PixConv_Swap32 (&pggff->ByteOrder, 1);
+      PixConv_Swap16 (&pggff->Width, 2);
+   }
+   else if (id == IDRGBZ && Size >= 2 * sizeof (UINT32))
+   {
+      UINT32 NumBands;
+
+      memcpy (&NumBands, (UINT8 *)pData + sizeof (UINT32), sizeof (UINT32));
+      if (!fNative)
+      {
+         PixConv_Swap32 (&NumBands, 1);
+      }
+      if (NumBands > Size / sizeof (UINT32) - 2)
+      {
+         NumBands = Size / sizeof (UINT32) - 2;
+      }
+      // BandRows, NumBands and the band sizes
+      PixConv_Swap32 (pData, 2 + NumBands);
+   }
+} ENDPROC (swapChunkData)
+
+/*************************************************************************
+                                readGGFF
+ *************************************************************************
+
+   SYNOPSIS
+		static int readGGFF (MEMFILE *mf, GGFFDATA *pggff, BOOL *pfSwap)
+
+   PURPOSE
+      Read the GGFF chunk at the start of a GFF file in memory, work
+      out its byte order and leave mf at the next chunk.
+
+   INPUT
+		mf     :   Memory file pointer.
+		pggff  :   Filled out in this machine's byte order.
+		pfSwap :   Set if the rest of the file needs swapping.
+
+   RETURNS
+      TRUE on success. FALSE on failure.
+
+   HISTORY
+		10/17/26 : Created.
+
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+static int readGGFF (MEMFILE *mf, GGFFDATA *pggff, BOOL *pfSwap)
+BEGINFUNC (readGGFF)
+{
+   CHUNKHEADER chunkheader;
+
+   if (MEMFILE_Read (mf, &chunkheader, sizeof (CHUNKHEADER)) != sizeof (CHUNKHEADER)
+    || chunkheader.id != IDGGFF
+    || MEMFILE_Read (mf, pggff, sizeof (GGFFDATA)) != sizeof (GGFFDATA))
+   {
+      SetGlobalErr (ERR_GENERIC);
+      GEcatf ("GFF file does not start with a GGFF chunk");
+      RETURN FALSE;
+   }
+
+   if (!gffByteOrder (pggff->ByteOrder, pfSwap))
+   {
+      SetGlobalErr (ERR_GENERIC);
+      GEcatf ("Unknown GFF byte order");
+      RETURN FALSE;
+   }
+
+   if (*pfSwap)
+   {
+      PixConv_Swap32 (&chunkheader.Size, 1);
+      swapChunkData (IDGGFF, pggff, sizeof (GGFFDATA), FALSE);
+   }
+
+   // Later versions may have added to the GGFF chunk.
+   if (chunkheader.Size < sizeof (GGFFDATA) || (long)(chunkheader.Size - sizeof (GGFFDATA)) > mf->bytesLeft)
+   {
+      SetGlobalErr (ERR_GENERIC);
+      GEcatf ("Bad GGFF chunk size");
+      RETURN FALSE;
+   }
+   MEMFILE_Seek (mf, chunkheader.Size - sizeof (GGFFDATA), SEEK_CUR);
+
+   RETURN TRUE;
+} ENDFUNC (readGGFF)
+
+/*************************************************************************
+                             readChunkHeader
+ *************************************************************************
+
+   SYNOPSIS
+		static int readChunkHeader (MEMFILE *mf, CHUNKHEADER *pheader, BOOL fSwap)
+
+   PURPOSE
+      Read the next chunk header from a GFF file in memory, swapping
+      it if needed.  mf is left at the chunk's data.
+
+   RETURNS
+      TRUE if there was a whole header and the data fits in the file.
+      FALSE at the end of the file.
+
+   HISTORY
+		10/17/26 : Created.
+
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+static int readChunkHeader (MEMFILE *mf, CHUNKHEADER *pheader, BOOL fSwap)
+BEGINFUNC (readChunkHeader)
+{
+   if (MEMFILE_Read (mf, pheader, sizeof (CHUNKHEADER)) != sizeof (CHUNKHEADER))
+   {
+      RETURN FALSE;
+   }
+   if (fSwap)
+   {
+      PixConv_Swap32 (&pheader->Size, 1);
+   }
+   /* The read left bytesLeft >= 0. */
+   RETURN (pheader->Size <= (unsigned long)mf->bytesLeft);
+} ENDFUNC (readChunkHeader)
+
+/*************************************************************************
+                              openGFFWriter
+ *************************************************************************
+
+   SYNOPSIS
+		static int openGFFWriter (GFFWRITER *pw, int fh, long maxBytes, BOOL fSwap)
+
+   PURPOSE
+      Get a staging buffer for writing chunks to fh.  It's never bigger
+      than GFF_WRITE_BUFFER_SIZE or the most the file can need.
+
+   RETURNS
+      TRUE on success. FALSE if out of memory.
+
+   HISTORY
+		10/17/26 : Created.
+
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+static int openGFFWriter (GFFWRITER *pw, int fh, long maxBytes, BOOL fSwap)
+BEGINFUNC (openGFFWriter)
+{
+   pw->fh     = fh;
+   pw->used   = 0;
+   pw->fSwap  = fSwap;
+   pw->size   = maxBytes < GFF_WRITE_BUFFER_SIZE ? maxBytes : GFF_WRITE_BUFFER_SIZE;
+   pw->buffer = (UINT8 *)malloc (pw->size ? pw->size : 1);
+   if (!pw->buffer)
+   {
+      SetGlobalErr (ERR_GENERIC);
+      GEcatf ("Out of memory writing gff");
+      RETURN FALSE;
+   }
+   RETURN TRUE;
+} ENDFUNC (openGFFWriter)
+
+/*************************************************************************
+                             flushGFFWriter
+ *************************************************************************
+
+   SYNOPSIS
+		static void flushGFFWriter (GFFWRITER *pw)
+
+   PURPOSE
+      Write out whatever is in the staging buffer.
+
+   HISTORY
+		10/17/26 : Created.
+
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+static void flushGFFWriter (GFFWRITER *pw)
+BEGINPROC (flushGFFWriter)
+{
+   if (pw->used)
+   {
+      CHK_Write (pw->fh, pw->buffer, pw->used);
+      pw->used = 0;
+   }
+} ENDPROC (flushGFFWriter)
+
+/*************************************************************************
+                            reserveGFFWriter
+ *************************************************************************
+
+   SYNOPSIS
+		static UINT8 *reserveGFFWriter (GFFWRITER *pw, long bytes)
+
+   PURPOSE
+      Make room for bytes more bytes, flushing if needed.  bytes must
+      not be more than the buffer size.  The caller fills them in and
+      adds them to pw->used.
+
+   HISTORY
+		10/17/26 : Created.
+
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+static UINT8 *reserveGFFWriter (GFFWRITER *pw, long bytes)
+BEGINFUNC (reserveGFFWriter)
+{
+   if (pw->used + bytes > pw->size)
+   {
+      flushGFFWriter (pw);
+   }
+   RETURN pw->buffer + pw->used;
+} ENDFUNC (reserveGFFWriter)
+
+/*************************************************************************
+                           writeGFFChunkHeader
+ *************************************************************************
+
+   SYNOPSIS
+		static void writeGFFChunkHeader (GFFWRITER *pw, IDTYPE id, UINT32 Size)
+
+   PURPOSE
+      Add a chunk header to the output.
+
+   HISTORY
+		10/17/26 : Created.
+
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+static void writeGFFChunkHeader (GFFWRITER *pw, IDTYPE id, UINT32 Size)
+BEGINPROC (writeGFFChunkHeader)
+{
+   CHUNKHEADER *pheader;
+
+   pheader = (CHUNKHEADER *)reserveGFFWriter (pw, sizeof (CHUNKHEADER));
+   pheader->id   = id;
+   pheader->Size = Size;
+   if (pw->fSwap)
+   {
+      PixConv_Swap32 (&pheader->Size, 1);
+   }
+   pw->used += sizeof (CHUNKHEADER);
+} ENDPROC (writeGFFChunkHeader)
+
+/*************************************************************************
+                              writeGFFBytes
+ *************************************************************************
+
+   SYNOPSIS
+		static void writeGFFBytes (GFFWRITER *pw, const void *pData, long bytes)
+
+   PURPOSE
+      Add bytes to the output as they are.  Too many to stage are
+      written straight from pData after flushing what's staged.
+
+   HISTORY
+		10/17/26 : Created.
+
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+static void writeGFFBytes (GFFWRITER *pw, const void *pData, long bytes)
+BEGINPROC (writeGFFBytes)
+{
+   if (bytes > pw->size)
+   {
+      flushGFFWriter (pw);
+      CHK_Write (pw->fh, (void *)pData, bytes);
+   }
+   else if (bytes)
+   {
+      memcpy (reserveGFFWriter (pw, bytes), pData, bytes);
+      pw->used += bytes;
+   }
+} ENDPROC (writeGFFBytes)
+
+/*************************************************************************
+                              writeGFFChunk
+ *************************************************************************
+
+   SYNOPSIS
+		static void writeGFFChunk (GFFWRITER *pw, IDTYPE id, const void *pData, UINT32 Size)
+
+   PURPOSE
+      Add a whole chunk to the output.  The words at the start of GGFF
+      and RGBZ chunks are staged and swapped there if needed, the
+      rest of the data is written as it is.
+
+   HISTORY
+		10/17/26 : Created.
+
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+static void writeGFFChunk (GFFWRITER *pw, IDTYPE id, const void *pData, UINT32 Size)
+BEGINPROC (writeGFFChunk)
+{
+   UINT32 words = 0;
+
+   writeGFFChunkHeader (pw, id, Size);
+
+   if (id == IDGGFF)
+   {
+      words = Size;
+   }
+   else if (id == IDRGBZ && Size >= 2 * sizeof (UINT32))
+   {
+      UINT32 NumBands;
+
+      memcpy (&NumBands, (const UINT8 *)pData + sizeof (UINT32), sizeof (UINT32));
+      words = NumBands < Size / sizeof (UINT32) - 2 ? (2 + NumBands) * sizeof (UINT32) : Size;
+   }
+
+   if (words && pw->fSwap && id == IDGGFF)
+   {
+      UINT8 *pDest = reserveGFFWriter (pw, words);
+
+      memcpy (pDest, pData, words);
+      swapChunkData (id, pDest, words, TRUE);
+      pw->used += words;
+   }
+   else if (words && pw->fSwap)
+   {
+      // The RGBZ index is all 32 bit words and can be more than the
+      // staging buffer holds.
+      UINT32 done, num;
+
+      for (done = 0; done < words; done += num)
+      {
+         UINT8 *pDest;
+
+         num   = words - done;
+         num   = num < (UINT32)(pw->size & ~3) ? num : (UINT32)(pw->size & ~3);
+         pDest = reserveGFFWriter (pw, num);
+         memcpy (pDest, (const UINT8 *)pData + done, num);
+         PixConv_Swap32 (pDest, num / sizeof (UINT32));
+         pw->used += num;
+      }
+   }
+   else
+   {
+      words = 0;
+   }
+   writeGFFBytes (pw, (const UINT8 *)pData + words, Size - words);
+} ENDPROC (writeGFFChunk)
+
+/*************************************************************************
+                              closeGFFWriter
+ *************************************************************************
+
+   SYNOPSIS
+		static void closeGFFWriter (GFFWRITER *pw)
+
+   PURPOSE
+      Flush and free the staging buffer.
+
+   HISTORY
+		10/17/26 : Created.
+
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+static void closeGFFWriter (GFFWRITER *pw)
+BEGINPROC (closeGFFWriter)
+{
+   flushGFFWriter (pw);
+   free (pw->buffer);
+   pw->buffer = NULL;
+} ENDPROC (closeGFFWriter)
+
+/*************************************************************************
+                              readRGBZIndex
+ *************************************************************************
+
+   SYNOPSIS
+		static int readRGBZIndex (RGBZINDEX *pindex, const UINT8 *pData, UINT32 Size, BOOL fSwap, long width, long height)
+
+   PURPOSE
+      Check the band index at the start of an RGBZ chunk and work out
+      where each band is.  pData is not changed so it can be a mapped
+      file.
+
+   INPUT
+		pindex :   Filled out, free with freeRGBZIndex.
+		pData  :   RGBZ chunk data.
+		Size   :   Bytes of data.
+		fSwap  :   Data is the other endian.
+		width  :   Image size from the GGFF chunk.
+		height :
+
+   RETURNS
+      TRUE on success. FALSE if the chunk is bad or out of memory.
+
+   HISTORY
+		10/17/26 : Created.
+
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+static int readRGBZIndex (RGBZINDEX *pindex, const UINT8 *pData, UINT32 Size, BOOL fSwap, long width, long height)
+BEGINFUNC (readRGBZIndex)
+{
+   UINT32 words[2];
+   UINT32 total;
+   UINT32 rowBytes = (UINT32)width * sizeof (RGBADATA);
+   long   band;
+
+   pindex->pBandSize = NULL;
+   if (Size < sizeof (words))
+   {
+      goto bad;
+   }
+   memcpy (words, pData, sizeof (words));
+   if (fSwap)
+   {
+      PixConv_Swap32 (words, 2);
+   }
+   pindex->width    = width;
+   pindex->height   = height;
+   pindex->bandRows = words[0];
+   pindex->numBands = words[1];
+   if (pindex->bandRows < 1 || pindex->numBands != (height + pindex->bandRows - 1) / pindex->bandRows
+    || (UINT32)pindex->numBands > (Size - sizeof (words)) / sizeof (UINT32))
+   {
+      goto bad;
+   }
+
+   pindex->pBandSize = (UINT32 *)malloc (pindex->numBands * 2 * sizeof (UINT32) + 1);
+   if (!pindex->pBandSize)
+   {
+      SetGlobalErr (ERR_GENERIC);
+      GEcatf ("Out of memory reading gff");
+      RETURN FALSE;
+   }
+   pindex->pBandOffset = pindex->pBandSize + pindex->numBands;
+   memcpy (pindex->pBandSize, pData + sizeof (words), pindex->numBands * sizeof (UINT32));
+   if (fSwap)
+   {
+      PixConv_Swap32 (pindex->pBandSize, pindex->numBands);
+   }
+
+   pindex->pBands = pData + sizeof (words) + pindex->numBands * sizeof (UINT32);
+   Size -= pindex->pBands - pData;
+   for (band = 0, total = 0; band < pindex->numBands; band++)
+   {
+      UINT32 bandSize = pindex->pBandSize[band] & ~GFF_RGBZ_STORED;
+      long   rows     = height - band * pindex->bandRows;
+
+      rows = rows < pindex->bandRows ? rows : pindex->bandRows;
+      if (bandSize > Size - total
+       || ((pindex->pBandSize[band] & GFF_RGBZ_STORED) && bandSize != rows * rowBytes))
+      {
+         goto bad;
+      }
+      pindex->pBandOffset[band] = total;
+      total += bandSize;
+   }
+   RETURN TRUE;
+
+bad:
+   free (pindex->pBandSize);
+   pindex->pBandSize = NULL;
+   SetGlobalErr (ERR_GENERIC);
+   GEcatf ("Bad RGBZ chunk in gff");
+   RETURN FALSE;
+} ENDFUNC (readRGBZIndex)
+
+/*************************************************************************
+                              freeRGBZIndex
+ *************************************************************************
+
+   SYNOPSIS
+		static void freeRGBZIndex (RGBZINDEX *pindex)
+
+   PURPOSE
+      Free what readRGBZIndex allocated.
+
+   HISTORY
+		10/17/26 : Created.
+
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+static void freeRGBZIndex (RGBZINDEX *pindex)
+BEGINPROC (freeRGBZIndex)
+{
+   free (pindex->pBandSize);
+   pindex->pBandSize = NULL;
+} ENDPROC (freeRGBZIndex)
+
+/*************************************************************************
+                             decodeRGBZBand
+ *************************************************************************
+
+   SYNOPSIS
+		static int decodeRGBZBand (const RGBZINDEX *pindex, long band, UINT8 *pDest, BOOL fPixel32)
+
+   PURPOSE
+      Decompress one band of an RGBZ chunk.  Safe to call from many
+      threads at once so it doesn't set the global error.
+
+   INPUT
+		pindex   :   From readRGBZIndex.
+		band     :   Band to decode.
+		pDest    :   Where the band's rows go.
+		fPixel32 :   Make pixel32s not RGBADATA.
+
+   RETURNS
+      TRUE on success. FALSE if the band is bad.
+
+   HISTORY
+		10/17/26 : Created.
+
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+static int decodeRGBZBand (const RGBZINDEX *pindex, long band, UINT8 *pDest, BOOL fPixel32)
+BEGINFUNC (decodeRGBZBand)
+{
+   const UINT8 *pSrc     = pindex->pBands + pindex->pBandOffset[band];
+   UINT32       bandSize = pindex->pBandSize[band];
+   long         rows     = pindex->height - band * pindex->bandRows;
+   long         bytes;
+
+   rows  = rows < pindex->bandRows ? rows : pindex->bandRows;
+   bytes = rows * pindex->width * sizeof (RGBADATA);
+
+   if (bandSize & GFF_RGBZ_STORED)
+   {
+      memcpy (pDest, pSrc, bytes);
+   }
+   else if (!ELZ_Decompress (pSrc, bandSize, pDest, bytes))
+   {
+      RETURN FALSE;
+   }
+
+   #if _EL_OS_WIN32__
+      if (fPixel32)
+      {
+         // pixel32 is b,g,r,a
+         long i;
+
+         for (i = 0; i < bytes; i += 4)
+         {
+            UINT8 t = pDest[i];
+            pDest[i] = pDest[i + 2];
+            pDest[i + 2] = t;
+         }
+      }
+   #endif
+
+   RETURN TRUE;
+} ENDFUNC (decodeRGBZBand)
+
+/*************************************************************************
+                              decodeRGBZJob
+ *************************************************************************
+
+   SYNOPSIS
+		static void decodeRGBZJob (void *pUserData, int job)
+
+   PURPOSE
+      ETHREAD_ParallelFor job that decodes band job of an RGBZJOB.
+
+   HISTORY
+		10/17/26 : Created.
+
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+static void decodeRGBZJob (void *pUserData, int job)
+BEGINPROC (decodeRGBZJob)
+{
+   RGBZJOB *pjob = (RGBZJOB *)pUserData;
+   const RGBZINDEX *pindex = pjob->pindex;
+   UINT8 *pDest = pjob->pDest + job * pindex->bandRows * pindex->width * sizeof (RGBADATA);
+
+   if (!decodeRGBZBand (pindex, job, pDest, pjob->fPixel32))
+   {
+      pjob->fFailed = TRUE;
+   }
+} ENDPROC (decodeRGBZJob)
+
+/*************************************************************************
+                               decodeRGBZ
+ *************************************************************************
+
+   SYNOPSIS
+		static int decodeRGBZ (const RGBZINDEX *pindex, UINT8 *pDest, BOOL fPixel32)
+
+   PURPOSE
+      Decompress a whole RGBZ chunk, the bands in parallel.
+
+   INPUT
+		pindex   :   From readRGBZIndex.
+		pDest    :   width * height pixels.
+		fPixel32 :   Make pixel32s not RGBADATA.
+
+   RETURNS
+      TRUE on success. FALSE if a band is bad.
+
+   HISTORY
+		10/17/26 : Created.
+
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+static int decodeRGBZ (const RGBZINDEX *pindex, UINT8 *pDest, BOOL fPixel32)
+BEGINFUNC (decodeRGBZ)
+{
+   RGBZJOB rj;
+
+   memset (&rj, 0, sizeof (rj));
+   rj.pindex   = pindex;
+   rj.pDest    = pDest;
+   rj.fPixel32 = fPixel32;
+   ETHREAD_ParallelFor (NULL, pindex->numBands, decodeRGBZJob, &rj);
+
+   if (rj.fFailed)
+   {
+      SetGlobalErr (ERR_GENERIC);
+      GEcatf ("Bad RGBZ band in gff");
+      RETURN FALSE;
+   }
+   RETURN TRUE;
+} ENDFUNC (decodeRGBZ)
+
+/*************************************************************************
+                              encodeRGBZJob
+ *************************************************************************
 
-/************************** P R O T O T Y P E S **************************/
+   SYNOPSIS
+		static void encodeRGBZJob (void *pUserData, int job)
 
-void CHK_Write16Bit (int fh, UINT16 u16);
-void CHK_Write32Bit (int fh, UINT32 u32);
+   PURPOSE
+      ETHREAD_ParallelFor job that compresses band job of an RGBZJOB
+      into its slot.  A band that doesn't get smaller is stored.
 
-/***************************** G L O B A L S *****************************/
+   HISTORY
+		10/17/26 : Created.
 
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
-/****************************** M A C R O S ******************************/
+static void encodeRGBZJob (void *pUserData, int job)
+BEGINPROC (encodeRGBZJob)
+{
+   RGBZJOB *pjob = (RGBZJOB *)pUserData;
+   RGBZINDEX *pindex = (RGBZINDEX *)pjob->pindex;
+   long rows = pindex->height - job * pindex->bandRows;
+   long bytes;
+   long packed;
+   const UINT8 *pSrc;
+   UINT8 *pSlot = pjob->pDest + job * pjob->slotSize;
+   UINT8 *pTemp = NULL;
+
+   rows  = rows < pindex->bandRows ? rows : pindex->bandRows;
+   bytes = rows * pindex->width * sizeof (RGBADATA);
+   pSrc  = pjob->prgba + job * pindex->bandRows * pindex->width * sizeof (RGBADATA);
+
+   #if _EL_OS_WIN32__
+      if (pjob->fPixel32)
+      {
+         // pixel32 is b,g,r,a
+         long i;
 
+         pTemp = (UINT8 *)malloc (bytes);
+         if (!pTemp)
+         {
+            pjob->fFailed = TRUE;
+            RETURN;
+         }
+         for (i = 0; i < bytes; i += 4)
+         {
+            pTemp[i]     = pSrc[i + 2];
+            pTemp[i + 1] = pSrc[i + 1];
+            pTemp[i + 2] = pSrc[i];
+            pTemp[i + 3] = pSrc[i + 3];
+         }
+         pSrc = pTemp;
+      }
+   #endif
 
-/**************************** R O U T I N E S ****************************/
+   packed = ELZ_Compress (pSrc, bytes, pSlot, bytes - 1);
+   if (packed)
+   {
+      pindex->pBandSize[job] = packed;
+   }
+   else
+   {
+      memcpy (pSlot, pSrc, bytes);
+      pindex->pBandSize[job] = bytes | GFF_RGBZ_STORED;
+   }
+   free (pTemp);
+} ENDPROC (encodeRGBZJob)
 
 /*************************************************************************
-                             PChunkNodeOfId
+                               encodeRGBZ
  *************************************************************************
 
    SYNOPSIS
-		CHUNKNODE *PChunkNodeOfId (GFF *pgff, IDTYPE id)
+		static UINT8 *encodeRGBZ (const UINT8 *prgba, long width, long height, BOOL fPixel32, UINT32 *pSize)
 
    PURPOSE
-      To find the chunknode of the chunk with the give id.
+      Make the data of an RGBZ chunk, in this machine's byte order,
+      from an image.  The bands are compressed in parallel.
 
    INPUT
-		pgff :   Pointer to GFF struct to search.
-		id   :   id to find.
+		prgba    :   width * height pixels.
+		fPixel32 :   prgba is pixel32s not RGBADATA.
+		pSize    :   Set to the size of the data.
 
-   OUTPUT
-		None
+   RETURNS
+      The data, free with free. NULL if out of memory.
 
-   EFFECTS
-		None
+   HISTORY
+		10/17/26 : Created.
 
-   RETURNS
-      Pointer to chunknode on success. NULL on failure.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
-   SEE ALSO
+static UINT8 *encodeRGBZ (const UINT8 *prgba, long width, long height, BOOL fPixel32, UINT32 *pSize)
+BEGINFUNC (encodeRGBZ)
+{
+   RGBZINDEX index;
+   RGBZJOB rj;
+   UINT8 *pData;
+   UINT32 words[2];
+   long rowBytes = width * sizeof (RGBADATA);
+   long headerSize;
+   long band;
+   UINT8 *pEnd;
+
+   memset (&index, 0, sizeof (index));
+   index.width    = width;
+   index.height   = height;
+   index.bandRows = rowBytes ? GFF_RGBZ_BAND_BYTES / rowBytes : 1;
+   index.bandRows = index.bandRows < 1 ? 1 : index.bandRows;
+   index.numBands = (height + index.bandRows - 1) / index.bandRows;
+
+   memset (&rj, 0, sizeof (rj));
+   rj.pindex   = &index;
+   rj.prgba    = prgba;
+   rj.slotSize = index.bandRows * rowBytes;
+   rj.fPixel32 = fPixel32;
+
+   // Each band goes in a slot big enough for it stored, then the
+   // slots are moved down to follow each other.
+   headerSize = sizeof (words) + index.numBands * sizeof (UINT32);
+   pData = (UINT8 *)malloc (headerSize + index.numBands * rj.slotSize + 1);
+   index.pBandSize = (UINT32 *)malloc (index.numBands * sizeof (UINT32) + 1);
+   if (!pData || !index.pBandSize)
+   {
+      free (pData);
+      free (index.pBandSize);
+      SetGlobalErr (ERR_GENERIC);
+      GEcatf ("Out of memory writing gff");
+      RETURN NULL;
+   }
+   rj.pDest = pData + headerSize;
+
+   ETHREAD_ParallelFor (NULL, index.numBands, encodeRGBZJob, &rj);
+   if (rj.fFailed)
+   {
+      free (pData);
+      free (index.pBandSize);
+      SetGlobalErr (ERR_GENERIC);
+      GEcatf ("Out of memory writing gff");
+      RETURN NULL;
+   }
+
+   pEnd = pData + headerSize;
+   for (band = 0; band < index.numBands; band++)
+   {
+      UINT32 bandSize = index.pBandSize[band] & ~GFF_RGBZ_STORED;
+
+      memmove (pEnd, rj.pDest + band * rj.slotSize, bandSize);
+      pEnd += bandSize;
+   }
+
+   words[0] = index.bandRows;
+   words[1] = index.numBands;
+   memcpy (pData, words, sizeof (words));
+   memcpy (pData + sizeof (words), index.pBandSize, index.numBands * sizeof (UINT32));
+   free (index.pBandSize);
 
+   *pSize = pEnd - pData;
+   RETURN pData;
+} ENDFUNC (encodeRGBZ)
+
+/*************************************************************************
+                             expandRGBZNode
+ *************************************************************************
+
+   SYNOPSIS
+		static int expandRGBZNode (GFF *pgff, CHUNKNODE *pchunknode)
+
+   PURPOSE
+      Replace a chunk node's RGBZ chunk, already in this machine's
+      byte order, with the RGBA chunk it holds so code using the GFF
+      never sees RGBZ.
+
+   RETURNS
+      TRUE on success. FALSE on failure.
 
    HISTORY
-		08/05/96 : Created.
+		10/17/26 : Created.
 
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
-CHUNKNODE *PChunkNodeOfId (GFF *pgff, IDTYPE id)
-BEGINFUNC (PChunkNodeOfId)
+static int expandRGBZNode (GFF *pgff, CHUNKNODE *pchunknode)
+BEGINFUNC (expandRGBZNode)
 {
-   CHUNKNODE   *pchunknode;
+   CHUNKGENERIC *pchunkz = pchunknode->pchunk;
+   CHUNKGENERIC *pchunk;
+   RGBZINDEX index;
+   long width, height;
+   UINT32 Size;
 
-   for (pchunknode = (CHUNKNODE *)LST_Head(pgff->plistChunkNodes);
-         !LST_IsEOList(pchunknode);
-         pchunknode = (CHUNKNODE *)LST_Next(pchunknode))
+   if (!pgff->pchunkggff)
    {
-      if (pchunknode->pchunk->Header.id == id)
-      {
-         RETURN pchunknode;  
-      }
+      SetGlobalErr (ERR_GENERIC);
+      GEcatf ("RGBZ chunk before the GGFF chunk");
+      RETURN FALSE;
    }
-	RETURN NULL;
-} ENDFUNC (PChunkNodeOfId)
+   width  = pgff->pchunkggff->Data.Width;
+   height = pgff->pchunkggff->Data.Height;
+   Size   = width * height * sizeof (RGBADATA);
+
+   if (!readRGBZIndex (&index, &pchunkz->u8First, pchunkz->Header.Size, FALSE, width, height))
+   {
+      RETURN FALSE;
+   }
+
+   pchunk = (CHUNKGENERIC *)malloc ((sizeof (CHUNKHEADER) +  Size));
+   if (!pchunk)
+   {
+      freeRGBZIndex (&index);
+      SetGlobalErr (ERR_GENERIC);
+      GEcatf ("Out of memory reading gff");
+      RETURN FALSE;
+   }
+   if (!decodeRGBZ (&index, &pchunk->u8First, FALSE))
+   {
+      freeRGBZIndex (&index);
+      free (pchunk);
+      RETURN FALSE;
+   }
+   freeRGBZIndex (&index);
+
+   pchunk->Header.id   = IDRGBA;
+   pchunk->Header.Size = Size;
+   pchunknode->pchunk  = pchunk;
+   pchunknode->Header  = pchunk->Header;
+   free (pchunkz);
+
+   RETURN TRUE;
+} ENDFUNC (expandRGBZNode)
 
 /*************************************************************************
                               loadGFF32Bit
@@ -167,52 +1109,64 @@ int loadGFF32Bit (BlockO32BitPixels *pbop, MEMFILE *mf)
 BEGINFUNC (loadGFF32Bit)
 {
    BOOL fSuccess;
-   BOOL fFoundGGFF, fFoundRGBA, fFoundPNDX, fFoundPCON, fFoundPCN2;
+   BOOL fSwap;
+   BOOL fFoundRGBA, fFoundRGBZ, fFoundPNDX, fFoundPCON, fFoundPCN2;
+   UINT32 rgbaSize = 0;
+   UINT32 rgbzSize = 0;
+   UINT32 pndxSize = 0;
+   UINT8 *prgbz;
    UINT8 *ppndx;
    PCONDATA *ppcon;
    PCN2DATA *ppcn2;
    RGBADATA *prgba;
-
-   pbop->rgba = NULL;
+   GGFFDATA ggffdata;
+   CHUNKHEADER chunkheader; 
 
    fSuccess = FALSE;
-   fFoundGGFF = FALSE;
    fFoundRGBA = FALSE;
+   fFoundRGBZ = FALSE;
    fFoundPNDX = FALSE;
    fFoundPCON = FALSE;
    fFoundPCN2 = FALSE;
 
-   while (!fFoundGGFF || !(fFoundRGBA || (fFoundPNDX && (fFoundPCON || fFoundPCN2))))
+   if (!readGGFF (mf, &ggffdata, &fSwap))
+   {
+      RETURN FALSE;
+   }
+   pbop->width = ggffdata.Width;
+   pbop->height = ggffdata.Height;
+   pbop->channels = 4;
+
+   // Every chunk after GGFF is bytes so only the headers need swapping.
+   // The RGBZ band index is swapped as it's read.
+   while (!(fFoundRGBA || fFoundRGBZ || (fFoundPNDX && (fFoundPCON || fFoundPCN2)))
+       && readChunkHeader (mf, &chunkheader, fSwap))
    {
-      long len;
-      CHUNKHEADER chunkheader; 
-      
-      // Read Header
-      len = MEMFILE_Read (mf, &chunkheader, sizeof (CHUNKHEADER));
-      if (len < sizeof(CHUNKHEADER)) break;
-
       if (chunkheader.id == IDGGFF)
       {
-         GGFFDATA ggffdata;
-         ENSURE_F (!fFoundGGFF, ("Multiple GGFF chunks in file"));
-         MEMFILE_Read (mf, &ggffdata, sizeof (ggffdata));
-         pbop->width = ggffdata.Width;
-         pbop->height = ggffdata.Height;
-         pbop->channels = 4;
-         fFoundGGFF = TRUE;
+         ENSURE_F (FALSE, ("Multiple GGFF chunks in file"));
       }
       else if (chunkheader.id == IDRGBA)
       {
          //printf("Found RGBA\n");
          ENSURE_F (!fFoundRGBA, ("Multiple RGBA chunks in file"));
          prgba = (RGBADATA *)mf->curPtr;
+         rgbaSize = chunkheader.Size;
          fFoundRGBA = TRUE;
       }
+      else if (chunkheader.id == IDRGBZ)
+      {
+         ENSURE_F (!fFoundRGBZ, ("Multiple RGBZ chunks in file"));
+         prgbz = mf->curPtr;
+         rgbzSize = chunkheader.Size;
+         fFoundRGBZ = TRUE;
+      }
       else if (chunkheader.id == IDPNDX)
       {
          //printf("Found PNDX\n");
          ENSURE_F (!fFoundPNDX, ("Multiple PNDX chunks in file"));
          ppndx = (UINT8 *)mf->curPtr;
+         pndxSize = chunkheader.Size;
          fFoundPNDX = TRUE;
       }
       else if (chunkheader.id == IDPCON)
@@ -230,86 +1184,371 @@ BEGINFUNC (loadGFF32Bit)
          fFoundPCN2 = TRUE;
       }
 
+      MEMFILE_Seek (mf, chunkheader.Size, SEEK_CUR);
    } // while
 
-   fSuccess = (fFoundGGFF && fFoundRGBA || (fFoundPNDX && (fFoundPCON | fFoundPCN2)));
-   if (fSuccess)
+   fSuccess = (fFoundRGBA || fFoundRGBZ || (fFoundPNDX && (fFoundPCON | fFoundPCN2)));
+   if (!fSuccess)
+   {
+      SetGlobalErr (ERR_GENERIC);
+      GEcatf ("GFF file has no image data");
+      RETURN FALSE;
+   }
+   if (fFoundRGBZ)
+   {
+      RGBZINDEX index;
+
+      // Decode straight into the image, the bands in parallel.
+      if (!readRGBZIndex (&index, prgbz, rgbzSize, fSwap, pbop->width, pbop->height))
+      {
+         RETURN FALSE;
+      }
+      if (!AllocPicturePixels (pbop, pbop->width * pbop->height))
+      {
+         freeRGBZIndex (&index);
+         SetGlobalErr (ERR_GENERIC);
+         GEcatf ("Out of memory reading gff");
+         RETURN FALSE;
+      }
+      fSuccess = decodeRGBZ (&index, (UINT8 *)pbop->rgba, TRUE);
+      freeRGBZIndex (&index);
+      if (!fSuccess)
+      {
+         FreePicturePixels (pbop);
+      }
+      RETURN fSuccess;
+   }
+   if (fFoundRGBA ? rgbaSize < (UINT32)pbop->width * pbop->height * sizeof (RGBADATA)
+                  : pndxSize < (UINT32)pbop->width * pbop->height)
+   {
+      SetGlobalErr (ERR_GENERIC);
+      GEcatf ("GFF image data chunk is too small");
+      RETURN FALSE;
+   }
+
+   {
+      // Allocate space for image.
+   	if (!AllocPicturePixels (pbop, pbop->width * pbop->height))
+   	{
+   		SetGlobalErr (ERR_GENERIC);
+   		GEcatf ("Out of memory reading gff");
+   		return FALSE;
+   	}
+      
+      if (fFoundRGBA)
+      {
+         int i;
+         pixel32 *p32;
+
+         for (
+            i = pbop->width * pbop->height,
+               p32 = pbop->rgba;
+            i;
+            i--, p32++, prgba++
+         )
+         {
+            p32->red   = prgba->Red;
+            p32->green = prgba->Green;
+            p32->blue  = prgba->Blue;
+            p32->alpha = prgba->Alpha;
+         }
+      }
+      else if (fFoundPCON)
+      {
+         int i;
+         pixel32 *p32;
+
+         for (
+            i = pbop->width * pbop->height,
+               p32 = pbop->rgba;
+            i;
+            i--, p32++, ppndx++
+         )
+         {
+            PCONDATA *ppconEntry;
+            ppconEntry = ppcon + *ppndx;
+            p32->red =   ppconEntry->Red;
+            p32->green =   ppconEntry->Green;
+            p32->blue =   ppconEntry->Blue;
+            p32->alpha = (ppconEntry->Constraint & GFF_PCON_TRANSPARENT) ? 0 : 0xFF;
+         }
+      }
+      else // fFoundPCON2
+      {
+         int i;
+         pixel32 *p32;
+
+         for (
+            i = pbop->width * pbop->height,
+               p32 = pbop->rgba;
+            i;
+            i--, p32++, ppndx++
+         )
+         {
+            PCN2DATA *ppcn2Entry;
+            ppcn2Entry = ppcn2 + *ppndx;
+            p32->red =   ppcn2Entry->Red;
+            p32->green =   ppcn2Entry->Green;
+            p32->blue =   ppcn2Entry->Blue;
+            p32->alpha =  ppcn2Entry->Alpha;
+         }
+      }
+   }
+
+	RETURN (fSuccess);
+
+} ENDFUNC (loadGFF32Bit)
+
+/*************************************************************************
+                               loadGFFInfo
+ *************************************************************************
+
+   SYNOPSIS
+		int loadGFFInfo (PictureInfo *pInfo, MEMFILE *mf)
+
+   PURPOSE
+      Fill out pInfo from the GGFF chunk.  GGFF is always the first
+      chunk so no pixel data is touched.
+
+   INPUT
+		pInfo :   Pointer to PictureInfo struct to fill out.
+		mf    :   Memory file pointer.
+
+   RETURNS
+      TRUE on success. FALSE on failure.
+
+   HISTORY
+		10/17/26 : Created.
+
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+int loadGFFInfo (PictureInfo *pInfo, MEMFILE *mf)
+BEGINFUNC (loadGFFInfo)
+{
+   GGFFDATA    ggffdata;
+   BOOL        fSwap;
+
+   if (!readGGFF (mf, &ggffdata, &fSwap))
+   {
+      RETURN FALSE;
+   }
+
+   pInfo->format       = PICFMT_GFF;
+   pInfo->width        = ggffdata.Width;
+   pInfo->height       = ggffdata.Height;
+   pInfo->channels     = 4;
+   pInfo->bitsPerPixel = 32;
+   pInfo->hasAlpha     = TRUE;
+
+   RETURN TRUE;
+} ENDFUNC (loadGFFInfo)
+
+/*************************************************************************
+                              streamGFF32Bit
+ *************************************************************************
+
+   SYNOPSIS
+		int streamGFF32Bit (MEMFILE *mf, long bandRows, PFNPICTUREROWS pfnRows, void *pUserData)
+
+   PURPOSE
+      Walk the chunks of a GFF file in memory and hand the image to
+      pfnRows bandRows rows at a time, converting RGBA or PNDX+PCON/PCN2
+      data one band at a time.  RGBZ data is decoded one of its own
+      bands at a time.
+
+   INPUT
+		mf        :   Memory file pointer.
+		bandRows  :   Rows per call to pfnRows.
+		pfnRows   :   Called with each band of rows.
+		pUserData :   Passed to pfnRows.
+
+   RETURNS
+      TRUE if the whole image was converted and pfnRows never returned
+      FALSE.
+
+   HISTORY
+		10/17/26 : Created.
+
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+int streamGFF32Bit (MEMFILE *mf, long bandRows, PFNPICTUREROWS pfnRows, void *pUserData)
+BEGINFUNC (streamGFF32Bit)
+{
+   PictureInfo info;
+   RGBADATA *prgba = NULL;
+   UINT8 *prgbz = NULL;
+   UINT8 *ppndx = NULL;
+   PCONDATA *ppcon = NULL;
+   PCN2DATA *ppcn2 = NULL;
+   UINT32 rgbaSize = 0;
+   UINT32 rgbzSize = 0;
+   UINT32 pndxSize = 0;
+   GGFFDATA ggffdata;
+   CHUNKHEADER chunkheader;
+   BOOL fSwap;
+   pixel32 *band;
+   RGBZINDEX index;
+   pixel32 *zband = NULL;
+   long zbandCur = -1;
+   long y;
+
+   if (!readGGFF (mf, &ggffdata, &fSwap))
+   {
+      RETURN FALSE;
+   }
+   info.width  = ggffdata.Width;
+   info.height = ggffdata.Height;
+
+   // The rest of the chunks can come in any order.
+   while (readChunkHeader (mf, &chunkheader, fSwap))
+   {
+      UINT8 *pData = mf->curPtr;
+
+      if (chunkheader.id == IDRGBA) { prgba = (RGBADATA *)pData; rgbaSize = chunkheader.Size; }
+      else if (chunkheader.id == IDRGBZ) { prgbz = pData; rgbzSize = chunkheader.Size; }
+      else if (chunkheader.id == IDPNDX) { ppndx = pData; pndxSize = chunkheader.Size; }
+      else if (chunkheader.id == IDPCON) ppcon = (PCONDATA *)pData;
+      else if (chunkheader.id == IDPCN2) ppcn2 = (PCN2DATA *)pData;
+
+      MEMFILE_Seek (mf, chunkheader.Size, SEEK_CUR);
+   }
+
+   if (!(prgba || prgbz || (ppndx && (ppcon || ppcn2))))
+   {
+      SetGlobalErr (ERR_GENERIC);
+      GEcatf ("GFF file has no image data");
+      RETURN FALSE;
+   }
+
+   if (prgbz)
+   {
+      if (!readRGBZIndex (&index, prgbz, rgbzSize, fSwap, info.width, info.height))
+      {
+         RETURN FALSE;
+      }
+   }
+   else if (prgba ? rgbaSize < (UINT32)info.width * info.height * sizeof (RGBADATA)
+             : pndxSize < (UINT32)info.width * info.height)
+   {
+      SetGlobalErr (ERR_GENERIC);
+      GEcatf ("GFF image data chunk is too small");
+      RETURN FALSE;
+   }
+
+   info.format       = PICFMT_GFF;
+   info.channels     = 4;
+   info.bitsPerPixel = 32;
+   info.hasAlpha     = TRUE;
+
+   if (!info.width || !info.height)
+   {
+      if (prgbz)
+      {
+         freeRGBZIndex (&index);
+      }
+      RETURN TRUE;
+   }
+
+   if (bandRows > info.height)
+   {
+      bandRows = info.height;
+   }
+
+   band = (pixel32 *) malloc (info.width * bandRows * sizeof (pixel32));
+   if (prgbz)
+   {
+      // RGBZ is decoded one of its own bands at a time as rows are needed.
+      zband = (pixel32 *) malloc (info.width * index.bandRows * sizeof (pixel32));
+   }
+   if (!band || (prgbz && !zband))
+   {
+      free (band);
+      free (zband);
+      if (prgbz)
+      {
+         freeRGBZIndex (&index);
+      }
+      SetGlobalErr (ERR_GENERIC);
+      GEcatf ("Out of memory reading gff");
+      RETURN FALSE;
+   }
+
+   for (y = 0; y < info.height; y += bandRows)
    {
-      UINT32   Size;
-      // Allocate space for image.
-      Size = pbop->width * pbop->height * sizeof (pixel32);
-      //MEM_AllocMemNoFail (pbop->rgba, Size);
-      pbop->rgba = (pixel32 *) malloc (Size);
-   	if (!pbop->rgba)
-   	{
-   		SetGlobalErr (ERR_GENERIC);
-   		GEcatf ("Out of memory reading gff");
-   		return FALSE;
-   	}
-      
-      if (fFoundRGBA)
-      {
-         int i;
-         pixel32 *p32;
+      long numRows = (info.height - y) < bandRows ? (info.height - y) : bandRows;
+      long i;
+      pixel32 *p32 = band;
 
-         for (
-            i = pbop->width * pbop->height,
-               p32 = pbop->rgba;
-            i;
-            i--, p32++, prgba++
-         )
+      for (i = prgbz ? 0 : info.width * numRows; i; i--, p32++)
+      {
+         if (prgba)
          {
             p32->red   = prgba->Red;
             p32->green = prgba->Green;
             p32->blue  = prgba->Blue;
             p32->alpha = prgba->Alpha;
+            prgba++;
+         }
+         else if (ppcon)
+         {
+            PCONDATA *ppconEntry = ppcon + *ppndx++;
+            p32->red   = ppconEntry->Red;
+            p32->green = ppconEntry->Green;
+            p32->blue  = ppconEntry->Blue;
+            p32->alpha = (ppconEntry->Constraint & GFF_PCON_TRANSPARENT) ? 0 : 0xFF;
+         }
+         else
+         {
+            PCN2DATA *ppcn2Entry = ppcn2 + *ppndx++;
+            p32->red   = ppcn2Entry->Red;
+            p32->green = ppcn2Entry->Green;
+            p32->blue  = ppcn2Entry->Blue;
+            p32->alpha = ppcn2Entry->Alpha;
          }
       }
-      else if (fFoundPCON)
+
+      for (i = 0; prgbz && i < numRows; i++)
       {
-         int i;
-         pixel32 *p32;
+         long row = y + i;
 
-         for (
-            i = pbop->width * pbop->height,
-               p32 = pbop->rgba;
-            i;
-            i--, p32++, ppndx++
-         )
+         if (row / index.bandRows != zbandCur)
          {
-            PCONDATA *ppconEntry;
-            ppconEntry = ppcon + *ppndx;
-            p32->red =   ppconEntry->Red;
-            p32->green =   ppconEntry->Green;
-            p32->blue =   ppconEntry->Blue;
-            p32->alpha = (ppconEntry->Constraint & GFF_PCON_TRANSPARENT) ? 0 : 0xFF;
+            zbandCur = row / index.bandRows;
+            if (!decodeRGBZBand (&index, zbandCur, (UINT8 *)zband, TRUE))
+            {
+               free (band);
+               free (zband);
+               freeRGBZIndex (&index);
+               SetGlobalErr (ERR_GENERIC);
+               GEcatf ("Bad RGBZ band in gff");
+               RETURN FALSE;
+            }
          }
+         memcpy (band + i * info.width,
+                 zband + (row - zbandCur * index.bandRows) * info.width,
+                 info.width * sizeof (pixel32));
       }
-      else // fFoundPCON2
-      {
-         int i;
-         pixel32 *p32;
 
-         for (
-            i = pbop->width * pbop->height,
-               p32 = pbop->rgba;
-            i;
-            i--, p32++, ppndx++
-         )
+      if (!pfnRows (pUserData, &info, band, y, numRows))
+      {
+         free (band);
+         free (zband);
+         if (prgbz)
          {
-            PCN2DATA *ppcn2Entry;
-            ppcn2Entry = ppcn2 + *ppndx;
-            p32->red =   ppcn2Entry->Red;
-            p32->green =   ppcn2Entry->Green;
-            p32->blue =   ppcn2Entry->Blue;
-            p32->alpha =  ppcn2Entry->Alpha;
+            freeRGBZIndex (&index);
          }
+         RETURN FALSE;
       }
    }
 
-	RETURN (fSuccess);
-
-} ENDFUNC (loadGFF32Bit)
+   free (band);
+   free (zband);
+   if (prgbz)
+   {
+      freeRGBZIndex (&index);
+   }
+   RETURN TRUE;
+} ENDFUNC (streamGFF32Bit)
 
 /*************************************************************************
                               saveGFF32Bit
@@ -345,38 +1584,108 @@ BEGINFUNC (loadGFF32Bit)
 int saveGFF32Bit (int fh, BlockO32BitPixels *pbop)
 BEGINFUNC (saveGFF32Bit)
 {
+	RETURN saveGFF32BitEx (fh, pbop, FALSE);
+} ENDFUNC (saveGFF32Bit)
+
+/*************************************************************************
+                             saveGFF32BitEx
+ *************************************************************************
+
+   SYNOPSIS
+		int saveGFF32BitEx (int fh, BlockO32BitPixels *pbop, int fCompress)
+
+   PURPOSE
+      saveGFF32Bit with the choice of writing the pixels as an RGBZ
+      chunk.  The bands are compressed in parallel.
+
+   INPUT
+		fh        :   File handle to save to.
+		pbop      :   pointer to data.
+		fCompress :   Write RGBZ not RGBA.
+
+   RETURNS
+      TRUE on success. FALSE on failure.
+
+   HISTORY
+		10/17/26 : Created.
+
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+int saveGFF32BitEx (int fh, BlockO32BitPixels *pbop, int fCompress)
+BEGINFUNC (saveGFF32BitEx)
+{
+   GFFWRITER writer;
+   GGFFDATA ggffdata;
+   UINT32 Dim, Size;
+   pixel32 *pp32;
+   UINT8 *prgbz = NULL;
+
+   Dim = pbop->width * pbop->height;  
+   Size = Dim * sizeof (RGBADATA);
+
+   if (fCompress)
+   {
+      prgbz = encodeRGBZ ((UINT8 *)pbop->rgba, pbop->width, pbop->height, TRUE, &Size);
+      if (!prgbz)
+      {
+         RETURN FALSE;
+      }
+   }
+
+   if (!openGFFWriter (&writer, fh, 2 * sizeof (CHUNKHEADER) + sizeof (GGFFDATA) + Size, FALSE))
+   {
+      free (prgbz);
+      RETURN FALSE;
+   }
 
    // Write GGFF Chunk
+   ggffdata.ByteOrder = GFF_BYTE_ORDER;
+   ggffdata.Width     = (UINT16)pbop->width;
+   ggffdata.Height    = (UINT16)pbop->height;
+   writeGFFChunk (&writer, IDGGFF, &ggffdata, sizeof (GGFFDATA));
+
+   if (prgbz)
    {
-      static UINT8 arID[4] = {(UINT8)'G',(UINT8)'G',(UINT8)'F',(UINT8)'F'};
-      CHK_Write (fh, arID, 4);                // Write ID
-      CHK_Write32Bit (fh, (UINT32)8);                  // Write Size
-      CHK_Write32Bit (fh, (UINT32)0x1234ABCD);     // Write byte order code.
-      CHK_Write16Bit (fh, (UINT16)pbop->width);
-      CHK_Write16Bit (fh, (UINT16)pbop->height);
+      writeGFFChunk (&writer, IDRGBZ, prgbz, Size);
+      free (prgbz);
+      closeGFFWriter (&writer);
+      RETURN TRUE;
    }
-   // Write RGBA Chunk
+
+   // Write RGBA Chunk, pixel data: r,g,b,a
+   writeGFFChunkHeader (&writer, IDRGBA, Size);
+   for (pp32 = pbop->rgba; Dim; )
    {
-      static UINT8 arID[4] = {(UINT8)'R',(UINT8)'G',(UINT8)'B',(UINT8)'A'};
-      UINT32 Dim, Size;
-      pixel32 *pp32;
+      UINT32 num = writer.size / sizeof (RGBADATA);
+      UINT8 *pDest;
 
-      CHK_Write (fh, arID, 4);                // Write ID
-      Dim = pbop->width * pbop->height;  
-      Size = Dim * 4;
-      CHK_Write32Bit (fh, Size);             // Write Size
-      for ( pp32 = pbop->rgba; Dim; pp32++, Dim--)
+      num = Dim < num ? Dim : num;
+      pDest = reserveGFFWriter (&writer, num * sizeof (RGBADATA));
+      #if _EL_OS_WIN32__
       {
-         UINT8 rgba[4];
-         rgba[0] = pp32->red;
-         rgba[1] = pp32->green;
-         rgba[2] = pp32->blue;
-         rgba[3] = pp32->alpha;
-         CHK_Write (fh, rgba, 4);          // pixel data: r,g,b,a
+         RGBADATA *prgba = (RGBADATA *)pDest;
+         UINT32 i;
+
+         for (i = 0; i < num; i++, prgba++)
+         {
+            prgba->Red   = pp32[i].red;
+            prgba->Green = pp32[i].green;
+            prgba->Blue  = pp32[i].blue;
+            prgba->Alpha = pp32[i].alpha;
+         }
       }
+      #else
+         // pixel32 is already r,g,b,a
+         memcpy (pDest, pp32, num * sizeof (RGBADATA));
+      #endif
+      writer.used += num * sizeof (RGBADATA);
+      pp32 += num;
+      Dim  -= num;
    }
+
+   closeGFFWriter (&writer);
 	RETURN  TRUE;
-} ENDFUNC (saveGFF32Bit)
+} ENDFUNC (saveGFF32BitEx)
 
 /*************************************************************************
                              CHK_Write32Bit
@@ -482,6 +1791,56 @@ BEGINPROC (PrintID)
 
 } ENDPROC (PrintID)
 
+/*************************************************************************
+                             setChunkPointer
+ *************************************************************************
+
+   SYNOPSIS
+		static void setChunkPointer (GFF *pgff, CHUNKGENERIC *pchunk)
+
+   PURPOSE
+      Fill in the convenience pointer for a chunk that's just been read
+      if it has one.
+
+   HISTORY
+		10/17/26 : Created.
+
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+static void setChunkPointer (GFF *pgff, CHUNKGENERIC *pchunk)
+BEGINPROC (setChunkPointer)
+{
+   if (pchunk->Header.id == IDGGFF)
+   {
+      //printf("Found GGFF\n");
+      ENSURE_F (NULL == pgff->pchunkggff, ("Multiple GGFF chunks in file"));
+      pgff->pchunkggff = (CHUNKGGFF *)pchunk;  
+   }
+   else if (pchunk->Header.id == IDRGBA)
+   {
+      //printf("Found RGBA\n");
+      ENSURE_F (NULL == pgff->pchunkrgba, ("Multiple RGBA chunks in file"));
+      pgff->pchunkrgba = (CHUNKRGBA *)pchunk;  
+   }
+   else if (pchunk->Header.id == IDPCON)
+   {
+      //printf("Found PCON\n");
+      ENSURE_F (NULL == pgff->pchunkpcon, ("Multiple PCON chunks in file"));
+      pgff->pchunkpcon = (CHUNKPCON *)pchunk;  
+   }
+   else if (pchunk->Header.id == IDPCN2)
+   {
+      ENSURE_F (NULL == pgff->pchunkpcn2, ("Multiple PCN2 chunks in file"));
+      pgff->pchunkpcn2 = (CHUNKPCN2 *)pchunk;  
+   }
+   else if (pchunk->Header.id == IDINVP)
+   {
+      //printf("Found INVP\n");
+      ENSURE_F (NULL == pgff->pchunkinvp, ("Multiple INVP chunks in file"));
+      pgff->pchunkinvp = (CHUNKINVP *)pchunk;  
+   }
+} ENDPROC (setChunkPointer)
+
 /*************************************************************************
                                  ReadGFF
  *************************************************************************
@@ -505,7 +1864,7 @@ BEGINPROC (PrintID)
       Pointer to allocated GFF structure on success. NULL on failure.
 
    SEE ALSO
-
+      ReadGFFEx
 
    HISTORY
 		08/03/96 : Created.
@@ -514,9 +1873,45 @@ BEGINPROC (PrintID)
 
 GFF *ReadGFF (char *pszFilename)
 BEGINFUNC (ReadGFF)
+{
+	RETURN ReadGFFEx (pszFilename, 0);
+} ENDFUNC (ReadGFF)
+
+/*************************************************************************
+                                ReadGFFEx
+ *************************************************************************
+
+   SYNOPSIS
+		GFF *ReadGFFEx (const char *pszFilename, int flags)
+
+   PURPOSE
+      To read a GFF file.  With GFFREAD_LAZY only the GGFF chunk is
+      read.  The rest of the file is just a directory of chunk headers
+      and offsets, and a chunk's data is read the first time
+      PChunkNodeOfId or LoadGFFChunkNode asks for it.  The file stays
+      open until FreeGFF.
+
+      Until a lazy chunk is loaded its chunk node's pchunk and its
+      convenience pointer in the GFF are NULL.
+
+   INPUT
+		pszFilename : name of file
+		flags       : GFFREAD_??? flags.
+
+   RETURNS
+      Pointer to allocated GFF structure on success. NULL on failure.
+
+   HISTORY
+		10/17/26 : Created.
+
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+GFF *ReadGFFEx (const char *pszFilename, int flags)
+BEGINFUNC (ReadGFFEx)
 {
    GFF   *pgff;
    int   fh;
+   BOOL  fLazy = (flags & GFFREAD_LAZY) != 0;
 
    pgff = CreateGFF();
    if (!pgff)
@@ -529,6 +1924,10 @@ BEGINFUNC (ReadGFF)
    fh = CHK_ReadOpen (pszFilename);
    if (fh)
    {
+      BOOL fSwap = FALSE;
+      long fileLength = CHK_FileLength (fh);
+      long offset = 0;
+
       for (;;)
       {
          long len;
@@ -539,10 +1938,56 @@ BEGINFUNC (ReadGFF)
          // Read Header
          len = EIO_Read (fh, &chunkheader, sizeof (CHUNKHEADER));
          if (len <= 0 ) break;
+         offset += len;
+
+         // GGFF comes first and is always the same size so its header
+         // says which way round the file is.  Its ByteOrder field is
+         // checked once it's read.
+         if (!pgff->pchunkggff && chunkheader.id == IDGGFF)
+         {
+            UINT32 Size = chunkheader.Size;
+
+            PixConv_Swap32 (&Size, 1);
+            fSwap = (Size == sizeof (GGFFDATA));
+         }
+         if (fSwap)
+         {
+            PixConv_Swap32 (&chunkheader.Size, 1);
+         }
+
+         if (len != sizeof (CHUNKHEADER) || chunkheader.Size > (UINT32)(fileLength - offset))
+         {
+            SetGlobalErr (ERR_GENERIC);
+            GEcatf1 ("GFF chunk runs past the end of %s", pszFilename);
+            CHK_Close (fh);
+            FreeGFF (pgff);
+            RETURN NULL;
+         }
+
+         if (fLazy && chunkheader.id != IDGGFF)
+         {
+            // Just remember where the data is.
+            pchunknode = (CHUNKNODE *)CHK_CreateNode2(sizeof(CHUNKNODE), NULL, "chunk");
+            pchunknode->pchunk = NULL;
+            pchunknode->Header = chunkheader;
+            pchunknode->Offset = offset;
+            LST_AddTail (pgff->plistChunkNodes, pchunknode);
+
+            CHK_Seek (fh, chunkheader.Size, SEEK_CUR);
+            offset += chunkheader.Size;
+            continue;
+         }
 
          // Create new chunk node if was able to read header
          pchunknode = CreateGFFChunkNode (chunkheader.id, chunkheader.Size);
+         if (!pchunknode)
+         {
+            CHK_Close (fh);
+            FreeGFF (pgff);
+            RETURN NULL;
+         }
          pchunk = pchunknode->pchunk;
+         pchunknode->Offset = offset;
 
          #if 0
          PrintID (pchunk->Header.id);
@@ -551,43 +1996,127 @@ BEGINFUNC (ReadGFF)
 
          // Read Data
          CHK_Read (fh, &pchunk->u8First, chunkheader.Size);
-
-         // Fill in convenience pointer for this chunk if necessary.
-         if (pchunk->Header.id == IDGGFF)
-         {
-            //printf("Found GGFF\n");
-            ENSURE_F (NULL == pgff->pchunkggff, ("Multiple GGFF chunks in file"));
-            pgff->pchunkggff = (CHUNKGGFF *)pchunk;  
-         }
-         else if (pchunk->Header.id == IDRGBA)
+         offset += chunkheader.Size;
+         if (fSwap)
          {
-            //printf("Found RGBA\n");
-            ENSURE_F (NULL == pgff->pchunkrgba, ("Multiple RGBA chunks in file"));
-            pgff->pchunkrgba = (CHUNKRGBA *)pchunk;  
+            swapChunkData (pchunk->Header.id, &pchunk->u8First, chunkheader.Size, FALSE);
          }
-         else if (pchunk->Header.id == IDPCON)
+
+         // Add new chunk node to list
+         LST_AddTail (pgff->plistChunkNodes, pchunknode);
+
+         if (pchunk->Header.id == IDRGBZ)
          {
-            //printf("Found PCON\n");
-            ENSURE_F (NULL == pgff->pchunkpcon, ("Multiple PCON chunks in file"));
-            pgff->pchunkpcon = (CHUNKPCON *)pchunk;  
+            if (!expandRGBZNode (pgff, pchunknode))
+            {
+               CHK_Close (fh);
+               FreeGFF (pgff);
+               RETURN NULL;
+            }
+            pchunk = pchunknode->pchunk;
          }
-         else if (pchunk->Header.id == IDINVP)
+
+         // Fill in convenience pointer for this chunk if necessary.
+         setChunkPointer (pgff, pchunk);
+         if (pchunk->Header.id == IDGGFF && pgff->pchunkggff->Data.ByteOrder != GFF_BYTE_ORDER)
          {
-            //printf("Found INVP\n");
-            ENSURE_F (NULL == pgff->pchunkinvp, ("Multiple INVP chunks in file"));
-            pgff->pchunkinvp = (CHUNKINVP *)pchunk;  
+            SetGlobalErr (ERR_GENERIC);
+            GEcatf1 ("Unknown GFF byte order in %s", pszFilename);
+            CHK_Close (fh);
+            FreeGFF (pgff);
+            RETURN NULL;
          }
- 
-         // Add new chunk node to list
-         LST_AddTail (pgff->plistChunkNodes, pchunknode);
 
       } // for(;;)
 
-      CHK_Close(fh);
+      if (fLazy)
+      {
+         pgff->fh    = fh;
+         pgff->fSwap = fSwap;
+      }
+      else
+      {
+         CHK_Close(fh);
+      }
    }
 
 	RETURN pgff;
-} ENDFUNC (ReadGFF)
+} ENDFUNC (ReadGFFEx)
+
+/*************************************************************************
+                            LoadGFFChunkNode
+ *************************************************************************
+
+   SYNOPSIS
+		CHUNKGENERIC *LoadGFFChunkNode (GFF *pgff, CHUNKNODE *pchunknode)
+
+   PURPOSE
+      Make sure a chunk's data is in memory.  Only chunks of a GFF read
+      with GFFREAD_LAZY can be missing, they're read from the file and
+      swapped if needed, RGBZ is expanded to RGBA and the GFF's
+      convenience pointer is filled in.
+
+   INPUT
+		pgff       : GFF the chunk node belongs to.
+		pchunknode : Chunk node to load.
+
+   RETURNS
+      pchunknode->pchunk, NULL on failure.
+
+   HISTORY
+		10/17/26 : Created.
+
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+CHUNKGENERIC *LoadGFFChunkNode (GFF *pgff, CHUNKNODE *pchunknode)
+BEGINFUNC (LoadGFFChunkNode)
+{
+   CHUNKGENERIC *pchunk;
+   UINT32 Size;
+
+   if (pchunknode->pchunk)
+   {
+      RETURN pchunknode->pchunk;
+   }
+
+   Size = pchunknode->Header.Size;
+   pchunk = (CHUNKGENERIC *)malloc ((sizeof (CHUNKHEADER) +  Size));
+   if (!pchunk)
+   {
+      SetGlobalErr (ERR_GENERIC);
+      GEcatf ("Out of memory reading gff");
+      RETURN NULL;
+   }
+
+   pchunk->Header = pchunknode->Header;
+   if (CHK_Seek (pgff->fh, pchunknode->Offset, SEEK_SET) != pchunknode->Offset
+    || CHK_Read (pgff->fh, &pchunk->u8First, Size) != (long)Size)
+   {
+      SetGlobalErr (ERR_GENERIC);
+      GEcatf ("Couldn't read gff chunk");
+      free (pchunk);
+      RETURN NULL;
+   }
+   if (pgff->fSwap)
+   {
+      swapChunkData (pchunk->Header.id, &pchunk->u8First, Size, FALSE);
+   }
+
+   pchunknode->pchunk = pchunk;
+   if (pchunk->Header.id == IDRGBZ)
+   {
+      if (!expandRGBZNode (pgff, pchunknode))
+      {
+         pchunknode->pchunk = NULL;
+         free (pchunk);
+         RETURN NULL;
+      }
+      pchunk = pchunknode->pchunk;
+   }
+   setChunkPointer (pgff, pchunk);
+
+	RETURN pchunk;
+} ENDFUNC (LoadGFFChunkNode)
 
 /*************************************************************************
                                 CreateGFF                                
@@ -739,6 +2268,7 @@ BEGINFUNC (CreateGFFChunkNode)
    pchunk->Header.id = id;
    pchunk->Header.Size = DataSize;
    pchunknode->pchunk = pchunk;
+   pchunknode->Header = pchunk->Header;
 
 	RETURN pchunknode;
 } ENDFUNC (CreateGFFChunkNode)
@@ -872,6 +2402,10 @@ BEGINPROC (FreeGFF)
       LST_Remove (pchunknodeDel);
       DestroyGFFChunkNode (pchunknodeDel);
    }
+   if (pgff->fh)
+   {
+      CHK_Close (pgff->fh);
+   }
    //MEM_FreeMem (pgff);
    free (pgff);
 
@@ -911,25 +2445,97 @@ BEGINPROC (FreeGFF)
 
 int WriteGFF (const char *pszFilename, GFF *pgff)
 BEGINFUNC (WriteGFF)
+{
+	RETURN WriteGFFEx (pszFilename, pgff, 0);
+} ENDFUNC (WriteGFF)
+
+/*************************************************************************
+                               WriteGFFEx
+ *************************************************************************
+
+   SYNOPSIS
+		int WriteGFFEx (const char *pszFilename, GFF *pgff, int flags)
+
+   PURPOSE
+      To write out a GFF structure to a file.  The chunks are staged
+      so small ones share a write.  With GFFWRITE_SWAP the file is
+      written for a machine of the other endian, the GFF itself is not
+      changed.  With GFFWRITE_COMPRESS RGBA chunks are written as
+      RGBZ.  Chunks of a lazy GFF that haven't been read yet are all
+      read in before the file is opened, so a lazy GFF can be written
+      back over the file it came from.
+
+   INPUT
+		pszFileName :
+		pgff        :
+		flags       : GFFWRITE_??? flags.
+
+   RETURNS
+      TRUE on success. FALSE on failure.
+
+   HISTORY
+		10/17/26 : Created.
+
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+int WriteGFFEx (const char *pszFilename, GFF *pgff, int flags)
+BEGINFUNC (WriteGFFEx)
 {
 	int	fh;
    CHUNKNODE   *pchunknode;
+   GFFWRITER   writer;
+   long        total = 0;
+
+   for (pchunknode = (CHUNKNODE *)LST_Head(pgff->plistChunkNodes);
+         !LST_IsEOList(pchunknode);
+         pchunknode = (CHUNKNODE *)LST_Next(pchunknode))
+   {
+      // Opening the file truncates it, which could be the file a lazy
+      // chunk still has to come from.
+      if (!LoadGFFChunkNode (pgff, pchunknode))
+      {
+         RETURN FALSE;
+      }
+      total += sizeof (CHUNKHEADER) + pchunknode->pchunk->Header.Size;
+   }
 
    fh = CHK_WriteOpen (pszFilename);
+   if (!openGFFWriter (&writer, fh, total, (flags & GFFWRITE_SWAP) != 0))
+   {
+      CHK_Close (fh);
+      RETURN FALSE;
+   }
+
    for (pchunknode = (CHUNKNODE *)LST_Head(pgff->plistChunkNodes);
          !LST_IsEOList(pchunknode);
          pchunknode = (CHUNKNODE *)LST_Next(pchunknode))
    {
-      CHUNKGENERIC *pchunk;
-      pchunk = pchunknode->pchunk;
+      CHUNKGENERIC *pchunk = pchunknode->pchunk;
+
+      if ((flags & GFFWRITE_COMPRESS) && pchunk->Header.id == IDRGBA && pgff->pchunkggff
+       && pchunk->Header.Size == (UINT32)pgff->pchunkggff->Data.Width * pgff->pchunkggff->Data.Height * sizeof (RGBADATA))
+      {
+         UINT32 Size;
+         UINT8 *pData;
+
+         pData = encodeRGBZ (&pchunk->u8First, pgff->pchunkggff->Data.Width,
+                             pgff->pchunkggff->Data.Height, FALSE, &Size);
+         if (!pData)
+         {
+            closeGFFWriter (&writer);
+            CHK_Close (fh);
+            RETURN FALSE;
+         }
+         writeGFFChunk (&writer, IDRGBZ, pData, Size);
+         free (pData);
+         continue;
+      }
 
-      // Write Header
-         CHK_Write (fh, &pchunk->Header, sizeof(CHUNKHEADER));
-      // Write Data
-         CHK_Write (fh, &pchunk->u8First, pchunk->Header.Size);
+      writeGFFChunk (&writer, pchunk->Header.id, &pchunk->u8First, pchunk->Header.Size);
    }
+   closeGFFWriter (&writer);
    CHK_Close (fh);
 
 	RETURN TRUE;
-} ENDFUNC (WriteGFF)
+} ENDFUNC (WriteGFFEx)
 
@@ -60,18 +60,54 @@
 #include "echidna/eio.h"
 #include "echidna/checkglu.h"
 #include "echidna/eerrors.h"
+#include "echidna/ethread.h"
 
 #include "readpcx.h"
 #include "readpic.h"
 #include "readtga.h"
 #include "photoshp.h"
+#include "piccache.h"
+#include "picpool.h"
 #include "echidna/gff.h"
 
 /*************************** C O N S T A N T S ***************************/
 
+// big enough for the largest header ReadPictureInfo needs (PIC = 104 + 4 * 4)
+#define PICTURE_INFO_HEADER_SIZE	256
+
+// what the *FromMemory readers call the picture in messages
+#define MEMORY_PICTURE_NAME			"<memory>"
+
+// Softimage PIC files start with this (big endian)
+#define PIC_MAGIC					0x5380F634UL
+
+// TGA 2.0 files end with this (plus a 0)
+#define TGA_FOOTER_SIGNATURE		"TRUEVISION-XFILE."
+#define TGA_FOOTER_SIZE				26
 
 /******************************* T Y P E S *******************************/
 
+// one file of a PictureBatch
+typedef struct
+{
+	BlockO32BitPixels	*pBOP;		// set by the task
+	ETHREAD_TASK		*task;		// NULL until started and after it's taken
+	long				 bytes;		// what it counts for against the budget
+} PictureBatchFile;
+
+struct PictureBatch
+{
+	const char			**filenames;
+	int					 numFiles;
+	int					 readAhead;		// most files being read or waiting to be taken
+	long				 memoryBudget;	// most bytes of them, 0 = no limit
+	int					 nextToStart;
+	int					 nextToTake;
+	long				 bytesAhead;	// bytes of files started and not yet taken
+	PicturePool			*pool;			// where the pictures' pixels come from, can be NULL
+	ETHREAD_POOL		*readers;		// readAhead threads the files are read on
+	PictureBatchFile	*files;
+};
 
 /************************** P R O T O T Y P E S **************************/
 
@@ -86,117 +122,893 @@
 
 /*********************************************************************
  *
- * Read32BitPicture
+ * pictureFormatOfExt
  *
  * SYNOPSIS
- *		BlockO32BitPixels *Read32BitPicture (CString &filename, CString &ext)
+ *		static int pictureFormatOfExt (const char *filename)
  *
  * PURPOSE
- *		
+ *		Which PICFMT_??? a filename's extension says it is.
+ *
+ * RETURN VALUE
+ *		PICFMT_??? or PICFMT_UNKNOWN.
+ *
+*/
+static int pictureFormatOfExt (const char *filename)
+{
+	char	ext[EIO_MAXEXT + 1];	// not EIO_Ext's static, batches run this on several threads
+
+	EIO_fnsplit (filename, NULL, NULL, ext);
+
+	if (!stricmp (".psd", ext)) return PICFMT_PSD;
+	if (!stricmp (".tga", ext)) return PICFMT_TGA;
+	if (!stricmp (".pic", ext)) return PICFMT_PIC;
+	if (!stricmp (".pcx", ext)) return PICFMT_PCX;
+	if (!stricmp (".gff", ext)) return PICFMT_GFF;
+
+	return PICFMT_UNKNOWN;
+}
+// pictureFormatOfExt
+
+/*********************************************************************
+ *
+ * DetectPictureFormat
+ *
+ * SYNOPSIS
+ *		int DetectPictureFormat (const void *pData, long size)
+ *
+ * PURPOSE
+ *		Work out what sort of picture is in memory from its first few
+ *		bytes.  PSD, PIC and GFF have magic numbers, PCX has a fixed
+ *		first byte and a small set of versions.  TGA has no magic so
+ *		it's checked last, by its 2.0 footer if it has one or by a
+ *		header that makes sense.
  *
  * INPUT
+ *		pData : the start of the picture (or the whole of it)
+ *		size  : bytes at pData
  *
+ * RETURN VALUE
+ *		PICFMT_??? or PICFMT_UNKNOWN.
  *
- * EFFECTS
+*/
+int DetectPictureFormat (const void *pData, long size)
+{
+	const uint8	*p = (const uint8 *)pData;
+
+	if (!p || size < 4)
+	{
+		return PICFMT_UNKNOWN;
+	}
+
+	if (p[0] == '8' && p[1] == 'B' && p[2] == 'P' && p[3] == 'S')
+	{
+		return PICFMT_PSD;
+	}
+	if (p[0] == 'G' && p[1] == 'G' && p[2] == 'F' && p[3] == 'F')
+	{
+		return PICFMT_GFF;
+	}
+	if ((((uint32)p[0] << 24) | ((uint32)p[1] << 16) | ((uint32)p[2] << 8) | (uint32)p[3]) == PIC_MAGIC)
+	{
+		return PICFMT_PIC;
+	}
+	if (p[0] == 10 && p[1] <= 5 && p[2] <= 1 && (p[3] == 1 || p[3] == 2 || p[3] == 4 || p[3] == 8))
+	{
+		return PICFMT_PCX;
+	}
+
+	if (size >= TGA_FOOTER_SIZE && !memcmp (p + size - TGA_FOOTER_SIZE + 8, TGA_FOOTER_SIGNATURE, sizeof (TGA_FOOTER_SIGNATURE)))
+	{
+		return PICFMT_TGA;
+	}
+	if (size >= 18 && p[1] <= 1)
+	{
+		int	bpp = p[16];
+
+		switch (p[2])
+		{
+		case 1:
+		case 9:
+			if (p[1] == 1 && bpp == 8) return PICFMT_TGA;
+			break;
+		case 2:
+		case 10:
+			if (bpp == 15 || bpp == 16 || bpp == 24 || bpp == 32) return PICFMT_TGA;
+			break;
+		case 3:
+		case 11:
+			if (bpp == 8) return PICFMT_TGA;
+			break;
+		}
+	}
+
+	return PICFMT_UNKNOWN;
+}
+// DetectPictureFormat
+
+/*********************************************************************
+ *
+ * pictureFormatOfFile
  *
+ * SYNOPSIS
+ *		static int pictureFormatOfFile (const char *filename, const void *pData, long size)
+ *
+ * PURPOSE
+ *		The extension decides like it always has.  Files with an
+ *		extension we don't know get a look at their magic bytes.
+ *
+*/
+static int pictureFormatOfFile (const char *filename, const void *pData, long size)
+{
+	int	format = pictureFormatOfExt (filename);
+
+	if (format == PICFMT_UNKNOWN)
+	{
+		format = DetectPictureFormat (pData, size);
+	}
+	return format;
+}
+// pictureFormatOfFile
+
+/*********************************************************************
+ *
+ * load32BitPicture
+ *
+ * SYNOPSIS
+ *		static int load32BitPicture (BlockO32BitPixels *b32, MEMFILE *mf, int format, const char *name)
+ *
+ * PURPOSE
+ *		Decode a picture of the given format from mf into b32.  The
+ *		pixels go wherever b32's capacity and pool say.  name is only
+ *		used in messages.
  *
  * RETURN VALUE
+ *		FALSE on error (GlobalErr is set).
+ *
+*/
+static int load32BitPicture (BlockO32BitPixels *b32, MEMFILE *mf, int format, const char *name)
+{
+	int	result = FALSE;
+
+	// only loaders that can leave the rows bottom first set it
+	b32->fBottomUp = FALSE;
+
+	switch (format)
+	{
+	case PICFMT_PSD:
+		InfoMess (("Loading Photoshop file %s\n", name));
+		result = loadPhotoshop32Bit (b32, mf);
+		break;
+	case PICFMT_TGA:
+		InfoMess (("Loading Targa file %s\n", name));
+		result = loadTGA32Bit (b32, mf);
+		break;
+	case PICFMT_PIC:
+		InfoMess (("Loading Softimage PIC file %s\n", name));
+		result = loadPIC32Bit (b32, mf);
+		break;
+	case PICFMT_PCX:
+		InfoMess (("Loading PCX file %s\n", name));
+		result = loadPCX32Bit (b32, mf);
+		break;
+	case PICFMT_GFF:
+		InfoMess (("Loading GFF file %s\n", name));
+		result = loadGFF32Bit (b32, mf);
+		break;
+	default:
+		SetGlobalErr (ERR_GENERIC);
+		GEcatf1 ("Unsupported file type '%s'", name);
+		break;
+	}
+
+	if (!result)
+	{
+		FreePicturePixels (b32);
+		return FALSE;
+	}
+
+	InfoMess (("Width = %d, Height = %d\n", b32->width, b32->height));
+
+	return TRUE;
+}
+// load32BitPicture
+
+/*********************************************************************
  *
+ * newPicture
  *
- * HISTORY
+ * SYNOPSIS
+ *		static BlockO32BitPixels *newPicture (PicturePool *pool, const char *name)
+ *
+ * PURPOSE
+ *		Make an empty picture whose pixels will come from pool (or
+ *		malloc if pool is NULL).
+ *
+ * RETURN VALUE
+ *		The picture or NULL if out of memory (GlobalErr is set).
+ *
+*/
+static BlockO32BitPixels *newPicture (PicturePool *pool, const char *name)
+{
+	BlockO32BitPixels	*b32;
+
+	b32 = (BlockO32BitPixels *)calloc(sizeof (BlockO32BitPixels),1);
+	if (!b32)
+	{
+		SetGlobalErr (ERR_GENERIC);
+		GEcatf1 ("Out of memory reading '%s'", name);
+		return NULL;
+	}
+	b32->pool = pool;
+
+	return b32;
+}
+// newPicture
+
+/*********************************************************************
+ *
+ * readPictureFile
+ *
+ * SYNOPSIS
+ *		static int readPictureFile (const char* filename, BlockO32BitPixels *b32)
+ *
+ * PURPOSE
+ *		Read and decode a file into b32, or get it from the picture
+ *		cache if it's there.
+ *
+ * RETURN VALUE
+ *		FALSE on error (GlobalErr is set).
+ *
+*/
+static int readPictureFile (const char* filename, BlockO32BitPixels *b32)
+{
+	MEMFILE	*mf;
+	int		 result = FALSE;
+
+	mf = MEMFILE_Open (filename);
+	if (mf)
+	{
+		int			format = pictureFormatOfFile (filename, mf->buffer, mf->size);
+		PICCACHEKEY	key;
+
+		// GFFs are the pipeline's own output and quick to load so
+		// they'd just fill the cache.  The cache only has pictures
+		// the right way up.
+		key.fEnabled = FALSE;
+		if (format != PICFMT_GFF && !b32->fNativeOrientation)
+		{
+			result = PicCache_Load (mf->buffer, mf->size, &key, b32);
+		}
+		if (!result)
+		{
+			result = load32BitPicture (b32, mf, format, filename);
+			if (result)
+			{
+				PicCache_Save (&key, b32);
+			}
+		}
+
+		MEMFILE_Close (mf);
+	}
+	else
+	{
+		SetGlobalErr (ERR_GENERIC);
+		GEcatf1 ("Trouble reading file '%s'", filename);
+	}
+
+	return result;
+}
+// readPictureFile
+
+/*********************************************************************
  *
+ * Read32BitPicture
+ *
+ * SYNOPSIS
+ *		BlockO32BitPixels *Read32BitPicture (const char* filename)
+ *
+ * PURPOSE
+ *		Load a picture as 32 bit pixels.  The format comes from the
+ *		extension or, if that's not one we know, the file's magic
+ *		bytes.
+ *
+ * RETURN VALUE
+ *		The picture or NULL on error (GlobalErr is set).  Free it with
+ *		Free32BitPicture.
+ *
+ *		If there's a picture cache (see SetPictureCacheDir) a file
+ *		that has been decoded before is read from there instead.
  *
  * SEE ALSO
+ *		Read32BitPictureFromMemory
+ *
+*/
+BlockO32BitPixels *Read32BitPicture (const char* filename)
+{
+	return Read32BitPictureFromPool (filename, NULL);
+}
+// Read32BitPicture
+
+/*********************************************************************
+ *
+ * Read32BitPictureEx
+ *
+ * SYNOPSIS
+ *		BlockO32BitPixels *Read32BitPictureEx (const char* filename, int flags)
+ *
+ * PURPOSE
+ *		Read32BitPicture with options.
+ *
+ * INPUT
+ *		filename : file to read
+ *		flags    : PICREAD_??? flags.  With PICREAD_NATIVE_ORIENTATION
+ *		           the rows are left in the order the file has them
+ *		           and fBottomUp is TRUE if that's bottom first.  It
+ *		           saves a pass over bottom up tgas for callers that
+ *		           can deal with them that way round.
+ *
+ * RETURN VALUE
+ *		The picture or NULL on error (GlobalErr is set).  Free it with
+ *		Free32BitPicture.
+ *
+*/
+BlockO32BitPixels *Read32BitPictureEx (const char* filename, int flags)
+{
+	BlockO32BitPixels	*b32;
+
+	b32 = newPicture (NULL, filename);
+	if (b32)
+	{
+		b32->fNativeOrientation = (flags & PICREAD_NATIVE_ORIENTATION) != 0;
+		if (!readPictureFile (filename, b32))
+		{
+			free (b32);
+			b32 = NULL;
+		}
+	}
+
+	return b32;
+}
+// Read32BitPictureEx
+
+/*********************************************************************
+ *
+ * Read32BitPictureFromPool
+ *
+ * SYNOPSIS
+ *		BlockO32BitPixels *Read32BitPictureFromPool (const char* filename, PicturePool *pool)
+ *
+ * PURPOSE
+ *		Like Read32BitPicture but the pixels go in a buffer from pool,
+ *		one freed by an earlier picture of about the same size if
+ *		there is one.  Free32BitPicture gives the buffer back to the
+ *		pool.
+ *
+ * INPUT
+ *		filename : file to read
+ *		pool     : from CreatePicturePool, NULL to just use malloc
+ *
+ * RETURN VALUE
+ *		The picture or NULL on error (GlobalErr is set).  Free it with
+ *		Free32BitPicture before destroying the pool.
+ *
+*/
+BlockO32BitPixels *Read32BitPictureFromPool (const char* filename, PicturePool *pool)
+{
+	BlockO32BitPixels	*b32;
+
+	b32 = newPicture (pool, filename);
+	if (b32 && !readPictureFile (filename, b32))
+	{
+		free (b32);
+		b32 = NULL;
+	}
+
+	return b32;
+}
+// Read32BitPictureFromPool
+
+/*********************************************************************
+ *
+ * Read32BitPictureInto
+ *
+ * SYNOPSIS
+ *		int Read32BitPictureInto (const char* filename, BlockO32BitPixels *pBOP)
+ *
+ * PURPOSE
+ *		Like Read32BitPicture but decodes into the caller's own buffer,
+ *		so nothing is allocated for the pixels.  ReadPictureInfo can
+ *		be used first to find how big it needs to be.
+ *
+ * INPUT
+ *		filename : file to read
+ *		pBOP     : rgba is the buffer and capacity how many pixels it
+ *		           holds.  width, height and channels are filled in.
+ *		           Don't pass it to Free32BitPicture.
+ *
+ * RETURN VALUE
+ *		FALSE on error (GlobalErr is set), which includes the picture
+ *		not fitting.
+ *
+*/
+int Read32BitPictureInto (const char* filename, BlockO32BitPixels *pBOP)
+{
+	if (!pBOP->rgba || pBOP->capacity <= 0)
+	{
+		SetGlobalErr (ERR_GENERIC);
+		GEcatf1 ("No buffer to read '%s' into", filename);
+		return FALSE;
+	}
+	pBOP->pool = NULL;
+
+	return readPictureFile (filename, pBOP);
+}
+// Read32BitPictureInto
+
+/*********************************************************************
+ *
+ * Read32BitPictureFromMemory
+ *
+ * SYNOPSIS
+ *		BlockO32BitPixels *Read32BitPictureFromMemory (const void *pData, long size, int formatHint)
+ *
+ * PURPOSE
+ *		Like Read32BitPicture but decodes a picture that's already in
+ *		memory, an entry in a bundle or something read from a pipe,
+ *		without going through a file.  The data is only read and can
+ *		be freed as soon as this returns.
+ *
+ * INPUT
+ *		pData      : the picture file image
+ *		size       : bytes at pData
+ *		formatHint : PICFMT_??? if known, PICFMT_UNKNOWN to look at the
+ *		             magic bytes
+ *
+ * RETURN VALUE
+ *		The picture or NULL on error (GlobalErr is set).  Free it with
+ *		Free32BitPicture.
+ *
+*/
+BlockO32BitPixels *Read32BitPictureFromMemory (const void *pData, long size, int formatHint)
+{
+	BlockO32BitPixels	*b32;
+	MEMFILE				 mf;
+
+	if (!pData || size <= 0)
+	{
+		SetGlobalErr (ERR_GENERIC);
+		GEcatf ("No picture data");
+		return NULL;
+	}
+
+	MEMFILE_Init (&mf, (void *)pData, size);
+
+	b32 = newPicture (NULL, MEMORY_PICTURE_NAME);
+	if (b32 && !load32BitPicture (b32, &mf, formatHint != PICFMT_UNKNOWN ? formatHint : DetectPictureFormat (pData, size), MEMORY_PICTURE_NAME))
+	{
+		free (b32);
+		b32 = NULL;
+	}
+
+	return b32;
+}
+// Read32BitPictureFromMemory
+
+void Free32BitPicture (BlockO32BitPixels *pBOP)
+{
+	FreePicturePixels (pBOP);
+
+	free (pBOP);
+}
+
+/*********************************************************************
+ *
+ * readBatchFile
+ *
+ * SYNOPSIS
+ *		static void readBatchFile (void *pUserData, int job)
+ *
+ * PURPOSE
+ *		ETHREAD task that reads file job of a PictureBatch.
+ *
+*/
+static void readBatchFile (void *pUserData, int job)
+{
+	PictureBatch	*pBatch = (PictureBatch *)pUserData;
+
+	pBatch->files[job].pBOP = Read32BitPictureFromPool (pBatch->filenames[job], pBatch->pool);
+}
+// readBatchFile
+
+/*********************************************************************
+ *
+ * startBatchReads
+ *
+ * SYNOPSIS
+ *		static void startBatchReads (PictureBatch *pBatch)
+ *
+ * PURPOSE
+ *		Start reading as many of the next files as readAhead and the
+ *		memory budget allow.  Each file's size comes from its header
+ *		before it's started, one that can't be read counts for nothing
+ *		since reading it will fail too.  One file is always allowed so
+ *		a picture bigger than the budget still gets read.
+ *
+*/
+static void startBatchReads (PictureBatch *pBatch)
+{
+	while (pBatch->nextToStart < pBatch->numFiles
+		&& pBatch->nextToStart - pBatch->nextToTake < pBatch->readAhead)
+	{
+		PictureBatchFile	*pFile = &pBatch->files[pBatch->nextToStart];
+
+		if (pBatch->memoryBudget && !pFile->bytes)
+		{
+			PictureInfo	info;
+
+			if (ReadPictureInfo (pBatch->filenames[pBatch->nextToStart], &info))
+			{
+				pFile->bytes = info.width * info.height * sizeof (pixel32);
+			}
+		}
+		if (pBatch->nextToStart != pBatch->nextToTake
+			&& pBatch->memoryBudget
+			&& pBatch->bytesAhead + pFile->bytes > pBatch->memoryBudget)
+		{
+			break;
+		}
+
+		pBatch->bytesAhead += pFile->bytes;
+		pFile->task         = ETHREAD_StartPoolTask (pBatch->readers, readBatchFile, pBatch, pBatch->nextToStart);
+		pBatch->nextToStart++;
+	}
+}
+// startBatchReads
+
+/*********************************************************************
+ *
+ * Read32BitPictureBatch
+ *
+ * SYNOPSIS
+ *		PictureBatch *Read32BitPictureBatch (const char **filenames, int numFiles, int readAhead, long memoryBudget, PicturePool *pool)
+ *
+ * PURPOSE
+ *		Start reading a list of pictures in the background.  Take them
+ *		in order with Read32BitPictureBatchNext, while the caller uses
+ *		one the next readAhead are read and decoded on a pool of
+ *		readAhead threads.
+ *
+ * INPUT
+ *		filenames    : files to read, the strings must last until
+ *		               Read32BitPictureBatchClose
+ *		numFiles     : how many
+ *		readAhead    : most files read ahead at once, 0 for one per CPU
+ *		memoryBudget : about the most bytes of decoded pictures held
+ *		               ahead, not counting the one the caller has.  0
+ *		               for no limit.
+ *		pool         : where the pictures' pixels come from, NULL
+ *		               for malloc.  See Read32BitPictureFromPool.
+ *
+ * RETURN VALUE
+ *		The batch or NULL if out of memory (GlobalErr is set).  Free it
+ *		with Read32BitPictureBatchClose.
+ *
+*/
+PictureBatch *Read32BitPictureBatch (const char **filenames, int numFiles, int readAhead, long memoryBudget, PicturePool *pool)
+{
+	PictureBatch	*pBatch;
+
+	pBatch = (PictureBatch *)calloc (1, sizeof (PictureBatch));
+	if (pBatch)
+	{
+		pBatch->filenames = (const char **)malloc (numFiles * sizeof (const char *) + 1);
+		pBatch->files     = (PictureBatchFile *)calloc (numFiles + 1, sizeof (PictureBatchFile));
+		pBatch->readAhead = readAhead > 0 ? readAhead : ETHREAD_NumCPUs ();
+		pBatch->readers   = ETHREAD_CreatePool (pBatch->readAhead);
+	}
+	if (!pBatch || !pBatch->filenames || !pBatch->files || !pBatch->readers)
+	{
+		if (pBatch)
+		{
+			ETHREAD_DestroyPool (pBatch->readers);
+			free (pBatch->filenames);
+			free (pBatch->files);
+			free (pBatch);
+		}
+		SetGlobalErr (ERR_GENERIC);
+		GEcatf ("Out of memory");
+		return NULL;
+	}
+
+	memcpy (pBatch->filenames, filenames, numFiles * sizeof (const char *));
+	pBatch->numFiles     = numFiles;
+	pBatch->memoryBudget = memoryBudget;
+	pBatch->pool         = pool;
+
+	// the decoders use the default pool and the picture cache, both
+	// have to be set up on this thread
+	ETHREAD_DefaultPool ();
+	PicCache_Init ();
+
+	startBatchReads (pBatch);
+
+	return pBatch;
+}
+// Read32BitPictureBatch
+
+/*********************************************************************
+ *
+ * Read32BitPictureBatchNext
+ *
+ * SYNOPSIS
+ *		int Read32BitPictureBatchNext (PictureBatch *pBatch, BlockO32BitPixels **ppBOP, const char **pFilename)
+ *
+ * PURPOSE
+ *		Take the next picture of a batch, waiting for it if it's not
+ *		read yet, and start reading more.
+ *
+ * INPUT
+ *		pBatch    : from Read32BitPictureBatch
+ *		ppBOP     : set to the picture or NULL if it couldn't be read
+ *		            (GlobalErr is set).  Free it with Free32BitPicture.
+ *		pFilename : set to its filename, can be NULL
+ *
+ * RETURN VALUE
+ *		FALSE when there are no more files.
+ *
+*/
+int Read32BitPictureBatchNext (PictureBatch *pBatch, BlockO32BitPixels **ppBOP, const char **pFilename)
+{
+	PictureBatchFile	*pFile;
+	const char			*filename;
+
+	if (pBatch->nextToTake >= pBatch->numFiles)
+	{
+		*ppBOP = NULL;
+		return FALSE;
+	}
+
+	pFile    = &pBatch->files[pBatch->nextToTake];
+	filename = pBatch->filenames[pBatch->nextToTake];
+	pBatch->nextToTake++;
+
+	ETHREAD_FinishTask (pFile->task);
+	pFile->task         = NULL;
+	pBatch->bytesAhead -= pFile->bytes;
+
+	*ppBOP = pFile->pBOP;
+	pFile->pBOP = NULL;
+	if (!*ppBOP)
+	{
+		// the reading threads may have mixed up their messages so
+		// start a new one
+		SetGlobalErr (ERR_GENERIC);
+		GEprintf1 ("Trouble reading file '%s'", filename);
+	}
+	if (pFilename)
+	{
+		*pFilename = filename;
+	}
+
+	startBatchReads (pBatch);
+
+	return TRUE;
+}
+// Read32BitPictureBatchNext
+
+/*********************************************************************
+ *
+ * Read32BitPictureBatchClose
+ *
+ * SYNOPSIS
+ *		void Read32BitPictureBatchClose (PictureBatch *pBatch)
+ *
+ * PURPOSE
+ *		Wait for any reads still going, free the pictures that were
+ *		never taken and free the batch.
+ *
+*/
+void Read32BitPictureBatchClose (PictureBatch *pBatch)
+{
+	int	i;
+
+	if (!pBatch)
+	{
+		return;
+	}
+
+	for (i = pBatch->nextToTake; i < pBatch->nextToStart; i++)
+	{
+		ETHREAD_FinishTask (pBatch->files[i].task);
+		if (pBatch->files[i].pBOP)
+		{
+			Free32BitPicture (pBatch->files[i].pBOP);
+		}
+	}
+
+	ETHREAD_DestroyPool (pBatch->readers);
+	free (pBatch->filenames);
+	free (pBatch->files);
+	free (pBatch);
+}
+// Read32BitPictureBatchClose
+
+/*********************************************************************
+ *
+ * ReadPictureInfo
+ *
+ * SYNOPSIS
+ *		int ReadPictureInfo (const char* filename, PictureInfo *pInfo)
+ *
+ * PURPOSE
+ *		Get the size and format of a picture by reading just its header.
+ *		No pixels are decoded.
+ *
+ * INPUT
+ *		filename : file to look at
+ *		pInfo    : filled out on success
+ *
+ * RETURN VALUE
+ *		TRUE on success, FALSE on failure (GlobalErr is set)
+ *
+*/
+int ReadPictureInfo (const char* filename, PictureInfo *pInfo)
+{
+	uint8	 header[PICTURE_INFO_HEADER_SIZE];
+	MEMFILE	 mf;
+	int		 fh;
+	long	 len;
+	int		 result = FALSE;
+
+	memset (pInfo, 0, sizeof (PictureInfo));
+
+	fh = EIO_ReadOpen (filename);
+	if (fh == (-1))
+	{
+		SetGlobalErr (ERR_GENERIC);
+		GEcatf1 ("Trouble reading file '%s'", filename);
+		return FALSE;
+	}
+	len = EIO_Read (fh, header, sizeof (header));
+	EIO_Close (fh);
+
+	if (len <= 0)
+	{
+		SetGlobalErr (ERR_GENERIC);
+		GEcatf1 ("Trouble reading file '%s'", filename);
+		return FALSE;
+	}
+
+	MEMFILE_Init (&mf, header, len);
+
+	switch (pictureFormatOfFile (filename, header, len))
+	{
+	case PICFMT_PSD:
+		result = loadPhotoshopInfo (pInfo, &mf);
+		break;
+	case PICFMT_TGA:
+		result = loadTGAInfo (pInfo, &mf);
+		break;
+	case PICFMT_PIC:
+		result = loadPICInfo (pInfo, &mf);
+		break;
+	case PICFMT_PCX:
+		result = loadPCXInfo (pInfo, &mf);
+		break;
+	case PICFMT_GFF:
+		result = loadGFFInfo (pInfo, &mf);
+		break;
+	default:
+		SetGlobalErr (ERR_GENERIC);
+		GEcatf1 ("Unsupported file type '%s'", filename);
+		break;
+	}
+
+	return result;
+}
+// ReadPictureInfo
+
+/*********************************************************************
+ *
+ * Stream32BitPicture
+ *
+ * SYNOPSIS
+ *		int Stream32BitPicture (const char* filename, long bandRows, PFNPICTUREROWS pfnRows, void *pUserData)
+ *
+ * PURPOSE
+ *		Decode a picture a band of rows at a time instead of all at
+ *		once.  pfnRows is called with each band, top row first.  Only
+ *		one band of decoded pixels exists at a time so this is the way
+ *		to look at every pixel of a big picture (histograms etc).
+ *
+ * INPUT
+ *		filename  : file to read
+ *		bandRows  : rows per call, 0 = PICTURE_STREAM_BAND_ROWS
+ *		pfnRows   : called with each band, return FALSE to stop
+ *		pUserData : passed to pfnRows
+ *
+ * RETURN VALUE
+ *		TRUE if the whole picture was decoded.  FALSE on error (GlobalErr
+ *		is set) or if pfnRows returned FALSE.
  *
 */
-BlockO32BitPixels *Read32BitPicture (const char* filename)
+int Stream32BitPicture (const char* filename, long bandRows, PFNPICTUREROWS pfnRows, void *pUserData)
 {
-	BlockO32BitPixels	*b32 = 0;
-	MEMFILE				*mf;
+	MEMFILE	*mf;
+	int		 result = FALSE;
 
-	mf = MEMFILE_Load (filename);
-	if (mf)
+	if (bandRows <= 0)
 	{
-		b32 = (BlockO32BitPixels *)calloc(sizeof (BlockO32BitPixels),1);
-	
-		if (!stricmp (".psd", EIO_Ext(filename)))
-		{
-			InfoMess (("Loading Photoshop file %s\n", filename));
-			if (!loadPhotoshop32Bit (b32, mf))
-			{
-				free(b32);
-				b32 = 0;
-			}
-		}
-		else if (!stricmp (".tga", EIO_Ext(filename)))
-		{
-			InfoMess (("Loading Targa file %s\n", filename));
-			if (!loadTGA32Bit (b32, mf))
-			{
-				free(b32);
-				b32 = 0;
-			}
-		}
-		else if (!stricmp (".pic", EIO_Ext(filename)))
-		{
-			InfoMess (("Loading Softimage PIC file %s\n", filename));
-			if (!loadPIC32Bit (b32, mf))
-			{
-				free(b32);
-				b32 = 0;
-			}
-		}
-		else if (!stricmp (".pcx", EIO_Ext(filename)))
-		{
-			InfoMess (("Loading PCX file %s\n", filename));
-			if (!loadPCX32Bit (b32, mf))
-			{
-				free(b32);
-				b32 = 0;
-			}
-		}
-		else if (!stricmp (".gff", EIO_Ext(filename)))
-		{
-			InfoMess (("Loading GFF file %s\n", filename));
-			if (!loadGFF32Bit (b32, mf))
-			{
-				free(b32);
-				b32 = 0;
-			}
-		}
-		else
-		{
-			b32 = 0;
-			SetGlobalErr (ERR_GENERIC);
-			GEcatf1 ("Unsupported file type '%s'", filename);
-		}
-
-		MEMFILE_Close (mf);
+		bandRows = PICTURE_STREAM_BAND_ROWS;
 	}
-	else
+
+	mf = MEMFILE_Open (filename);
+	if (!mf)
 	{
 		SetGlobalErr (ERR_GENERIC);
 		GEcatf1 ("Trouble reading file '%s'", filename);
+		return FALSE;
 	}
 
-	if (b32)
+	switch (pictureFormatOfFile (filename, mf->buffer, mf->size))
 	{
-		InfoMess (("Width = %d, Height = %d\n", b32->width, b32->height));
+	case PICFMT_PSD:
+		InfoMess (("Streaming Photoshop file %s\n", filename));
+		result = streamPhotoshop32Bit (mf, bandRows, pfnRows, pUserData);
+		break;
+	case PICFMT_TGA:
+		InfoMess (("Streaming Targa file %s\n", filename));
+		result = streamTGA32Bit (mf, bandRows, pfnRows, pUserData);
+		break;
+	case PICFMT_PIC:
+		InfoMess (("Streaming Softimage PIC file %s\n", filename));
+		result = streamPIC32Bit (mf, bandRows, pfnRows, pUserData);
+		break;
+	case PICFMT_PCX:
+		InfoMess (("Streaming PCX file %s\n", filename));
+		result = streamPCX32Bit (mf, bandRows, pfnRows, pUserData);
+		break;
+	case PICFMT_GFF:
+		InfoMess (("Streaming GFF file %s\n", filename));
+		result = streamGFF32Bit (mf, bandRows, pfnRows, pUserData);
+		break;
+	default:
+		SetGlobalErr (ERR_GENERIC);
+		GEcatf1 ("Unsupported file type '%s'", filename);
+		break;
 	}
 
-	return b32;
+	MEMFILE_Close (mf);
+
+	return result;
 }
-// Read32BitPicture
+// Stream32BitPicture
 
-void Free32BitPicture (BlockO32BitPixels *pBOP)
+/*********************************************************************
+ *
+ * PictureFormatName
+ *
+ * SYNOPSIS
+ *		const char *PictureFormatName (int format)
+ *
+ * PURPOSE
+ *		Printable name for a PICFMT_??? value.
+ *
+*/
+const char *PictureFormatName (int format)
 {
-	if (pBOP->rgba)
+	switch (format)
 	{
-		free (pBOP->rgba);
+	case PICFMT_TGA:	return "tga";
+	case PICFMT_PSD:	return "psd";
+	case PICFMT_PIC:	return "pic";
+	case PICFMT_PCX:	return "pcx";
+	case PICFMT_GFF:	return "gff";
 	}
-
-	free (pBOP);
+	return "unknown";
 }
+// PictureFormatName
 
 /*************************************************************************
                             Write32BitPicture
@@ -231,19 +1043,51 @@ void Free32BitPicture (BlockO32BitPixels *pBOP)
 
 int Write32BitPicture (const char *filename, BlockO32BitPixels *pBOP)
 BEGINFUNC (Write32BitPicture)
+{
+	RETURN Write32BitPictureEx (filename, pBOP, 0);
+
+} ENDFUNC (Write32BitPicture)
+
+/*************************************************************************
+                            Write32BitPictureEx
+ *************************************************************************
+
+   SYNOPSIS
+		int Write32BitPictureEx (const char *filename, BlockO32BitPixels *pBOP, int flags)
+
+   PURPOSE
+		Write32BitPicture with options.
+
+   INPUT
+		filename : file to write, the extension picks the format
+		pBOP     : picture to save
+		flags    : PICWRITE_??? flags.  PICWRITE_RLE compresses
+		           formats that can be (tga, gff), others ignore it.
+
+   RETURNS
+		TRUE on success.
+
+   HISTORY
+		10/17/26 : Created.
+
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+int Write32BitPictureEx (const char *filename, BlockO32BitPixels *pBOP, int flags)
+BEGINFUNC (Write32BitPictureEx)
 {
 	int	fh;
+	int	result = TRUE;
 
 	if (!stricmp(".tga", EIO_Ext(filename)))
 	{
 		fh = CHK_WriteOpen (filename);
-		saveTGA32Bit (fh, pBOP);
+		result = saveTGA32BitEx (fh, pBOP, (flags & PICWRITE_RLE) != 0);
 		CHK_Close (fh);
 	}
 	else if (!stricmp(".gff", EIO_Ext(filename)))
 	{
 		fh = CHK_WriteOpen (filename);
-		saveGFF32Bit (fh, pBOP);
+		result = saveGFF32BitEx (fh, pBOP, (flags & PICWRITE_RLE) != 0);
 		CHK_Close (fh);
  	}
 	else if (!stricmp(".rgb", EIO_Ext(filename)))
@@ -269,33 +1113,101 @@ BEGINFUNC (Write32BitPicture)
 		return FALSE;
 	}
 
-	return TRUE;
+	return result;
 
-} ENDFUNC (Write32BitPicture)
+} ENDFUNC (Write32BitPictureEx)
 
 /*********************************************************************
  *
- * Read8BitPicture
+ * load8BitPicture
  *
  * SYNOPSIS
- *		BlockO8BitPixels *Read8BitPicture (const char *filename)
+ *		static BlockO8BitPixels *load8BitPicture (MEMFILE *mf, int format, const char *name)
  *
  * PURPOSE
- *		
+ *		Decode an 8 bit picture of the given format from mf.  name is
+ *		only used in messages.
  *
- * INPUT
+*/
+static BlockO8BitPixels *load8BitPicture (MEMFILE *mf, int format, const char *name)
+{
+	BlockO8BitPixels	*b8;
+
+	b8 = (BlockO8BitPixels *)calloc(sizeof (BlockO8BitPixels),1);
+	if (!b8)
+	{
+		SetGlobalErr (ERR_GENERIC);
+		GEcatf1 ("Out of memory reading '%s'", name);
+		return NULL;
+	}
+
+	switch (format)
+	{
+	case PICFMT_PSD:
+		#if 1
+		InfoMess (("8 Bit Photoshop File not yet supported\n"));
+		#else
+		InfoMess (("Loading Photoshop file %s\n", name));
+		if (!loadPhotoshop8Bit (b8, mf))
+		{
+			free(b8);
+			b8 = 0;
+		}
+		#endif
+		break;
+	case PICFMT_TGA:
+		#if 1
+		InfoMess (("8 Bit Targa File not yet supported\n"));
+		#else
+		InfoMess (("Loading Targa file %s\n", name));
+		if (!loadTGA8Bit (b8, mf))
+		{
+			free(b8);
+			b8 = 0;
+		}
+		#endif
+		break;
+	case PICFMT_PCX:
+		InfoMess (("Loading PCX file %s\n", name));
+		if (!loadPCX8Bit (b8, mf))
+		{
+			free(b8);
+			b8 = 0;
+		}
+		break;
+	default:
+		free (b8);
+		b8 = 0;
+		SetGlobalErr (ERR_GENERIC);
+		GEcatf1 ("Unsupported file type '%s'", name);
+		break;
+	}
+
+	if (b8)
+	{
+		InfoMess (("Width = %d, Height = %d\n", b8->width, b8->height));
+	}
+
+	return b8;
+}
+// load8BitPicture
+
+/*********************************************************************
  *
+ * Read8BitPicture
  *
- * EFFECTS
+ * SYNOPSIS
+ *		BlockO8BitPixels *Read8BitPicture (const char *filename)
  *
+ * PURPOSE
+ *		Load a paletted picture.  The format comes from the extension
+ *		or, if that's not one we know, the file's magic bytes.
  *
  * RETURN VALUE
- *
- *
- * HISTORY
- *
+ *		The picture or NULL on error.  Free it with Free8BitPicture.
  *
  * SEE ALSO
+ *		Read8BitPictureFromMemory
  *
 */
 BlockO8BitPixels *Read8BitPicture (const char* filename)
@@ -303,52 +1215,10 @@ BlockO8BitPixels *Read8BitPicture (const char* filename)
 	BlockO8BitPixels	*b8 = 0;
 	MEMFILE				*mf;
 
-	mf = MEMFILE_Load (filename);
+	mf = MEMFILE_Open (filename);
 	if (mf)
 	{
-		b8 = (BlockO8BitPixels *)calloc(sizeof (BlockO8BitPixels),1);
-	
-		if (!stricmp (".psd", EIO_Ext(filename)))
-		{
-			#if 1
-			InfoMess (("8 Bit Photoshop File not yet supported\n"));
-			#else
-			InfoMess (("Loading Photoshop file %s\n", filename));
-			if (!loadPhotoshop8Bit (b8, mf))
-			{
-				free(b8);
-				b8 = 0;
-			}
-			#endif
-		}
-		else if (!stricmp (".tga", EIO_Ext(filename)))
-		{
-			#if 1
-			InfoMess (("8 Bit Targa File not yet supported\n"));
-			#else
-			InfoMess (("Loading Targa file %s\n", filename));
-			if (!loadTGA8Bit (b8, mf))
-			{
-				free(b8);
-				b8 = 0;
-			}
-			#endif
-		}
-		else if (!stricmp (".pcx", EIO_Ext(filename)))
-		{
-			InfoMess (("Loading PCX file %s\n", filename));
-			if (!loadPCX8Bit (b8, mf))
-			{
-				free(b8);
-				b8 = 0;
-			}
-		}
-		else
-		{
-			b8 = 0;
-			SetGlobalErr (ERR_GENERIC);
-			GEcatf1 ("Unsupported file type '%s'", filename);
-		}
+		b8 = load8BitPicture (mf, pictureFormatOfFile (filename, mf->buffer, mf->size), filename);
 
 		MEMFILE_Close (mf);
 	}
@@ -358,14 +1228,38 @@ BlockO8BitPixels *Read8BitPicture (const char* filename)
 		GEcatf1 ("Trouble reading file '%s'", filename);
 	}
 
-	if (b8)
+	return b8;
+}
+// Read8BitPicture
+
+/*********************************************************************
+ *
+ * Read8BitPictureFromMemory
+ *
+ * SYNOPSIS
+ *		BlockO8BitPixels *Read8BitPictureFromMemory (const void *pData, long size, int formatHint)
+ *
+ * PURPOSE
+ *		Like Read8BitPicture but for a picture that's already in
+ *		memory.  See Read32BitPictureFromMemory.
+ *
+*/
+BlockO8BitPixels *Read8BitPictureFromMemory (const void *pData, long size, int formatHint)
+{
+	MEMFILE	mf;
+
+	if (!pData || size <= 0)
 	{
-		InfoMess (("Width = %d, Height = %d\n", b8->width, b8->height));
+		SetGlobalErr (ERR_GENERIC);
+		GEcatf ("No picture data");
+		return NULL;
 	}
 
-	return b8;
+	MEMFILE_Init (&mf, (void *)pData, size);
+
+	return load8BitPicture (&mf, formatHint != PICFMT_UNKNOWN ? formatHint : DetectPictureFormat (pData, size), MEMORY_PICTURE_NAME);
 }
-// Read8BitPicture
+// Read8BitPictureFromMemory
 
 void Free8BitPicture (BlockO8BitPixels *pBOP)
 {
@@ -409,7 +1303,7 @@ UINT8 *ReadRawPalette (const char* filename, int *pNumColors)
 	UINT8	*pu8 = NULL;
 	MEMFILE				*mf;
 
-	mf = MEMFILE_Load (filename);
+	mf = MEMFILE_Open (filename);
 	if (mf)
 	{
 		pu8 = (UINT8 *)calloc(4, 256);
@@ -613,71 +1507,99 @@ BEGINFUNC (Write8BitPicture)
 
 /*********************************************************************
  *
- * ReadGrey8BitPicture
+ * loadGrey8BitPicture
  *
  * SYNOPSIS
- *		BlockOGrey8BitPixels *ReadGrey8BitPicture (const char *filename)
+ *		static BlockOGrey8BitPixels *loadGrey8BitPicture (MEMFILE *mf, int format, const char *name)
  *
  * PURPOSE
- *		
+ *		Decode a greyscale picture of the given format from mf.  name
+ *		is only used in messages.
  *
- * INPUT
+*/
+static BlockOGrey8BitPixels *loadGrey8BitPicture (MEMFILE *mf, int format, const char *name)
+{
+	BlockOGrey8BitPixels	*b8;
+
+	b8 = (BlockOGrey8BitPixels *)calloc(sizeof (BlockOGrey8BitPixels),1);
+	if (!b8)
+	{
+		SetGlobalErr (ERR_GENERIC);
+		GEcatf1 ("Out of memory reading '%s'", name);
+		return NULL;
+	}
+
+	switch (format)
+	{
+	case PICFMT_PSD:
+		#if 1
+		InfoMess (("8 Bit Photoshop File not yet supported\n"));
+		#else
+		InfoMess (("Loading Photoshop file %s\n", name));
+		if (!loadPhotoshopGrey8Bit (b8, mf))
+		{
+			free(b8);
+			b8 = 0;
+		}
+		#endif
+		break;
+	case PICFMT_TGA:
+		#if 1
+		InfoMess (("8 Bit Targa File not yet supported\n"));
+		#else
+		InfoMess (("Loading Targa file %s\n", name));
+		if (!loadTGAGrey8Bit (b8, mf))
+		{
+			free(b8);
+			b8 = 0;
+		}
+		#endif
+		break;
+	default:
+		free (b8);
+		b8 = 0;
+		SetGlobalErr (ERR_GENERIC);
+		GEcatf1 ("Unsupported file type '%s'", name);
+		break;
+	}
+
+	if (b8)
+	{
+		InfoMess (("Width = %d, Height = %d\n", b8->width, b8->height));
+	}
+
+	return b8;
+}
+// loadGrey8BitPicture
+
+/*********************************************************************
  *
+ * ReadGrey8BitPicture
  *
- * EFFECTS
+ * SYNOPSIS
+ *		BlockOGrey8BitPixels *ReadGrey8BitPicture (const char *filename)
  *
+ * PURPOSE
+ *		Load a greyscale picture.  The format comes from the extension
+ *		or, if that's not one we know, the file's magic bytes.
  *
  * RETURN VALUE
- *
- *
- * HISTORY
- *
+ *		The picture or NULL on error.  Free it with
+ *		FreeGrey8BitPicture.
  *
  * SEE ALSO
+ *		ReadGrey8BitPictureFromMemory
  *
 */
 BlockOGrey8BitPixels *ReadGrey8BitPicture (const char* filename)
 {
 	BlockOGrey8BitPixels	*b8 = 0;
-	MEMFILE				*mf;
+	MEMFILE					*mf;
 
-	mf = MEMFILE_Load (filename);
+	mf = MEMFILE_Open (filename);
 	if (mf)
 	{
-		b8 = (BlockOGrey8BitPixels *)calloc(sizeof (BlockOGrey8BitPixels),1);
-	
-		if (!stricmp (".psd", EIO_Ext(filename)))
-		{
-			#if 1
-			InfoMess (("8 Bit Photoshop File not yet supported\n"));
-			#else
-			InfoMess (("Loading Photoshop file %s\n", filename));
-			if (!loadPhotoshopGrey8Bit (b8, mf))
-			{
-				free(b8);
-				b8 = 0;
-			}
-			#endif
-		}
-		else if (!stricmp (".tga", EIO_Ext(filename)))
-		{
-			#if 1
-			InfoMess (("8 Bit Targa File not yet supported\n"));
-			#else
-			InfoMess (("Loading Targa file %s\n", filename));
-			if (!loadTGAGrey8Bit (b8, mf))
-			{
-				free(b8);
-				b8 = 0;
-			}
-			#endif
-		}
-		else
-		{
-			b8 = 0;
-			SetGlobalErr (ERR_GENERIC);
-			GEcatf1 ("Unsupported file type '%s'", filename);
-		}
+		b8 = loadGrey8BitPicture (mf, pictureFormatOfFile (filename, mf->buffer, mf->size), filename);
 
 		MEMFILE_Close (mf);
 	}
@@ -687,14 +1609,38 @@ BlockOGrey8BitPixels *ReadGrey8BitPicture (const char* filename)
 		GEcatf1 ("Trouble reading file '%s'", filename);
 	}
 
-	if (b8)
+	return b8;
+}
+// ReadGrey8BitPicture
+
+/*********************************************************************
+ *
+ * ReadGrey8BitPictureFromMemory
+ *
+ * SYNOPSIS
+ *		BlockOGrey8BitPixels *ReadGrey8BitPictureFromMemory (const void *pData, long size, int formatHint)
+ *
+ * PURPOSE
+ *		Like ReadGrey8BitPicture but for a picture that's already in
+ *		memory.  See Read32BitPictureFromMemory.
+ *
+*/
+BlockOGrey8BitPixels *ReadGrey8BitPictureFromMemory (const void *pData, long size, int formatHint)
+{
+	MEMFILE	mf;
+
+	if (!pData || size <= 0)
 	{
-		InfoMess (("Width = %d, Height = %d\n", b8->width, b8->height));
+		SetGlobalErr (ERR_GENERIC);
+		GEcatf ("No picture data");
+		return NULL;
 	}
 
-	return b8;
+	MEMFILE_Init (&mf, (void *)pData, size);
+
+	return loadGrey8BitPicture (&mf, formatHint != PICFMT_UNKNOWN ? formatHint : DetectPictureFormat (pData, size), MEMORY_PICTURE_NAME);
 }
-// ReadGrey8BitPicture
+// ReadGrey8BitPictureFromMemory
 
 void FreeGrey8BitPicture (BlockOGrey8BitPixels *pBOP)
 {
@@ -739,13 +1685,37 @@ void FreeGrey8BitPicture (BlockOGrey8BitPixels *pBOP)
 
 int WriteGrey8BitPicture (const char *filename, BlockOGrey8BitPixels *pBOP)
 BEGINFUNC (WriteGrey8BitPicture)
+{
+	RETURN WriteGrey8BitPictureEx (filename, pBOP, 0);
+
+} ENDFUNC (WriteGrey8BitPicture)
+
+/*************************************************************************
+                            WriteGrey8BitPictureEx
+ *************************************************************************
+
+   SYNOPSIS
+		int WriteGrey8BitPictureEx (const char *filename, BlockOGrey8BitPixels *pBOP, int flags)
+
+   PURPOSE
+		WriteGrey8BitPicture with PICWRITE_??? options.  See
+		Write32BitPictureEx.
+
+   HISTORY
+		10/17/26 : Created.
+
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+int WriteGrey8BitPictureEx (const char *filename, BlockOGrey8BitPixels *pBOP, int flags)
+BEGINFUNC (WriteGrey8BitPictureEx)
 {
 	int	fh;
+	int	result;
 
 	if (!stricmp(".tga", EIO_Ext(filename)))
 	{
 		fh = CHK_WriteOpen (filename);
-		saveTGAGrey8Bit (fh, pBOP);
+		result = saveTGAGrey8BitEx (fh, pBOP, (flags & PICWRITE_RLE) != 0);
 		CHK_Close (fh);
 	}
 	else
@@ -755,9 +1725,9 @@ BEGINFUNC (WriteGrey8BitPicture)
 		return FALSE;
 	}
 
-	return TRUE;
+	return result;
 
-} ENDFUNC (WriteGrey8BitPicture)
+} ENDFUNC (WriteGrey8BitPictureEx)
 
 
 
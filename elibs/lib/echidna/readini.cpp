@@ -90,6 +90,26 @@
 using std::string;
 using std::map;
 
+#if _EL_OS_IRIX53__
+#include <stdlib.h>
+#include <limits.h>
+
+/*
+ * Unix has realpath instead.  It fails on files that don't exist, those
+ * are left as they are.
+ */
+static char *_fullpath (char *absPath, const char *relPath, size_t maxLength)
+{
+	char	resolved[PATH_MAX];
+	const char	*s = realpath (relPath, resolved) ? resolved : relPath;
+
+	strncpy (absPath, s, maxLength - 1);
+	absPath[maxLength - 1] = '\0';
+
+	return absPath;
+}
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -52,14 +52,25 @@
 #include "switches.h"
 #include "echidna/ensure.h"
 
+#include <string.h>
+
 #include "echidna/readgfx.h"
 #include "echidna/memfile.h"
 #include "echidna/checkglu.h"
 #include "echidna/eerrors.h"
+#include "echidna/ethread.h"
+#include "echidna/pixconv.h"
 #include "readpcx.h"
+#include "picpool.h"
 
 /**************************** C O N S T A N T S ***************************/
 
+// longest run one PCX byte pair can hold
+#define PCX_MAX_RUN				63
+
+// bytes of encoded rows SavePCX8Bit collects before writing
+#define PCX_WRITE_BUFFER		(64 * 1024)
+
 
 /******************************** T Y P E S *******************************/
 
@@ -84,14 +95,204 @@ typedef struct {
 	uint8	reserved[54];
 } PCXHeader;
 
+// one band-parallel decode in Read256ColorPCX
+typedef struct
+{
+	const uint8	**rowStart;		// where each row's RLE data starts
+	uint8		 *pixels;
+	long		  width;
+	long		  height;
+	long		  srcRowBytes;
+	long		  rowsPerJob;
+}
+PCXJob;
+
 /****************************** G L O B A L S *****************************/
 
 
 /******************************* M A C R O S ******************************/
 
+// images smaller than this aren't worth handing to other threads
+#define PCX_MIN_PARALLEL_PIXELS	(64 * 1024)
+// jobs per thread so a slow band doesn't hold everyone up
+#define PCX_JOBS_PER_THREAD		4
+
 
 /***************************** R O U T I N E S ****************************/
 
+/*********************************************************************
+ *
+ * skipPCXRow
+ *
+ * SYNOPSIS
+ *		static const uint8 *skipPCXRow (const uint8 *s, const uint8 *end, long srcRowBytes)
+ *
+ * PURPOSE
+ *		Step over the RLE data of one row without decoding it.
+ *
+ * RETURN VALUE
+ *		Where the next row starts or NULL if the data ends first.
+ *
+*/
+static const uint8 *skipPCXRow (const uint8 *s, const uint8 *end, long srcRowBytes)
+{
+	long	len = srcRowBytes;
+
+	while (len > 0)
+	{
+		if (s >= end)
+		{
+			return NULL;
+		}
+		if ((*s & 0xC0) == 0xC0)
+		{
+			if (s + 1 >= end)
+			{
+				return NULL;
+			}
+			len -= *s & 0x3F;
+			s   += 2;
+		}
+		else
+		{
+			len--;
+			s++;
+		}
+	}
+
+	return s;
+}
+// skipPCXRow
+
+/*********************************************************************
+ *
+ * decodePCXRow
+ *
+ * SYNOPSIS
+ *		static void decodePCXRow (uint8 *d, long width, const uint8 *s, long srcRowBytes)
+ *
+ * PURPOSE
+ *		Decode one row whose data skipPCXRow has already checked is all
+ *		there.  Only the first width of its srcRowBytes bytes are kept.
+ *		Runs are not supposed to cross rows, any that do are cut off.
+ *
+*/
+static void decodePCXRow (uint8 *d, long width, const uint8 *s, long srcRowBytes)
+{
+	long	x = 0;
+
+	while (x < srcRowBytes)
+	{
+		uint8	data = *s++;
+
+		if ((data & 0xC0) == 0xC0)
+		{
+			long	count = data & 0x3F;
+
+			data = *s++;
+			if (x < width)
+			{
+				memset (d + x, data, count < width - x ? count : width - x);
+			}
+			x += count;
+		}
+		else
+		{
+			if (x < width)
+			{
+				d[x] = data;
+			}
+			x++;
+		}
+	}
+}
+// decodePCXRow
+
+/*********************************************************************
+ *
+ * decodePCXJob
+ *
+ * SYNOPSIS
+ *		static void decodePCXJob (void *pUserData, int job)
+ *
+ * PURPOSE
+ *		ETHREAD job for Read256ColorPCX.  Decodes one band of rows.
+ *
+*/
+static void decodePCXJob (void *pUserData, int job)
+{
+	PCXJob	*pj = (PCXJob *)pUserData;
+	long	 y  = job * pj->rowsPerJob;
+	long	 yEnd;
+
+	yEnd = y + pj->rowsPerJob;
+	if (yEnd > pj->height)
+	{
+		yEnd = pj->height;
+	}
+
+	for (; y < yEnd; y++)
+	{
+		decodePCXRow (pj->pixels + y * pj->width, pj->width, pj->rowStart[y], pj->srcRowBytes);
+	}
+}
+// decodePCXJob
+
+/*********************************************************************
+ *
+ * encodePCXRow
+ *
+ * SYNOPSIS
+ *		static uint8 *encodePCXRow (uint8 *d, const uint8 *s, long width)
+ *
+ * PURPOSE
+ *		RLE one row of 8 bit pixels.  Runs are found with the pixconv
+ *		kernels so long runs and long stretches without any are
+ *		stepped over many bytes at a time.  Single bytes below 0xC0
+ *		go out as themselves, anything else as a run.  d needs room
+ *		for 2 * width bytes.
+ *
+ * RETURN VALUE
+ *		The end of the encoded row.
+ *
+*/
+static uint8 *encodePCXRow (uint8 *d, const uint8 *s, long width)
+{
+	while (width)
+	{
+		long	max = width < PCX_MAX_RUN ? width : PCX_MAX_RUN;
+		long	num = PixConv_RunLength8 (s, max);
+
+		if (num > 1)
+		{
+			d[0] = (uint8)(0xC0 | num);
+			d[1] = *s;
+			d += 2;
+			s += num;
+		}
+		else
+		{
+			const uint8	*sEnd;
+
+			// copy up to where the next run starts
+			num  = PixConv_FindRepeat8 (s, width);
+			sEnd = s + num;
+			while (s < sEnd)
+			{
+				if (*s >= 0xC0)
+				{
+					*d++ = 0xC1;
+				}
+				*d++ = *s++;
+			}
+		}
+		width -= num;
+	}
+
+	return d;
+}
+// encodePCXRow
+
 /*********************************************************************
  *
  * Read256ColorPCX
@@ -119,67 +320,65 @@ typedef struct {
 */
 int Read256ColorPCX (BlockO8BitPixels *bop, MEMFILE *mf, short bytesPerLine)
 {
-	long			 nRows = bop->height;
-	long			 unpRowBytes = bop->width;
-	long			 srcRowBytes = bytesPerLine;
-	long			 dstRowBytes;
+	PCXJob			 pj;
+	const uint8		*s;
+	const uint8		*end;
 	long			 iRow;
-	uint8			*buffer = 0;
-	uint8			*pixels = 0;
-	uint8			*pdest;
-	int				 result = FALSE;
+	int				 numJobs;
+	uint8			*pixels   = 0;
+	const uint8		**rowStart = 0;
+	int				 result   = FALSE;
 
-	dstRowBytes = bop->width;
+	pj.width       = bop->width;
+	pj.height      = bop->height;
+	pj.srcRowBytes = (unsigned short)bytesPerLine;
 
-	pixels = (uint8 *)malloc (bop->width * bop->height);
-	buffer = (uint8 *)malloc (srcRowBytes);
-	pdest  = pixels;
+	if (pj.srcRowBytes < pj.width)
+	{
+		SetGlobalErr (ERR_GENERIC);
+		GEcatf ("Read256ColorPCX:Bad bytes per line");
+		goto RIBcleanup;
+	}
+
+	pixels   = (uint8 *)malloc (bop->width * bop->height + 1);
+	rowStart = (const uint8 **)malloc ((bop->height + 1) * sizeof (const uint8 *));
 
-	if (!buffer || !pixels)
+	if (!rowStart || !pixels)
 	{
 		SetGlobalErr (ERR_OUT_OF_MEMORY);
 		GEcatf ("Out of memory reading pcx");
 		goto RIBcleanup;
 	}
 
-	for (iRow = 0; iRow < nRows; iRow++)
+	// Find where every row starts in one quick pass so the rows can
+	// then be decoded on any thread in any order.
+	s   = mf->curPtr;
+	end = mf->curPtr + mf->bytesLeft;
+	for (iRow = 0; iRow < pj.height; iRow++)
 	{
-		uint8	*dst;
-		uint8	 data;
-		long	 len = srcRowBytes;
-
-		dst = buffer;
-		while (len > 0)
+		rowStart[iRow] = s;
+		s = skipPCXRow (s, end, pj.srcRowBytes);
+		if (!s)
 		{
-			if ((data = MEMFILE_getc(mf)) == EOF)
-			{
-				SetGlobalErr (ERR_GENERIC);
-				GEcatf ("Read256ColorPCX:Error reading file");
-				goto RIBcleanup;
-			}
-			if ((data & 0xC0) == 0xC0)
-			{
-				uint8	count;
-
-				count = data & 0x3F;
-				if ((data = MEMFILE_getc(mf)) == EOF)
-				{
-					SetGlobalErr (ERR_GENERIC);
-					GEcatf ("Read256ColorPCX:Error reading file");
-					goto RIBcleanup;
-				}
-				memset (dst, data, count);
-				len -= count;
-				dst += count;
-			} else {
-				*dst++ = data;
-				len--;
-			}
+			SetGlobalErr (ERR_GENERIC);
+			GEcatf ("Read256ColorPCX:Error reading file");
+			goto RIBcleanup;
 		}
+	}
 
-		memcpy (pdest, buffer, unpRowBytes);
-		pdest += unpRowBytes;
+	pj.rowStart   = rowStart;
+	pj.pixels     = pixels;
+	pj.rowsPerJob = pj.height ? pj.height : 1;
+
+	if (pj.width * pj.height >= PCX_MIN_PARALLEL_PIXELS)
+	{
+		long	maxJobs = ETHREAD_PoolThreads (NULL) * PCX_JOBS_PER_THREAD;
+
+		pj.rowsPerJob = (pj.height + maxJobs - 1) / maxJobs;
 	}
+	numJobs = (int)((pj.height + pj.rowsPerJob - 1) / pj.rowsPerJob);
+
+	ETHREAD_ParallelFor (NULL, numJobs, decodePCXJob, &pj);
 
 	{
 		uint8	haspalette;
@@ -218,7 +417,7 @@ int Read256ColorPCX (BlockO8BitPixels *bop, MEMFILE *mf, short bytesPerLine)
 	result = TRUE;
 
 RIBcleanup:
-	if (buffer)				free (buffer);
+	if (rowStart)			free ((void *)rowStart);
 	if (!result && pixels)	free (pixels);
 
 	return result;
@@ -253,6 +452,8 @@ int loadPCX (BlockO8BitPixels *bop, MEMFILE *mf)
 {
 	PCXHeader	 phead;
 
+	bop->pixels = NULL;
+
 	if (MEMFILE_Read (mf, &phead, sizeof (phead)) != sizeof (phead))
 	{
 		SetGlobalErr (ERR_GENERIC);
@@ -301,6 +502,246 @@ cleanup:
 
 } /* ReadPCX */
 
+/*************************************************************************
+                               loadPCXInfo
+ *************************************************************************
+
+   SYNOPSIS
+		int loadPCXInfo (PictureInfo *pInfo, MEMFILE *mf)
+
+   PURPOSE
+		Fill out pInfo from the 128 byte PCX header without decoding
+		the image.
+
+   INPUT
+		pInfo :
+		mf    :
+
+   RETURNS
+		TRUE on success. FALSE if not a PCX we can read.
+
+   HISTORY
+		10/17/26 : Created.
+
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+int loadPCXInfo (PictureInfo *pInfo, MEMFILE *mf)
+{
+	PCXHeader	 phead;
+
+	if (MEMFILE_Read (mf, &phead, sizeof (phead)) != sizeof (phead))
+	{
+		SetGlobalErr (ERR_GENERIC);
+		GEcatf ("ReadPCX:Couldn't read header info");
+		return FALSE;
+	}
+
+	LilWord2Native (phead.XMin);
+	LilWord2Native (phead.YMin);
+	LilWord2Native (phead.XMax);
+	LilWord2Native (phead.YMax);
+
+	if (phead.Encoding != 1)
+	{
+		SetGlobalErr (ERR_GENERIC);
+		GEcatf1 ("ReadPCX:Can't read PCX files with type %d encoding (yet)", phead.Encoding);
+		return FALSE;
+	}
+
+	pInfo->format       = PICFMT_PCX;
+	pInfo->width        = phead.XMax - phead.XMin + 1;
+	pInfo->height       = phead.YMax - phead.YMin + 1;
+	pInfo->channels     = phead.NPlanes;
+	pInfo->bitsPerPixel = phead.BitsPerPixel * phead.NPlanes;
+	pInfo->hasAlpha     = FALSE;
+
+	return TRUE;
+
+} /* loadPCXInfo */
+
+/*************************************************************************
+                             streamPCX32Bit
+ *************************************************************************
+
+   SYNOPSIS
+		int streamPCX32Bit (MEMFILE *mf, long bandRows, PFNPICTUREROWS pfnRows, void *pUserData)
+
+   PURPOSE
+		Decode a 256 color PCX bandRows rows at a time, expanding each
+		band through the palette and handing it to pfnRows.  The
+		palette lives at the end of the file so it's read first.
+
+   INPUT
+		mf        :
+		bandRows  : rows per call to pfnRows
+		pfnRows   :
+		pUserData : passed to pfnRows
+
+   RETURNS
+		TRUE if the whole picture was decoded and pfnRows never
+		returned FALSE.
+
+   HISTORY
+		10/17/26 : Created.
+
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+int streamPCX32Bit (MEMFILE *mf, long bandRows, PFNPICTUREROWS pfnRows, void *pUserData)
+{
+	PCXHeader	 phead;
+	PictureInfo	 info;
+	uint8		 palette[768];
+	pixel32		 colorMap[256];
+	uint8		*line   = NULL;
+	pixel32		*band   = NULL;
+	const uint8	*s;
+	const uint8	*end;
+	int			 result = FALSE;
+	long		 width;
+	long		 height;
+	long		 srcRowBytes;
+	long		 y;
+
+	if (MEMFILE_Read (mf, &phead, sizeof (phead)) != sizeof (phead))
+	{
+		SetGlobalErr (ERR_GENERIC);
+		GEcatf ("ReadPCX:Couldn't read header info");
+		goto cleanup;
+	}
+
+	LilWord2Native (phead.XMin);
+	LilWord2Native (phead.YMin);
+	LilWord2Native (phead.XMax);
+	LilWord2Native (phead.YMax);
+	LilWord2Native (phead.BytesPerLine);
+
+	if (phead.Encoding != 1)
+	{
+		SetGlobalErr (ERR_GENERIC);
+		GEcatf1 ("ReadPCX:Can't read PCX files with type %d encoding (yet)", phead.Encoding);
+		goto cleanup;
+	}
+
+	if (phead.BitsPerPixel != 8 || phead.NPlanes != 1 || phead.Version < 5)
+	{
+		SetGlobalErr (ERR_GENERIC);
+		GEcatf ("ReadPCX:Can only 256 color PCX files (currently)");
+		goto cleanup;
+	}
+
+	width       = phead.XMax - phead.XMin + 1;
+	height      = phead.YMax - phead.YMin + 1;
+	srcRowBytes = phead.BytesPerLine;
+
+	if (srcRowBytes < width)
+	{
+		SetGlobalErr (ERR_GENERIC);
+		GEcatf ("ReadPCX:Bad bytes per line");
+		goto cleanup;
+	}
+
+	info.format       = PICFMT_PCX;
+	info.width        = width;
+	info.height       = height;
+	info.channels     = 1;
+	info.bitsPerPixel = 8;
+	info.hasAlpha     = FALSE;
+
+	{
+		uint8	haspalette;
+
+		if (mf->size < (long)sizeof (phead) + 769L)
+		{
+			SetGlobalErr (ERR_GENERIC);
+			GEcatf ("Read256ColorPCX:Error reading palette (2)");
+			goto cleanup;
+		}
+
+		MEMFILE_Seek (mf, -769L, SEEK_END);
+
+		if (MEMFILE_Read (mf, &haspalette, 1) != 1 || haspalette != 12)
+		{
+			SetGlobalErr (ERR_GENERIC);
+			GEcatf ("Read256ColorPCX:Error reading palette");
+			goto cleanup;
+		}
+
+		if (MEMFILE_Read (mf, palette, 768) != 768)
+		{
+			SetGlobalErr (ERR_GENERIC);
+			GEcatf ("Read256ColorPCX:Error reading palette (3)");
+			goto cleanup;
+		}
+
+		MEMFILE_Seek (mf, sizeof (phead), SEEK_SET);
+	}
+
+	for (y = 0; y < 256; y++)
+	{
+		colorMap[y].red   = palette[y * 3 + 0];
+		colorMap[y].green = palette[y * 3 + 1];
+		colorMap[y].blue  = palette[y * 3 + 2];
+		colorMap[y].alpha = 255;
+	}
+
+	if (!width || !height)
+	{
+		result = TRUE;
+		goto cleanup;
+	}
+
+	if (bandRows > height)
+	{
+		bandRows = height;
+	}
+
+	line = (uint8 *)malloc (width);
+	band = (pixel32 *)malloc (width * bandRows * sizeof (pixel32));
+	if (!line || !band)
+	{
+		SetGlobalErr (ERR_OUT_OF_MEMORY);
+		GEcatf ("Out of memory reading pcx");
+		goto cleanup;
+	}
+
+	s   = mf->curPtr;
+	end = mf->curPtr + mf->bytesLeft;
+	for (y = 0; y < height; y += bandRows)
+	{
+		long	numRows = (height - y) < bandRows ? (height - y) : bandRows;
+		long	row;
+
+		for (row = 0; row < numRows; row++)
+		{
+			const uint8	*next = skipPCXRow (s, end, srcRowBytes);
+
+			if (!next)
+			{
+				SetGlobalErr (ERR_GENERIC);
+				GEcatf ("Read256ColorPCX:Error reading file");
+				goto cleanup;
+			}
+			decodePCXRow (line, width, s, srcRowBytes);
+			PixConv_Index8 (band + row * width, line, width, colorMap);
+			s = next;
+		}
+
+		if (!pfnRows (pUserData, &info, band, y, numRows))
+		{
+			goto cleanup;
+		}
+	}
+
+	result = TRUE;
+
+cleanup:
+	if (line)	free (line);
+	if (band)	free (band);
+
+	return result;
+
+} /* streamPCX32Bit */
+
 /*************************************************************************
                                  loadPCX
  *************************************************************************
@@ -343,36 +784,26 @@ BEGINFUNC (loadPCX32Bit)
 		bop->width    = bop8.width;
 		bop->height   = bop8.height;
 
-		bop->rgba = (pixel32 *)malloc (bop->width * bop->height * 4);
-		if (!bop->rgba)
+		if (!AllocPicturePixels (bop, bop->width * bop->height))
 		{
+			free (bop8.pixels);
 			SetGlobalErr (ERR_OUT_OF_MEMORY);
 			GEcatf ("Out of memory reading pcx");
 			RETURN FALSE;
 		}
 	
 		{
-			pixel32	*d;
-			uint8	*s;
-			long	 size;
-	
-			s = bop8.pixels;
-			d = bop->rgba;
-			size = bop->width * bop->height;
-	
-			while (size)
+			pixel32	colorMap[256];
+			int		i;
+
+			for (i = 0; i < 256; i++)
 			{
-				int		 p;
-	
-				p        = *s++;
-				d->red   = bop8.palette[p].red;
-				d->green = bop8.palette[p].green;
-				d->blue  = bop8.palette[p].blue;
-				d->alpha = 255;
-
-				d++;
-				size--;
+				colorMap[i].red   = bop8.palette[i].red;
+				colorMap[i].green = bop8.palette[i].green;
+				colorMap[i].blue  = bop8.palette[i].blue;
+				colorMap[i].alpha = 255;
 			}
+			PixConv_Index8 (bop->rgba, bop8.pixels, bop->width * bop->height, colorMap);
 		}
 
 		free (bop8.pixels);
@@ -481,11 +912,11 @@ BEGINFUNC (SavePCX8Bit)
 		LilWord(0),			// short	VScreenSize; 
 	};
 	
-	long	 x;
 	long	 y;
 	long	 bytesPerLine;
+	long	 bufSize;
 	uint8	*linebuf;
-	uint8	 value;
+	uint8	*dst;
 	uint8	*picture = bop->pixels;
 
 	bytesPerLine = ((bop->width + 1) & 0x7FFFFFFE);
@@ -494,7 +925,10 @@ BEGINFUNC (SavePCX8Bit)
 	pcx.YMax = (short)(bop->height - 1);
 	pcx.BytesPerLine = (short)bytesPerLine;
 
-	linebuf = CHK_CallocateMemory (bytesPerLine * 3, "linebuf");
+	// rows are collected and written a buffer at a time, there's
+	// always room for at least one more worst case row
+	bufSize = PCX_WRITE_BUFFER + bytesPerLine * 2 + 2;
+	linebuf = CHK_CallocateMemory (bufSize, "linebuf");
 
 	MakeLilWord (pcx.XMax);
 	MakeLilWord (pcx.YMax);
@@ -504,37 +938,27 @@ BEGINFUNC (SavePCX8Bit)
 
 	CHK_Write (fh, &pcx, sizeof (pcx));
 
+	dst = linebuf;
 	for (y = 0; y < bop->height; y++)
 	{
-		uint8	*dst;
-		long	 cnt;
-
-		cnt = 0;
-		dst = linebuf;
-
-		for (x = 0; x < bop->width; x++)
-		{
-			if (*picture >= 0xC0)
-			{
-				*dst++ = 0xC1;
-				cnt++;
-			}
-			*dst++ = *picture++;
-			cnt++;
-		}
+		dst      = encodePCXRow (dst, picture, bop->width);
+		picture += bop->width;
 
 		if (bop->width & 0x01)
 		{
 			*dst++ = 0xC1;
 			*dst++ = 0xFF;
-			cnt += 2;
 		}
 
-		CHK_Write (fh, linebuf, cnt);
+		if (dst - linebuf >= PCX_WRITE_BUFFER)
+		{
+			CHK_Write (fh, linebuf, dst - linebuf);
+			dst = linebuf;
+		}
 	}
 
-	value = 0x0C;
-	CHK_Write (fh, &value, 1);
+	*dst++ = 0x0C;
+	CHK_Write (fh, linebuf, dst - linebuf);
 	CHK_Write (fh, bop->palette, 768);
 
 	CHK_DeallocateMemory (linebuf, "linebuf");
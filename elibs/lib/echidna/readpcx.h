@@ -79,6 +79,8 @@ extern "C" {
 
 extern int loadPCX32Bit (BlockO32BitPixels *bop, MEMFILE *mf);
 extern int loadPCX8Bit (BlockO8BitPixels *bop, MEMFILE *mf);
+extern int loadPCXInfo (PictureInfo *pInfo, MEMFILE *mf);
+extern int streamPCX32Bit (MEMFILE *mf, long bandRows, PFNPICTUREROWS pfnRows, void *pUserData);
 extern int SavePCX8Bit (int fh, BlockO8BitPixels *bop);
 
 #ifdef __cplusplus
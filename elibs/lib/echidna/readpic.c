@@ -53,15 +53,21 @@
 #include "switches.h"
 #include "echidna/ensure.h"
 
+#include <stddef.h>
+#include <string.h>
+
 #include "echidna/readgfx.h"
 #include "echidna/memfile.h"
 #include "echidna/checkglu.h"
 #include "echidna/eerrors.h"
+#include "echidna/pixconv.h"
 #include "readpic.h"
+#include "picpool.h"
 
 /**************************** C O N S T A N T S ***************************/
 
 #define PIC_UNCOMPRESSED     0x00
+#define PIC_PURE_RUN_LENGTH  0x01
 #define PIC_MIXED_RUN_LENGTH 0x02
 
 #define PIC_CHANNEL_RED_BIT   0x80
@@ -93,26 +99,51 @@ typedef struct PICChannel
 }
 PICChannel;
 
-int loadPIC32Bit(BlockO32BitPixels* blockPtr, MEMFILE* mf)
+// a channel packet ready to decode
+typedef struct PICPacket
+{
+  int   type;
+  int   numChannels;    // bytes per pixel in the packet
+  int   offset[4];      // where each of those goes in a pixel32
+  int   mask;           // PIC_CHANNEL_???_BIT of them
+  int   fWhole;         // store whole pixels, missing channels are 255
+}
+PICPacket;
+
+/*********************************************************************
+ *
+ * readPICHeader
+ *
+ * SYNOPSIS
+ *      static int readPICHeader (PICHeader *phead, PICChannel *channel, int *pNumPackets, MEMFILE *mf)
+ *
+ * PURPOSE
+ *      Read the PIC header and the chain of channel packets that
+ *      describe each scanline.  channel must have room for 4 packets.
+ *      Leaves mf pointing at the first scanline.
+ *
+ * RETURN VALUE
+ *      TRUE on success.  *pNumPackets is set to the number of packets
+ *      per scanline.
+ *
+*/
+static int readPICHeader (PICHeader *phead, PICChannel *channel, int *pNumPackets, MEMFILE *mf)
 {
-    PICHeader   phead;
-    PICChannel  channel[4];
     int         i;
-	int			alphaChannel = 0;
 
-    if (MEMFILE_Read(mf, &phead, sizeof( phead )) != sizeof (phead))
+    if (MEMFILE_Read(mf, phead, sizeof( *phead )) != sizeof (*phead))
     {
 		SetGlobalErr (ERR_GENERIC);
 		GEcatf ("Invalid PIC file");
-		goto cleanup;
+		return FALSE;
     }
 
-    phead.magic   = MSBFToNative32Bit (phead.magic);
-    phead.version = MSBFToNative32Bit (phead.version);
-    phead.width   = MSBFToNative16Bit (phead.width);
-    phead.height  = MSBFToNative16Bit (phead.height);
-    phead.ratio   = MSBFToNative32Bit (phead.ratio);
-    phead.fields  = MSBFToNative16Bit (phead.fields);
+    phead->magic   = MSBFToNative32Bit (phead->magic);
+    phead->version = MSBFToNative32Bit (phead->version);
+    phead->width   = MSBFToNative16Bit (phead->width);
+    phead->height  = MSBFToNative16Bit (phead->height);
+    phead->ratio   = MSBFToNative32Bit (phead->ratio);
+    phead->fields  = MSBFToNative16Bit (phead->fields);
 
     for(i = 0; i < 4; i++)
     {
@@ -120,7 +151,7 @@ int loadPIC32Bit(BlockO32BitPixels* blockPtr, MEMFILE* mf)
         {
 			SetGlobalErr (ERR_GENERIC);
     		GEcatf ("Invalid PIC file (2)");
-    		goto cleanup;
+    		return FALSE;
         }
 
         #if 0
@@ -132,11 +163,6 @@ int loadPIC32Bit(BlockO32BitPixels* blockPtr, MEMFILE* mf)
     		EL_printf("\n");
         #endif
 
-        if (channel[i].channel & PIC_CHANNEL_ALPHA_BIT)
-		{
-			blockPtr->channels = 1;
-        }
-		
         if (!channel[i].chained)
         {
             break;
@@ -147,173 +173,357 @@ int loadPIC32Bit(BlockO32BitPixels* blockPtr, MEMFILE* mf)
     {
 		SetGlobalErr (ERR_GENERIC);
         GEcatf ("Too Many Channels");
-        goto cleanup;
+        return FALSE;
     }
 
+    if((phead->width <= 0 ) || (phead->height <= 0 ))
     {
-        long bufferWidth  = phead.width;
-        long bufferHeight = phead.height;
-        long bufferSize;
-		int  c;
-		int  y;
-        pixel32* pEOB;
+		SetGlobalErr (ERR_GENERIC);
+  		GEcatf ("Invalid PIC file (3), bad size");
+        return FALSE;
+    }
+
+    *pNumPackets = i + 1;
+
+    return TRUE;
+}
+// readPICHeader
 
-        if((bufferWidth <= 0 ) || (bufferHeight <= 0 ))
+/*********************************************************************
+ *
+ * setupPICPackets
+ *
+ * SYNOPSIS
+ *      static int setupPICPackets (PICPacket *packets, const PICChannel *channel, int numPackets)
+ *
+ * PURPOSE
+ *      Work out once where each packet's bytes go in a pixel32.  The
+ *      first packet of a scanline stores whole pixels, setting the
+ *      channels it doesn't have to 255, so the image needs no clearing
+ *      and runs can be filled a word at a time.
+ *
+ * RETURN VALUE
+ *      FALSE if a packet is one we can't read.
+ *
+*/
+static int setupPICPackets (PICPacket *packets, const PICChannel *channel, int numPackets)
+{
+    static const struct
+    {
+        int bit;
+        int offset;
+    }
+    order[4] =
+    {
+        { PIC_CHANNEL_RED_BIT,   offsetof (pixel32, red),   },
+        { PIC_CHANNEL_GREEN_BIT, offsetof (pixel32, green), },
+        { PIC_CHANNEL_BLUE_BIT,  offsetof (pixel32, blue),  },
+        { PIC_CHANNEL_ALPHA_BIT, offsetof (pixel32, alpha), },
+    };
+    int c;
+
+    for (c = 0; c < numPackets; c++)
+    {
+        PICPacket*  pk = &packets[c];
+        int         i;
+
+        pk->type        = channel[c].type;
+        pk->mask        = channel[c].channel & 0xF0;
+        pk->numChannels = 0;
+        pk->fWhole      = c == 0;
+
+        if (!pk->mask)
         {
-			SetGlobalErr (ERR_GENERIC);
-      		GEcatf ("Invalid PIC file (3), bad size");
-            goto cleanup;
+            SetGlobalErr (ERR_GENERIC);
+            GEcatf("bad channel flags\n");
+            return FALSE;
+        }
+        if (pk->type != PIC_UNCOMPRESSED && pk->type != PIC_PURE_RUN_LENGTH && pk->type != PIC_MIXED_RUN_LENGTH)
+        {
+            SetGlobalErr (ERR_GENERIC);
+            GEcatf ("error reading file (3)");
+            return FALSE;
         }
 
-      	bufferSize = bufferWidth * bufferHeight * sizeof (pixel32);
+        for (i = 0; i < 4; i++)
+        {
+            if (pk->mask & order[i].bit)
+            {
+                pk->offset[pk->numChannels++] = order[i].offset;
+            }
+        }
+    }
 
-        blockPtr->rgba   = (pixel32 *) malloc (bufferSize);
-        blockPtr->width  = bufferWidth;
-        blockPtr->height = bufferHeight;
-		
-        if (!blockPtr->rgba)
+    return TRUE;
+}
+// setupPICPackets
+
+/*********************************************************************
+ *
+ * storePICPixels
+ *
+ * SYNOPSIS
+ *      static void storePICPixels (pixel32 *d, const uint8 *s, long count, const PICPacket *pk)
+ *
+ * PURPOSE
+ *      Store count pixels of literal packet data.
+ *
+*/
+static void storePICPixels (pixel32 *d, const uint8 *s, long count, const PICPacket *pk)
+{
+    if (pk->fWhole && pk->mask == (PIC_CHANNEL_RED_BIT | PIC_CHANNEL_GREEN_BIT | PIC_CHANNEL_BLUE_BIT))
+    {
+        for (; count > 0; count--, d++, s += 3)
         {
-            SetGlobalErr (ERR_GENERIC);
-            GEcatf ("Out of Memory loading tga");
-            goto cleanup;
+            d->red   = s[0];
+            d->green = s[1];
+            d->blue  = s[2];
+            d->alpha = 255;
         }
-		
-		memset (blockPtr->rgba, 255, bufferSize);
+    }
+    else if (pk->fWhole && pk->mask == (PIC_CHANNEL_RED_BIT | PIC_CHANNEL_GREEN_BIT | PIC_CHANNEL_BLUE_BIT | PIC_CHANNEL_ALPHA_BIT))
+    {
+        for (; count > 0; count--, d++, s += 4)
+        {
+            d->red   = s[0];
+            d->green = s[1];
+            d->blue  = s[2];
+            d->alpha = s[3];
+        }
+    }
+    else if (pk->numChannels == 1 && !pk->fWhole)
+    {
+        uint8*  p = (uint8 *)d + pk->offset[0];
 
-        pEOB = blockPtr->rgba + bufferWidth * bufferHeight;
+        for (; count > 0; count--, p += sizeof (pixel32))
+        {
+            *p = *s++;
+        }
+    }
+    else
+    {
+        static const pixel32 white = { 255, 255, 255, 255, };
+        int     n = pk->numChannels;
 
-        for(y = 0; y < bufferHeight; y++)
+        for (; count > 0; count--, d++, s += n)
+        {
+            int i;
+
+            if (pk->fWhole)
+            {
+                *d = white;
+            }
+            for (i = 0; i < n; i++)
+            {
+                ((uint8 *)d)[pk->offset[i]] = s[i];
+            }
+        }
+    }
+}
+// storePICPixels
+
+/*********************************************************************
+ *
+ * fillPICPixels
+ *
+ * SYNOPSIS
+ *      static void fillPICPixels (pixel32 *d, const uint8 *s, long count, const PICPacket *pk)
+ *
+ * PURPOSE
+ *      Store a run of count pixels all the same as the one packet
+ *      pixel at s.
+ *
+*/
+static void fillPICPixels (pixel32 *d, const uint8 *s, long count, const PICPacket *pk)
+{
+    int     n = pk->numChannels;
+    int     i;
+
+    if (pk->fWhole)
+    {
+        pixel32 p = { 255, 255, 255, 255, };
+
+        for (i = 0; i < n; i++)
+        {
+            ((uint8 *)&p)[pk->offset[i]] = s[i];
+        }
+        PixConv_Fill32 (d, p, count);
+    }
+    else
+    {
+        for (i = 0; i < n; i++)
         {
-            for(c = 0; c < i + 1; c++)
+            uint8*  p = (uint8 *)d + pk->offset[i];
+            uint8   v = s[i];
+            long    x;
+
+            for (x = 0; x < count; x++, p += sizeof (pixel32))
             {
-                pixel32*  pPixel;
-                uint8     channels = channel[c].channel;
+                *p = v;
+            }
+        }
+    }
+}
+// fillPICPixels
+
+/*********************************************************************
+ *
+ * decodePICRow
+ *
+ * SYNOPSIS
+ *      static const uint8 *decodePICRow (pixel32 *pRow, pixel32 *pEOB, long width, const PICPacket *packets, int numPackets, const uint8 *s, const uint8 *end)
+ *
+ * PURPOSE
+ *      Decode one scanline, all of its channel packets, from s into
+ *      pRow.  Runs are expanded a whole packet at a time, not a byte
+ *      at a time.  A run may not claim to go past pEOB but the part
+ *      past the end of the scanline isn't stored, the next scanline
+ *      writes all of its own pixels anyway.
+ *
+ * RETURN VALUE
+ *      Where the next scanline starts or NULL if the data is bad.
+ *
+*/
+static const uint8 *decodePICRow (pixel32 *pRow, pixel32 *pEOB, long width, const PICPacket *packets, int numPackets, const uint8 *s, const uint8 *end)
+{
+    int c;
 
-        	    pPixel = blockPtr->rgba + y * bufferWidth;
+    for(c = 0; c < numPackets; c++)
+    {
+        const PICPacket*    pk = &packets[c];
+        long                n  = pk->numChannels;
+        long                x  = 0;
 
-                if (channels == 0)
+        switch(pk->type)
+        {
+        case PIC_UNCOMPRESSED:
+            if (end - s < width * n)
+            {
+                SetGlobalErr (ERR_GENERIC);
+                GEcatf ("error reading file (4)");
+                return NULL;
+            }
+            storePICPixels (pRow, s, width, pk);
+            s += width * n;
+            break;
+        case PIC_PURE_RUN_LENGTH:
+        case PIC_MIXED_RUN_LENGTH:
+            while (x < width)
+            {
+                long    count;
+                int     fRun = TRUE;
+
+                if (s >= end)
                 {
-					SetGlobalErr (ERR_GENERIC);
-                    GEcatf("bad channel flags\n");
-                    goto cleanup;
+                    SetGlobalErr (ERR_GENERIC);
+                    GEcatf ("error reading file (4)");
+                    return NULL;
                 }
+                count = *s++;
 
-                switch(channel[c].type)
+                // pure runs are all count then pixel
+                if (pk->type == PIC_MIXED_RUN_LENGTH)
                 {
-                case PIC_UNCOMPRESSED:
+                    if (count > 128)
                     {
-                        long x;
-
-                        for(x = 0; x < bufferWidth; x++)
-                        {
-                            if (channels & PIC_CHANNEL_RED_BIT)   { pPixel->red   = MEMFILE_getc(mf); }
-                            if (channels & PIC_CHANNEL_GREEN_BIT) { pPixel->green = MEMFILE_getc(mf); }
-                            if (channels & PIC_CHANNEL_BLUE_BIT)  { pPixel->blue  = MEMFILE_getc(mf); }
-                            if (channels & PIC_CHANNEL_ALPHA_BIT) { pPixel->alpha = MEMFILE_getc(mf); }
-                            pPixel++;
-                        }
+                        count -= 127;
                     }
-                    break;
-                case PIC_MIXED_RUN_LENGTH:
+                    else if (count == 128)
                     {
-                        long x = 0;
-
-                        while (x < bufferWidth)
+                        if (end - s < 2)
                         {
-                            long count = MEMFILE_getc(mf);
-
-                            if(count > 128)
-                            {
-                                uint8 r,g,b,a;
-
-                                if (channels & PIC_CHANNEL_RED_BIT)   { r = MEMFILE_getc(mf); }
-                                if (channels & PIC_CHANNEL_GREEN_BIT) { g = MEMFILE_getc(mf); }
-                                if (channels & PIC_CHANNEL_BLUE_BIT)  { b = MEMFILE_getc(mf); }
-                                if (channels & PIC_CHANNEL_ALPHA_BIT) { a = MEMFILE_getc(mf); }
-
-                                count -= 127;
-
-                                if (pPixel + count > pEOB)
-                                {
-									SetGlobalErr (ERR_GENERIC);
-                                    GEcatf ("error reading file");
-                                    goto cleanup;
-                                }
-
-                                while (count > 0)
-                                {
-                                    if (channels & PIC_CHANNEL_RED_BIT)   { pPixel->red   = r; }
-                                    if (channels & PIC_CHANNEL_GREEN_BIT) { pPixel->green = g; }
-                                    if (channels & PIC_CHANNEL_BLUE_BIT)  { pPixel->blue  = b; }
-                                    if (channels & PIC_CHANNEL_ALPHA_BIT) { pPixel->alpha = a; }
-
-                                    pPixel++;
-                                    x++;
-                                    count--;
-                                }
-                            }
-                            else if (count == 128)
-                            {
-                                uint8 r,g,b,a;
-
-                                count  = MEMFILE_getc(mf) * 256;
-                                count += MEMFILE_getc(mf);
-
-                                if (channels & PIC_CHANNEL_RED_BIT)   { r = MEMFILE_getc(mf); }
-                                if (channels & PIC_CHANNEL_GREEN_BIT) { g = MEMFILE_getc(mf); }
-                                if (channels & PIC_CHANNEL_BLUE_BIT)  { b = MEMFILE_getc(mf); }
-                                if (channels & PIC_CHANNEL_ALPHA_BIT) { a = MEMFILE_getc(mf); }
-
-                                if (pPixel + count > pEOB)
-                                {
-									SetGlobalErr (ERR_GENERIC);
-                                    GEcatf ("error reading file (2)");
-                                    goto cleanup;
-                                }
-
-                                while (count > 0)
-                                {
-                                    if (channels & PIC_CHANNEL_RED_BIT)   { pPixel->red   = r; }
-                                    if (channels & PIC_CHANNEL_GREEN_BIT) { pPixel->green = g; }
-                                    if (channels & PIC_CHANNEL_BLUE_BIT)  { pPixel->blue  = b; }
-                                    if (channels & PIC_CHANNEL_ALPHA_BIT) { pPixel->alpha = a; }
-
-                                    pPixel++;
-                                    x++;
-                                    count--;
-                                }
-                            }
-                            else /* if (count < 128) */
-                            {
-                                count++;
-
-                                if (pPixel + count > pEOB)
-                                {
-									SetGlobalErr (ERR_GENERIC);
-                                    GEcatf ("error reading file (3)");
-                                    goto cleanup;
-                                }
-
-                                while (count > 0)
-                                {
-                                    if (channels & PIC_CHANNEL_RED_BIT)   { pPixel->red   = MEMFILE_getc(mf); }
-                                    if (channels & PIC_CHANNEL_GREEN_BIT) { pPixel->green = MEMFILE_getc(mf); }
-                                    if (channels & PIC_CHANNEL_BLUE_BIT)  { pPixel->blue  = MEMFILE_getc(mf); }
-                                    if (channels & PIC_CHANNEL_ALPHA_BIT) { pPixel->alpha = MEMFILE_getc(mf); }
-
-                                    pPixel++;
-                                    x++;
-                                    count--;
-                                }
-                            }
+                            SetGlobalErr (ERR_GENERIC);
+                            GEcatf ("error reading file (2)");
+                            return NULL;
                         }
+                        count = s[0] * 256 + s[1];
+                        s += 2;
                     }
-                    break;
-                default:
-					SetGlobalErr (ERR_GENERIC);
-                    GEcatf ("error reading file (3)");
-                    goto cleanup;
+                    else
+                    {
+                        count++;
+                        fRun = FALSE;
+                    }
+                }
+
+                if (pRow + x + count > pEOB || end - s < (fRun ? n : count * n))
+                {
+                    SetGlobalErr (ERR_GENERIC);
+                    GEcatf ("error reading file");
+                    return NULL;
                 }
+
+                if (fRun)
+                {
+                    fillPICPixels (pRow + x, s, count < width - x ? count : width - x, pk);
+                    s += n;
+                }
+                else
+                {
+                    storePICPixels (pRow + x, s, count < width - x ? count : width - x, pk);
+                    s += count * n;
+                }
+                x += count;
+            }
+            break;
+        }
+    }
+
+    return s;
+}
+// decodePICRow
+
+int loadPIC32Bit(BlockO32BitPixels* blockPtr, MEMFILE* mf)
+{
+    PICHeader   phead;
+    PICChannel  channel[4];
+    PICPacket   packets[4];
+    int         numPackets;
+    int         i;
+
+    if (!readPICHeader (&phead, channel, &numPackets, mf)
+        || !setupPICPackets (packets, channel, numPackets))
+    {
+        goto cleanup;
+    }
+
+    for (i = 0; i < numPackets; i++)
+    {
+        if (channel[i].channel & PIC_CHANNEL_ALPHA_BIT)
+		{
+			blockPtr->channels = 1;
+        }
+    }
+
+    {
+        long bufferWidth  = phead.width;
+        long bufferHeight = phead.height;
+		int  y;
+        pixel32* pEOB;
+        const uint8* s   = mf->curPtr;
+        const uint8* end = mf->curPtr + mf->bytesLeft;
+
+        AllocPicturePixels (blockPtr, bufferWidth * bufferHeight);
+        blockPtr->width  = bufferWidth;
+        blockPtr->height = bufferHeight;
+		
+        if (!blockPtr->rgba)
+        {
+            SetGlobalErr (ERR_GENERIC);
+            GEcatf ("Out of Memory loading pic");
+            goto cleanup;
+        }
+		
+        pEOB = blockPtr->rgba + bufferWidth * bufferHeight;
+
+        // each scanline's first packet writes every pixel in full so
+        // the buffer doesn't need clearing
+        for(y = 0; y < bufferHeight; y++)
+        {
+            s = decodePICRow (blockPtr->rgba + y * bufferWidth, pEOB, bufferWidth, packets, numPackets, s, end);
+            if (!s)
+            {
+                goto cleanup;
             }
         }
     }
@@ -321,11 +531,200 @@ int loadPIC32Bit(BlockO32BitPixels* blockPtr, MEMFILE* mf)
     return TRUE;
 
 cleanup:
-    if (blockPtr->rgba)
+    FreePicturePixels (blockPtr);
+
+    return FALSE;
+}
+
+/*********************************************************************
+ *
+ * loadPICInfo
+ *
+ * SYNOPSIS
+ *      int loadPICInfo (PictureInfo *pInfo, MEMFILE *mf)
+ *
+ * PURPOSE
+ *      Fill out pInfo from the PIC header and channel packet list
+ *      without decoding any scanlines.
+ *
+ * RETURN VALUE
+ *      TRUE on success, FALSE if the header is bad.
+ *
+*/
+int loadPICInfo (PictureInfo *pInfo, MEMFILE *mf)
+{
+    PICHeader   phead;
+    PICChannel  channel;
+    int         i;
+    int         channels = 0;
+    int         hasAlpha = FALSE;
+
+    if (MEMFILE_Read(mf, &phead, sizeof( phead )) != sizeof (phead))
     {
-        free (blockPtr->rgba);
+        SetGlobalErr (ERR_GENERIC);
+        GEcatf ("Invalid PIC file");
+        return FALSE;
     }
 
-    return FALSE;
+    phead.width   = MSBFToNative16Bit (phead.width);
+    phead.height  = MSBFToNative16Bit (phead.height);
+
+    for (i = 0; i < 4; i++)
+    {
+        uint8   bits;
+
+        if (MEMFILE_Read(mf, &channel, sizeof(PICChannel)) != sizeof (PICChannel))
+        {
+            SetGlobalErr (ERR_GENERIC);
+            GEcatf ("Invalid PIC file (2)");
+            return FALSE;
+        }
+
+        for (bits = (uint8)channel.channel; bits; bits &= bits - 1)
+        {
+            channels++;
+        }
+        if (channel.channel & PIC_CHANNEL_ALPHA_BIT)
+        {
+            hasAlpha = TRUE;
+        }
+        if (!channel.chained)
+        {
+            break;
+        }
+    }
+
+    if (i == 4)
+    {
+        SetGlobalErr (ERR_GENERIC);
+        GEcatf ("Too Many Channels");
+        return FALSE;
+    }
+
+    if (phead.width <= 0 || phead.height <= 0)
+    {
+        SetGlobalErr (ERR_GENERIC);
+        GEcatf ("Invalid PIC file (3), bad size");
+        return FALSE;
+    }
+
+    pInfo->format       = PICFMT_PIC;
+    pInfo->width        = phead.width;
+    pInfo->height       = phead.height;
+    pInfo->channels     = channels;
+    pInfo->bitsPerPixel = channels * 8;
+    pInfo->hasAlpha     = hasAlpha;
+
+    return TRUE;
 }
+// loadPICInfo
+
+
+/*********************************************************************
+ *
+ * streamPIC32Bit
+ *
+ * SYNOPSIS
+ *      int streamPIC32Bit (MEMFILE *mf, long bandRows, PFNPICTUREROWS pfnRows, void *pUserData)
+ *
+ * PURPOSE
+ *      Decode a PIC file bandRows scanlines at a time handing each
+ *      band to pfnRows.  PIC files are stored top down so this is one
+ *      pass through the file with a single band buffer.
+ *
+ * RETURN VALUE
+ *      TRUE if the whole picture was decoded and pfnRows never
+ *      returned FALSE.
+ *
+*/
+int streamPIC32Bit (MEMFILE *mf, long bandRows, PFNPICTUREROWS pfnRows, void *pUserData)
+{
+    PICHeader   phead;
+    PICChannel  channel[4];
+    PICPacket   packets[4];
+    PictureInfo info;
+    pixel32*    band   = NULL;
+    const uint8* s;
+    const uint8* end;
+    int         result = FALSE;
+    int         numPackets;
+    int         i;
+    long        width;
+    long        height;
+    long        y;
+
+    if (!readPICHeader (&phead, channel, &numPackets, mf)
+        || !setupPICPackets (packets, channel, numPackets))
+    {
+        goto cleanup;
+    }
 
+    width  = phead.width;
+    height = phead.height;
+
+    info.format   = PICFMT_PIC;
+    info.width    = width;
+    info.height   = height;
+    info.channels = 0;
+    info.hasAlpha = FALSE;
+    for (i = 0; i < numPackets; i++)
+    {
+        uint8   bits;
+
+        for (bits = (uint8)channel[i].channel; bits; bits &= bits - 1)
+        {
+            info.channels++;
+        }
+        if (channel[i].channel & PIC_CHANNEL_ALPHA_BIT)
+        {
+            info.hasAlpha = TRUE;
+        }
+    }
+    info.bitsPerPixel = info.channels * 8;
+
+    if (bandRows > height)
+    {
+        bandRows = height;
+    }
+
+    band = (pixel32 *) malloc (width * bandRows * sizeof (pixel32));
+    if (!band)
+    {
+        SetGlobalErr (ERR_GENERIC);
+        GEcatf ("Out of Memory loading pic");
+        goto cleanup;
+    }
+
+    s   = mf->curPtr;
+    end = mf->curPtr + mf->bytesLeft;
+    for (y = 0; y < height; y += bandRows)
+    {
+        long    numRows = (height - y) < bandRows ? (height - y) : bandRows;
+        long    row;
+
+        for (row = 0; row < numRows; row++)
+        {
+            s = decodePICRow (band + row * width, band + width * bandRows, width, packets, numPackets, s, end);
+            if (!s)
+            {
+                goto cleanup;
+            }
+        }
+
+        if (!pfnRows (pUserData, &info, band, y, numRows))
+        {
+            goto cleanup;
+        }
+    }
+
+    result = TRUE;
+
+cleanup:
+    if (band)
+    {
+        free (band);
+    }
+
+    return result;
+}
+// streamPIC32Bit
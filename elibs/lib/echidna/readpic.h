@@ -64,6 +64,8 @@ extern "C" {
 #endif
 
 extern int loadPIC32Bit( BlockO32BitPixels* bop, MEMFILE* mf);
+extern int loadPICInfo (PictureInfo *pInfo, MEMFILE *mf);
+extern int streamPIC32Bit (MEMFILE *mf, long bandRows, PFNPICTUREROWS pfnRows, void *pUserData);
 
 #ifdef __cplusplus
 }
@@ -53,10 +53,14 @@
 #include "switches.h"
 #include "echidna/ensure.h"
 
+#include <string.h>
+
 #include "echidna/readgfx.h"
 #include "echidna/checkglu.h"
 #include "echidna/eerrors.h"
+#include "echidna/pixconv.h"
 #include "readtga.h"
+#include "picpool.h"
 
 /**************************** C O N S T A N T S ***************************/
 
@@ -66,6 +70,13 @@
 // a alpha bits
 #define TGA_IDESC_HFLIP 0x10
 #define TGA_IDESC_VFLIP 0x20
+#define TGA_IDESC_ALPHABITS 0x0F
+
+// most pixels in one RLE packet
+#define TGA_MAX_PACKET      128
+
+// saveTGA???Ex collect their output here and write it in big pieces
+#define TGA_WRITE_BUFFER_SIZE   (256 * 1024)
 
 /******************************** T Y P E S *******************************/
 
@@ -97,6 +108,15 @@ typedef struct TGAHeader
     uint8   idesc;          // Byte 17
 } TGAHeader;
 
+// staging buffer for the savers
+typedef struct TGAWriter
+{
+    int      fh;
+    uint8   *buffer;
+    long     size;
+    long     used;
+} TGAWriter;
+
 /****************************** G L O B A L S *****************************/
 
 
@@ -107,36 +127,88 @@ typedef struct TGAHeader
 
 /*********************************************************************
  *
- * loadUncompressedTGA
+ * convertTGAPixels
  *
  * SYNOPSIS
- *      void  loadUncompressedTGA (BlockO32BitPixels *blockPtr, unsigned char *fileBufferPtr)
+ *      static void convertTGAPixels (pixel32 *d, const uint8 *s, long count, int channels, const pixel32 *colorMap, uint8 idesc)
  *
  * PURPOSE
+ *      Convert count targa pixels of channels bytes each to pixel32
+ *      using the fastest kernels the CPU has.  idesc says if 16 bit
+ *      pixels use their top bit as alpha.
  *
+*/
+static void convertTGAPixels (pixel32 *d, const uint8 *s, long count, int channels, const pixel32 *colorMap, uint8 idesc)
+{
+	switch (channels)
+	{
+	case 1:
+		if (colorMap)
+		{
+			PixConv_Index8 (d, s, count, colorMap);
+		}
+		else
+		{
+			PixConv_Grey8 (d, s, count);
+		}
+		break;
+	case 2:
+		PixConv_BGR555 (d, s, count, (idesc & TGA_IDESC_ALPHABITS) != 0);
+		break;
+	case 3:
+		PixConv_BGR24 (d, s, count);
+		break;
+	case 4:
+		PixConv_BGRA32 (d, s, count);
+		break;
+	}
+}
+// convertTGAPixels
+
+/*********************************************************************
  *
- * INPUT
- *
+ * tgaRowsReversed
  *
- * EFFECTS
+ * SYNOPSIS
+ *      static int tgaRowsReversed (uint8 idesc)
  *
+ * PURPOSE
+ *      TRUE if the rows of a targa with this descriptor are stored in
+ *      the opposite order to the one the loaders give them in, top
+ *      row first (bottom row first if READ_UPSIDEDOWN).  The loaders
+ *      use it to decode each row straight into its place.
  *
- * RETURN VALUE
+*/
+static int tgaRowsReversed (uint8 idesc)
+{
+    #if READ_UPSIDEDOWN
+        return (idesc & TGA_IDESC_VFLIP) != 0;
+    #else
+        return !(idesc & TGA_IDESC_VFLIP);
+    #endif
+}
+// tgaRowsReversed
+
+/*********************************************************************
  *
+ * loadUncompressedTGA
  *
- * HISTORY
+ * SYNOPSIS
+ *      static int loadUncompressedTGA (BlockO32BitPixels *blockPtr, int channels, MEMFILE *mf, pixel32* colorMap, uint8 idesc, int fReverse)
  *
+ * PURPOSE
+ *      Decode uncompressed pixel data.  If fReverse the first row in
+ *      the file goes at the bottom of blockPtr.
  *
- * SEE ALSO
+ * RETURN VALUE
+ *      FALSE if the data is short.
  *
 */
-static int loadUncompressedTGA (BlockO32BitPixels *blockPtr, int channels, MEMFILE *mf, pixel32* colorMap, uint8 idesc)
+static int loadUncompressedTGA (BlockO32BitPixels *blockPtr, int channels, MEMFILE *mf, pixel32* colorMap, uint8 idesc, int fReverse)
 {
 
 	pixel32* bufferStart;
-	pixel32* buffer;
 
-	long	 i;
 	long	 loop;
 	long	 lineSize;
 	long	 bufferSize;
@@ -149,141 +221,34 @@ static int loadUncompressedTGA (BlockO32BitPixels *blockPtr, int channels, MEMFI
 	lineSize     = bufferWidth;
 	bufferSize   = lineSize * bufferHeight;
 
-	#if READ_UPSIDEDOWN
-		if (idesc & TGA_IDESC_VFLIP)
-		{
-			bufferStart  = blockPtr->rgba + bufferSize - lineSize;
-			lineMod      = -lineSize;
-		}
-		else
-		{
-			bufferStart  = blockPtr->rgba;
-			lineMod      = lineSize;
-		}
-    #else
-		if (idesc & TGA_IDESC_VFLIP)
-		{
-			bufferStart  = blockPtr->rgba;
-			lineMod      = lineSize;
-		}
-		else
-		{
-			bufferStart  = blockPtr->rgba + bufferSize - lineSize;
-			lineMod      = -lineSize;
-		}
-	#endif
-
-	buffer = bufferStart;
-
-	switch (channels)
+	if (fReverse)
 	{
-	case 1:
-		if (colorMap)
-		{
-			// No Alpha / Uncompressed
-
-			for (loop = 0; loop < bufferHeight; loop++)
-			{
-				buffer = bufferStart;
-
-				for (i = 0; i < bufferWidth; i++)
-				{
-					uint8	k;
-
-					k = MEMFILE_getc(mf);
-
-					buffer->red   = colorMap[k].red;
-					buffer->green = colorMap[k].green;
-					buffer->blue  = colorMap[k].blue;
-					buffer->alpha = colorMap[k].alpha;
-					buffer++;
-				}
-
-				bufferStart += lineMod;
-			}
-		}
-		else
-		{
-			// No Alpha / Uncompressed
-
-			for (loop = 0; loop < bufferHeight; loop++)
-			{
-				buffer = bufferStart;
-
-				for (i = 0; i < bufferWidth; i++)
-				{
-					uint8	k;
-
-					k = MEMFILE_getc(mf);
-
-					buffer->red   = k;
-					buffer->green = k;
-					buffer->blue  = k;
-					buffer->alpha = 255;
-					buffer++;
-				}
-
-				bufferStart += lineMod;
-			}
-		}
-		break;
-	case 3:
-		{
-			// No Alpha / Uncompressed
-
-			for (loop = 0; loop < bufferHeight; loop++)
-			{
-				buffer = bufferStart;
-
-				for (i = 0; i < bufferWidth; i++)
-				{
-					uint8	r,g,b;
-
-					b = MEMFILE_getc(mf);
-					g = MEMFILE_getc(mf);
-					r = MEMFILE_getc(mf);
-
-					buffer->red   = r;
-					buffer->green = g;
-					buffer->blue  = b;
-					buffer->alpha = 255;
-					buffer++;
-				}
-
-				bufferStart += lineMod;
-			}
-		}
-		break;
-	case 4:
-		{
-			// Alpha / Uncompressed
-
-			for (loop = 0; loop < bufferHeight; loop++)
-			{
-				buffer = bufferStart;
+		bufferStart  = blockPtr->rgba + bufferSize - lineSize;
+		lineMod      = -lineSize;
+	}
+	else
+	{
+		bufferStart  = blockPtr->rgba;
+		lineMod      = lineSize;
+	}
 
-				for (i = 0; i < bufferWidth; i++)
-				{
-					uint8	r,g,b,a;
+	if (mf->bytesLeft < bufferSize * channels)
+	{
+		SetGlobalErr (ERR_GENERIC);
+		GEcatf ("Unexpected end of targa data\n");
+		return FALSE;
+	}
 
-					b = MEMFILE_getc(mf);
-					g = MEMFILE_getc(mf);
-					r = MEMFILE_getc(mf);
-					a = MEMFILE_getc(mf);
+	// convert a row at a time straight from the file buffer into the
+	// row it belongs in so there's no separate flip pass
+	for (loop = 0; loop < bufferHeight; loop++)
+	{
+		convertTGAPixels (bufferStart, mf->curPtr, bufferWidth, channels, colorMap, idesc);
+		MEMFILE_Seek (mf, bufferWidth * channels, SEEK_CUR);
 
-					buffer->red   = r;
-					buffer->green = g;
-					buffer->blue  = b;
-					buffer->alpha = a;
-					buffer++;
-				}
-				bufferStart += lineMod;
-			}
-		}
-		break;
-	default:
-		return FALSE;
+		bufferStart += lineMod;
 	}
+
 	return TRUE;
 }
 // loadUncompressedTGA
@@ -293,73 +258,55 @@ static int loadUncompressedTGA (BlockO32BitPixels *blockPtr, int channels, MEMFI
  * loadUncompressedGrey8BitTGA
  *
  * SYNOPSIS
- *      void  loadUncompressedGrey8BitTGA (BlockOGrey8BitPixels *blockPtr, unsigned char *fileBufferPtr)
+ *      static int loadUncompressedGrey8BitTGA (BlockOGrey8BitPixels *blockPtr, MEMFILE *mf, uint8 idesc)
  *
  * PURPOSE
- *
- *
- * INPUT
- *
- *
- * EFFECTS
- *
+ *      Copy uncompressed 8 bit rows into blockPtr, each straight to
+ *      the row it belongs in.
  *
  * RETURN VALUE
- *
- *
- * HISTORY
- *
- *
- * SEE ALSO
+ *      FALSE if the data is short.
  *
 */
 static int loadUncompressedGrey8BitTGA (BlockOGrey8BitPixels *blockPtr, MEMFILE *mf, uint8 idesc)
 {
+    uint8*   buffer;
 
-    uint8* bufferStart;
-    uint8* buffer;
-
-    long     i;
     long     loop;
-    long     lineSize;
-    long     bufferSize;
+    long     lineMod;
     long     bufferWidth;
     long     bufferHeight;
 
     bufferWidth  = blockPtr->width;
     bufferHeight = blockPtr->height;
-    lineSize     = bufferWidth;
-    bufferSize   = lineSize * bufferHeight;
-
-    bufferStart  = blockPtr->pixels + bufferSize - lineSize;
-
-    buffer = bufferStart;
 
-    for (loop = 0; loop < bufferHeight; loop++)
+    if (mf->bytesLeft < bufferWidth * bufferHeight)
     {
-        buffer = bufferStart;
-
-        for (i = 0; i < bufferWidth; i++)
-        {
-            uint8   a;
-
-            a = MEMFILE_getc(mf);
-
-            *buffer = a;
-            buffer++;
-        }
-
-        bufferStart -= lineSize;
+        SetGlobalErr (ERR_GENERIC);
+        GEcatf ("Unexpected end of targa data");
+        return FALSE;
     }
 
-    if (idesc & TGA_IDESC_VFLIP)
+    if (tgaRowsReversed (idesc))
     {
-        return flipBuffer (blockPtr->pixels, blockPtr->width, blockPtr->height);
+        buffer  = blockPtr->pixels + bufferWidth * (bufferHeight - 1);
+        lineMod = -bufferWidth;
     }
     else
     {
-        return TRUE;
+        buffer  = blockPtr->pixels;
+        lineMod = bufferWidth;
+    }
+
+    for (loop = 0; loop < bufferHeight; loop++)
+    {
+        memcpy (buffer, mf->curPtr, bufferWidth);
+        MEMFILE_Seek (mf, bufferWidth, SEEK_CUR);
+
+        buffer += lineMod;
     }
+
+    return TRUE;
 }
 // loadUncompressedGrey8BitTGA
 
@@ -368,92 +315,108 @@ static int loadUncompressedGrey8BitTGA (BlockOGrey8BitPixels *blockPtr, MEMFILE
  * loadCompressedGrey8BitTGA
  *
  * SYNOPSIS
- *      void  loadCompressedGrey8BitTGA (BlockOGrey8BitPixels *blockPtr, uint8 *fileBufferPtr)
+ *      static int loadCompressedGrey8BitTGA (BlockOGrey8BitPixels *blockPtr, MEMFILE *mf, uint8 idesc)
  *
  * PURPOSE
- *
- *
- * INPUT
- *
- *
- * EFFECTS
- *
+ *      Decode 8 bit run length data into blockPtr.  Packets can run
+ *      on from one row to the next so they're split at the ends of
+ *      rows and each piece goes straight to the row it belongs in.
  *
  * RETURN VALUE
- *
- *
- * HISTORY
- *
- *
- * SEE ALSO
+ *      FALSE if the data is short or bad.
  *
 */
-int loadCompressedGrey8BitTGA (BlockOGrey8BitPixels *blockPtr, MEMFILE *mf, uint8 idesc)
+static int loadCompressedGrey8BitTGA (BlockOGrey8BitPixels *blockPtr, MEMFILE *mf, uint8 idesc)
 {
-    uint8           a;
     uint8           i;
-    uint8           count;
-    uint8*          buffer;
-
-    long            pixelCount;
-    long            totalPixels;
-    long            bufferWidth;
-    long            bufferHeight;
-
-    bufferWidth  = blockPtr->width;
-    bufferHeight = blockPtr->height;
-    totalPixels  = bufferWidth * bufferHeight;
-    buffer       = blockPtr->pixels;
-    pixelCount   = 0;
+    long            count;
+    long            width;
+    long            height;
+    long            x;
+    long            y;
+    int             fReverse;
+    uint8*          row;
+    const uint8*    s;
+    const uint8*    sEnd;
+
+    width     = blockPtr->width;
+    height    = blockPtr->height;
+    fReverse  = tgaRowsReversed (idesc);
+    s         = mf->curPtr;
+    sEnd      = s + (mf->bytesLeft > 0 ? mf->bytesLeft : 0);
+
+    if (!width)
+    {
+        return TRUE;
+    }
 
-    while (pixelCount < totalPixels)
+    // work straight from the file buffer a whole packet at a time
+    x   = 0;
+    y   = 0;
+    row = blockPtr->pixels + (fReverse ? height - 1 : 0) * width;
+    while (y < height)
     {
-        i = MEMFILE_getc(mf);
-        count = (0x7F & i) + 1;
+        if (s >= sEnd)
+        {
+            SetGlobalErr (ERR_GENERIC);
+            GEcatf ("Unexpected end of targa data");
+            return FALSE;
+        }
 
-        pixelCount += count;
+        i = *s++;
+        count = (0x7F & i) + 1;
 
-        if (pixelCount > totalPixels)
+        if (count > (height - y) * width - x)
         {
             SetGlobalErr (ERR_GENERIC);
             GEcatf ("Pixel overflow in targa decompression");
             return FALSE;
         }
 
-        if (i & 0x80)
+        if (sEnd - s < ((i & 0x80) ? 1 : count))
+        {
+            SetGlobalErr (ERR_GENERIC);
+            GEcatf ("Unexpected end of targa data");
+            return FALSE;
+        }
+
+        while (count)
         {
-            // run data
+            long    n = count < width - x ? count : width - x;
 
-            a = MEMFILE_getc(mf);
+            if (i & 0x80)
+            {
+                // run data
 
-            while (count--)
+                memset (row + x, *s, n);
+            }
+            else
             {
-                *buffer = a;
-                buffer++;
+                // dump data
+
+                memcpy (row + x, s, n);
+                s += n;
             }
-        }
-        else
-        {
-            // dump data
+            x     += n;
+            count -= n;
 
-            while (count--)
+            if (x == width)
             {
-                a = MEMFILE_getc(mf);
-
-                *buffer = a;
-                buffer++;
+                x = 0;
+                y++;
+                row = blockPtr->pixels + (fReverse ? height - 1 - y : y) * width;
             }
         }
-    }
 
-    if (idesc & TGA_IDESC_VFLIP)
-    {
-        return TRUE;
-    }
-    else
-    {
-		return flipBuffer (blockPtr->pixels, blockPtr->width, blockPtr->height);
+        if (i & 0x80)
+        {
+            s++;
+        }
     }
+
+    MEMFILE_Seek (mf, (long)(s - mf->curPtr), SEEK_CUR);
+
+    return TRUE;
 }
 // loadCompressedGrey8BitTGA
 
@@ -517,6 +480,7 @@ int loadTGAGrey8Bit (BlockOGrey8BitPixels *blockPtr, MEMFILE *mf)
     switch (tgaHeader->itype)
     {
     case 2:
+    case 3:
         if (tgaHeader->bpp != 8)
         {
             SetGlobalErr (ERR_GENERIC);
@@ -534,6 +498,7 @@ int loadTGAGrey8Bit (BlockOGrey8BitPixels *blockPtr, MEMFILE *mf)
         break;
 
     case 10:
+    case 11:
         if (tgaHeader->bpp != 8)
         {
             SetGlobalErr (ERR_GENERIC);
@@ -636,221 +601,141 @@ int flipBuffer (void *buffer, long rowSize, long rows)
  * loadCompressedTGA
  *
  * SYNOPSIS
- *		void  loadCompressedTGA (BlockO32BitPixels *blockPtr, uint8 *fileBufferPtr)
+ *		static int loadCompressedTGA (BlockO32BitPixels *blockPtr, int channels, MEMFILE *mf, pixel32* colorMap, uint8 idesc, int fReverse)
  *
  * PURPOSE
- *
- *
- * INPUT
- *
- *
- * EFFECTS
- *
+ *		Decode run length data.  Packets can run on from one row to
+ *		the next so they're split at the ends of rows and each piece
+ *		goes straight to the row it belongs in, the bottom one first
+ *		if fReverse.
  *
  * RETURN VALUE
- *
- *
- * HISTORY
- *
- *
- * SEE ALSO
+ *		FALSE if the data is short or bad.
  *
 */
-int loadCompressedTGA (BlockO32BitPixels *blockPtr, int channels, MEMFILE *mf, pixel32* colorMap, uint8 idesc)
+static int loadCompressedTGA (BlockO32BitPixels *blockPtr, int channels, MEMFILE *mf, pixel32* colorMap, uint8 idesc, int fReverse)
 {
-	uint8			a;
-	uint8			r;
-	uint8			g;
-	uint8			b;
 	uint8			i;
-	uint8			count;
-	pixel32*		buffer;
+	long			count;
+	long			width;
+	long			height;
+	long			x;
+	long			y;
+	pixel32*		row;
+	const uint8*	s;
+	const uint8*	sEnd;
+
+	width     = blockPtr->width;
+	height    = blockPtr->height;
+	s         = mf->curPtr;
+	sEnd      = s + (mf->bytesLeft > 0 ? mf->bytesLeft : 0);
+
+	if (!width)
+	{
+		return TRUE;
+	}
 
-	long			pixelCount;
-	long			totalPixels;
-	long			bufferWidth;
-	long			bufferHeight;
+	// work straight from the file buffer a whole packet at a time so
+	// runs are a fill and raw packets are one conversion call per row
+	x   = 0;
+	y   = 0;
+	row = blockPtr->rgba + (fReverse ? height - 1 : 0) * width;
+	while (y < height)
+	{
+		pixel32	p;
 
-	bufferWidth  = blockPtr->width;
-	bufferHeight = blockPtr->height;
-	totalPixels  = bufferWidth * bufferHeight;
-	buffer       = blockPtr->rgba;
-	pixelCount   = 0;
+		if (s >= sEnd)
+		{
+			SetGlobalErr(ERR_GENERIC);
+			GEcatf ("Unexpected end of targa data\n");
+			return FALSE;
+		}
 
-	while (pixelCount < totalPixels)
-	{
-		i = MEMFILE_getc(mf);
+		i = *s++;
 		count = (0x7F & i) + 1;
 
-		pixelCount += count;
-
-		if (pixelCount > totalPixels)
+		if (count > (height - y) * width - x)
 		{
 			SetGlobalErr(ERR_GENERIC);
 			GEcatf ("Pixel overflow in targa decompression\n");
 			return FALSE;
 		}
 
+		if (sEnd - s < ((i & 0x80) ? 1 : count) * channels)
+		{
+			SetGlobalErr(ERR_GENERIC);
+			GEcatf ("Unexpected end of targa data\n");
+			return FALSE;
+		}
+
 		if (i & 0x80)
 		{
 			// run data
-			switch (channels)
-			{
-			case 1:
-				if (colorMap)
-				{
-					uint8 k;
-					k = MEMFILE_getc(mf);
 
-					r = colorMap[k].red;
-					g = colorMap[k].green;
-					b = colorMap[k].blue;
-					a = colorMap[k].alpha;
-				}
-				else
-				{
-					b = MEMFILE_getc(mf);
-					g = b;
-					r = b;
-					a = 255;
-				}
-				break;
-			case 3:
-				b = MEMFILE_getc(mf);
-				g = MEMFILE_getc(mf);
-				r = MEMFILE_getc(mf);
-				a = 255;
-				break;
-			case 4:
-				b = MEMFILE_getc(mf);
-				g = MEMFILE_getc(mf);
-				r = MEMFILE_getc(mf);
-				a = MEMFILE_getc(mf);
-				break;
-			}
+			convertTGAPixels (&p, s, 1, channels, colorMap, idesc);
+			s += channels;
+		}
 
-			while (count--)
-			{
-				buffer->red   = r;
-				buffer->green = g;
-				buffer->blue  = b;
-				buffer->alpha = a;
-				buffer++;
-			}
-		}
-		else
+		while (count)
 		{
-			// dump data
+			long	n = count < width - x ? count : width - x;
 
-			while (count--)
+			if (i & 0x80)
 			{
-				switch (channels)
-				{
-				case 1:
-					if (colorMap)
-					{
-						uint8 k;
-						k = MEMFILE_getc(mf);
-
-						r = colorMap[k].red;
-						g = colorMap[k].green;
-						b = colorMap[k].blue;
-						a = colorMap[k].alpha;
-					}
-					else
-					{
-						b = MEMFILE_getc(mf);
-						g = b;
-						r = b;
-						a = 255;
-					}
-					break;
-				case 3:
-					b = MEMFILE_getc(mf);
-					g = MEMFILE_getc(mf);
-					r = MEMFILE_getc(mf);
-					break;
-				case 4:
-					b = MEMFILE_getc(mf);
-					g = MEMFILE_getc(mf);
-					r = MEMFILE_getc(mf);
-					a = MEMFILE_getc(mf);
-					break;
-				}
+				PixConv_Fill32 (row + x, p, n);
+			}
+			else
+			{
+				// dump data
 
-				buffer->red   = r;
-				buffer->green = g;
-				buffer->blue  = b;
-				buffer->alpha = a;
-				buffer++;
+				convertTGAPixels (row + x, s, n, channels, colorMap, idesc);
+				s += n * channels;
+			}
+			x     += n;
+			count -= n;
+
+			if (x == width)
+			{
+				x = 0;
+				y++;
+				row = blockPtr->rgba + (fReverse ? height - 1 - y : y) * width;
 			}
 		}
 	}
 
-    #if READ_UPSIDEDOWN
-		if (idesc & TGA_IDESC_VFLIP)
-		{
-			flipBuffer (blockPtr->rgba, blockPtr->width * sizeof (pixel32), blockPtr->height);
-		}
-		else
-		{
-		}
-    #else
-		if (idesc & TGA_IDESC_VFLIP)
-		{
-		}
-		else
-		{
-			flipBuffer (blockPtr->rgba, blockPtr->width * sizeof (pixel32), blockPtr->height);
-		}
-	#endif
+	MEMFILE_Seek (mf, (long)(s - mf->curPtr), SEEK_CUR);
 
 	return TRUE;
 }
 // loadCompressedTGA
 
 
+#define MAX_COLORMAP 256
+
 /*********************************************************************
  *
- * loadTGA32Bit
+ * readTGAHeader
  *
  * SYNOPSIS
- *      void loadTGA32Bit (BlockO32BitPixels *blockPtr, char *fileName)
+ *      static int readTGAHeader (TGAHeader *tgaHeader, MEMFILE *mf, pixel32 *colorMap, int *pChannels)
  *
  * PURPOSE
- *
- *
- * INPUT
- *
- *
- * EFFECTS
- *
+ *      Read the targa header, skip the ID field and read the color map
+ *      if there is one.  Leaves mf pointing at the pixel data.
  *
  * RETURN VALUE
- *
- *
- * HISTORY
- *
- *
- * SEE ALSO
+ *      TRUE on success.  *pChannels is set to the bytes per pixel
+ *      (1, 3 or 4).
  *
 */
-#define MAX_COLORMAP 256
-
-int loadTGA32Bit (BlockO32BitPixels *blockPtr, MEMFILE *mf)
+static int readTGAHeader (TGAHeader *tgaHeader, MEMFILE *mf, pixel32 *colorMap, int *pChannels)
 {
-    TGAHeader        tgaHeaderX;
-    TGAHeader       *tgaHeader = &tgaHeaderX;
-
-    long            alphachannels;
-    long            bufferWidth;
-    long            bufferHeight;
-
-	pixel32			colorMap[MAX_COLORMAP];
-	int				fColorMap = FALSE;
-	int				channels = 0;
-
-    MEMFILE_Read(mf, tgaHeader, sizeof (TGAHeader));
+    if (MEMFILE_Read(mf, tgaHeader, sizeof (TGAHeader)) != sizeof (TGAHeader))
+    {
+        SetGlobalErr (ERR_GENERIC);
+        GEcatf ("Bad TGA header");
+        return FALSE;
+    }
 
     #if 0
     {
@@ -879,32 +764,43 @@ int loadTGA32Bit (BlockO32BitPixels *blockPtr, MEMFILE *mf)
 
     MEMFILE_Seek (mf, tgaHeader->ID, SEEK_CUR); // Skip User Info
 
-    alphachannels = FALSE;
     if (tgaHeader->bpp == 32)
     {
-        alphachannels = TRUE;
-		channels = 4;
+		*pChannels = 4;
     }
 	else if (tgaHeader->bpp == 24)
 	{
-		channels = 3;
+		*pChannels = 3;
+	}
+	else if (tgaHeader->bpp == 16 || tgaHeader->bpp == 15)
+	{
+		*pChannels = 2;
 	}
 	else if (tgaHeader->bpp == 8)
 	{
 		int	firstColor = ((long)tgaHeader->mincolorl + (long)tgaHeader->mincolorh * 256L);
 		int	numColors  = ((long)tgaHeader->colorsl   + (long)tgaHeader->colorsh   * 256L);
 
-		channels = 1;
-
-		fColorMap = TRUE;
+		*pChannels = 1;
 
 		if (numColors > 0 && firstColor + numColors <= 256)
 		{
 			int colorNdx;
-			memset (colorMap, 0, sizeof (colorMap));
+			memset (colorMap, 0, MAX_COLORMAP * sizeof (pixel32));
 
 			switch (tgaHeader->colorsize)
 			{
+			case 15:
+			case 16:
+				if (mf->bytesLeft < numColors * 2)
+				{
+					SetGlobalErr (ERR_GENERIC);
+					GEcatf ("bad color map\n");
+					return FALSE;
+				}
+				PixConv_BGR555 (colorMap + firstColor, mf->curPtr, numColors, FALSE);
+				MEMFILE_Seek (mf, numColors * 2, SEEK_CUR);
+				break;
 			case 24:
 				for (colorNdx = 0; colorNdx < numColors; ++colorNdx)
 				{
@@ -938,32 +834,90 @@ int loadTGA32Bit (BlockO32BitPixels *blockPtr, MEMFILE *mf)
 			default:
 				SetGlobalErr (ERR_GENERIC);
 				GEcatf ("unhandled color map size\n");
-				goto cleanup;
+				return FALSE;
 			}
 		}
 		else if (numColors)
 		{
 			SetGlobalErr (ERR_GENERIC);
 			GEcatf ("too many colors in color map\n");
-			goto cleanup;
+			return FALSE;
 		}
 	}
 	else
 	{
 		SetGlobalErr (ERR_GENERIC);
 		GEcatf ("unsupported bits per pixel\n");
-		goto cleanup;
+		return FALSE;
 	}
 
-    bufferWidth  = ((long)tgaHeader->widthl  + (long)tgaHeader->widthh * 256L);
-    bufferHeight = ((long)tgaHeader->heightl + (long)tgaHeader->heighth * 256L);
+    return TRUE;
+}
+// readTGAHeader
 
+/*********************************************************************
+ *
+ * loadTGA32Bit
+ *
+ * SYNOPSIS
+ *      void loadTGA32Bit (BlockO32BitPixels *blockPtr, char *fileName)
+ *
+ * PURPOSE
+ *
+ *
+ * INPUT
+ *
+ *
+ * EFFECTS
+ *
+ *
+ * RETURN VALUE
+ *
+ *
+ * HISTORY
+ *
+ *
+ * SEE ALSO
+ *
+*/
+int loadTGA32Bit (BlockO32BitPixels *blockPtr, MEMFILE *mf)
+{
+    TGAHeader        tgaHeaderX;
+    TGAHeader       *tgaHeader = &tgaHeaderX;
+
+    long            alphachannels;
+    long            bufferWidth;
+    long            bufferHeight;
+
+	pixel32			colorMap[MAX_COLORMAP];
+	int				channels = 0;
+	int				fReverse;
+
+    if (!readTGAHeader (tgaHeader, mf, colorMap, &channels))
     {
-        long    bufferSize;
+        goto cleanup;
+    }
+
+    // rows are decoded straight to where they go, in the file's order
+    // if the caller can take that
+    if (blockPtr->fNativeOrientation)
+    {
+        fReverse            = FALSE;
+        blockPtr->fBottomUp = !(tgaHeader->idesc & TGA_IDESC_VFLIP);
+    }
+    else
+    {
+        fReverse            = tgaRowsReversed (tgaHeader->idesc);
+        blockPtr->fBottomUp = FALSE;
+    }
 
-        bufferSize = bufferWidth * bufferHeight * 4;
+    alphachannels = (tgaHeader->bpp == 32) || (tgaHeader->bpp == 16 && (tgaHeader->idesc & TGA_IDESC_ALPHABITS));
 
-        blockPtr->rgba   = (pixel32 *) malloc (bufferSize);
+    bufferWidth  = ((long)tgaHeader->widthl  + (long)tgaHeader->widthh * 256L);
+    bufferHeight = ((long)tgaHeader->heightl + (long)tgaHeader->heighth * 256L);
+
+    {
+        AllocPicturePixels (blockPtr, bufferWidth * bufferHeight);
         blockPtr->width  = bufferWidth;
         blockPtr->height = bufferHeight;
 
@@ -991,14 +945,14 @@ int loadTGA32Bit (BlockO32BitPixels *blockPtr, MEMFILE *mf)
 		}
 		else
 		{
-			if (!loadUncompressedTGA (blockPtr, channels, mf, colorMap, tgaHeader->idesc))
+			if (!loadUncompressedTGA (blockPtr, channels, mf, colorMap, tgaHeader->idesc, fReverse))
 			{
 				goto cleanup;
 			}
 		}
 		break;
 	case 2: // uncompressed true color
-		if (((tgaHeader->bpp != 24) && (tgaHeader->bpp != 32)))
+		if (((tgaHeader->bpp != 15) && (tgaHeader->bpp != 16) && (tgaHeader->bpp != 24) && (tgaHeader->bpp != 32)))
 		{
 			SetGlobalErr (ERR_GENERIC);
 			GEcatf1 ("Unsupported bit depth (%d)\n", tgaHeader->bpp);
@@ -1006,7 +960,7 @@ int loadTGA32Bit (BlockO32BitPixels *blockPtr, MEMFILE *mf)
 		}
 		else
 		{
-			if (!loadUncompressedTGA (blockPtr, channels, mf, NULL, tgaHeader->idesc))
+			if (!loadUncompressedTGA (blockPtr, channels, mf, NULL, tgaHeader->idesc, fReverse))
 			{
 				goto cleanup;
 			}
@@ -1021,7 +975,7 @@ int loadTGA32Bit (BlockO32BitPixels *blockPtr, MEMFILE *mf)
 		}
 		else
 		{
-			if (!loadUncompressedTGA (blockPtr, channels, mf, NULL, tgaHeader->idesc))
+			if (!loadUncompressedTGA (blockPtr, channels, mf, NULL, tgaHeader->idesc, fReverse))
 			{
 				goto cleanup;
 			}
@@ -1036,14 +990,14 @@ int loadTGA32Bit (BlockO32BitPixels *blockPtr, MEMFILE *mf)
 		}
 		else
 		{
-			if (!loadCompressedTGA (blockPtr, channels, mf, colorMap, tgaHeader->idesc))
+			if (!loadCompressedTGA (blockPtr, channels, mf, colorMap, tgaHeader->idesc, fReverse))
 			{
 				goto cleanup;
 			}
 		}
 		break;
 	case 10: // rle compressed black & white
-		if (((tgaHeader->bpp != 24) && (tgaHeader->bpp != 32)))
+		if (((tgaHeader->bpp != 15) && (tgaHeader->bpp != 16) && (tgaHeader->bpp != 24) && (tgaHeader->bpp != 32)))
 		{
 			SetGlobalErr (ERR_GENERIC);
 			GEcatf1 ("Unsupported bit depth (%d)\n", tgaHeader->bpp);
@@ -1051,7 +1005,7 @@ int loadTGA32Bit (BlockO32BitPixels *blockPtr, MEMFILE *mf)
 		}
 		else
 		{
-			if (!loadCompressedTGA (blockPtr, channels, mf, NULL, tgaHeader->idesc))
+			if (!loadCompressedTGA (blockPtr, channels, mf, NULL, tgaHeader->idesc, fReverse))
 			{
 				goto cleanup;
 			}
@@ -1066,7 +1020,7 @@ int loadTGA32Bit (BlockO32BitPixels *blockPtr, MEMFILE *mf)
 		}
 		else
 		{
-			if (!loadCompressedTGA (blockPtr, channels, mf, NULL, tgaHeader->idesc))
+			if (!loadCompressedTGA (blockPtr, channels, mf, NULL, tgaHeader->idesc, fReverse))
 			{
 				goto cleanup;
 			}
@@ -1081,15 +1035,545 @@ int loadTGA32Bit (BlockO32BitPixels *blockPtr, MEMFILE *mf)
     return TRUE;
 
 cleanup:
-    if (blockPtr->rgba)
-    {
-        free (blockPtr->rgba);
-    }
+    FreePicturePixels (blockPtr);
     return FALSE;
 }
 
 // loadTGA32Bit
 
+/*********************************************************************
+ *
+ * loadTGAInfo
+ *
+ * SYNOPSIS
+ *      int loadTGAInfo (PictureInfo *pInfo, MEMFILE *mf)
+ *
+ * PURPOSE
+ *      Fill out pInfo from the 18 byte targa header without decoding
+ *      any pixels.
+ *
+ * RETURN VALUE
+ *      TRUE on success, FALSE if the header is bad or unsupported.
+ *
+*/
+int loadTGAInfo (PictureInfo *pInfo, MEMFILE *mf)
+{
+    TGAHeader   tgaHeader;
+
+    if (MEMFILE_Read(mf, &tgaHeader, sizeof (TGAHeader)) != sizeof (TGAHeader))
+    {
+        SetGlobalErr (ERR_GENERIC);
+        GEcatf ("Bad TGA header");
+        return FALSE;
+    }
+
+    switch (tgaHeader.itype)
+    {
+    case 1:
+    case 2:
+    case 3:
+    case 9:
+    case 10:
+    case 11:
+        break;
+    default:
+        SetGlobalErr (ERR_GENERIC);
+        GEcatf ("Unsupported TGA file type\n");
+        return FALSE;
+    }
+
+    pInfo->format       = PICFMT_TGA;
+    pInfo->width        = ((long)tgaHeader.widthl  + (long)tgaHeader.widthh * 256L);
+    pInfo->height       = ((long)tgaHeader.heightl + (long)tgaHeader.heighth * 256L);
+    pInfo->bitsPerPixel = tgaHeader.bpp;
+    pInfo->hasAlpha     = (tgaHeader.bpp == 32) || (tgaHeader.bpp == 16 && (tgaHeader.idesc & TGA_IDESC_ALPHABITS)) || (tgaHeader.ctype == 1 && tgaHeader.colorsize == 32);
+    pInfo->channels     = (tgaHeader.bpp + 7) / 8;
+
+    return TRUE;
+}
+// loadTGAInfo
+
+/*
+ * state of a targa RLE packet that may span more than one row
+ */
+typedef struct TGARLEState
+{
+	long		left;		// pixels left in the current packet
+	int			isRun;		// TRUE if the current packet is a run
+	pixel32		runPixel;	// pixel repeated by the current run
+} TGARLEState;
+
+/*
+ * where a row starts in the compressed data
+ */
+typedef struct TGARLEMark
+{
+	long		pos;
+	TGARLEState	state;
+} TGARLEMark;
+
+/*********************************************************************
+ *
+ * readTGARLEPixels
+ *
+ * SYNOPSIS
+ *      static int readTGARLEPixels (TGARLEState *pState, pixel32 *d, long count, int channels, MEMFILE *mf, const pixel32 *colorMap, uint8 idesc)
+ *
+ * PURPOSE
+ *      Decode count pixels of targa RLE data, carrying any partly used
+ *      packet over to the next call in pState.  If d is NULL the pixels
+ *      are skipped instead of decoded.
+ *
+ * RETURN VALUE
+ *      FALSE if the data runs out.
+ *
+*/
+static int readTGARLEPixels (TGARLEState *pState, pixel32 *d, long count, int channels, MEMFILE *mf, const pixel32 *colorMap, uint8 idesc)
+{
+	while (count)
+	{
+		long	num;
+
+		if (!pState->left)
+		{
+			int	i;
+
+			if (mf->bytesLeft <= 0)
+			{
+				SetGlobalErr(ERR_GENERIC);
+				GEcatf ("Unexpected end of targa data\n");
+				return FALSE;
+			}
+
+			i = MEMFILE_getc(mf);
+			pState->left  = (0x7F & i) + 1;
+			pState->isRun = (i & 0x80) != 0;
+
+			if (mf->bytesLeft < (pState->isRun ? 1 : pState->left) * channels)
+			{
+				SetGlobalErr(ERR_GENERIC);
+				GEcatf ("Unexpected end of targa data\n");
+				return FALSE;
+			}
+
+			if (pState->isRun)
+			{
+				convertTGAPixels (&pState->runPixel, mf->curPtr, 1, channels, colorMap, idesc);
+				MEMFILE_Seek (mf, channels, SEEK_CUR);
+			}
+		}
+
+		num = pState->left < count ? pState->left : count;
+		pState->left -= num;
+		count        -= num;
+
+		if (pState->isRun)
+		{
+			if (d)
+			{
+				PixConv_Fill32 (d, pState->runPixel, num);
+				d += num;
+			}
+		}
+		else
+		{
+			if (d)
+			{
+				convertTGAPixels (d, mf->curPtr, num, channels, colorMap, idesc);
+				d += num;
+			}
+			MEMFILE_Seek (mf, num * channels, SEEK_CUR);
+		}
+	}
+
+	return TRUE;
+}
+// readTGARLEPixels
+
+/*********************************************************************
+ *
+ * streamTGA32Bit
+ *
+ * SYNOPSIS
+ *      int streamTGA32Bit (MEMFILE *mf, long bandRows, PFNPICTUREROWS pfnRows, void *pUserData)
+ *
+ * PURPOSE
+ *      Decode a targa bandRows rows at a time, top row first, handing
+ *      each band to pfnRows.  Only one band of pixels is ever allocated.
+ *      Bottom up files are read by seeking to each row (uncompressed)
+ *      or to row marks recorded by a first pass (RLE).
+ *
+ * RETURN VALUE
+ *      TRUE if the whole picture was decoded and pfnRows never returned
+ *      FALSE.
+ *
+*/
+int streamTGA32Bit (MEMFILE *mf, long bandRows, PFNPICTUREROWS pfnRows, void *pUserData)
+{
+	TGAHeader		tgaHeader;
+	PictureInfo		info;
+	TGARLEState		rle;
+	TGARLEMark*		marks = NULL;
+	pixel32*		band  = NULL;
+	pixel32			colorMap[MAX_COLORMAP];
+	const pixel32*	pColorMap = NULL;
+	int				channels  = 0;
+	int				compressed;
+	int				topDown;
+	int				result = FALSE;
+	long			width;
+	long			height;
+	long			dataStart;
+	long			y;
+
+	if (!readTGAHeader (&tgaHeader, mf, colorMap, &channels))
+	{
+		goto cleanup;
+	}
+
+	switch (tgaHeader.itype)
+	{
+	case 1: // uncompressed color map
+	case 9: // rle compressed color map
+		pColorMap = colorMap;
+		// fall through
+	case 3: // uncompressed black & white
+	case 11: // rle compressed black & white
+		if (tgaHeader.bpp != 8)
+		{
+			SetGlobalErr (ERR_GENERIC);
+			GEcatf1 ("Unsupported bit depth (%d)\n", tgaHeader.bpp);
+			goto cleanup;
+		}
+		break;
+	case 2: // uncompressed true color
+	case 10: // rle compressed true color
+		if (((tgaHeader.bpp != 15) && (tgaHeader.bpp != 16) && (tgaHeader.bpp != 24) && (tgaHeader.bpp != 32)))
+		{
+			SetGlobalErr (ERR_GENERIC);
+			GEcatf1 ("Unsupported bit depth (%d)\n", tgaHeader.bpp);
+			goto cleanup;
+		}
+		break;
+	default:
+		SetGlobalErr (ERR_GENERIC);
+		GEcatf ("Unsupported TGA file type\n");
+		goto cleanup;
+	}
+
+	compressed = (tgaHeader.itype >= 9);
+	width      = ((long)tgaHeader.widthl  + (long)tgaHeader.widthh * 256L);
+	height     = ((long)tgaHeader.heightl + (long)tgaHeader.heighth * 256L);
+	dataStart  = MEMFILE_Seek (mf, 0, SEEK_CUR);
+
+	topDown    = !tgaRowsReversed (tgaHeader.idesc);
+
+	info.format       = PICFMT_TGA;
+	info.width        = width;
+	info.height       = height;
+	info.bitsPerPixel = tgaHeader.bpp;
+	info.hasAlpha     = (tgaHeader.bpp == 32) || (tgaHeader.bpp == 16 && (tgaHeader.idesc & TGA_IDESC_ALPHABITS)) || (tgaHeader.ctype == 1 && tgaHeader.colorsize == 32);
+	info.channels     = channels;
+
+	if (!width || !height)
+	{
+		result = TRUE;
+		goto cleanup;
+	}
+
+	if (!compressed && mf->bytesLeft < width * height * channels)
+	{
+		SetGlobalErr (ERR_GENERIC);
+		GEcatf ("Unexpected end of targa data\n");
+		goto cleanup;
+	}
+
+	if (bandRows > height)
+	{
+		bandRows = height;
+	}
+
+	band = (pixel32 *) malloc (width * bandRows * sizeof (pixel32));
+	if (!band)
+	{
+		SetGlobalErr (ERR_GENERIC);
+		GEcatf ("Out of Memory loading tga");
+		goto cleanup;
+	}
+
+	memset (&rle, 0, sizeof (rle));
+
+	if (compressed && !topDown)
+	{
+		// packets can cross rows so note the packet state at the start
+		// of every row then decode the rows in reverse order from there
+		marks = (TGARLEMark *) malloc (height * sizeof (TGARLEMark));
+		if (!marks)
+		{
+			SetGlobalErr (ERR_GENERIC);
+			GEcatf ("Out of Memory loading tga");
+			goto cleanup;
+		}
+
+		for (y = 0; y < height; y++)
+		{
+			marks[y].pos   = MEMFILE_Seek (mf, 0, SEEK_CUR);
+			marks[y].state = rle;
+			if (!readTGARLEPixels (&rle, NULL, width, channels, mf, pColorMap, tgaHeader.idesc))
+			{
+				goto cleanup;
+			}
+		}
+	}
+
+	for (y = 0; y < height; y += bandRows)
+	{
+		long	numRows = (height - y) < bandRows ? (height - y) : bandRows;
+		long	row;
+
+		for (row = 0; row < numRows; row++)
+		{
+			pixel32*	d       = band + row * width;
+			long		fileRow = topDown ? y + row : height - 1 - (y + row);
+
+			if (compressed)
+			{
+				if (marks)
+				{
+					MEMFILE_Seek (mf, marks[fileRow].pos, SEEK_SET);
+					rle = marks[fileRow].state;
+				}
+				if (!readTGARLEPixels (&rle, d, width, channels, mf, pColorMap, tgaHeader.idesc))
+				{
+					goto cleanup;
+				}
+			}
+			else
+			{
+				if (!topDown)
+				{
+					MEMFILE_Seek (mf, dataStart + fileRow * width * channels, SEEK_SET);
+				}
+				convertTGAPixels (d, mf->curPtr, width, channels, pColorMap, tgaHeader.idesc);
+				MEMFILE_Seek (mf, width * channels, SEEK_CUR);
+			}
+		}
+
+		if (!pfnRows (pUserData, &info, band, y, numRows))
+		{
+			goto cleanup;
+		}
+	}
+
+	result = TRUE;
+
+cleanup:
+	if (marks)
+	{
+		free (marks);
+	}
+	if (band)
+	{
+		free (band);
+	}
+	return result;
+}
+// streamTGA32Bit
+
+/*********************************************************************
+ *
+ * openTGAWriter
+ *
+ * SYNOPSIS
+ *      static int openTGAWriter (TGAWriter *w, int fh, long maxBytes)
+ *
+ * PURPOSE
+ *      Get a staging buffer for writing to fh.  It's never bigger than
+ *      TGA_WRITE_BUFFER_SIZE or the most the file can need.
+ *
+ * RETURN VALUE
+ *      TRUE on success, FALSE if out of memory (GlobalErr is set).
+ *
+*/
+static int openTGAWriter (TGAWriter *w, int fh, long maxBytes)
+{
+    w->fh     = fh;
+    w->used   = 0;
+    w->size   = maxBytes < TGA_WRITE_BUFFER_SIZE ? maxBytes : TGA_WRITE_BUFFER_SIZE;
+    w->buffer = (uint8 *)malloc (w->size);
+    if (!w->buffer)
+    {
+        SetGlobalErr (ERR_GENERIC);
+        GEcatf ("Out of memory saving tga");
+        return FALSE;
+    }
+    return TRUE;
+}
+// openTGAWriter
+
+/*********************************************************************
+ *
+ * flushTGAWriter
+ *
+ * SYNOPSIS
+ *      static void flushTGAWriter (TGAWriter *w)
+ *
+ * PURPOSE
+ *      Write out whatever is in the staging buffer.
+ *
+*/
+static void flushTGAWriter (TGAWriter *w)
+{
+    if (w->used)
+    {
+        CHK_Write (w->fh, w->buffer, w->used);
+        w->used = 0;
+    }
+}
+// flushTGAWriter
+
+/*********************************************************************
+ *
+ * reserveTGAWriter
+ *
+ * SYNOPSIS
+ *      static uint8 *reserveTGAWriter (TGAWriter *w, long bytes)
+ *
+ * PURPOSE
+ *      Make room for bytes more bytes, flushing if needed.  bytes
+ *      must not be more than the buffer size.  The caller fills them
+ *      in and adds them to w->used.
+ *
+*/
+static uint8 *reserveTGAWriter (TGAWriter *w, long bytes)
+{
+    if (w->used + bytes > w->size)
+    {
+        flushTGAWriter (w);
+    }
+    return w->buffer + w->used;
+}
+// reserveTGAWriter
+
+/*********************************************************************
+ *
+ * closeTGAWriter
+ *
+ * SYNOPSIS
+ *      static void closeTGAWriter (TGAWriter *w)
+ *
+ * PURPOSE
+ *      Flush and free the staging buffer.
+ *
+*/
+static void closeTGAWriter (TGAWriter *w)
+{
+    flushTGAWriter (w);
+    free (w->buffer);
+    w->buffer = NULL;
+}
+// closeTGAWriter
+
+/*********************************************************************
+ *
+ * writeTGARow32
+ *
+ * SYNOPSIS
+ *      static void writeTGARow32 (TGAWriter *w, const pixel32 *s, long width, int fRLE)
+ *
+ * PURPOSE
+ *      Add one row of B,G,R,A pixels to the output.  With fRLE the row
+ *      is packed into run and raw packets that don't cross the end of
+ *      the row.  A raw packet stops where the next run starts.
+ *
+*/
+static void writeTGARow32 (TGAWriter *w, const pixel32 *s, long width, int fRLE)
+{
+    while (width)
+    {
+        long     max = width < TGA_MAX_PACKET ? width : TGA_MAX_PACKET;
+        long     num;
+        uint8   *d;
+
+        if (!fRLE)
+        {
+            // a raw chunk as big as will fit
+            num = w->size / 4;
+            num = width < num ? width : num;
+            d   = reserveTGAWriter (w, num * 4);
+            PixConv_ToBGRA32 (d, s, num);
+            w->used += num * 4;
+        }
+        else if ((num = PixConv_RunLength32 (s, max)) > 1)
+        {
+            d = reserveTGAWriter (w, 1 + 4);
+            d[0] = (uint8)(0x80 | (num - 1));
+            PixConv_ToBGRA32 (d + 1, s, 1);
+            w->used += 1 + 4;
+        }
+        else
+        {
+            num = PixConv_FindRepeat32 (s, max);
+            d   = reserveTGAWriter (w, 1 + num * 4);
+            d[0] = (uint8)(num - 1);
+            PixConv_ToBGRA32 (d + 1, s, num);
+            w->used += 1 + num * 4;
+        }
+
+        s     += num;
+        width -= num;
+    }
+}
+// writeTGARow32
+
+/*********************************************************************
+ *
+ * writeTGARow8
+ *
+ * SYNOPSIS
+ *      static void writeTGARow8 (TGAWriter *w, const uint8 *s, long width, int fRLE)
+ *
+ * PURPOSE
+ *      writeTGARow32 for 8 bit pixels.
+ *
+*/
+static void writeTGARow8 (TGAWriter *w, const uint8 *s, long width, int fRLE)
+{
+    while (width)
+    {
+        long     max = width < TGA_MAX_PACKET ? width : TGA_MAX_PACKET;
+        long     num;
+        uint8   *d;
+
+        if (!fRLE)
+        {
+            num = width < w->size ? width : w->size;
+            d   = reserveTGAWriter (w, num);
+            memcpy (d, s, num);
+            w->used += num;
+        }
+        else if ((num = PixConv_RunLength8 (s, max)) > 1)
+        {
+            d = reserveTGAWriter (w, 2);
+            d[0] = (uint8)(0x80 | (num - 1));
+            d[1] = *s;
+            w->used += 2;
+        }
+        else
+        {
+            num = PixConv_FindRepeat8 (s, max);
+            d   = reserveTGAWriter (w, 1 + num);
+            d[0] = (uint8)(num - 1);
+            memcpy (d + 1, s, num);
+            w->used += 1 + num;
+        }
+
+        s     += num;
+        width -= num;
+    }
+}
+// writeTGARow8
+
 /*************************************************************************
                               saveTGA32Bit
  *************************************************************************
@@ -1128,37 +1612,46 @@ cleanup:
 int saveTGA32Bit (int fh, BlockO32BitPixels *bop)
 BEGINFUNC (saveTGA32Bit)
 {
-    static TGAHeader tgaHeader =
-    {
-    0,  //  uint8   ID;             // Byte 0
-    0,  //  uint8   ctype;          // Byte 1
-    2,  //  uint8   itype;          // Byte 2
-    0,  //  uint8   mincolorl;      // Byte 3
-    0,  //  uint8   mincolorh;      // Byte 4
-    0,  //  uint8   colorsl;        // Byte 5
-    0,  //  uint8   colorsh;        // Byte 6
-    0,  //  uint8   colorsize;      // Byte 7
-    0,  //  uint8   originxl;       // Byte 8
-    0,  //  uint8   originxh;       // Byte 9
-    0,  //  uint8   originyl;       // Byte 10
-    0,  //  uint8   originyh;       // Byte 11
-    0,  //  uint8   widthl;         // Byte 12
-    0,  //  uint8   widthh;         // Byte 13
-    0,  //  uint8   heightl;        // Byte 14
-    0,  //  uint8   heighth;        // Byte 15
-    32, //  uint8   bpp;            // Byte 16
-    0,  //  uint8   idesc;          // Byte 17
-    };
-
-    uint8 *BRGABuffer;
-
-    BRGABuffer = (uint8 *)malloc (bop->width * bop->height * 4);
-    if (!BRGABuffer)
-    {
-        SetGlobalErr (ERR_GENERIC);
-        GEcatf ("Out of memory saving tga");
-        return FALSE;
-    }
+    RETURN saveTGA32BitEx (fh, bop, FALSE);
+
+} ENDFUNC (saveTGA32Bit)
+
+/*************************************************************************
+                              saveTGA32BitEx
+ *************************************************************************
+
+   SYNOPSIS
+        int saveTGA32BitEx (int fh, BlockO32BitPixels *bop, int fRLE)
+
+   PURPOSE
+        Save a 32 bit targa, RLE compressed (type 10) if fRLE is TRUE.
+        Rows are converted straight into a staging buffer bottom row
+        first so there is no copy of the whole image and no flip, and
+        the file goes out in a few big writes.
+
+   INPUT
+        fh   : file to write to
+        bop  : picture to save
+        fRLE : TRUE to compress
+
+   RETURNS
+        TRUE on success, FALSE if out of memory.
+
+   HISTORY
+        10/17/26 : Created.
+
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+int saveTGA32BitEx (int fh, BlockO32BitPixels *bop, int fRLE)
+BEGINFUNC (saveTGA32BitEx)
+{
+    TGAHeader   tgaHeader;
+    TGAWriter   w;
+    long        y;
+
+    memset (&tgaHeader, 0, sizeof (tgaHeader));
+    tgaHeader.itype = fRLE ? 10 : 2;
+    tgaHeader.bpp   = 32;
 
     tgaHeader.widthl = (UINT8)(bop->width % 256);
     tgaHeader.widthh = (UINT8)(bop->width / 256);
@@ -1166,32 +1659,25 @@ BEGINFUNC (saveTGA32Bit)
     tgaHeader.heightl = (UINT8)(bop->height % 256);
     tgaHeader.heighth = (UINT8)(bop->height / 256);
 
-    CHK_Write (fh, &tgaHeader, sizeof (tgaHeader));
-
+    // worst case RLE is a raw packet per TGA_MAX_PACKET pixels
+    if (!openTGAWriter (&w, fh, sizeof (tgaHeader) + bop->width * bop->height * 4 + bop->height * ((bop->width + TGA_MAX_PACKET - 1) / TGA_MAX_PACKET) + 1 + TGA_MAX_PACKET * 4))
     {
-        pixel32 *s = bop->rgba;
-        uint8   *d = BRGABuffer;
-        long     count = bop->width * bop->height;
+        RETURN FALSE;
+    }
 
-        while (count)
-        {
-            *d++ = s->blue;
-            *d++ = s->green;
-            *d++ = s->red;
-            *d++ = s->alpha;
+    memcpy (reserveTGAWriter (&w, sizeof (tgaHeader)), &tgaHeader, sizeof (tgaHeader));
+    w.used += sizeof (tgaHeader);
 
-            s++;
-            count--;
-        }
+    for (y = bop->height - 1; y >= 0; y--)
+    {
+        writeTGARow32 (&w, bop->rgba + y * bop->width, bop->width, fRLE);
     }
 
-    flipBuffer (BRGABuffer, bop->width * 4, bop->height);
-    CHK_Write (fh, BRGABuffer, bop->width * bop->height * 4);
-    free (BRGABuffer);
+    closeTGAWriter (&w);
 
-    return TRUE;
+    RETURN TRUE;
 
-} ENDFUNC (saveTGA32Bit)
+} ENDFUNC (saveTGA32BitEx)
 
 /*************************************************************************
                                saveTGAGrey8Bit
@@ -1227,37 +1713,44 @@ BEGINFUNC (saveTGA32Bit)
 int saveTGAGrey8Bit (int fh, BlockOGrey8BitPixels *bop)
 BEGINFUNC (saveTGAGrey8Bit)
 {
-    static TGAHeader tgaHeader =
-    {
-    0,  //  uint8   ID;             // Byte 0
-    0,  //  uint8   ctype;          // Byte 1
-    3,  //  uint8   itype;          // Byte 2 -- uncompressed 8bit greyscale
-    0,  //  uint8   mincolorl;      // Byte 3
-    0,  //  uint8   mincolorh;      // Byte 4
-    0,  //  uint8   colorsl;        // Byte 5
-    0,  //  uint8   colorsh;        // Byte 6
-    0,  //  uint8   colorsize;      // Byte 7
-    0,  //  uint8   originxl;       // Byte 8
-    0,  //  uint8   originxh;       // Byte 9
-    0,  //  uint8   originyl;       // Byte 10
-    0,  //  uint8   originyh;       // Byte 11
-    0,  //  uint8   widthl;         // Byte 12
-    0,  //  uint8   widthh;         // Byte 13
-    0,  //  uint8   heightl;        // Byte 14
-    0,  //  uint8   heighth;        // Byte 15
-    8,  //  uint8   bpp;            // Byte 16
-    0,  //  uint8   idesc;          // Byte 17
-    };
-
-    uint8 *buffer;
-
-    buffer = (uint8 *)malloc (bop->width * bop->height);
-    if (!buffer)
-    {
-        SetGlobalErr (ERR_GENERIC);
-        GEcatf ("Out of memory saving tga");
-        return FALSE;
-    }
+    RETURN saveTGAGrey8BitEx (fh, bop, FALSE);
+
+} ENDFUNC (saveTGAGrey8Bit)
+
+/*************************************************************************
+                              saveTGAGrey8BitEx
+ *************************************************************************
+
+   SYNOPSIS
+        int saveTGAGrey8BitEx (int fh, BlockOGrey8BitPixels *bop, int fRLE)
+
+   PURPOSE
+        Save a greyscale targa, RLE compressed (type 11) if fRLE is
+        TRUE.  See saveTGA32BitEx.
+
+   INPUT
+        fh   : file to write to
+        bop  : picture to save
+        fRLE : TRUE to compress
+
+   RETURNS
+        TRUE on success, FALSE if out of memory.
+
+   HISTORY
+        10/17/26 : Created.
+
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+int saveTGAGrey8BitEx (int fh, BlockOGrey8BitPixels *bop, int fRLE)
+BEGINFUNC (saveTGAGrey8BitEx)
+{
+    TGAHeader   tgaHeader;
+    TGAWriter   w;
+    long        y;
+
+    memset (&tgaHeader, 0, sizeof (tgaHeader));
+    tgaHeader.itype = fRLE ? 11 : 3;
+    tgaHeader.bpp   = 8;
 
     tgaHeader.widthl = (UINT8)(bop->width % 256);
     tgaHeader.widthh = (UINT8)(bop->width / 256);
@@ -1265,15 +1758,23 @@ BEGINFUNC (saveTGAGrey8Bit)
     tgaHeader.heightl = (UINT8)(bop->height % 256);
     tgaHeader.heighth = (UINT8)(bop->height / 256);
 
-    CHK_Write (fh, &tgaHeader, sizeof (tgaHeader));
+    if (!openTGAWriter (&w, fh, sizeof (tgaHeader) + bop->width * bop->height + bop->height * ((bop->width + TGA_MAX_PACKET - 1) / TGA_MAX_PACKET) + 1 + TGA_MAX_PACKET))
+    {
+        RETURN FALSE;
+    }
 
-    memcpy (buffer, bop->pixels, bop->width * bop->height);
-    flipBuffer (buffer, bop->width * 1, bop->height);
-    CHK_Write (fh, buffer, bop->width * bop->height * 1);
-    free (buffer);
+    memcpy (reserveTGAWriter (&w, sizeof (tgaHeader)), &tgaHeader, sizeof (tgaHeader));
+    w.used += sizeof (tgaHeader);
+
+    for (y = bop->height - 1; y >= 0; y--)
+    {
+        writeTGARow8 (&w, bop->pixels + y * bop->width, bop->width, fRLE);
+    }
+
+    closeTGAWriter (&w);
 
     RETURN TRUE;
 
-} ENDFUNC (saveTGAGrey8Bit)
+} ENDFUNC (saveTGAGrey8BitEx)
 
 
@@ -80,9 +80,13 @@ extern "C" {
 /************************** P R O T O T Y P E S **************************/
 
 extern int loadTGA32Bit (BlockO32BitPixels *bop, MEMFILE *mf);
+extern int loadTGAInfo (PictureInfo *pInfo, MEMFILE *mf);
+extern int streamTGA32Bit (MEMFILE *mf, long bandRows, PFNPICTUREROWS pfnRows, void *pUserData);
 extern int saveTGA32Bit (int fh, BlockO32BitPixels *bop);
+extern int saveTGA32BitEx (int fh, BlockO32BitPixels *bop, int fRLE);
 extern int loadTGAGrey8Bit (BlockOGrey8BitPixels *bop, MEMFILE *mf);
 extern int saveTGAGrey8Bit (int fh, BlockOGrey8BitPixels *bop);
+extern int saveTGAGrey8BitEx (int fh, BlockOGrey8BitPixels *bop, int fRLE);
 
 #ifdef __cplusplus
 }
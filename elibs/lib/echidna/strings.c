@@ -344,7 +344,7 @@ int strnicmp (const char *s1, const char *s2, size_t len)
 /**# MODULE:STRINGS_strupr                                                */
 /*------------------------------------------------------------------------*/
 
-#if AZTEC_C	|| _EL_CC_SGIC__
+#if AZTEC_C	|| _EL_CC_SGIC__ || _EL_CC_GCC__
 char *strupr (char *s)
 {
     register char *h = s;
@@ -361,7 +361,7 @@ char *strupr (char *s)
 /**# MODULE:STRINGS_strlwr                                                */
 /*------------------------------------------------------------------------*/
 
-#if AZTEC_C	|| _EL_CC_SGIC__
+#if AZTEC_C	|| _EL_CC_SGIC__ || _EL_CC_GCC__
 char *strlwr (char *s)
 {
     register char *h = s;
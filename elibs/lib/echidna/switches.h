@@ -53,6 +53,7 @@
 
 #define	EL_DEBUG_MESSAGES	0	// dmbess.h
 #define	EL_DEBUG_MEMORY	0	// memsafe.h
+#define	EL_USE_SIMD		1	// pixconv.c
 
 #endif /* SWITCHES_H */
 
@@ -53,8 +53,8 @@
 
 #include "platform.h"
 #include "switches.h"
-#include "echidna\ensure.h"
-#include "echidna\utils.h"
+#include "echidna/ensure.h"
+#include "echidna/utils.h"
 
 /*************************** C O N S T A N T S ***************************/
 
@@ -69,6 +69,7 @@
 #include <echidna\memsafe.h>
 #include <echidna\utils.h>
 #include <echidna\dbmess.h>
+#include <echidna\planar.h>
 
 /*************************** C O N S T A N T S ***************************/
 
@@ -83,6 +84,7 @@ typedef enum {
    dmMaxex
 } DITHERMETHOD;
 
+// Same order as the PLANAR_KEY_??? kinds
 typedef enum {
    tkNone,     // No transparency in this image
    tkAlphaLow,  // Transparent if Alpha below given threshhold
@@ -105,20 +107,6 @@ typedef enum {
 
 /************************** P R O T O T Y P E S **************************/
 
-void ReduceWithNoDither (
-   RGBADATA *prgbadataNew, 
-   RGBADATA *prgbadataOld, 
-   int Width, 
-   int Height
-);
-
-void ReduceWithErrorPropagationDither (
-   RGBADATA *prgbadataNew, 
-   RGBADATA *prgbadataOld, 
-   int Width, 
-   int Height
-);
-
 void ReduceWithOrderedDither (
    RGBADATA *prgbadataNew, 
    RGBADATA *prgbadataOld, 
@@ -134,18 +122,6 @@ void WriteRaw16 (
    TRANSPARENCYRAW tr
 );
 
-void DetermineTransparency (
-   RGBADATA *prgbadataNew, 
-   RGBADATA *prgbadataOld, 
-   int Width, 
-   int Height,
-   TRANSPARENCYKIND tk,
-   UINT8 Alpha,
-   UINT8 Red,
-   UINT8 Green,
-   UINT8 Blue
-);
-
 /***************************** G L O B A L S *****************************/
 
 
@@ -253,8 +229,8 @@ BEGINFUNCMAIN(main)
       GFF	*pgff;
       DITHERMETHOD   dmDither;      
       TRANSPARENCYKIND tkTransparency;    // What kind of transparency to use.
-      int RedT, GreenT,BlueT;             // Transparency RGB values.
-      int AlphaT;                         // Transparency Alpha threshhold.
+      int RedT = 0, GreenT = 0, BlueT = 0;  // Transparency RGB values.
+      int AlphaT = 0;                     // Transparency Alpha threshhold.
       TRANSPARENCYRAW trTransparency;     // How to handle transparency flag in raw output
 
       trTransparency = (ARG(PixelOut)) ? (TRANSPARENCYRAW) atoi (ARG(PixelOut)) : trNone0;
@@ -296,8 +272,6 @@ BEGINFUNCMAIN(main)
       else
       {
          CHUNKNODE *pchunknodeRGBA;
-         CHUNKNODE *pchunknodeRGBANew;
-         CHUNKRGBA *pchunkrgbaNew;
          RGBADATA *prgbadataOld;
          RGBADATA *prgbadataNew;
          int Width, Height;
@@ -320,43 +294,73 @@ BEGINFUNCMAIN(main)
          }
          
          
-         /* Make new chunk for new image */
-         pchunknodeRGBANew = CreateGFFChunkNodeNoFail (IDRGBA, 
-            (sizeof(RGBADATA) * Width * Height));
-         pchunkrgbaNew = (CHUNKRGBA *)pchunknodeRGBANew->pchunk;
-         prgbadataNew = &pchunkrgbaNew->Data;
+         /* Reduce in place, the image is already in the buffer it was read into */
+         prgbadataNew = prgbadataOld;
 
+         /*
+         ** The transparency test and the reductions are done on a
+         ** planar copy of the image with the Planar_??? filters.
+         */
+         {
+            PlanarImage piImage;
+            PlanarKey   key;
+            BOOL        fReduced;
 
-         DetermineTransparency (prgbadataNew, prgbadataOld, Width, Height,
-                  tkTransparency, AlphaT, RedT, GreenT, BlueT);
-         
+            if (!Planar_Create (&piImage, Width, Height))
+            {
+               EL_printf ("ERROR: %s\n", GlobalErrMsg);
+               RETURN EXIT_FAILURE;
+            }
+            Planar_FromRGBA (&piImage, (uint8 *)prgbadataOld);
+
+            // Set alpha to 0 for transparent pixels and 255 for opaque ones.
+            key.kind  = (int)tkTransparency;
+            key.alpha = (uint8)AlphaT;
+            key.red   = (uint8)RedT;
+            key.green = (uint8)GreenT;
+            key.blue  = (uint8)BlueT;
+            Planar_AlphaTest (&piImage, &piImage, &key);
+
+            fReduced = TRUE;
+            switch (dmDither) {
+            case dmNone:
+               Planar_Reduce555 (&piImage, &piImage);
+               break;
+            case dmErrorPropagation:
+               fReduced = Planar_Dither555 (&piImage, &piImage);
+               break;
+            case dmOrdered:
+               // Done on the RGBA data below.
+               break;
+            default:
+               ENSURE_ (FALSE, "Illegal Dither method value\n");
+               break;
+            }
+
+            if (fReduced)
+            {
+               Planar_ToRGBA ((uint8 *)prgbadataNew, &piImage);
+            }
+            Planar_Destroy (&piImage);
+            if (!fReduced)
+            {
+               EL_printf ("ERROR: %s\n", GlobalErrMsg);
+               RETURN EXIT_FAILURE;
+            }
+         }
 
-         switch (dmDither) {
-         case dmNone:
-            ReduceWithNoDither (prgbadataNew, prgbadataOld, Width, Height);
-            break;
-         case dmErrorPropagation:
-            ReduceWithErrorPropagationDither (prgbadataNew, prgbadataOld, Width, Height);
-            break;
-         case dmOrdered:
+         if (dmOrdered == dmDither)
+         {
             ReduceWithOrderedDither (prgbadataNew, prgbadataOld, Width, Height);
-            break;
-         default:
-            ENSURE_ (FALSE, "Illegal Dither method value\n");
-            break;
          }
          
-         LST_Remove (pchunknodeRGBA);
-         DestroyGFFChunkNode (pchunknodeRGBA);
-         LST_AddTail (pgff->plistChunkNodes, pchunknodeRGBANew);
-         
          if (ARG(Raw))
          {
             WriteRaw16(prgbadataNew, ARG(OutFile), Width, Height, trTransparency);  
          }
          else
          {
-            WriteGFF (ARG(OutFile), pgff);      
+            WriteGFFEx (ARG(OutFile), pgff, GFFWRITE_COMPRESS);      
          }
       }
    }
@@ -525,288 +529,6 @@ BEGINPROC (WriteRaw16)
 } ENDPROC (WriteRaw16)
   
 
-/*************************************************************************
-                           ReduceWithNoDither                            
- *************************************************************************
-
-   SYNOPSIS
-		void ReduceWithNoDither (
-		   RGBADATA *prgbadataNew, 
-		   RGBADATA *prgbadataOld, 
-		   int Width, 
-		   int Height
-		)
-
-   PURPOSE
-  		
-  
-   INPUT
-		prgbadataNew :
-		prgbadataOld :
-		Width        :
-		Height       :
-  
-   OUTPUT
-		None  
-  
-   EFFECTS
-		None  
-  
-   SEE ALSO
-  
-  
-   HISTORY
-		11/06/96 : Created.
-  
- * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
-
-void ReduceWithNoDither (
-   RGBADATA *prgbadataNew, 
-   RGBADATA *prgbadataOld, 
-   int Width, 
-   int Height
-)
-BEGINPROC (ReduceWithNoDither)
-{
-   int x, y;
-   RGBADATA *prgbadataSrc, *prgbadataDst;
-   
-   for (y = Height, 
-         prgbadataSrc = prgbadataOld,
-         prgbadataDst = prgbadataNew;
-         y; 
-         y--
-   )
-   {
-      for (x = Width; x; x--)
-      {
-      
-         /* Copy value, round up lower 3 bits if won't overflow, then truncate */
-         prgbadataDst->Red = prgbadataSrc->Red;
-         if ((prgbadataDst->Red & 0xF8) < 0xF8) prgbadataDst->Red += 4;
-         prgbadataDst->Red &= 0xF8;
-         
-         prgbadataDst->Green = prgbadataSrc->Green;
-         if ((prgbadataDst->Green & 0xF8) < 0xF8) prgbadataDst->Green += 4;
-         prgbadataDst->Green &= 0xF8;
-         
-         prgbadataDst->Blue = prgbadataSrc->Blue;
-         if ((prgbadataDst->Blue & 0xF8) < 0xF8) prgbadataDst->Blue += 4;
-         prgbadataDst->Blue &= 0xF8;
-         
-         ++prgbadataSrc;
-         ++prgbadataDst;
-      }
-   }
-   
-} ENDPROC (ReduceWithNoDither)
-
-/*************************************************************************
-                     ReduceWithErrorPropagationDither                     
- *************************************************************************
-
-   SYNOPSIS
-		void ReduceWithErrorPropagationDither (
-		   RGBADATA *prgbadataNew, 
-		   RGBADATA *prgbadataOld, 
-		   int Width, 
-		   int Height
-		)
-
-   PURPOSE
-  		
-  
-   INPUT
-		prgbadataNew :
-		prgbadataOld :
-		Width        :
-		Height       :
-  
-   OUTPUT
-		None  
-  
-   EFFECTS
-		None  
-  
-   SEE ALSO
-  
-  
-   HISTORY
-		11/06/96 : Created.
-  
- * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
-// Pixel error tracking struct.
-typedef struct {
-   float Red;
-   float Green;
-   float Blue;
-} ERRPIX; 
-
-void ReduceWithErrorPropagationDither (
-   RGBADATA *prgbadataNew, 
-   RGBADATA *prgbadataOld, 
-   int Width, 
-   int Height
-)
-BEGINPROC (ReduceWithErrorPropagationDither)
-{
-#define NUM_COLOR_COMPONENTS_PER_PIXEL 3
-#define ERRTYPE   INT32
-#define ErrValOfU8(v)   (INT32)((UINT32)(v) << 16)
-#define U8OfErrVal(v)   (UINT8) ( ((UINT32)(v) >> 16) | ((v&0x80000000) ? 0xFFFF0000 : 0) )
-#define ERR_4_POINT_0   (0x040000)
-
-   int x, y;
-   UINT8 *pu8ComponentSrc, *pu8ComponentDst;
-   ERRTYPE *prErr, *prErrNextRow; // fixed point 8.8
-   ERRTYPE *prErrBuff;             // Buffer for tracking error values for each color component.
-   UINT32 NumPixels;
-   UINT32 NumErrs;
-   UINT32 SizeOfErrBuff;
-   
-   /*
-   ** Allocate buffer for tracking error values of the color components 
-   */
-   NumPixels = ((UINT32)Width * (UINT32)Height);
-   NumErrs = NumPixels * NUM_COLOR_COMPONENTS_PER_PIXEL;
-   SizeOfErrBuff =  NumErrs * sizeof (ERRTYPE);
-   MEM_CallocMemNoFail(prErrBuff, SizeOfErrBuff);
-   
-   /* Process the pixels */
-   for ( 
-      y = Height, 
-         prErr = prErrBuff,
-         prErrNextRow = prErrBuff + (Width * NUM_COLOR_COMPONENTS_PER_PIXEL),
-         pu8ComponentSrc = &prgbadataOld->Red,
-         pu8ComponentDst = &prgbadataNew->Red;
-      y; 
-      y--
-   )
-   {
-      for (x = Width; x; x--)
-      {
-         int c; // component index 1..3
-         
-         // Is it a Transparent pixels
-         if (0 == pu8ComponentDst[3])
-         { // Then skip it.
-            pu8ComponentSrc += 4;
-            pu8ComponentDst += 4;
-            prErr += NUM_COLOR_COMPONENTS_PER_PIXEL;
-            prErrNextRow +=NUM_COLOR_COMPONENTS_PER_PIXEL;
-            continue;
-         }
-         
-         for (
-            c = NUM_COLOR_COMPONENTS_PER_PIXEL; 
-            c; 
-            c--,
-               pu8ComponentSrc++,
-               pu8ComponentDst++,
-               prErr++,
-               prErrNextRow++
-         )
-         {
-            ERRTYPE rValue;
-            UINT8 u8Value;
-            
-            rValue = ErrValOfU8(*pu8ComponentSrc) + *prErr;
-            if (rValue < ErrValOfU8(0))
-            {
-               u8Value = 0;
-            }
-            else if (rValue > ErrValOfU8(0xF8))
-            {
-               u8Value = 0xF8;
-            }
-            else
-            {
-               /* Round up to highest 5 bits */
-               rValue = (rValue + ERR_4_POINT_0);  // add 4.5 to round up to high 5 bits.
-               u8Value = U8OfErrVal(rValue);
-            }
-            *pu8ComponentDst = u8Value & 0xF8; // Take only the high five bits
-         
-            /*
-            ** Calculate and distribute the error to neighboring 4 pixels that 
-            ** have not already been processed.  See diagram below of relevant 
-            ** 3x2 pixel area.  
-            */
-            //                x = Already processed pixel.x
-            //       +-+-+-+  * = Current pixel being processed.
-            //       |x|*|1|  1 = Unprocessed pixel which get 7/16 of error.
-            //       +-+-+-+  2 = Unprocessed pixel which get 3/16 of error.
-            //       |2|3|4|  3 = Unprocessed pixel which get 5/16 of error.
-            //       +-+-+-+  4 = Unprocessed pixel which get 1/16 of error.
-            //                # = Not part of image. Off edge. (This symbol used below). 
-            {
-               ERRTYPE rError;
-               int icase;
-               
-               rError = ErrValOfU8((int)*pu8ComponentSrc - (int)*pu8ComponentDst);
-               
-               // Case statement makes sure not to assign values off bottom, left or right edges of image.
-               //      Right Edge?     Left Edge?          Bottom Edge?
-               icase = ((1==x) << 2) | ((Width==x) << 1) | (1==y);
-               switch (icase) { 
-               case 0: // Current pixel not on any edge of image
-                  prErr[NUM_COLOR_COMPONENTS_PER_PIXEL]         += rError * 7/16;   //       +-+-+-+
-                  prErrNextRow[-NUM_COLOR_COMPONENTS_PER_PIXEL] += rError * 3/16;   //       |x|*|1|
-                  prErrNextRow[0]                               += rError * 5/16;   //       +-+-+-+
-                  prErrNextRow[NUM_COLOR_COMPONENTS_PER_PIXEL]  += rError * 1/16;   //       |2|3|4|
-                  break;                                                            //       +-+-+-+
-               case 1: // Current pixel on bottom edge of image.
-                  prErr[NUM_COLOR_COMPONENTS_PER_PIXEL]         += rError * 7/16;   //       +-+-+-+
-                  //prErrNextRow[-NUM_COLOR_COMPONENTS_PER_PIXEL] += rError * 3/16; //       |x|*|1|
-                  //prErrNextRow[0]                               += rError * 5/16; //       +-+-+-+
-                  //prErrNextRow[NUM_COLOR_COMPONENTS_PER_PIXEL]  += rError * 1/16; //       |#|#|#|
-                  break;                                                            //       +-+-+-+
-               case 2: // Current pixel on left edge of image.
-                  prErr[NUM_COLOR_COMPONENTS_PER_PIXEL]         += rError * 7/16;   //       +-+-+-+
-                  //prErrNextRow[-NUM_COLOR_COMPONENTS_PER_PIXEL] += rError * 3/16; //       |#|*|1| 
-                  prErrNextRow[0]                               += rError * 5/16;   //       +-+-+-+ 
-                  prErrNextRow[NUM_COLOR_COMPONENTS_PER_PIXEL]  += rError * 1/16;   //       |#|3|4| 
-                  break;                                                            //       +-+-+-+ 
-               case 3: // Current pixel on bottom left corner of image.
-                  prErr[NUM_COLOR_COMPONENTS_PER_PIXEL]         += rError * 7/16;   //       +-+-+-+
-                  //prErrNextRow[-NUM_COLOR_COMPONENTS_PER_PIXEL] += rError * 3/16; //       |#|*|1| 
-                  //prErrNextRow[0]                               += rError * 5/16; //       +-+-+-+ 
-                  //prErrNextRow[NUM_COLOR_COMPONENTS_PER_PIXEL]  += rError * 1/16; //       |#|#|#| 
-                  break;                                                            //       +-+-+-+ 
-               case 4: // Current pixel on right edge of image.
-                  //prErr[NUM_COLOR_COMPONENTS_PER_PIXEL]         += rError * 7/16; //       +-+-+-+
-                  prErrNextRow[-NUM_COLOR_COMPONENTS_PER_PIXEL] += rError * 3/16;   //       |x|*|#| 
-                  prErrNextRow[0]                               += rError * 5/16;   //       +-+-+-+ 
-                  //prErrNextRow[NUM_COLOR_COMPONENTS_PER_PIXEL]  += rError * 1/16; //       |2|3|#| 
-                  break;                                                            //       +-+-+-+ 
-               case 5: // Current pixel on bottom right corner of image.   
-                  //prErr[NUM_COLOR_COMPONENTS_PER_PIXEL]         += rError * 7/16; //       +-+-+-+
-                  //prErrNextRow[-NUM_COLOR_COMPONENTS_PER_PIXEL] += rError * 3/16; //       |x|*|#| 
-                  //prErrNextRow[0]                               += rError * 5/16; //       +-+-+-+ 
-                  //prErrNextRow[NUM_COLOR_COMPONENTS_PER_PIXEL]  += rError * 1/16; //       |#|#|#| 
-                  break;                                                            //       +-+-+-+ 
-               case 6:
-                  ENSURE(FALSE); // impossible case. x cannot be 1 and Width at same time.
-                  break;
-               case 7:
-                  ENSURE(FALSE); // impossible case. x cannot be 1 and Width at same time.
-                  break;
-               }
-            }
-         } // End Component loop
-         
-         /* skip over the alpha component */
-         ++pu8ComponentDst;
-         ++pu8ComponentSrc;
-         
-      } // End x loop
-      
-   } // End y loop
-   
-   MEM_FreeMem (prErrBuff);
-
-} ENDPROC (ReduceWithErrorPropagationDither)
-
 /*************************************************************************
                          ReduceWithOrderedDither                         
  *************************************************************************
@@ -894,113 +616,3 @@ BEGINPROC (ReduceWithOrderedDither)
 
 
 } ENDPROC (ReduceWithOrderedDither)
- 
-/*************************************************************************
-                          DetermineTransparency                          
- *************************************************************************
-
-   SYNOPSIS
-		void DetermineTransparency (
-		   RGBADATA *prgbadataNew, 
-		   RGBADATA *prgbadataOld, 
-		   int Width, 
-		   int Height,
-		   TRANSPARENCYKIND tk,
-		   UINT8 Alpha,
-		   UINT8 Red,
-		   UINT8 Green,
-		   UINT8 Blue
-		)
-
-   PURPOSE
-  		Set the alpha values in the new rgb chunk to 0 for transparent pixels
-      and 255 for opaque pixels, based on transparency criteria.
-  
-   INPUT
-		prgbadataNew :
-		prgbadataOld :
-		Width        :
-		Height       :
-		tk           :
-		Alpha        :
-		Red          :
-		Green        :
-		Blue         :
-  
-   OUTPUT
-		None  
-  
-   EFFECTS
-		None  
-  
-   SEE ALSO
-  
-  
-   HISTORY
-		11/07/96 : Created.
-  
- * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
-
-void DetermineTransparency (
-   RGBADATA *prgbadataNew, 
-   RGBADATA *prgbadataOld, 
-   int Width, 
-   int Height,
-   TRANSPARENCYKIND tk,
-   UINT8 Alpha,
-   UINT8 Red,
-   UINT8 Green,
-   UINT8 Blue
-)
-BEGINPROC (DetermineTransparency)
-{
-   int x, y;
-   UINT8 c = 0;
-   RGBADATA *prgbadataSrc, *prgbadataDst;
-   
-   for (
-      y = Height, 
-         prgbadataSrc = prgbadataOld,
-         prgbadataDst = prgbadataNew;
-      y; 
-      y--
-   )
-   {
-      for (
-         x = Width; 
-         x; 
-         x--,
-         prgbadataSrc++,
-         prgbadataDst++
-            
-      )
-      {
-      
-         prgbadataDst->Alpha = 255; // assume opaque
-         switch (tk) {
-         case tkNone:
-            break;
-         case tkAlphaLow:
-            if (prgbadataSrc->Alpha <= Alpha)
-            {
-               prgbadataDst->Alpha = 0;
-            }
-            break;
-         case tkAlphaHigh:
-            if (prgbadataSrc->Alpha >= Alpha) 
-            {
-               prgbadataDst->Alpha = 0;
-            }
-            break;
-         case tkRGB:
-            if (prgbadataSrc->Red == Red && prgbadataSrc->Green == Green && prgbadataSrc->Blue == Blue) 
-            {
-               prgbadataDst->Alpha = 0;
-            }
-            break;
-         }
-      }
-   }
-
-} ENDPROC (DetermineTransparency)
- 
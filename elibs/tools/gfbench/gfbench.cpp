@@ -0,0 +1,1382 @@
+/*************************************************************************
+ *                                                                       *
+ *                              GFBENCH.CPP                              *
+ *                                                                       *
+ *************************************************************************
+
+		Copyright (c) 1996-2008, Echidna
+
+		All rights reserved.
+
+		Redistribution and use in source and binary forms, with or
+		without modification, are permitted provided that the following
+		conditions are met:
+
+		* Redistributions of source code must retain the above copyright
+		  notice, this list of conditions and the following disclaimer.
+		* Redistributions in binary form must reproduce the above copyright
+		  notice, this list of conditions and the following disclaimer
+		  in the documentation and/or other materials provided with the
+		  distribution.
+
+		THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+		CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+		INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+		MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+		DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+		BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+		EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+		TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+		DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+		ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+		OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+		OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+		POSSIBILITY OF SUCH DAMAGE.
+
+
+   DESCRIPTION
+		Times the picture loaders and savers.  Makes a synthetic picture,
+		writes it out in every format and depth the loaders read (tga
+		raw and rle at 8/16/24/32 bits, pcx, psd, pic, gff) and then
+		decodes each of those from memory over and over.  The savers
+		are timed writing to a file in the -D directory.
+
+		Reports MB/s of file data and millions of pixels a second.
+
+		With -C the pic files are also read with the pic reader the
+		library had before it decoded whole pixels at a time, to see
+		what that change bought, and both readers must give the same
+		pixels.  It also checks a gff read with GFFREAD_LAZY can be
+		written back over the file it was read from.
+
+		On Linux build it with "make -f MAKEFILE.LNX".
+
+   PROGRAMMERS
+
+
+   FUNCTIONS
+
+   TABS : 4 7
+
+   HISTORY
+		10/17/26 : Created.
+
+ *************************************************************************/
+
+/**************************** I N C L U D E S ****************************/
+
+#include "platform.h"
+#include "switches.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <echidna/ensure.h>
+
+#include <echidna/argparse.h>
+#include <echidna/readgfx.h>
+#include <echidna/eerrors.h>
+#include <echidna/eio.h>
+#include <echidna/checkglu.h>
+#include <echidna/gff.h>
+#include <echidna/memfile.h>
+#include <echidna/ethread.h>
+
+// the per format loaders and savers aren't in the public headers
+#include "readtga.h"
+#include "readpcx.h"
+#include "readpic.h"
+#include "photoshp.h"
+#include "picpool.h"
+
+#if _EL_OS_WIN32__
+	#include <windows.h>
+#else
+	#include <time.h>
+#endif
+
+/*************************** C O N S T A N T S ***************************/
+
+// the synthetic picture alternates flat spans, which compress, with
+// spans that change every pixel, which don't
+#define BENCH_SPAN_WIDTH   24
+#define BENCH_SPAN_HEIGHT  16
+
+// every case runs at least this many times however long it takes
+#define BENCH_MIN_RUNS     3
+
+#define BENCH_TEMP_NAME    "gfbench.tmp"
+#define BENCH_GFF_NAME     "gfbench.gff"
+
+/******************************* T Y P E S *******************************/
+
+/*
+ * A growable block of bytes the corpus files are built in
+ */
+typedef struct {
+   uint8 *pData;
+   long   size;
+   long   maxSize;
+} BENCHBUF;
+
+/*
+ * The picture everything is made from, as 8 bit indices into a
+ * palette and as 32 bit pixels.
+ */
+typedef struct {
+   BlockO32BitPixels   bop;
+   BlockO8BitPixels    bop8;
+} BENCHPIC;
+
+typedef int (*PFNLOAD32) (BlockO32BitPixels *bop, MEMFILE *mf);
+
+/*
+ * One file in the corpus and the loader that reads it
+ */
+typedef struct {
+   const char *pszName;
+   PFNLOAD32   pfnLoad;
+   uint8      *pData;
+   long        size;
+   MEMFILE    *mf;     // if pData came from reading back a saved file
+} LOADCASE;
+
+typedef int (*PFNSAVE) (int fh, BENCHPIC *pbp);
+
+typedef struct {
+   const char *pszName;
+   PFNSAVE     pfnSave;
+} SAVECASE;
+
+/*
+ * What a timed case did
+ */
+typedef struct {
+   double   best;       // fastest run in seconds
+   double   total;      // all runs in seconds
+   long     runs;
+} BENCHTIME;
+
+typedef int (*PFNBENCHRUN) (void *pUserData);
+
+/************************** P R O T O T Y P E S **************************/
+
+
+/***************************** G L O B A L S *****************************/
+
+
+/****************************** M A C R O S ******************************/
+
+
+/**************************** R O U T I N E S ****************************/
+
+/*********************************************************************
+ *
+ * benchSeconds
+ *
+ * SYNOPSIS
+ *		static double benchSeconds (void)
+ *
+ * PURPOSE
+ *		A high resolution clock for timing.  Only differences mean
+ *		anything.
+ *
+*/
+static double benchSeconds (void)
+{
+#if _EL_OS_WIN32__
+   LARGE_INTEGER  count;
+   LARGE_INTEGER  freq;
+
+   QueryPerformanceCounter (&count);
+   QueryPerformanceFrequency (&freq);
+
+   return (double)count.QuadPart / (double)freq.QuadPart;
+#else
+   struct timespec   ts;
+
+   clock_gettime (CLOCK_MONOTONIC, &ts);
+
+   return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+#endif
+}
+// benchSeconds
+
+/*********************************************************************
+ *
+ * runTimed
+ *
+ * SYNOPSIS
+ *		static void runTimed (BENCHTIME *pbt, PFNBENCHRUN pfnRun, void *pUserData, double minSeconds)
+ *
+ * PURPOSE
+ *		Call pfnRun until it has been at it for minSeconds and at
+ *		least BENCH_MIN_RUNS times.  Exits if pfnRun fails.
+ *
+*/
+static void runTimed (BENCHTIME *pbt, PFNBENCHRUN pfnRun, void *pUserData, double minSeconds)
+{
+   pbt->best  = 0.0;
+   pbt->total = 0.0;
+   pbt->runs  = 0;
+
+   while (pbt->runs < BENCH_MIN_RUNS || pbt->total < minSeconds)
+   {
+      double   start;
+      double   elapsed;
+
+      start   = benchSeconds ();
+      if (!pfnRun (pUserData))
+      {
+         EL_printf ("ERROR: %s\n", GlobalErrMsg);
+         exit (EXIT_FAILURE);
+      }
+      elapsed = benchSeconds () - start;
+
+      if (!pbt->runs || elapsed < pbt->best)
+      {
+         pbt->best = elapsed;
+      }
+      pbt->total += elapsed;
+      pbt->runs++;
+   }
+}
+// runTimed
+
+/*********************************************************************
+ *
+ * printTimed
+ *
+ * SYNOPSIS
+ *		static void printTimed (const char *pszName, const BENCHTIME *pbt, long bytes, long pixels)
+ *
+ * PURPOSE
+ *		Print a line of results.  The rates are from the fastest run,
+ *		that's the one with the least noise from everything else the
+ *		machine was doing.
+ *
+*/
+static void printTimed (const char *pszName, const BENCHTIME *pbt, long bytes, long pixels)
+{
+   double   best = pbt->best > 0.0 ? pbt->best : 1e-9;
+   char     szLine[256];
+
+   // EL_printf doesn't pad everywhere
+   sprintf (szLine, "%-22s %9ld %6ld %9.3f %9.1f %9.1f",
+      pszName,
+      (bytes + 1023) / 1024,
+      pbt->runs,
+      best * 1000.0,
+      (double)bytes / best / (1024.0 * 1024.0),
+      (double)pixels / best / 1e6);
+   EL_printf ("%s\n", szLine);
+}
+// printTimed
+
+/*********************************************************************
+ *
+ * bufPut
+ *
+ * SYNOPSIS
+ *		static void bufPut (BENCHBUF *pbb, const void *pData, long size)
+ *
+ * PURPOSE
+ *		Append bytes to a BENCHBUF.
+ *
+*/
+static void bufPut (BENCHBUF *pbb, const void *pData, long size)
+{
+   if (pbb->size + size > pbb->maxSize)
+   {
+      long  newSize = pbb->maxSize * 2 + size + 4096;
+
+      pbb->pData   = (uint8 *)realloc (pbb->pData, newSize);
+      pbb->maxSize = newSize;
+      if (!pbb->pData)
+      {
+         EL_printf ("ERROR: Out of memory building test files\n");
+         exit (EXIT_FAILURE);
+      }
+   }
+   memcpy (pbb->pData + pbb->size, pData, size);
+   pbb->size += size;
+}
+// bufPut
+
+static void bufByte (BENCHBUF *pbb, int value)
+{
+   uint8 b = (uint8)value;
+
+   bufPut (pbb, &b, 1);
+}
+
+static void bufLSBF16 (BENCHBUF *pbb, int value)
+{
+   bufByte (pbb, value);
+   bufByte (pbb, value >> 8);
+}
+
+static void bufMSBF16 (BENCHBUF *pbb, int value)
+{
+   bufByte (pbb, value >> 8);
+   bufByte (pbb, value);
+}
+
+static void bufMSBF32 (BENCHBUF *pbb, UINT32 value)
+{
+   bufMSBF16 (pbb, (int)(value >> 16));
+   bufMSBF16 (pbb, (int)(value & 0xFFFF));
+}
+
+/*********************************************************************
+ *
+ * runLength
+ *
+ * SYNOPSIS
+ *		static long runLength (const uint8 *p, long count, int pixelSize, long maxRun)
+ *
+ * PURPOSE
+ *		How many of the count pixelSize byte pixels at p are the same
+ *		as the first, up to maxRun.
+ *
+*/
+static long runLength (const uint8 *p, long count, int pixelSize, long maxRun)
+{
+   long  run = 1;
+
+   if (count > maxRun)
+   {
+      count = maxRun;
+   }
+   while (run < count && !memcmp (p, p + run * pixelSize, pixelSize))
+   {
+      run++;
+   }
+
+   return run;
+}
+// runLength
+
+/*********************************************************************
+ *
+ * rawLength
+ *
+ * SYNOPSIS
+ *		static long rawLength (const uint8 *p, long count, int pixelSize, long maxRaw)
+ *
+ * PURPOSE
+ *		How many of the count pixels at p to store as is before a run
+ *		starts, up to maxRaw.  At least 1.
+ *
+*/
+static long rawLength (const uint8 *p, long count, int pixelSize, long maxRaw)
+{
+   long  raw = 1;
+
+   if (count > maxRaw)
+   {
+      count = maxRaw;
+   }
+   while (raw < count && runLength (p + raw * pixelSize, count - raw, pixelSize, 2) < 2)
+   {
+      raw++;
+   }
+
+   return raw;
+}
+// rawLength
+
+/*********************************************************************
+ *
+ * putPackets
+ *
+ * SYNOPSIS
+ *		static void putPackets (BENCHBUF *pbb, const uint8 *pRow, long width, int pixelSize, int format)
+ *
+ * PURPOSE
+ *		Run length encode a row the way format does it.  tga, psd
+ *		(packbits) and pic (mixed run length) all have a count byte
+ *		followed by one pixel for a run or count pixels for a raw
+ *		packet, runs and raws of up to 128.  They only differ in how
+ *		the count is written.
+ *
+*/
+static void putPackets (BENCHBUF *pbb, const uint8 *pRow, long width, int pixelSize, int format)
+{
+   long  x = 0;
+
+   while (x < width)
+   {
+      const uint8   *p   = pRow + x * pixelSize;
+      long           run = runLength (p, width - x, pixelSize, 128);
+
+      if (run >= 2)
+      {
+         switch (format)
+         {
+         case PICFMT_TGA: bufByte (pbb, 0x80 | (run - 1)); break;
+         case PICFMT_PSD: bufByte (pbb, 1 - run);          break;
+         case PICFMT_PIC: bufByte (pbb, run + 127);        break;
+         }
+         bufPut (pbb, p, pixelSize);
+         x += run;
+      }
+      else
+      {
+         long  raw = rawLength (p, width - x, pixelSize, 128);
+
+         bufByte (pbb, raw - 1);
+         bufPut (pbb, p, raw * pixelSize);
+         x += raw;
+      }
+   }
+}
+// putPackets
+
+/*********************************************************************
+ *
+ * makePicture
+ *
+ * SYNOPSIS
+ *		static int makePicture (BENCHPIC *pbp, long width, long height)
+ *
+ * PURPOSE
+ *		Make the picture all the test files are written from.
+ *
+*/
+static int makePicture (BENCHPIC *pbp, long width, long height)
+{
+   long  x;
+   long  y;
+   int   i;
+
+   memset (pbp, 0, sizeof (*pbp));
+
+   pbp->bop.width     = width;
+   pbp->bop.height    = height;
+   pbp->bop.channels  = 1;
+   pbp->bop.rgba      = (pixel32 *)malloc (width * height * sizeof (pixel32));
+   pbp->bop8.width    = width;
+   pbp->bop8.height   = height;
+   pbp->bop8.pixels   = (uint8 *)malloc (width * height);
+
+   if (!pbp->bop.rgba || !pbp->bop8.pixels)
+   {
+      return FALSE;
+   }
+
+   for (i = 0; i < 256; i++)
+   {
+      pbp->bop8.palette[i].red   = (uint8)i;
+      pbp->bop8.palette[i].green = (uint8)(i * 7);
+      pbp->bop8.palette[i].blue  = (uint8)(255 - i);
+   }
+
+   for (y = 0; y < height; y++)
+   {
+      uint8    *pIndex = pbp->bop8.pixels + y * width;
+      pixel32  *pPixel = pbp->bop.rgba + y * width;
+
+      for (x = 0; x < width; x++)
+      {
+         long  span = x / BENCH_SPAN_WIDTH;
+         long  band = y / BENCH_SPAN_HEIGHT;
+         int   index;
+
+         if ((span + band) & 1)
+         {
+            index = (int)((x * 3 + y) & 255);
+         }
+         else
+         {
+            index = (int)((span * 7 + band * 13) & 255);
+         }
+
+         pIndex[x]       = (uint8)index;
+         pPixel[x].red   = pbp->bop8.palette[index].red;
+         pPixel[x].green = pbp->bop8.palette[index].green;
+         pPixel[x].blue  = pbp->bop8.palette[index].blue;
+         pPixel[x].alpha = (uint8)index;
+      }
+   }
+
+   return TRUE;
+}
+// makePicture
+
+/*********************************************************************
+ *
+ * makeTGA
+ *
+ * SYNOPSIS
+ *		static void makeTGA (BENCHBUF *pbb, const BENCHPIC *pbp, int imageType, int bpp)
+ *
+ * PURPOSE
+ *		Write the picture as a tga of the given image type (1, 2, 3,
+ *		9, 10, 11) and bits per pixel.  Rows are stored bottom up like
+ *		most tgas are.
+ *
+*/
+static void makeTGA (BENCHBUF *pbb, const BENCHPIC *pbp, int imageType, int bpp)
+{
+   long     width     = pbp->bop.width;
+   long     height    = pbp->bop.height;
+   int      pixelSize = bpp / 8;
+   int      fColorMap = (imageType & 7) == 1;
+   uint8   *pRow;
+   long     x;
+   long     y;
+
+   bufByte   (pbb, 0);                    // id length
+   bufByte   (pbb, fColorMap);            // color map type
+   bufByte   (pbb, imageType);
+   bufLSBF16 (pbb, 0);                    // first color
+   bufLSBF16 (pbb, fColorMap ? 256 : 0);  // colors
+   bufByte   (pbb, fColorMap ? 24 : 0);   // color size
+   bufLSBF16 (pbb, 0);                    // origin x
+   bufLSBF16 (pbb, 0);                    // origin y
+   bufLSBF16 (pbb, (int)width);
+   bufLSBF16 (pbb, (int)height);
+   bufByte   (pbb, bpp);
+   bufByte   (pbb, bpp == 32 ? 8 : bpp == 16 ? 1 : 0);   // alpha bits, bottom up
+
+   if (fColorMap)
+   {
+      int   i;
+
+      for (i = 0; i < 256; i++)
+      {
+         bufByte (pbb, pbp->bop8.palette[i].blue);
+         bufByte (pbb, pbp->bop8.palette[i].green);
+         bufByte (pbb, pbp->bop8.palette[i].red);
+      }
+   }
+
+   pRow = (uint8 *)malloc (width * 4);
+   for (y = height - 1; y >= 0; y--)
+   {
+      const pixel32  *s     = pbp->bop.rgba + y * width;
+      const uint8    *sNdx  = pbp->bop8.pixels + y * width;
+      uint8          *d     = pRow;
+
+      for (x = 0; x < width; x++, s++)
+      {
+         switch (bpp)
+         {
+         case 8:
+            *d++ = sNdx[x];
+            break;
+         case 16:
+            {
+               int   c = ((s->alpha >= 128) << 15) | ((s->red >> 3) << 10) | ((s->green >> 3) << 5) | (s->blue >> 3);
+
+               *d++ = (uint8)c;
+               *d++ = (uint8)(c >> 8);
+            }
+            break;
+         case 24:
+         case 32:
+            *d++ = s->blue;
+            *d++ = s->green;
+            *d++ = s->red;
+            if (bpp == 32)
+            {
+               *d++ = s->alpha;
+            }
+            break;
+         }
+      }
+
+      if (imageType & 8)
+      {
+         putPackets (pbb, pRow, width, pixelSize, PICFMT_TGA);
+      }
+      else
+      {
+         bufPut (pbb, pRow, width * pixelSize);
+      }
+   }
+   free (pRow);
+}
+// makeTGA
+
+/*********************************************************************
+ *
+ * makePSD
+ *
+ * SYNOPSIS
+ *		static void makePSD (BENCHBUF *pbb, const BENCHPIC *pbp, int fCompress)
+ *
+ * PURPOSE
+ *		Write the picture as a 4 channel photoshop file, raw or
+ *		packbits compressed.
+ *
+*/
+static void makePSD (BENCHBUF *pbb, const BENCHPIC *pbp, int fCompress)
+{
+   long     width  = pbp->bop.width;
+   long     height = pbp->bop.height;
+   long     sizes  = 0;
+   uint8   *pRow;
+   int      c;
+   long     x;
+   long     y;
+
+   bufMSBF32 (pbb, 0x38425053);  // 8BPS
+   bufMSBF16 (pbb, 1);           // version
+   bufMSBF32 (pbb, 0);           // reserved
+   bufMSBF16 (pbb, 0);
+   bufMSBF16 (pbb, 4);           // channels
+   bufMSBF32 (pbb, height);
+   bufMSBF32 (pbb, width);
+   bufMSBF16 (pbb, 8);           // depth
+   bufMSBF16 (pbb, 3);           // rgb
+   bufMSBF32 (pbb, 0);           // mode data
+   bufMSBF32 (pbb, 0);           // resources
+   bufMSBF32 (pbb, 0);           // layers and masks
+   bufMSBF16 (pbb, fCompress);
+
+   // packbits rows are preceeded by every row's size, filled in below
+   if (fCompress)
+   {
+      sizes = pbb->size;
+      for (y = 0; y < 4 * height; y++)
+      {
+         bufMSBF16 (pbb, 0);
+      }
+   }
+
+   pRow = (uint8 *)malloc (width);
+   for (c = 0; c < 4; c++)
+   {
+      for (y = 0; y < height; y++)
+      {
+         const pixel32  *s = pbp->bop.rgba + y * width;
+
+         for (x = 0; x < width; x++)
+         {
+            switch (c)
+            {
+            case 0: pRow[x] = s[x].red;   break;
+            case 1: pRow[x] = s[x].green; break;
+            case 2: pRow[x] = s[x].blue;  break;
+            case 3: pRow[x] = s[x].alpha; break;
+            }
+         }
+
+         if (fCompress)
+         {
+            long  start = pbb->size;
+            long  len;
+            uint8 *pSize;
+
+            putPackets (pbb, pRow, width, 1, PICFMT_PSD);
+
+            len   = pbb->size - start;
+            pSize = pbb->pData + sizes + (c * height + y) * 2;
+            pSize[0] = (uint8)(len >> 8);
+            pSize[1] = (uint8)len;
+         }
+         else
+         {
+            bufPut (pbb, pRow, width);
+         }
+      }
+   }
+   free (pRow);
+}
+// makePSD
+
+/*********************************************************************
+ *
+ * makePIC
+ *
+ * SYNOPSIS
+ *		static void makePIC (BENCHBUF *pbb, const BENCHPIC *pbp, int fCompress)
+ *
+ * PURPOSE
+ *		Write the picture as a softimage pic.  Compressed it's the
+ *		usual mixed run length rgb packet chained to an alpha one,
+ *		otherwise one uncompressed rgba packet.
+ *
+*/
+static void makePIC (BENCHBUF *pbb, const BENCHPIC *pbp, int fCompress)
+{
+   long     width  = pbp->bop.width;
+   long     height = pbp->bop.height;
+   uint8   *pRGB;
+   uint8   *pAlpha;
+   long     x;
+   long     y;
+   int      i;
+
+   bufMSBF32 (pbb, 0x5380F634);  // magic
+   bufMSBF32 (pbb, 0x406D70A4);  // version 3.71
+   for (i = 0; i < 80; i++)
+   {
+      bufByte (pbb, 0);          // comment
+   }
+   bufPut    (pbb, "PICT", 4);
+   bufMSBF16 (pbb, (int)width);
+   bufMSBF16 (pbb, (int)height);
+   bufMSBF32 (pbb, 0x3F800000);  // ratio 1.0
+   bufMSBF16 (pbb, 3);           // both fields
+   bufMSBF16 (pbb, 0);
+
+   // chained, size, type, channels
+   if (fCompress)
+   {
+      bufByte (pbb, 1); bufByte (pbb, 8); bufByte (pbb, 2); bufByte (pbb, 0xE0);
+      bufByte (pbb, 0); bufByte (pbb, 8); bufByte (pbb, 2); bufByte (pbb, 0x10);
+   }
+   else
+   {
+      bufByte (pbb, 0); bufByte (pbb, 8); bufByte (pbb, 0); bufByte (pbb, 0xF0);
+   }
+
+   pRGB   = (uint8 *)malloc (width * 4);
+   pAlpha = (uint8 *)malloc (width);
+   for (y = 0; y < height; y++)
+   {
+      const pixel32  *s = pbp->bop.rgba + y * width;
+
+      for (x = 0; x < width; x++)
+      {
+         if (fCompress)
+         {
+            pRGB[x * 3 + 0] = s[x].red;
+            pRGB[x * 3 + 1] = s[x].green;
+            pRGB[x * 3 + 2] = s[x].blue;
+            pAlpha[x]       = s[x].alpha;
+         }
+         else
+         {
+            pRGB[x * 4 + 0] = s[x].red;
+            pRGB[x * 4 + 1] = s[x].green;
+            pRGB[x * 4 + 2] = s[x].blue;
+            pRGB[x * 4 + 3] = s[x].alpha;
+         }
+      }
+
+      if (fCompress)
+      {
+         putPackets (pbb, pRGB, width, 3, PICFMT_PIC);
+         putPackets (pbb, pAlpha, width, 1, PICFMT_PIC);
+      }
+      else
+      {
+         bufPut (pbb, pRGB, width * 4);
+      }
+   }
+   free (pAlpha);
+   free (pRGB);
+}
+// makePIC
+
+/*********************************************************************
+ *
+ * savers
+ *
+ * PURPOSE
+ *		The save functions with the same arguments so they can go in a
+ *		table.
+ *
+*/
+static int saveTGARaw (int fh, BENCHPIC *pbp)
+{
+   return saveTGA32BitEx (fh, &pbp->bop, FALSE);
+}
+
+static int saveTGARLE (int fh, BENCHPIC *pbp)
+{
+   return saveTGA32BitEx (fh, &pbp->bop, TRUE);
+}
+
+static int savePCX (int fh, BENCHPIC *pbp)
+{
+   return SavePCX8Bit (fh, &pbp->bop8);
+}
+
+static int saveGFFRaw (int fh, BENCHPIC *pbp)
+{
+   return saveGFF32BitEx (fh, &pbp->bop, FALSE);
+}
+
+static int saveGFFRLE (int fh, BENCHPIC *pbp)
+{
+   return saveGFF32BitEx (fh, &pbp->bop, TRUE);
+}
+
+static SAVECASE SaveCases[] = {
+   { "saveTGA32Bit raw",   saveTGARaw, },
+   { "saveTGA32Bit rle",   saveTGARLE, },
+   { "SavePCX8Bit",        savePCX,    },
+   { "saveGFF32Bit raw",   saveGFFRaw, },
+   { "saveGFF32Bit rle",   saveGFFRLE, },
+};
+
+/*********************************************************************
+ *
+ * savedFile
+ *
+ * SYNOPSIS
+ *		static MEMFILE *savedFile (const char *pszFilename, PFNSAVE pfnSave, BENCHPIC *pbp)
+ *
+ * PURPOSE
+ *		Save the picture with pfnSave and read it back.  For the
+ *		formats whose only writer is the one in the library.
+ *
+*/
+static MEMFILE *savedFile (const char *pszFilename, PFNSAVE pfnSave, BENCHPIC *pbp)
+{
+   int   fh;
+   int   result;
+
+   fh     = CHK_WriteOpen (pszFilename);
+   result = pfnSave (fh, pbp);
+   CHK_Close (fh);
+
+   return result ? MEMFILE_Load (pszFilename) : NULL;
+}
+// savedFile
+
+/*********************************************************************
+ *
+ * checkLazyWriteBack
+ *
+ * SYNOPSIS
+ *		static int checkLazyWriteBack (const char *pszFilename, BENCHPIC *pbp)
+ *
+ * PURPOSE
+ *		Save the picture as a gff, read it back with GFFREAD_LAZY so
+ *		none of its pixels are loaded, write that over the same file
+ *		and check the file still has the picture in it.
+ *
+*/
+static int checkLazyWriteBack (const char *pszFilename, BENCHPIC *pbp)
+{
+   BlockO32BitPixels *pbop;
+   GFF   *pgff;
+   int    fh;
+   int    result;
+
+   fh     = CHK_WriteOpen (pszFilename);
+   result = saveGFFRLE (fh, pbp);
+   CHK_Close (fh);
+   if (!result)
+   {
+      return FALSE;
+   }
+
+   pgff = ReadGFFEx (pszFilename, GFFREAD_LAZY);
+   if (!pgff)
+   {
+      return FALSE;
+   }
+   result = WriteGFF (pszFilename, pgff);
+   FreeGFF (pgff);
+   if (!result)
+   {
+      return FALSE;
+   }
+
+   pbop = Read32BitPicture (pszFilename);
+   if (!pbop)
+   {
+      return FALSE;
+   }
+   result = pbop->width == pbp->bop.width && pbop->height == pbp->bop.height
+         && !memcmp (pbop->rgba, pbp->bop.rgba, pbop->width * pbop->height * sizeof (pixel32));
+   Free32BitPicture (pbop);
+
+   return result;
+}
+// checkLazyWriteBack
+
+/*********************************************************************
+ *
+ * load and save runs
+ *
+*/
+typedef struct {
+   LOADCASE            *plc;
+   BlockO32BitPixels    bop;
+} LOADRUN;
+
+static int runLoad (void *pUserData)
+{
+   LOADRUN  *plr = (LOADRUN *)pUserData;
+   MEMFILE   mf;
+
+   MEMFILE_Init (&mf, plr->plc->pData, plr->plc->size);
+
+   return plr->plc->pfnLoad (&plr->bop, &mf);
+}
+
+typedef struct {
+   SAVECASE   *psc;
+   BENCHPIC   *pbp;
+   const char *pszFilename;
+   long        size;
+} SAVERUN;
+
+static int runSave (void *pUserData)
+{
+   SAVERUN  *psr = (SAVERUN *)pUserData;
+   int       fh;
+   int       result;
+
+   fh        = CHK_WriteOpen (psr->pszFilename);
+   result    = psr->psc->pfnSave (fh, psr->pbp);
+   psr->size = CHK_Tell (fh);
+   CHK_Close (fh);
+
+   return result;
+}
+
+/*********************************************************************
+ *
+ * loadPIC32BitOld
+ *
+ * SYNOPSIS
+ *		static int loadPIC32BitOld (BlockO32BitPixels *blockPtr, MEMFILE *mf)
+ *
+ * PURPOSE
+ *		The pic reader the library had before it decoded whole pixels
+ *		at a time, kept for -C to time the new one against.  It gets
+ *		every byte with MEMFILE_getc, tests the channel mask for every
+ *		channel of every pixel and clears the picture first.  Only
+ *		reads uncompressed and mixed run length packets.
+ *
+*/
+typedef struct {
+   int32 magic;
+   int32 version;
+   char  comment[80];
+   char  id[4];
+   int16 width;
+   int16 height;
+   int32 ratio;
+   int16 fields;
+   int16 pad;
+} OLDPICHEADER;
+
+typedef struct {
+   int8  chained;
+   int8  size;
+   int8  type;
+   int8  channel;
+} OLDPICCHANNEL;
+
+static int oldPICRow (pixel32 *pRow, pixel32 *pEOB, long width, const OLDPICCHANNEL *channel, int numPackets, MEMFILE *mf)
+{
+   int   c;
+
+   for (c = 0; c < numPackets; c++)
+   {
+      pixel32  *pPixel   = pRow;
+      uint8     channels = channel[c].channel;
+      long      x        = 0;
+
+      if (!channels)
+      {
+         SetGlobalErr (ERR_GENERIC);
+         GEcatf ("bad channel flags");
+         return FALSE;
+      }
+
+      if (channel[c].type == 0)
+      {
+         for (x = 0; x < width; x++, pPixel++)
+         {
+            if (channels & 0x80) { pPixel->red   = MEMFILE_getc (mf); }
+            if (channels & 0x40) { pPixel->green = MEMFILE_getc (mf); }
+            if (channels & 0x20) { pPixel->blue  = MEMFILE_getc (mf); }
+            if (channels & 0x10) { pPixel->alpha = MEMFILE_getc (mf); }
+         }
+         continue;
+      }
+      if (channel[c].type != 2)
+      {
+         SetGlobalErr (ERR_GENERIC);
+         GEcatf ("error reading file (3)");
+         return FALSE;
+      }
+
+      while (x < width)
+      {
+         long  count = MEMFILE_getc (mf);
+         int   fRun  = count >= 128;
+         uint8 r = 0, g = 0, b = 0, a = 0;
+
+         if (count == EOF)
+         {
+            SetGlobalErr (ERR_GENERIC);
+            GEcatf ("error reading file (4)");
+            return FALSE;
+         }
+
+         if (count == 128)
+         {
+            count  = MEMFILE_getc (mf) * 256;
+            count += MEMFILE_getc (mf);
+         }
+         else if (count > 128)
+         {
+            count -= 127;
+         }
+         else
+         {
+            count++;
+         }
+         if (fRun)
+         {
+            if (channels & 0x80) { r = MEMFILE_getc (mf); }
+            if (channels & 0x40) { g = MEMFILE_getc (mf); }
+            if (channels & 0x20) { b = MEMFILE_getc (mf); }
+            if (channels & 0x10) { a = MEMFILE_getc (mf); }
+         }
+
+         if (pPixel + count > pEOB)
+         {
+            SetGlobalErr (ERR_GENERIC);
+            GEcatf ("error reading file");
+            return FALSE;
+         }
+
+         for (; count > 0; count--, x++, pPixel++)
+         {
+            if (!fRun)
+            {
+               if (channels & 0x80) { r = MEMFILE_getc (mf); }
+               if (channels & 0x40) { g = MEMFILE_getc (mf); }
+               if (channels & 0x20) { b = MEMFILE_getc (mf); }
+               if (channels & 0x10) { a = MEMFILE_getc (mf); }
+            }
+            if (channels & 0x80) { pPixel->red   = r; }
+            if (channels & 0x40) { pPixel->green = g; }
+            if (channels & 0x20) { pPixel->blue  = b; }
+            if (channels & 0x10) { pPixel->alpha = a; }
+         }
+      }
+   }
+
+   return TRUE;
+}
+
+static int loadPIC32BitOld (BlockO32BitPixels *blockPtr, MEMFILE *mf)
+{
+   OLDPICHEADER   head;
+   OLDPICCHANNEL  channel[4];
+   pixel32       *pEOB;
+   long           width;
+   long           height;
+   long           y;
+   int            numPackets;
+
+   if (MEMFILE_Read (mf, &head, sizeof (head)) != sizeof (head))
+   {
+      SetGlobalErr (ERR_GENERIC);
+      GEcatf ("Invalid PIC file");
+      return FALSE;
+   }
+   for (numPackets = 0; numPackets < 4; )
+   {
+      if (MEMFILE_Read (mf, &channel[numPackets], sizeof (OLDPICCHANNEL)) != sizeof (OLDPICCHANNEL))
+      {
+         SetGlobalErr (ERR_GENERIC);
+         GEcatf ("Invalid PIC file (2)");
+         return FALSE;
+      }
+      if (!channel[numPackets++].chained)
+      {
+         break;
+      }
+   }
+
+   width  = MSBFToNative16Bit (head.width);
+   height = MSBFToNative16Bit (head.height);
+   if (width <= 0 || height <= 0 || channel[numPackets - 1].chained)
+   {
+      SetGlobalErr (ERR_GENERIC);
+      GEcatf ("Invalid PIC file (3)");
+      return FALSE;
+   }
+   for (y = 0; y < numPackets; y++)
+   {
+      if (channel[y].channel & 0x10)
+      {
+         blockPtr->channels = 1;
+      }
+   }
+
+   if (!AllocPicturePixels (blockPtr, width * height))
+   {
+      SetGlobalErr (ERR_GENERIC);
+      GEcatf ("Out of Memory loading pic");
+      return FALSE;
+   }
+   blockPtr->width  = width;
+   blockPtr->height = height;
+   memset (blockPtr->rgba, 255, width * height * sizeof (pixel32));
+
+   pEOB = blockPtr->rgba + width * height;
+   for (y = 0; y < height; y++)
+   {
+      if (!oldPICRow (blockPtr->rgba + y * width, pEOB, width, channel, numPackets, mf))
+      {
+         FreePicturePixels (blockPtr);
+         return FALSE;
+      }
+   }
+
+   return TRUE;
+}
+// loadPIC32BitOld
+
+/*************************** ArgParse Template ***************************/
+enum {
+   NDX_Width,
+   NDX_Height,
+   NDX_Time,
+   NDX_Dir,
+   NDX_Compare,
+};
+
+#define ARG(name) (newargs [NDX_ ## name])
+
+char Usage[] = "Usage: GFBench [Switches]\n";
+static char	**newargs;
+
+ArgSpec Template[] = {
+   {CHRKEYWORD_ARG,              "W",
+      "\t-W<width>    Width of the test picture. Default = 1024.\n"
+   ,},
+   {CHRKEYWORD_ARG,              "H",
+      "\t-H<height>   Height of the test picture. Default = 1024.\n"
+   ,},
+   {CHRKEYWORD_ARG,              "T",
+      "\t-T<seconds>  Least time to spend on each test. Default = 1.\n"
+   ,},
+   {CHRKEYWORD_ARG,              "D",
+      "\t-D<dir>      Where the savers write. Default = current directory.\n"
+   ,},
+   {CHRSWITCH_ARG,               "C",
+      "\t-C           Compare. Also time the pic reader from before it read\n"
+      "\t             whole pixels at a time and check both decode the same.\n"
+      "\t             Check a lazy gff can be written back over its own file.\n"
+   ,},
+   {0, NULL, NULL, },
+};
+
+/********************************** MAIN **********************************/
+
+int main(int argc, char **argv)
+BEGINFUNCMAIN(main)
+{
+	newargs = argparse (argc, argv, Template);
+
+	if (!newargs)
+	{
+		EL_printf ("%s\n", GlobalErrMsg);
+		printarghelp (Usage, Template);
+		RETURN EXIT_FAILURE;
+	}
+	else
+	{
+      static const struct {
+         const char *pszName;
+         int         format;
+         int         type;    // tga image type or TRUE to compress
+         int         bpp;
+      } Made[] = {
+         { "loadTGA32Bit 8 grey",   PICFMT_TGA,  3,  8, },
+         { "loadTGA32Bit 8 cmap",   PICFMT_TGA,  1,  8, },
+         { "loadTGA32Bit 16",       PICFMT_TGA,  2, 16, },
+         { "loadTGA32Bit 24",       PICFMT_TGA,  2, 24, },
+         { "loadTGA32Bit 32",       PICFMT_TGA,  2, 32, },
+         { "loadTGA32Bit 8 grey r", PICFMT_TGA, 11,  8, },
+         { "loadTGA32Bit 8 cmap r", PICFMT_TGA,  9,  8, },
+         { "loadTGA32Bit 16 rle",   PICFMT_TGA, 10, 16, },
+         { "loadTGA32Bit 24 rle",   PICFMT_TGA, 10, 24, },
+         { "loadTGA32Bit 32 rle",   PICFMT_TGA, 10, 32, },
+         { "loadPhotoshop32Bit",    PICFMT_PSD, FALSE, 32, },
+         { "loadPhotoshop32Bit r",  PICFMT_PSD, TRUE,  32, },
+         { "loadPIC32Bit",          PICFMT_PIC, FALSE, 32, },
+         { "loadPIC32Bit rle",      PICFMT_PIC, TRUE,  32, },
+      };
+      static const struct {
+         const char *pszName;
+         PFNLOAD32   pfnLoad;
+         PFNSAVE     pfnSave;
+      } Saved[] = {
+         { "loadPCX32Bit",          loadPCX32Bit, savePCX,    },
+         { "loadGFF32Bit raw",      loadGFF32Bit, saveGFFRaw, },
+         { "loadGFF32Bit rle",      loadGFF32Bit, saveGFFRLE, },
+      };
+      #define NUM_MADE   (sizeof (Made) / sizeof (Made[0]))
+      #define NUM_SAVED  (sizeof (Saved) / sizeof (Saved[0]))
+      #define NUM_SAVES  (sizeof (SaveCases) / sizeof (SaveCases[0]))
+
+      LOADCASE    LoadCases[NUM_MADE + NUM_SAVED];
+      BENCHPIC    bp;
+      BENCHTIME   bt;
+      LOADRUN     lr;
+      SAVERUN     sr;
+      char        szTemp[EIO_MAXPATH];
+      char        szGFF[EIO_MAXPATH];
+      char        szLine[128];
+      char        szName[64];
+      pixel32    *pOld;
+      long        width;
+      long        height;
+      long        pixels;
+      double      minSeconds;
+      int         result;
+      int         i;
+
+      width      = ARG(Width)  ? atol (ARG(Width))  : 1024;
+      height     = ARG(Height) ? atol (ARG(Height)) : 1024;
+      minSeconds = ARG(Time)   ? atof (ARG(Time))   : 1.0;
+      pixels     = width * height;
+
+      if (width < 1 || width > 32767 || height < 1 || height > 32767)
+      {
+         EL_printf ("ERROR: Width and height must be 1..32767\n");
+         RETURN EXIT_FAILURE;
+      }
+
+      EIO_fnmerge (szTemp, ARG(Dir) ? ARG(Dir) : "", BENCH_TEMP_NAME, NULL);
+      EIO_fnmerge (szGFF,  ARG(Dir) ? ARG(Dir) : "", BENCH_GFF_NAME,  NULL);
+
+      if (!makePicture (&bp, width, height))
+      {
+         EL_printf ("ERROR: Out of memory making the test picture\n");
+         RETURN EXIT_FAILURE;
+      }
+
+      // the corpus
+      for (i = 0; i < (int)NUM_MADE; i++)
+      {
+         BENCHBUF bb = { NULL, 0, 0, };
+         LOADCASE *plc = &LoadCases[i];
+
+         switch (Made[i].format)
+         {
+         case PICFMT_TGA:
+            makeTGA (&bb, &bp, Made[i].type, Made[i].bpp);
+            plc->pfnLoad = loadTGA32Bit;
+            break;
+         case PICFMT_PSD:
+            makePSD (&bb, &bp, Made[i].type);
+            plc->pfnLoad = loadPhotoshop32Bit;
+            break;
+         case PICFMT_PIC:
+            makePIC (&bb, &bp, Made[i].type);
+            plc->pfnLoad = loadPIC32Bit;
+            break;
+         }
+         plc->pszName = Made[i].pszName;
+         plc->pData   = bb.pData;
+         plc->size    = bb.size;
+         plc->mf      = NULL;
+      }
+      for (i = 0; i < (int)NUM_SAVED; i++)
+      {
+         LOADCASE *plc = &LoadCases[NUM_MADE + i];
+
+         plc->pszName = Saved[i].pszName;
+         plc->pfnLoad = Saved[i].pfnLoad;
+         plc->mf      = savedFile (szTemp, Saved[i].pfnSave, &bp);
+         if (!plc->mf)
+         {
+            EL_printf ("ERROR: Couldn't make test file for %s\n%s\n", plc->pszName, GlobalErrMsg);
+            RETURN EXIT_FAILURE;
+         }
+         plc->pData   = plc->mf->buffer;
+         plc->size    = plc->mf->size;
+      }
+
+      EL_printf ("%ld x %ld pixels, %d threads\n\n", width, height, ETHREAD_PoolThreads (NULL));
+      sprintf (szLine, "%-22s %9s %6s %9s %9s %9s", "test", "KB", "runs", "ms", "MB/s", "Mpix/s");
+      EL_printf ("%s\n", szLine);
+
+      // decode into the same buffer every time so it's the decoder
+      // being timed and not the allocator
+      memset (&lr, 0, sizeof (lr));
+      lr.bop.rgba     = (pixel32 *)malloc (pixels * sizeof (pixel32));
+      lr.bop.capacity = pixels;
+      pOld            = ARG(Compare) ? (pixel32 *)malloc (pixels * sizeof (pixel32)) : NULL;
+
+      for (i = 0; i < (int)(NUM_MADE + NUM_SAVED); i++)
+      {
+         lr.plc = &LoadCases[i];
+         runTimed (&bt, runLoad, &lr, minSeconds);
+         printTimed (lr.plc->pszName, &bt, lr.plc->size, pixels);
+
+         if (ARG(Compare) && lr.plc->pfnLoad == loadPIC32Bit)
+         {
+            LOADCASE lcOld = *lr.plc;
+
+            sprintf (szName, "%s old", lr.plc->pszName);
+            lcOld.pszName = szName;
+            lcOld.pfnLoad = loadPIC32BitOld;
+            lr.plc = &lcOld;
+            runTimed (&bt, runLoad, &lr, minSeconds);
+            printTimed (lcOld.pszName, &bt, lcOld.size, pixels);
+
+            // what the old reader left in the buffer against the new one
+            memcpy (pOld, lr.bop.rgba, pixels * sizeof (pixel32));
+            lr.plc = &LoadCases[i];
+            runLoad (&lr);
+            if (memcmp (pOld, lr.bop.rgba, pixels * sizeof (pixel32)))
+            {
+               EL_printf ("ERROR: %s decodes differently from the old reader\n", lr.plc->pszName);
+               RETURN EXIT_FAILURE;
+            }
+         }
+      }
+
+      // savers
+      sr.pbp         = &bp;
+      sr.pszFilename = szTemp;
+      for (i = 0; i < (int)NUM_SAVES; i++)
+      {
+         sr.psc  = &SaveCases[i];
+         sr.size = 0;
+         runTimed (&bt, runSave, &sr, minSeconds);
+         printTimed (sr.psc->pszName, &bt, sr.size, pixels);
+      }
+
+      remove (szTemp);
+
+      if (ARG(Compare))
+      {
+         result = checkLazyWriteBack (szGFF, &bp);
+         remove (szGFF);
+         if (!result)
+         {
+            EL_printf ("ERROR: Writing a lazy gff back over its own file lost it\n%s\n", GlobalErrMsg);
+            RETURN EXIT_FAILURE;
+         }
+      }
+
+      for (i = 0; i < (int)(NUM_MADE + NUM_SAVED); i++)
+      {
+         if (LoadCases[i].mf)
+         {
+            MEMFILE_Close (LoadCases[i].mf);
+         }
+         else
+         {
+            free (LoadCases[i].pData);
+         }
+      }
+      free (pOld);
+      free (lr.bop.rgba);
+      free (bp.bop.rgba);
+      free (bp.bop8.pixels);
+   }
+
+   RETURN EXIT_SUCCESS;
+}
+ENDFUNCMAIN(main)
@@ -0,0 +1,31 @@
+/*************************************************************************
+ *                                                                       *
+ *                              SWITCHES.H                               *
+ *                                                                       *
+ *************************************************************************
+
+                          Copyright 1996 Echidna
+
+   DESCRIPTION
+
+
+   PROGRAMMERS
+
+
+   FUNCTIONS
+
+   TABS : 5 9
+
+   HISTORY
+		07/15/96 : Created.
+
+ *************************************************************************/
+
+#ifndef SWITCHES_H
+#define SWITCHES_H
+
+#define	EL_DEBUG_MESSAGES	0	// dmbess.h
+#define	EL_DEBUG_MEMORY	0	// memsafe.h
+
+#endif /* SWITCHES_H */
+
@@ -119,31 +119,47 @@ BEGINFUNCMAIN(main)
   }
   else
   {
-    // Load a 32 bit picture (or 8bit as 32bit) and then save it
+    // Only the header is needed unless the file has an alpha channel,
+    // in which case we have to look at the pixels to see if it's used.
     {
-      BlockO32BitPixels *b32;
+      PictureInfo info;
 
-      b32 = Read32BitPicture (ARG(InFile));
-      if (b32)
+      if (ReadPictureInfo (ARG(InFile), &info))
       {
-        // Check if there is any non 1 alpha.
         bool nonOneAlpha = false;
-        pixel32* pixel = b32->rgba;
-        pixel32* lastPixel = pixel + b32->width * b32->height;
 
-        while (pixel < lastPixel)
+        if (info.hasAlpha)
         {
-          if (pixel->alpha != 255)
+          BlockO32BitPixels *b32;
+
+          b32 = Read32BitPicture (ARG(InFile));
+          if (b32)
+          {
+            pixel32* pixel = b32->rgba;
+            pixel32* lastPixel = pixel + b32->width * b32->height;
+
+            while (pixel < lastPixel)
+            {
+              if (pixel->alpha != 255)
+              {
+                nonOneAlpha = true;
+                break;
+              }
+              ++pixel;
+            }
+            Free32BitPicture (b32);
+          }
+          else
           {
-            nonOneAlpha = true;
-            break;
+            EL_printf("ERROR: unable to load picture %s\n", ARG(InFile));
           }
-          ++pixel;
         }
 
-        EL_printf("width=%d\n", b32->width);
-        EL_printf("height=%d\n", b32->height);
+        EL_printf("width=%d\n", info.width);
+        EL_printf("height=%d\n", info.height);
         EL_printf("nonOneAlpha=%d\n", nonOneAlpha);
+        EL_printf("channels=%d\n", info.channels);
+        EL_printf("format=%s\n", PictureFormatName (info.format));
       }
       else
       {
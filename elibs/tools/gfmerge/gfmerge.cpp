@@ -865,45 +865,27 @@ BEGINFUNC (ReadAPalette)
    
    if (!stricmp (".gff", EIO_Ext(pszPaletteFile)))
    {
-   	MEMFILE				*mf;
-   
-   	mf = MEMFILE_Load (pszPaletteFile);
-   	if (mf)
-   	{
-   
-         CHUNKHEADER   chunkheader;
-         int result, headerresult;;
-         BOOL  fGotPCON;
-         
-         fGotPCON = FALSE;
-         
-         /* Read chunks until find pcon chunk */
-         while (!fGotPCON)
+      GFF   *pgff;
+
+      // Only the PCON chunk is wanted so leave the pixels in the file.
+      pgff = ReadGFFEx (pszPaletteFile, GFFREAD_LAZY);
+      if (pgff)
+      {
+         CHUNKNODE   *pchunknode;
+
+         pchunknode = PChunkNodeOfId (pgff, IDPCON);
+         if (pchunknode)
          {
-            headerresult = MEMFILE_Read (mf, &chunkheader, sizeof (CHUNKHEADER));
-            
-            if (sizeof (CHUNKHEADER) != headerresult)
-            {
-               break;
-            } 
-            else if (!fGotPCON && chunkheader.id == IDPCON)
-            { /* Found pcon chunk */
-               
-		       MEM_CallocMemNoFail(ppalrec->ppcondata, chunkheader.Size);
-               result = MEMFILE_Read (mf, ppalrec->ppcondata, chunkheader.Size);
-               ENSURE(result != 0);
-               
-               ppalrec->NumInPalette = chunkheader.Size / sizeof (PCONDATA);
-               ENSURE(ppalrec->NumInPalette == ENTRIES_MAX);
-               
-               fGotPCON = TRUE;
-            }
-            else // skip unwanted data.
-            {
-               MEMFILE_Seek (mf, chunkheader.Size, SEEK_CUR);
-            }
+            UINT32   Size;
+
+            Size = pchunknode->pchunk->Header.Size;
+            MEM_CallocMemNoFail(ppalrec->ppcondata, Size);
+            memcpy (ppalrec->ppcondata, &pchunknode->pchunk->u8First, Size);
+
+            ppalrec->NumInPalette = Size / sizeof (PCONDATA);
+            ENSURE(ppalrec->NumInPalette == ENTRIES_MAX);
          }
-		   MEMFILE_Close (mf);
+         FreeGFF (pgff);
       }  
    }
    else
@@ -26,6 +26,7 @@
 
 #define	EL_DEBUG_MESSAGES	1	// dmbess.h
 #define	EL_DEBUG_MEMORY	0	// memsafe.h
+#define	EL_USE_SIMD		1	// inv_cmap.c
 
 #endif /* SWITCHES_H */
 
@@ -42,6 +42,17 @@
  JMA:
    Changed ASSERTION definition and calls to use conventional meaning.
    Added calculations for preset colors.   
+   Moved all state into a QuantizeContext so palettes can be built on
+      several threads at once.  Compiled with QUANTIZE_ALPHA for gfpalalpha
+      the boxes have a fourth (alpha) axis.
+   Added the qeMoments engine: box statistics come from cumulative moment
+      tables (see Wu, Graphics Gems II) instead of a scan of the box, so
+      summing a box is constant time.  The sums are the same 32 bit sums
+      the scans make so the palettes are the same.
+   Added quantize_sparse_ctx() for SPARSE_HISTs, which have just the colors
+      that are there at 8 bits a component with 32 bit counts.
+   Added quantize_sparse_check() to check the sparse path against the
+      6 bit one on histograms both can hold.
  TODO:   
       Figure out what to do if two seeded colors are so close that they are the same
           when quantized by the historgram
@@ -68,90 +79,229 @@
 #define uint   UINT32       
 typedef unsigned long  ulong;
 
+/*
+** Without QUANTIZE_ALPHA the alpha bounds of every box are 0..0 so the
+** alpha terms below add nothing and the alpha axis is never split.
+*/
 typedef struct
 {
   uint variance;           /* weighted variance */
   uint total_weight;       /* total weight */
-  uint tt_sum;             /* tt_sum += r*r+g*g+b*b*weight over entire box */
+  uint tt_sum;             /* tt_sum += a*a+r*r+g*g+b*b*weight over entire box */
   uint t_ur;               /* t_ur += r*weight over entire box */
   uint t_ug;               /* t_ug += g*weight over entire box */
   uint t_ub;               /* t_ub += b*weight over entire box */
-  INT  ir, ig, ib;         /* upper and lower bounds */
-  INT  jr, jg, jb;
+  uint t_ua;               /* t_ua += a*weight over entire box */
+  INT  ir, ig, ib, ia;     /* upper and lower bounds */
+  INT  jr, jg, jb, ja;
   
   // Variables for tracking info on boxes with seeded colors (preset colors that cannot be changed).
   int  fHasSeed;            /* Flag: Does this box have a preset quantized color? */
   INT  rSeed;              /* PreSet quantized color for this box */
   INT  gSeed;
   INT  bSeed;
+  INT  aSeed;
   uint SeedVariance;  /* Total variance from preset quantized color in this box */
 } box;
 
 typedef struct {
    HIST_ENTRY_TYPE  *phist;
    HIST_ENTRY_TYPE   histValue;
+   INT               r, g, b;     // where phist is
 } SEEDINFO;
 
-typedef void (*PFN_BOXOP)(box *pbox);   // Box operation function pointer type
+/*
+** Cumulative moments: entry (r,g,b) holds the sums over every histogram
+** cell (r' < r, g' < g, b' < b) so any box's sums come from 8 entries.
+*/
+typedef struct {
+   uint w;                 /* weight */
+   uint r;                 /* r*weight */
+   uint g;                 /* g*weight */
+   uint b;                 /* b*weight */
+   uint rgb2;              /* (r*r+g*g+b*b)*weight */
+   uint used;              /* cells with a non zero histogram entry */
+} MOMENT;
+
+#if !QUANTIZE_ALPHA
+/*
+** quantize_sparse_ctx() works on a list of the colors instead of a table.
+** A box owns colors [first, last) of the list, which is reordered as boxes
+** are split.  Colors are 0..255 so the sums are doubles to keep from
+** overflowing.
+*/
+typedef struct {
+   UINT8  c[3];            /* r, g, b */
+   UINT8  fSeed;           /* a preset color */
+   UINT32 count;
+} SCOLOR;
+
+typedef struct {
+   double w;               /* weight */
+   double t[3];            /* r*weight, g*weight, b*weight */
+   double tt;              /* (r*r+g*g+b*b)*weight */
+   double sv;              /* weight * distance^2 from the box's seed */
+   long   seeds;           /* preset colors */
+} SSLICE;
+
+typedef struct {
+   SSLICE s;               /* sums over the box */
+   double variance;
+   INT    i[3], j[3];      /* lower and upper bounds */
+   long   first, last;     /* colors of the box */
+   int    fHasSeed;
+   INT    seed[3];
+} SBOX;
+#endif
+
+typedef void (*PFN_BOXOP)(QuantizeContext *pqc, box *pbox);   // Box operation function pointer type
+
+#define MOM_SIDE   (HIST_MAX + 1)
+#define MOM_CELLS  (MOM_SIDE * MOM_SIDE * MOM_SIDE)
+
+/*
+** Everything one run of the quantizer works on.  Nothing is static so
+** any number of palettes can be built at once, one context each.
+*/
+struct QuantizeContext
+{
+   PFN_BOXOP  pfnShrinkBox;  // Pointer to current box shrinking function to use.
+   PFN_BOXOP  pfnSumBox;     // Pointer to current box summing function to use.
+   PFN_BOXOP  pfnEngineShrink;     // The engine's shrink_box.
+   PFN_BOXOP  pfnEngineSum;        // The engine's sum_box.
+   PFN_BOXOP  pfnEngineSumSeeded;  // The engine's sum_box_seeded.
+   QUANTIZEENGINE engine;
+   MOMENT    *pMoments;      /* qeMoments: MOM_CELLS cumulative moments */
+   box * *heap;              /* priority queue */
+   INT heap_size;
+   box *boxes;               /* box list */
+   INT total_boxes;          /* total boxes allocated */
+   INT num_boxes;            /* num boxes in use */
+   HIST_ENTRY_TYPE *hist;    /* histogram */
+   int NumSeeded;            /* number of palette entries that can be used but not set */
+   int NumOpen;              /* number of palette that can be set and used */
+   INT max_boxes;            /* boxes heap and boxes have room for */
+   int max_seeds;            /* seeds arseedinfo has room for */
+
+   /*
+   ** arseedinfo[] is used in a mechanism that allows the preset colors to be
+   ** seeded into the quantization process without requiring another histogram to
+   ** be allocated.  Normally the histogram must contain only values in positions
+   ** for the colors being seeded.  In this scheme, the original histogram values for
+   ** the picture are left intact except at the positions of the seeded colors,
+   ** which are set to indexes (1..Num Seeded Colors) into arseedinfo[].  The
+   ** corresponding entries in arseedinfo[] contain copies of the original
+   ** historgram value that was overwritten and a pointer back to the histogram
+   ** entry that was overwritten.  The pointer is used as both a convenient way to
+   ** restore the originial value and to verify which histogram entries are
+   ** for seeded colors (by comparing their address to the pointer in
+   ** arseedinfo[] which their value indexes).
+   ** Note: position 0 is unused. This optimizes the condition check for seeded entries
+   ** in the special function sum_box_seeded(), by allowing it to short circuit on 0
+   ** entries in the histogram (which will be true for most entries).
+   */
+   SEEDINFO *arseedinfo;
+
+#if !QUANTIZE_ALPHA
+   /* quantize_sparse_ctx() */
+   SCOLOR    *pScolors;      /* the colors, grouped by box */
+   long       max_scolors;
+   SBOX      *psboxes;
+   INT        max_sboxes;
+   int        fSeeding;      /* boxing the preset colors */
+   SSLICE     arslice[3][SPARSE_MAX];   /* a box cut in slices along each axis */
+#endif
+};
 
 
 /************************** P R O T O T Y P E S **************************/
 
-static void shrink_box(box *pbox);
-static void no_shrink_box(box *pbox);
-static void sum_box(box *pbox);
-static void sum_box_seeded(box *pbox);  // Sum box using special histogram method that ignores
+static void shrink_box(QuantizeContext *pqc, box *pbox);
+static void no_shrink_box(QuantizeContext *pqc, box *pbox);
+static void sum_box(QuantizeContext *pqc, box *pbox);
+static void sum_box_seeded(QuantizeContext *pqc, box *pbox);  // Sum box using special histogram method that ignores
                                     // all but the 'seeded' colors in the histogram.
+#if !QUANTIZE_ALPHA
+static void shrink_box_moments(QuantizeContext *pqc, box *pbox);
+static void sum_box_moments(QuantizeContext *pqc, box *pbox);
+static void sum_box_seeded_moments(QuantizeContext *pqc, box *pbox);
+#endif
 
 /***************************** G L O B A L S *****************************/
 /*----------------------------------------------------------------------------*/
-static PFN_BOXOP  pfnShrinkBox;  // Pointer to current box shrinking function to use.
-static PFN_BOXOP  pfnSumBox;     // Pointer to current box summing function to use.
-static box * *heap;     /* priority queue */
-static INT heap_size;
-static box *boxes;      /* box list */
-static INT total_boxes; /* total boxes allocated */
-static INT num_boxes;   /* num boxes in use */
-static HIST_ENTRY_TYPE *hist;      /* histogram */
-static int NumSeeded;               /* number of palette entries that can be used but not set */
-static int NumOpen;                 /* number of palette that can be set and used */
-
-/*
-** arseedinfo[] is used in a mechanism that allows the preset colors to be 
-** seeded into the quantization process without requiring another histogram to 
-** be allocated.  Normally the histogram must contain only values in positions 
-** for the colors being seeded.  In this scheme, the original histogram values for 
-** the picture are left intact except at the positions of the seeded colors, 
-** which are set to indexes (1..Num Seeded Colors) into arseedinfo[].  The 
-** corresponding entries in arseedinfo[] contain copies of the original 
-** historgram value that was overwritten and a pointer back to the histogram 
-** entry that was overwritten.  The pointer is used as both a convenient way to 
-** restore the originial value and to verify which histogram entries are 
-** for seeded colors (by comparing their address to the pointer in 
-** arseedinfo[] which their value indexes).  
-** Note: position 0 is unused. This optimizes the condition check for seeded entries 
-** in the special function sum_box_seeded(), by allowing it to short circuit on 0
-** entries in the histogram (which will be true for most entries).
-*/
-static SEEDINFO *arseedinfo; 
 
  
 /****************************** M A C R O S ******************************/
 
+#define HIST_AT(pqc,r,g,b,a)  ((pqc)->hist + ((a) * A_STRIDE) + ((r) * R_STRIDE) + ((g) * G_STRIDE) + (b))
+
+// Cumulative moment of everything below (r,g,b), 0..HIST_MAX.
+#define MOM_AT(pm,r,g,b)      ((pm) + ((r) * MOM_SIDE + (g)) * MOM_SIDE + (b))
 
 /**************************** R O U T I N E S ****************************/
 
 
-static void no_shrink_box(box *pbox)
+static void no_shrink_box(QuantizeContext *pqc, box *pbox)
 {
    // purposely empty.
-   pbox = pbox;   // avoid compiler warning
+   pqc = pqc;     // avoid compiler warning
+   pbox = pbox;
 }
 
+#if QUANTIZE_ALPHA
+/*----------------------------------------------------------------------------*/
+/* Shrinks box to minimum possible size.  With alpha it's simplest to look at */
+/* every cell once and keep the bounds of the used ones.                      */
+/*----------------------------------------------------------------------------*/
+static void shrink_box(QuantizeContext *pqc, box *pbox)
+{
+  INT r, g, b, a;
+  INT lr, lg, lb, la;
+  INT hr, hg, hb, ha;
+  HIST_ENTRY_TYPE *gp, *bp;
+
+  lr = lg = lb = la = HIST_MAX;
+  hr = hg = hb = ha = -1;
+
+  for (a = pbox->ia; a <= pbox->ja; a++)
+  {
+    for (r = pbox->ir; r <= pbox->jr; r++)
+    {
+      gp = HIST_AT (pqc, r, pbox->ig, pbox->ib, a);
+
+      for (g = pbox->ig; g <= pbox->jg; g++, gp += G_STRIDE)
+      {
+        bp = gp;
+
+        for (b = pbox->ib; b <= pbox->jb; b++)
+        {
+          if (*bp++)
+          {
+            if (a < la) la = a;
+            if (a > ha) ha = a;
+            if (r < lr) lr = r;
+            if (r > hr) hr = r;
+            if (g < lg) lg = g;
+            if (g > hg) hg = g;
+            if (b < lb) lb = b;
+            if (b > hb) hb = b;
+          }
+        }
+      }
+    }
+  }
+
+  if (ha >= 0)
+  {
+    pbox->ir = lr; pbox->ig = lg; pbox->ib = lb; pbox->ia = la;
+    pbox->jr = hr; pbox->jg = hg; pbox->jb = hb; pbox->ja = ha;
+  }
+}
+#else
 /*----------------------------------------------------------------------------*/
 /* Shrinks box to minimum possible size.                                      */
 /*----------------------------------------------------------------------------*/
-static void shrink_box(box *pbox)
+static void shrink_box(QuantizeContext *pqc, box *pbox)
 #if 0
 static void shrink_box(INT ir, INT ig, INT ib,
                        INT jr, INT jg, INT jb,
@@ -184,7 +334,7 @@ static void shrink_box(INT ir, INT ig, INT ib,
    hb = &pbox->jb;
    
 
-  s = hist + (ir * R_STRIDE + ig * G_STRIDE + ib);
+  s = pqc->hist + (ir * R_STRIDE + ig * G_STRIDE + ib);
 
   rp = s;
 
@@ -249,7 +399,7 @@ lg_done:
 
 lb_done:
 
-  s = hist + (jr * R_STRIDE + jg * G_STRIDE + jb);
+  s = pqc->hist + (jr * R_STRIDE + jg * G_STRIDE + jb);
 
   rp = s;
 
@@ -316,23 +466,26 @@ hb_done:
 
   return;
 }
+#endif
 /*----------------------------------------------------------------------------*/
 /* Standard binary tree based priorty queue manipulation functions.           */
 /*----------------------------------------------------------------------------*/
-static void down_heap(void)
+static void down_heap(QuantizeContext *pqc)
 {
   uint i, j, q;
   box *p;
+  box **heap = pqc->heap;
+  uint heap_size = (uint)pqc->heap_size;
 
   p = heap[1];
   q = p->variance;
 
   for (i = 1; ; )
   {
-    if ((j = i << 1) > (uint)heap_size)
+    if ((j = i << 1) > heap_size)
       break;
 
-    if (j < (uint)heap_size)
+    if (j < heap_size)
     {
       if (heap[j]->variance < heap[j + 1]->variance)
         j++;
@@ -349,12 +502,13 @@ static void down_heap(void)
   heap[i] = p;
 }
 /*----------------------------------------------------------------------------*/
-static void insert_heap(box *p)
+static void insert_heap(QuantizeContext *pqc, box *p)
 {
   uint i, j, q;
+  box **heap = pqc->heap;
 
   q = p->variance;
-  j = ++heap_size;
+  j = ++pqc->heap_size;
 
   for ( ; ; )
   {
@@ -375,14 +529,14 @@ static void insert_heap(box *p)
 /* Returns "worst" box, or NULL if no more splittable boxes remain. The worst */
 /* box is the box with the largest variance.                                  */
 /*----------------------------------------------------------------------------*/
-static box *worst_box(void)
+static box *worst_box(QuantizeContext *pqc)
 {
-   if (heap_size == 0)
+   if (pqc->heap_size == 0)
       return NULL;
    else 
    {
       box *pbox;
-      pbox = heap[1];
+      pbox = pqc->heap[1];
       if (!pbox->variance)
       {
          pbox = NULL;  
@@ -397,27 +551,30 @@ static box *worst_box(void)
 /* Calculate statistics over the specified box. This is an implementation of  */
 /* the "brute force" method of gathering statistics described earlier.        */
 /*----------------------------------------------------------------------------*/
-static void sum_box(box *pbox)
+static void sum_box(QuantizeContext *pqc, box *pbox)
 {
-  INT i, j, r, g, b;
-  uint rs, ts;
-  uint w, tr, tg, tb;
+  INT i, j, r, g, b, a;
+  uint as, rs, ts;
+  uint w, tr, tg, tb, ta;
   HIST_ENTRY_TYPE *rp, *gp, *bp;
 
 
   j = 0;
 
-  tr = tg = tb = i = 0;
+  tr = tg = tb = ta = i = 0;
    if (pbox->fHasSeed)
    {
       pbox->SeedVariance = 0;
    }
 
-  rp = hist + ((pbox->ir * R_STRIDE) + (pbox->ig * G_STRIDE) + pbox->ib);
+  for (a = pbox->ia; a <= pbox->ja; a++)
+  {
+  as = a * a;
+  rp = HIST_AT (pqc, pbox->ir, pbox->ig, pbox->ib, a);
 
   for (r = pbox->ir; r <= pbox->jr; r++)
   {
-    rs = r * r;
+    rs = as + r * r;
     gp = rp;
 
     for (g = pbox->ig; g <= pbox->jg; g++)
@@ -434,14 +591,16 @@ static void sum_box(box *pbox)
           tr += r * w;
           tg += g * w;
           tb += b * w;
+          ta += a * w;
           i  += (ts + b * b) * w;
           if (pbox->fHasSeed)
           {
-            INT rdiff, gdiff, bdiff;
+            INT rdiff, gdiff, bdiff, adiff;
             rdiff = (r - pbox->rSeed);
             gdiff = (g - pbox->gSeed);
             bdiff = (b - pbox->bSeed);
-            pbox->SeedVariance += w * ((uint)(rdiff * rdiff) + (uint)(gdiff * gdiff) + (uint)(bdiff * bdiff));
+            adiff = (a - pbox->aSeed);
+            pbox->SeedVariance += w * ((uint)(rdiff * rdiff) + (uint)(gdiff * gdiff) + (uint)(bdiff * bdiff) + (uint)(adiff * adiff));
           }
         }
       }
@@ -450,32 +609,39 @@ static void sum_box(box *pbox)
 
     rp += R_STRIDE;
   }
+  }
 
   pbox->total_weight = j;
   pbox->tt_sum       = i;
   pbox->t_ur         = tr;
   pbox->t_ug         = tg;
   pbox->t_ub         = tb;
+  pbox->t_ua         = ta;
 
 } // sum_box
 
-static void sum_box_seeded (box *pbox)
+static void sum_box_seeded (QuantizeContext *pqc, box *pbox)
 {
-  INT i, j, r, g, b;
-  uint rs, ts;
-  uint w, tr, tg, tb;
+  INT i, j, r, g, b, a;
+  uint as, rs, ts;
+  uint w, tr, tg, tb, ta;
   HIST_ENTRY_TYPE *rp, *gp, *bp;
+  SEEDINFO *arseedinfo = pqc->arseedinfo;
+  int NumSeeded = pqc->NumSeeded;
 
 
   j = 0;
 
-  tr = tg = tb = i = 0;
+  tr = tg = tb = ta = i = 0;
 
-  rp = hist + ((pbox->ir * R_STRIDE) + (pbox->ig * G_STRIDE) + pbox->ib);
+  for (a = pbox->ia; a <= pbox->ja; a++)
+  {
+  as = a * a;
+  rp = HIST_AT (pqc, pbox->ir, pbox->ig, pbox->ib, a);
 
   for (r = pbox->ir; r <= pbox->jr; r++)
   {
-    rs = r * r;
+    rs = as + r * r;
     gp = rp;
 
     for (g = pbox->ig; g <= pbox->jg; g++)
@@ -493,11 +659,13 @@ static void sum_box_seeded (box *pbox)
           pbox->rSeed = r;
           pbox->gSeed = g;
           pbox->bSeed = b;
+          pbox->aSeed = a;
         }
           j  += w;
           tr += r * w;
           tg += g * w;
           tb += b * w;
+          ta += a * w;
           i  += (ts + b * b) * w;
       }
       gp += G_STRIDE;
@@ -505,15 +673,303 @@ static void sum_box_seeded (box *pbox)
 
     rp += R_STRIDE;
   }
+  }
 
   pbox->total_weight = j;
   pbox->tt_sum       = i;
   pbox->t_ur         = tr;
   pbox->t_ug         = tg;
   pbox->t_ub         = tb;
+  pbox->t_ua         = ta;
    
 } // sum_box_seeded
 
+#if !QUANTIZE_ALPHA
+/*----------------------------------------------------------------------------*/
+/* Cumulative moment tables.  Every sum is modulo 2^32 like the uint sums in  */
+/* sum_box() so adding and subtracting corners gives exactly what sum_box()   */
+/* would have added up.                                                       */
+/*----------------------------------------------------------------------------*/
+static void moment_add(MOMENT *d, const MOMENT *s)
+{
+   d->w    += s->w;
+   d->r    += s->r;
+   d->g    += s->g;
+   d->b    += s->b;
+   d->rgb2 += s->rgb2;
+   d->used += s->used;
+}
+
+/*----------------------------------------------------------------------------*/
+/* Builds pqc->pMoments from the histogram as it will be once the seeds have  */
+/* been put back (seeds count as at least 1).  Returns FALSE if out of memory.*/
+/*----------------------------------------------------------------------------*/
+static int build_moments(QuantizeContext *pqc)
+{
+   MOMENT *pm;
+   INT r, g, b;
+
+   if (!pqc->pMoments)
+   {
+      if ((pqc->pMoments = (MOMENT *)malloc(MOM_CELLS * sizeof(MOMENT))) == NULL)
+         return FALSE;
+   }
+   pm = pqc->pMoments;
+   memset (pm, 0, MOM_CELLS * sizeof(MOMENT));
+
+   for (r = 0; r < HIST_MAX; r++)
+   {
+      for (g = 0; g < HIST_MAX; g++)
+      {
+         HIST_ENTRY_TYPE *ph = HIST_AT (pqc, r, g, 0, 0);
+         MOMENT *p = MOM_AT (pm, r + 1, g + 1, 1);
+         uint ts = r * r + g * g;
+
+         for (b = 0; b < HIST_MAX; b++, ph++, p++)
+         {
+            uint w = *ph;
+
+            if (w)
+            {
+               if (w <= (uint)pqc->NumSeeded && pqc->arseedinfo[w].phist == ph)
+               {
+                  w = pqc->arseedinfo[w].histValue;
+                  w = (0 == w) ? 1 : w;
+               }
+               p->w    = w;
+               p->r    = r * w;
+               p->g    = g * w;
+               p->b    = b * w;
+               p->rgb2 = (ts + b * b) * w;
+               p->used = 1;
+            }
+         }
+      }
+   }
+
+   // Running sums along b then g then r.
+   for (r = 1; r < MOM_SIDE; r++)
+      for (g = 1; g < MOM_SIDE; g++)
+         for (b = 2; b < MOM_SIDE; b++)
+            moment_add (MOM_AT (pm, r, g, b), MOM_AT (pm, r, g, b - 1));
+
+   for (r = 1; r < MOM_SIDE; r++)
+      for (g = 2; g < MOM_SIDE; g++)
+         for (b = 1; b < MOM_SIDE; b++)
+            moment_add (MOM_AT (pm, r, g, b), MOM_AT (pm, r, g - 1, b));
+
+   for (r = 2; r < MOM_SIDE; r++)
+      for (g = 1; g < MOM_SIDE; g++)
+         for (b = 1; b < MOM_SIDE; b++)
+            moment_add (MOM_AT (pm, r, g, b), MOM_AT (pm, r - 1, g, b));
+
+   return TRUE;
+}
+
+/*----------------------------------------------------------------------------*/
+/* Sums of the cells ir..jr, ig..jg, ib..jb.                                  */
+/*----------------------------------------------------------------------------*/
+static void moment_volume(const MOMENT *pm,
+                          INT ir, INT ig, INT ib,
+                          INT jr, INT jg, INT jb,
+                          MOMENT *pv)
+{
+   const MOMENT *p0, *p1, *p2, *p3, *p4, *p5, *p6, *p7;
+
+   jr++; jg++; jb++;
+
+   p0 = MOM_AT (pm, jr, jg, jb);
+   p1 = MOM_AT (pm, ir, jg, jb);
+   p2 = MOM_AT (pm, jr, ig, jb);
+   p3 = MOM_AT (pm, jr, jg, ib);
+   p4 = MOM_AT (pm, ir, ig, jb);
+   p5 = MOM_AT (pm, ir, jg, ib);
+   p6 = MOM_AT (pm, jr, ig, ib);
+   p7 = MOM_AT (pm, ir, ig, ib);
+
+   #define MOM_VOLUME(f)   (p0->f - p1->f - p2->f - p3->f + p4->f + p5->f + p6->f - p7->f)
+   pv->w    = MOM_VOLUME(w);
+   pv->r    = MOM_VOLUME(r);
+   pv->g    = MOM_VOLUME(g);
+   pv->b    = MOM_VOLUME(b);
+   pv->rgb2 = MOM_VOLUME(rgb2);
+   pv->used = MOM_VOLUME(used);
+   #undef MOM_VOLUME
+}
+
+/*----------------------------------------------------------------------------*/
+/* shrink_box() for qeMoments.  Each bound is a binary search on the count of */
+/* used cells.                                                                */
+/*----------------------------------------------------------------------------*/
+static void shrink_box_moments(QuantizeContext *pqc, box *pbox)
+{
+   const MOMENT *pm = pqc->pMoments;
+   INT ir = pbox->ir, ig = pbox->ig, ib = pbox->ib;
+   INT jr = pbox->jr, jg = pbox->jg, jb = pbox->jb;
+   INT lo, hi, mid;
+   MOMENT m;
+
+   moment_volume (pm, ir, ig, ib, jr, jg, jb, &m);
+   if (!m.used)
+   {
+      return;
+   }
+
+   // lowest r used
+   for (lo = ir, hi = jr; lo < hi; )
+   {
+      mid = (lo + hi) >> 1;
+      moment_volume (pm, ir, ig, ib, mid, jg, jb, &m);
+      if (m.used) hi = mid; else lo = mid + 1;
+   }
+   pbox->ir = lo;
+
+   // highest r used
+   for (lo = ir, hi = jr; lo < hi; )
+   {
+      mid = (lo + hi + 1) >> 1;
+      moment_volume (pm, mid, ig, ib, jr, jg, jb, &m);
+      if (m.used) lo = mid; else hi = mid - 1;
+   }
+   pbox->jr = lo;
+
+   // lowest g used
+   for (lo = ig, hi = jg; lo < hi; )
+   {
+      mid = (lo + hi) >> 1;
+      moment_volume (pm, ir, ig, ib, jr, mid, jb, &m);
+      if (m.used) hi = mid; else lo = mid + 1;
+   }
+   pbox->ig = lo;
+
+   // highest g used
+   for (lo = ig, hi = jg; lo < hi; )
+   {
+      mid = (lo + hi + 1) >> 1;
+      moment_volume (pm, ir, mid, ib, jr, jg, jb, &m);
+      if (m.used) lo = mid; else hi = mid - 1;
+   }
+   pbox->jg = lo;
+
+   // lowest b used
+   for (lo = ib, hi = jb; lo < hi; )
+   {
+      mid = (lo + hi) >> 1;
+      moment_volume (pm, ir, ig, ib, jr, jg, mid, &m);
+      if (m.used) hi = mid; else lo = mid + 1;
+   }
+   pbox->ib = lo;
+
+   // highest b used
+   for (lo = ib, hi = jb; lo < hi; )
+   {
+      mid = (lo + hi + 1) >> 1;
+      moment_volume (pm, ir, ig, mid, jr, jg, jb, &m);
+      if (m.used) lo = mid; else hi = mid - 1;
+   }
+   pbox->jb = lo;
+}
+
+/*----------------------------------------------------------------------------*/
+/* sum_box() for qeMoments.                                                   */
+/*----------------------------------------------------------------------------*/
+static void sum_box_moments(QuantizeContext *pqc, box *pbox)
+{
+   MOMENT m;
+
+   moment_volume (pqc->pMoments, pbox->ir, pbox->ig, pbox->ib, pbox->jr, pbox->jg, pbox->jb, &m);
+
+   pbox->total_weight = m.w;
+   pbox->tt_sum       = m.rgb2;
+   pbox->t_ur         = m.r;
+   pbox->t_ug         = m.g;
+   pbox->t_ub         = m.b;
+   pbox->t_ua         = 0;
+
+   if (pbox->fHasSeed)
+   {
+      // sum of w * ((r-rSeed)^2 + (g-gSeed)^2 + (b-bSeed)^2) multiplied out
+      uint rs = pbox->rSeed;
+      uint gs = pbox->gSeed;
+      uint bs = pbox->bSeed;
+
+      pbox->SeedVariance = m.rgb2
+                         - 2 * (rs * m.r + gs * m.g + bs * m.b)
+                         + (rs * rs + gs * gs + bs * bs) * m.w;
+   }
+}
+
+/*----------------------------------------------------------------------------*/
+/* sum_box_seeded() for qeMoments.  Every cell weighs 1, which has a closed   */
+/* form, and the few seeds weigh HIST_ENTRY_TYPEMAX.                          */
+/*----------------------------------------------------------------------------*/
+static uint sum_of(INT i, INT j)          /* i + ... + j */
+{
+   return (uint)((i + j) * (j - i + 1) / 2);
+}
+
+static uint sum_of_squares(INT i, INT j)  /* i*i + ... + j*j */
+{
+   return (uint)((j * (j + 1) * (2 * j + 1) - (i - 1) * i * (2 * i - 1)) / 6);
+}
+
+static void sum_box_seeded_moments(QuantizeContext *pqc, box *pbox)
+{
+   uint nr, ng, nb;
+   uint w, tr, tg, tb, tt;
+   int  i;
+   INT  lastSeed;
+   SEEDINFO *ps;
+
+   nr = pbox->jr - pbox->ir + 1;
+   ng = pbox->jg - pbox->ig + 1;
+   nb = pbox->jb - pbox->ib + 1;
+
+   w  = nr * ng * nb;
+   tr = sum_of (pbox->ir, pbox->jr) * ng * nb;
+   tg = sum_of (pbox->ig, pbox->jg) * nr * nb;
+   tb = sum_of (pbox->ib, pbox->jb) * nr * ng;
+   tt = sum_of_squares (pbox->ir, pbox->jr) * ng * nb
+      + sum_of_squares (pbox->ig, pbox->jg) * nr * nb
+      + sum_of_squares (pbox->ib, pbox->jb) * nr * ng;
+
+   // sum_box_seeded() keeps the last seed it comes to.
+   lastSeed = -1;
+   for (i = pqc->NumSeeded, ps = pqc->arseedinfo + 1; i; i--, ps++)
+   {
+      if (  pbox->ir <= ps->r && ps->r <= pbox->jr
+         && pbox->ig <= ps->g && ps->g <= pbox->jg
+         && pbox->ib <= ps->b && ps->b <= pbox->jb
+      )
+      {
+         uint extra = HIST_ENTRY_TYPEMAX - 1;
+         INT  order = (ps->r * HIST_MAX + ps->g) * HIST_MAX + ps->b;
+
+         w  += extra;
+         tr += ps->r * extra;
+         tg += ps->g * extra;
+         tb += ps->b * extra;
+         tt += (uint)(ps->r * ps->r + ps->g * ps->g + ps->b * ps->b) * extra;
+
+         if (order > lastSeed)
+         {
+            lastSeed = order;
+            pbox->rSeed = ps->r;
+            pbox->gSeed = ps->g;
+            pbox->bSeed = ps->b;
+         }
+      }
+   }
+
+   pbox->total_weight = w;
+   pbox->tt_sum       = tt;
+   pbox->t_ur         = tr;
+   pbox->t_ug         = tg;
+   pbox->t_ub         = tb;
+   pbox->t_ua         = 0;
+}
+#endif // !QUANTIZE_ALPHA
+
 /*----------------------------------------------------------------------------*/
 
 static uint get_variance(box *pbox)
@@ -534,6 +990,7 @@ static uint get_variance(box *pbox)
       temp  = (double)pbox->t_ur * (double)pbox->t_ur;
       temp += (double)pbox->t_ug * (double)pbox->t_ug;
       temp += (double)pbox->t_ub * (double)pbox->t_ub;
+      temp += (double)pbox->t_ua * (double)pbox->t_ua;
       temp /= (double)pbox->total_weight;
       variance = ((uint)((double)pbox->tt_sum - temp));
    }
@@ -541,51 +998,79 @@ static uint get_variance(box *pbox)
    return variance;
 }
 
+/*----------------------------------------------------------------------------*/
+/* Moves the slice mid_box from right_box to left_box.                        */
+/*----------------------------------------------------------------------------*/
+static void move_slice(box *left_box, box *mid_box, box *right_box)
+{
+    left_box->total_weight += mid_box->total_weight;
+    left_box->tt_sum       += mid_box->tt_sum;
+    left_box->t_ur         += mid_box->t_ur;
+    left_box->t_ug         += mid_box->t_ug;
+    left_box->t_ub         += mid_box->t_ub;
+    left_box->t_ua         += mid_box->t_ua;
+
+    right_box->total_weight -= mid_box->total_weight;
+    right_box->tt_sum       -= mid_box->tt_sum;
+    right_box->t_ur         -= mid_box->t_ur;
+    right_box->t_ug         -= mid_box->t_ug;
+    right_box->t_ub         -= mid_box->t_ub;
+    right_box->t_ua         -= mid_box->t_ua;
+}
+
+/*----------------------------------------------------------------------------*/
+/* Puts left_box back to empty and right_box back to the whole original box.  */
+/*----------------------------------------------------------------------------*/
+static void reset_split(box *left_box, box *right_box, const box *original)
+{
+   left_box->total_weight         = 0;
+   left_box->tt_sum               = 0;
+   left_box->t_ur                 = 0;
+   left_box->t_ug                 = 0;
+   left_box->t_ub                 = 0;
+   left_box->t_ua                 = 0;
+   left_box->fHasSeed             = FALSE;
+
+   right_box->total_weight         = original->total_weight;
+   right_box->tt_sum               = original->tt_sum;
+   right_box->t_ur                 = original->t_ur;
+   right_box->t_ug                 = original->t_ug;
+   right_box->t_ub                 = original->t_ub;
+   right_box->t_ua                 = original->t_ua;
+   right_box->fHasSeed             = original->fHasSeed;
+}
 
 /*----------------------------------------------------------------------------*/
 /* Splits box along the axis which will minimize the two new box's overall    */
 /* variance. A search on each axis is used to locate the optimum split point. */
 /*----------------------------------------------------------------------------*/
-static void split_box(box *original_box)
+static void split_box(QuantizeContext *pqc, box *original_box)
 {
    INT icase;
    box *left_box;
    box *right_box;                
    box *mid_box, mid_box_struct;
+   box original;                   // copy of the box before it's split
    int fHasSeed;
     uint left_variance, right_variance;
     uint left_variance_r, right_variance_r;
     uint left_variance_g, right_variance_g;
     uint left_variance_b, right_variance_b;
+    uint left_variance_a, right_variance_a;
          
    /* Original box values  */
    uint total_weight;
-   uint tt_sum, t_ur, t_ug, t_ub;
-   INT  ir, ig, ib, jr, jg, jb;
-   
-   #if 0
-   /* Left box values */
-   uint total_weight1;
-   uint tt_sum1, t_ur1, t_ug1, t_ub1;
-   INT  ir1, ig1, ib1, jr1, jg1, jb1;
-   
-   /* Right box values */   
-   uint total_weight2;
-   uint tt_sum2, t_ur2, t_ug2, t_ub2;
-   INT  ir2, ig2, ib2, jr2, jg2, jb2;
+   uint tt_sum, t_ur, t_ug, t_ub, t_ua;
+   INT  ir, ig, ib, ia, jr, jg, jb, ja;
    
-   /* Mid box values */   
-   uint total_weight3;
-   uint tt_sum3, t_ur3, t_ug3, t_ub3;
-   #endif
-   
-   uint lowest_variance, variance_r, variance_g, variance_b;
-   INT  pick_r, pick_g, pick_b;
+   uint lowest_variance, variance_r, variance_g, variance_b, variance_a;
+   INT  pick_r, pick_g, pick_b, pick_a;
    
-   left_box = boxes + num_boxes; 
-   num_boxes++;
+   left_box = pqc->boxes + pqc->num_boxes;
+   pqc->num_boxes++;
    mid_box = &mid_box_struct;     // used for slice of box moved over from 
    right_box = original_box;       
+   original = *original_box;
    
    fHasSeed = right_box->fHasSeed;
    total_weight          = right_box->total_weight;
@@ -593,41 +1078,28 @@ static void split_box(box *original_box)
    t_ur                  = right_box->t_ur;
    t_ug                  = right_box->t_ug;
    t_ub                  = right_box->t_ub;
+   t_ua                  = right_box->t_ua;
    ir                    = right_box->ir;
    ig                    = right_box->ig;
    ib                    = right_box->ib;
+   ia                    = right_box->ia;
    jr                    = right_box->jr;
    jg                    = right_box->jg;
    jb                    = right_box->jb;
+   ja                    = right_box->ja;
 
    mid_box->fHasSeed          = right_box->fHasSeed          ;
    mid_box->rSeed             = left_box->rSeed = right_box->rSeed            ;
    mid_box->gSeed             = left_box->gSeed = right_box->gSeed             ;
    mid_box->bSeed             = left_box->bSeed = right_box->bSeed             ;
+   mid_box->aSeed             = left_box->aSeed = right_box->aSeed             ;
    
    
 /************************************************************/
    /* left box's initial statistics */
-   
-   left_box->total_weight         = 0;
-   left_box->tt_sum               = 0;
-   left_box->t_ur                 = 0;
-   left_box->t_ug                 = 0;
-   left_box->t_ub                 = 0;
-   left_box->fHasSeed             = FALSE;
-   
-   #if 0
-   /* right box's initial statistics */
-   
-   right_box->total_weight         = total_weight;
-   right_box->tt_sum               = tt_sum;
-   right_box->t_ur                 = t_ur;
-   right_box->t_ug                 = t_ug;
-   right_box->t_ub                 = t_ub;
-   #else
    /* right box's initial statistics are already set as values of original box */
-   #endif
    
+   reset_split (left_box, right_box, &original);
    
    /* Note: One useful optimization has been purposefully omitted from the
    * following loops. The variance function is always called twice per
@@ -644,9 +1116,11 @@ static void split_box(box *original_box)
    left_box->ir = mid_box->ir = right_box->ir = ir;
    left_box->ig = mid_box->ig = right_box->ig = ig;
    left_box->ib = mid_box->ib = right_box->ib = ib;
+   left_box->ia = mid_box->ia = right_box->ia = ia;
    left_box->jr = mid_box->jr = right_box->jr = jr;
    left_box->jg = mid_box->jg = right_box->jg = jg;
    left_box->jb = mid_box->jb = right_box->jb = jb;
+   left_box->ja = mid_box->ja = right_box->ja = ja;
    
    for (
       left_box->jr = ir,
@@ -666,7 +1140,7 @@ static void split_box(box *original_box)
      * away from the right box and given to the left box
      */
      
-    pfnSumBox (mid_box);
+    pqc->pfnSumBox (pqc, mid_box);
 
    #ifdef DEBUGGING
     ASSERT (mid_box->total_weight <= total_weight);
@@ -674,17 +1148,7 @@ static void split_box(box *original_box)
 
     /* update left and right box's statistics */
 
-    left_box->total_weight += mid_box->total_weight;
-    left_box->tt_sum       += mid_box->tt_sum;
-    left_box->t_ur         += mid_box->t_ur;
-    left_box->t_ug         += mid_box->t_ug;
-    left_box->t_ub         += mid_box->t_ub;
-
-    right_box->total_weight -= mid_box->total_weight;
-    right_box->tt_sum       -= mid_box->tt_sum;
-    right_box->t_ur         -= mid_box->t_ur;
-    right_box->t_ug         -= mid_box->t_ug;
-    right_box->t_ub         -= mid_box->t_ub;
+    move_slice (left_box, mid_box, right_box);
 
     if (fHasSeed)
     {
@@ -719,22 +1183,7 @@ static void split_box(box *original_box)
   }
 /************************************************************/
 
-  /* left box's initial statistics */
-   left_box->total_weight         = 0;
-   left_box->tt_sum               = 0;
-   left_box->t_ur                 = 0;
-   left_box->t_ug                 = 0;
-   left_box->t_ub                 = 0;
-   left_box->fHasSeed             = FALSE;
-
-  /* right box's initial statistics */
-
-   right_box->total_weight         = total_weight;
-   right_box->tt_sum               = tt_sum;
-   right_box->t_ur                 = t_ur;
-   right_box->t_ug                 = t_ug;
-   right_box->t_ub                 = t_ub;
-   right_box->fHasSeed             = fHasSeed;
+   reset_split (left_box, right_box, &original);
    
   /* locate optimum split point on green axis */
 
@@ -762,25 +1211,15 @@ static void split_box(box *original_box)
      * away from the right box and given to the left box
      */
 
-      pfnSumBox (mid_box);
+      pqc->pfnSumBox (pqc, mid_box);
 
    #ifdef DEBUGGING
-    ASSERT (mid_box->total_weight3 <= total_weight);
+    ASSERT (mid_box->total_weight <= total_weight);
    #endif
 
     /* update left and right box's statistics */
 
-    left_box->total_weight += mid_box->total_weight;
-    left_box->tt_sum       += mid_box->tt_sum;
-    left_box->t_ur         += mid_box->t_ur;
-    left_box->t_ug         += mid_box->t_ug;
-    left_box->t_ub         += mid_box->t_ub;
-
-    right_box->total_weight -= mid_box->total_weight;
-    right_box->tt_sum       -= mid_box->tt_sum;
-    right_box->t_ur         -= mid_box->t_ur;
-    right_box->t_ug         -= mid_box->t_ug;
-    right_box->t_ub         -= mid_box->t_ub;
+    move_slice (left_box, mid_box, right_box);
 
     if (fHasSeed)
     {
@@ -815,23 +1254,8 @@ static void split_box(box *original_box)
   }
 
 /************************************************************/
-  /* left box's initial statistics */
-
-   left_box->total_weight         = 0;
-   left_box->tt_sum               = 0;
-   left_box->t_ur                 = 0;
-   left_box->t_ug                 = 0;
-   left_box->t_ub                 = 0;
-   left_box->fHasSeed             = FALSE;
 
-  /* right box's initial statistics */
-
-   right_box->total_weight         = total_weight;
-   right_box->tt_sum               = tt_sum;
-   right_box->t_ur                 = t_ur;
-   right_box->t_ug                 = t_ug;
-   right_box->t_ub                 = t_ub;
-   right_box->fHasSeed             = fHasSeed;
+   reset_split (left_box, right_box, &original);
 
   /* locate optimum split point on blue axis */
   
@@ -841,7 +1265,6 @@ static void split_box(box *original_box)
    mid_box->ig = right_box->ig = ig;
    mid_box->jg = left_box->jg  = jg;
    
-   //for (i = ib; i < jb; i++)
    for (
       left_box->jb = ib,
       mid_box->jb = ib, 
@@ -860,9 +1283,7 @@ static void split_box(box *original_box)
      * away from the right box and given to the left box
      */
 
-      pfnSumBox(mid_box);
-    //sum(ir, ig, i, jr, jg, i,
-    //    &total_weight3, &tt_sum3, &t_ur3, &t_ug3, &t_ub3);
+      pqc->pfnSumBox (pqc, mid_box);
 
    #ifdef DEBUGGING
     ASSERT (mid_box->total_weight <= total_weight);
@@ -870,17 +1291,7 @@ static void split_box(box *original_box)
 
     /* update left and right box's statistics */
 
-    left_box->total_weight += mid_box->total_weight;
-    left_box->tt_sum       += mid_box->tt_sum;
-    left_box->t_ur         += mid_box->t_ur;
-    left_box->t_ug         += mid_box->t_ug;
-    left_box->t_ub         += mid_box->t_ub;
-
-    right_box->total_weight -= mid_box->total_weight;
-    right_box->tt_sum       -= mid_box->tt_sum;
-    right_box->t_ur         -= mid_box->t_ur;
-    right_box->t_ug         -= mid_box->t_ug;
-    right_box->t_ub         -= mid_box->t_ub;
+    move_slice (left_box, mid_box, right_box);
 
     if (fHasSeed)
     {
@@ -916,24 +1327,88 @@ static void split_box(box *original_box)
 
 /************************************************************/
 
+   reset_split (left_box, right_box, &original);
+
+  /* locate optimum split point on alpha axis (0..0 without QUANTIZE_ALPHA) */
+
+   variance_a = 0xFFFFFFFF;
+
    /* restore changed box boundries */
    mid_box->ib = right_box->ib = ib;
    mid_box->jb = left_box->jb  = jb;
 
-  /* now find out which axis should be split */
+   for (
+      left_box->ja = ia,
+      mid_box->ja = ia,
+      right_box->ia = ia+1
+      ;
+      mid_box->ia < ja
+      ;
+      left_box->ja++,
+      mid_box->ia++, mid_box->ja++,
+      right_box->ia++
+   )
+   {
+    uint total_variance;
 
-  lowest_variance = variance_r;
-  icase = 0;
-  left_variance = left_variance_r;
-  right_variance = right_variance_r;
+    /* calculate the statistics for the area being taken
+     * away from the right box and given to the left box
+     */
 
-  if (variance_g < lowest_variance)
-  {
-    lowest_variance = variance_g;
-    icase = 1;
-     left_variance = left_variance_g;
-     right_variance = right_variance_g;
-  }
+      pqc->pfnSumBox (pqc, mid_box);
+
+    /* update left and right box's statistics */
+
+    move_slice (left_box, mid_box, right_box);
+
+    if (fHasSeed)
+    {
+       left_box->SeedVariance += mid_box->SeedVariance;
+       right_box->SeedVariance -= mid_box->SeedVariance;
+
+       // See if set color moved from right box to left box
+       if ( right_box->fHasSeed && right_box->aSeed < right_box->ia)
+       {
+         left_box->fHasSeed = TRUE;
+         right_box->fHasSeed = FALSE;
+       }
+    }
+
+    /* calculate left and right box's overall variance */
+
+    total_variance = get_variance(left_box) + get_variance (right_box);
+
+    /* found better split point? if so, remember it */
+
+    if (total_variance < variance_a)
+    {
+      variance_a = total_variance;
+      pick_a = mid_box->ia;
+      left_variance_a = get_variance (left_box);
+      right_variance_a = get_variance (right_box);
+    }
+  }
+
+/************************************************************/
+
+   /* restore changed box boundries */
+   mid_box->ia = right_box->ia = ia;
+   mid_box->ja = left_box->ja  = ja;
+
+  /* now find out which axis should be split */
+
+  lowest_variance = variance_r;
+  icase = 0;
+  left_variance = left_variance_r;
+  right_variance = right_variance_r;
+
+  if (variance_g < lowest_variance)
+  {
+    lowest_variance = variance_g;
+    icase = 1;
+     left_variance = left_variance_g;
+     right_variance = right_variance_g;
+  }
 
   if (variance_b < lowest_variance)
   {
@@ -943,29 +1418,43 @@ static void split_box(box *original_box)
     right_variance = right_variance_b;
   }
 
+  if (variance_a < lowest_variance)
+  {
+    lowest_variance = variance_a;
+    icase = 3;
+    left_variance = left_variance_a;
+    right_variance = right_variance_a;
+  }
+
   /* split box on the selected axis */
 
-  left_box->ir = ir; left_box->ig = ig; left_box->ib = ib;
-  right_box->jr = jr; right_box->jg = jg; right_box->jb = jb;
+  left_box->ir = ir; left_box->ig = ig; left_box->ib = ib; left_box->ia = ia;
+  right_box->jr = jr; right_box->jg = jg; right_box->jb = jb; right_box->ja = ja;
 
   switch (icase)
   {
     case 0:
     {
-      left_box->jr = pick_r + 0; left_box->jg = jg; left_box->jb = jb;
-      right_box->ir = pick_r + 1; right_box->ig = ig; right_box->ib = ib;
+      left_box->jr = pick_r + 0; left_box->jg = jg; left_box->jb = jb; left_box->ja = ja;
+      right_box->ir = pick_r + 1; right_box->ig = ig; right_box->ib = ib; right_box->ia = ia;
       break;
     }
     case 1:
     {
-      left_box->jr = jr; left_box->jg = pick_g + 0; left_box->jb = jb;
-      right_box->ir = ir; right_box->ig = pick_g + 1; right_box->ib = ib;
+      left_box->jr = jr; left_box->jg = pick_g + 0; left_box->jb = jb; left_box->ja = ja;
+      right_box->ir = ir; right_box->ig = pick_g + 1; right_box->ib = ib; right_box->ia = ia;
       break;
     }
     case 2:
     {
-      left_box->jr = jr; left_box->jg = jg; left_box->jb = pick_b + 0;
-      right_box->ir = ir; right_box->ig = ig; right_box->ib = pick_b + 1;
+      left_box->jr = jr; left_box->jg = jg; left_box->jb = pick_b + 0; left_box->ja = ja;
+      right_box->ir = ir; right_box->ig = ig; right_box->ib = pick_b + 1; right_box->ia = ia;
+      break;
+    }
+    case 3:
+    {
+      left_box->jr = jr; left_box->jg = jg; left_box->jb = jb; left_box->ja = pick_a + 0;
+      right_box->ir = ir; right_box->ig = ig; right_box->ib = ib; right_box->ia = pick_a + 1;
       break;
     }
   }
@@ -978,6 +1467,7 @@ static void split_box(box *original_box)
       if (  right_box->ir <= right_box->rSeed &&  right_box->rSeed <= right_box->jr
          && right_box->ig <= right_box->gSeed &&  right_box->gSeed <= right_box->jg
          && right_box->ib <= right_box->bSeed &&  right_box->bSeed <= right_box->jb
+         && right_box->ia <= right_box->aSeed &&  right_box->aSeed <= right_box->ja
       )
       {
          right_box->fHasSeed = TRUE;
@@ -992,18 +1482,19 @@ static void split_box(box *original_box)
 
   /* shrink the new boxes to their minimum possible sizes */
 
-  pfnShrinkBox(left_box);
-  pfnShrinkBox(right_box);
+  pqc->pfnShrinkBox(pqc, left_box);
+  pqc->pfnShrinkBox(pqc, right_box);
 
   /* update statistics */
 
-   pfnSumBox (left_box);
+   pqc->pfnSumBox (pqc, left_box);
 
   right_box->total_weight         = total_weight - left_box->total_weight;
   right_box->tt_sum               = tt_sum - left_box->tt_sum;
   right_box->t_ur                 = t_ur - left_box->t_ur;
   right_box->t_ug                 = t_ug - left_box->t_ug;
   right_box->t_ub                 = t_ub - left_box->t_ub;
+  right_box->t_ua                 = t_ua - left_box->t_ua;
 
   /* create the new boxes */
   left_box->variance = left_variance;
@@ -1012,41 +1503,41 @@ static void split_box(box *original_box)
   /* enter all splittable boxes into the priory queue */
   
   icase = 0;
-  if ((right_box->jr - right_box->ir) + (right_box->jg - right_box->ig) + (right_box->jb - right_box->ib)) icase = 2;
-  if ((left_box->jr - left_box->ir) + (left_box->jg - left_box->ig) + (left_box->jb - left_box->ib)) icase++;
+  if ((right_box->jr - right_box->ir) + (right_box->jg - right_box->ig) + (right_box->jb - right_box->ib) + (right_box->ja - right_box->ia)) icase = 2;
+  if ((left_box->jr - left_box->ir) + (left_box->jg - left_box->ig) + (left_box->jb - left_box->ib) + (left_box->ja - left_box->ia)) icase++;
 
   switch (icase)
   {
     case 0: // Neither box is further splitable.
     {
-      heap[1] = heap[heap_size]; // Overwrite old box in heap  with copy of smaller box at bottom of heap.
+      pqc->heap[1] = pqc->heap[pqc->heap_size]; // Overwrite old box in heap  with copy of smaller box at bottom of heap.
 
-      heap_size--;   // shrink heap size, effectively deleting smaller box at bottom of heap.
+      pqc->heap_size--;   // shrink heap size, effectively deleting smaller box at bottom of heap.
 
-      if (heap_size)
-        down_heap(); // adjust heap to account for smaller sized box introduced at root.
+      if (pqc->heap_size)
+        down_heap(pqc); // adjust heap to account for smaller sized box introduced at root.
 
       break;
     }
     case 1: // new left_box is splitable, old right_box is not.
     {
-      heap[1] = left_box;  // replace old box position in heap with new box
+      pqc->heap[1] = left_box;  // replace old box position in heap with new box
 
-      down_heap();   // adjust heap to account for smaller size of box that is replacing old box.
+      down_heap(pqc);   // adjust heap to account for smaller size of box that is replacing old box.
 
       break;
     }
     case 2: // Old right_box is splittable, new left_box is not.
     {
-      down_heap();   // just adjust heap to account for reduced size of old box that was already in heap.
+      down_heap(pqc);   // just adjust heap to account for reduced size of old box that was already in heap.
 
       break;
     }
     case 3: // Both boxes are splittable
     {
-      down_heap();   // adjust heap to account for reduced size of old box that was already in heap.
+      down_heap(pqc);   // adjust heap to account for reduced size of old box that was already in heap.
 
-      insert_heap(left_box);  // insert new box into heap.
+      insert_heap(pqc, left_box);  // insert new box into heap.
 
       break;
     }
@@ -1057,7 +1548,7 @@ static void split_box(box *original_box)
 /*----------------------------------------------------------------------------*/
 /* Creates new colormap.                                                      */
 /*----------------------------------------------------------------------------*/
-static void make_color_map(uchar *color_map, 
+static void make_color_map(QuantizeContext *pqc, uchar *color_map,
     PALETTE_SITE *palsite, int num_pal_entries 
 )
 {
@@ -1065,14 +1556,14 @@ static void make_color_map(uchar *color_map,
    int c;  // Color Table Index.
    box *p;
    
-   p = boxes;
+   p = pqc->boxes;
 
    c = 0;
-   for (i = 0; i < num_boxes; i++, p++)
+   for (i = 0; i < pqc->num_boxes; i++, p++)
    {
       if (p->fHasSeed) {continue;}
       
-      for ( NULL; palsite->SiteKind != skOpen; c++, color_map += 3, palsite++) {};
+      for ( NULL; palsite->SiteKind != skOpen; c++, color_map += QUANTIZE_CHANNELS, palsite++) {};
       
       ASSERT(c < num_pal_entries);
       
@@ -1090,6 +1581,11 @@ static void make_color_map(uchar *color_map,
          *color_map = (uchar)(((p->t_ub << HIST_SHIFT) + (total_weight >> 1)) / total_weight);
          *color_map++ |= (*color_map >> (8 - HIST_SHIFT));
          
+      #if QUANTIZE_ALPHA
+         *color_map = (uchar)(((p->t_ua << HIST_SHIFT) + (total_weight >> 1)) / total_weight);
+         *color_map++ |= (*color_map >> (8 - HIST_SHIFT));
+      #endif
+
          ++c;
          ++palsite;
       }
@@ -1099,34 +1595,58 @@ static void make_color_map(uchar *color_map,
 /*----------------------------------------------------------------------------*/
 /* Create initial box, initialize heap.                                       */
 /*----------------------------------------------------------------------------*/
-static INT initialize(INT colors, 
+static INT initialize(QuantizeContext *pqc, INT colors,
     PALETTE_SITE *palsite, int num_pal_entries
 )
 {
-  total_boxes = colors + NumSeeded; 
+  box *boxes;
+
+  pqc->total_boxes = colors + pqc->NumSeeded;
 
-  if ((heap = malloc(sizeof(box *) * (total_boxes + 1))) == NULL)
-    return TRUE;
+  // The context keeps what it allocated for the next run.
+  if (pqc->total_boxes > pqc->max_boxes)
+  {
+    if (pqc->heap) free(pqc->heap);
+    if (pqc->boxes) free(pqc->boxes);
+    pqc->max_boxes = 0;
+
+    if ((pqc->heap = (box **)malloc(sizeof(box *) * (pqc->total_boxes + 1))) == NULL)
+      return TRUE;
 
-  if ((boxes = calloc(total_boxes, sizeof(box))) == NULL)
-    return TRUE;
+    if ((pqc->boxes = (box *)malloc(pqc->total_boxes * sizeof(box))) == NULL)
+      return TRUE;
+
+    pqc->max_boxes = pqc->total_boxes;
+  }
+  memset (pqc->boxes, 0, pqc->total_boxes * sizeof(box));
+  boxes = pqc->boxes;
 
-  if (NumSeeded)
+  if (pqc->NumSeeded)
   {
-     if ((arseedinfo = calloc((NumSeeded+1), sizeof(SEEDINFO))) == NULL)
-       return TRUE;
+     if (pqc->NumSeeded > pqc->max_seeds)
+     {
+       if (pqc->arseedinfo) free(pqc->arseedinfo);
+       pqc->max_seeds = 0;
+
+       if ((pqc->arseedinfo = (SEEDINFO *)malloc((pqc->NumSeeded+1) * sizeof(SEEDINFO))) == NULL)
+         return TRUE;
+
+       pqc->max_seeds = pqc->NumSeeded;
+     }
+     memset (pqc->arseedinfo, 0, (pqc->NumSeeded+1) * sizeof(SEEDINFO));
       /*
       ** Prepare Seed info
       */
       {
          int i, seed;   
          PALETTE_SITE *ps;
+         SEEDINFO *arseedinfo = pqc->arseedinfo;
          seed = 0;
          for (i = num_pal_entries, ps = palsite;  i;  i--, ps++)
          {
             if (skSeeded == ps->SiteKind)
             {
-               int r,g,b;
+               int r,g,b,a;
                
                HIST_ENTRY_TYPE *ph;
                
@@ -1134,19 +1654,27 @@ static INT initialize(INT colors,
                r = (ps->r >> HIST_SHIFT);
                g = (ps->g >> HIST_SHIFT);
                b = (ps->b >> HIST_SHIFT);
-               ph = hist +  r * R_STRIDE + g * G_STRIDE + b;
+            #if QUANTIZE_ALPHA
+               a = (ps->a >> HIST_SHIFT);
+            #else
+               a = 0;
+            #endif
+               ph = HIST_AT (pqc, r, g, b, a);
                // Check if have collision of two seeds at same histogram site */
                if (0 < *ph && *ph < seed && arseedinfo[*ph].phist == ph)
                {
                   // Collision. So skip this redundant seed.
                   seed--;
-                  NumSeeded--;
+                  pqc->NumSeeded--;
                   ps->SiteKind = skRedundant; // communicate back that this seed position was not used.
                }
                else
                {
                   arseedinfo[seed].phist     = ph;
                   arseedinfo[seed].histValue = *ph;
+                  arseedinfo[seed].r         = r;
+                  arseedinfo[seed].g         = g;
+                  arseedinfo[seed].b         = b;
                   *ph = seed;
                }
             }
@@ -1155,95 +1683,156 @@ static INT initialize(INT colors,
   }
 
 
-  boxes->ir = boxes->ig = boxes->ib = 0;
+  /* pick the engine's box functions */
+  pqc->pfnEngineShrink    = shrink_box;
+  pqc->pfnEngineSum       = sum_box;
+  pqc->pfnEngineSumSeeded = sum_box_seeded;
+#if !QUANTIZE_ALPHA
+  // Out of memory for the tables just means scanning the histogram.
+  if (qeMoments == pqc->engine && build_moments(pqc))
+  {
+    pqc->pfnEngineShrink    = shrink_box_moments;
+    pqc->pfnEngineSum       = sum_box_moments;
+    pqc->pfnEngineSumSeeded = sum_box_seeded_moments;
+  }
+#endif
+
+  boxes->ir = boxes->ig = boxes->ib = boxes->ia = 0;
   boxes->jr = boxes->jg = boxes->jb = HIST_MAX - 1;
+  boxes->ja = QUANTIZE_ALPHA ? HIST_MAX - 1 : 0;
 
   /* shrink initial box to minimum possible size */
-  shrink_box(boxes); // always call real shrink_box here. Don't go through func pointer.
+  pqc->pfnEngineShrink(pqc, boxes); // always call real shrink_box here. Don't go through pfnShrinkBox.
 
 
   /* calculate the initial box's statistics */
-  if (NumSeeded) 
+  if (pqc->NumSeeded)
   {
-   sum_box_seeded (boxes); // always call original sum_box_seeded here. Don't go through func pointer.
+   pqc->pfnEngineSumSeeded (pqc, boxes); // always call original sum_box_seeded here. Don't go through pfnSumBox.
   }
   else
   {
-   sum_box (boxes); // always call original sum_box here. Don't go through func pointer.
+   pqc->pfnEngineSum (pqc, boxes); // always call original sum_box here. Don't go through pfnSumBox.
   }
 
   boxes->variance     = 1;
 
   /* enter box into heap if it's splittable */
 
-  num_boxes           = 1;
-  heap_size           = 0;
+  pqc->num_boxes           = 1;
+  pqc->heap_size           = 0;
 
-  if ((boxes->jr - boxes->ir) + (boxes->jg - boxes->ig) + (boxes->jb - boxes->ib))
+  if ((boxes->jr - boxes->ir) + (boxes->jg - boxes->ig) + (boxes->jb - boxes->ib) + (boxes->ja - boxes->ia))
   {
-    heap[1] = boxes;
-    heap_size = 1;
+    pqc->heap[1] = boxes;
+    pqc->heap_size = 1;
   }
 
   return FALSE;
 }
 
 /*----------------------------------------------------------------------------*/
-int quantize(HIST_ENTRY_TYPE *histogram, int max_colors, uchar *color_map, int *num_colors, 
+/* Counts seeds and open slots and copies preset colors to color_map.         */
+/* Returns FALSE if there aren't max_colors open slots.                       */
+/*----------------------------------------------------------------------------*/
+static int count_sites(QuantizeContext *pqc, int max_colors, uchar *color_map,
+    PALETTE_SITE *palsite, int num_pal_entries
+)
+{
+   int i;
+   PALETTE_SITE *ps;
+   uchar *pcolor;
+
+   pqc->NumSeeded = pqc->NumOpen = 0;
+   for (i = num_pal_entries, ps = palsite, pcolor = color_map;  i;  i--, ps++)
+   {
+      pqc->NumOpen  += (skOpen == ps->SiteKind);
+      pqc->NumSeeded += (skSeeded == ps->SiteKind);
+      /*
+      ** Copy unchangable colors directly into color_table. (Note: copies changable ones 
+      ** too for efficiency but they will get overwritten.) 
+      */
+      *pcolor++ = ps->r;
+      *pcolor++ = ps->g;
+      *pcolor++ = ps->b;
+   #if QUANTIZE_ALPHA
+      *pcolor++ = ps->a;
+   #endif
+   }
+   if (pqc->NumOpen < max_colors)
+   {  
+      EL_printf ("Error: Not enough open slots (%d) in palette for %d quantized colors\n", pqc->NumOpen, max_colors);
+      return FALSE;
+   }
+   return TRUE;
+}
+
+/*----------------------------------------------------------------------------*/
+/* Makes a context for quantize_ctx().  Returns NULL if out of memory.        */
+/*----------------------------------------------------------------------------*/
+QuantizeContext *quantize_create(void)
+{
+   return (QuantizeContext *)calloc(1, sizeof(QuantizeContext));
+}
+
+/*----------------------------------------------------------------------------*/
+void quantize_destroy(QuantizeContext *pqc)
+{
+   if (pqc)
+   {
+      if (pqc->pMoments) free(pqc->pMoments);
+#if !QUANTIZE_ALPHA
+      if (pqc->pScolors) free(pqc->pScolors);
+      if (pqc->psboxes) free(pqc->psboxes);
+#endif
+      if (pqc->arseedinfo) free(pqc->arseedinfo);
+      if (pqc->boxes) free(pqc->boxes);
+      if (pqc->heap) free(pqc->heap);
+      free(pqc);
+   }
+}
+
+/*----------------------------------------------------------------------------*/
+/* Picks how box statistics are gathered.  qeMoments (the default) needs      */
+/* MOM_CELLS * sizeof(MOMENT) more memory and isn't there with QUANTIZE_ALPHA.*/
+/*----------------------------------------------------------------------------*/
+void quantize_set_engine(QuantizeContext *pqc, QUANTIZEENGINE engine)
+{
+   pqc->engine = engine;
+}
+
+/*----------------------------------------------------------------------------*/
+/* Quantizes histogram using pqc.  One context can only be used by one thread */
+/* at a time but contexts can run at the same time on different histograms.   */
+/*----------------------------------------------------------------------------*/
+int quantize_ctx(QuantizeContext *pqc, HIST_ENTRY_TYPE *histogram, int max_colors, uchar *color_map, int *num_colors,
     PALETTE_SITE *palsite, int num_pal_entries
 )
 {
    INT status = FALSE;
    box *pbox;
   
-   heap  = NULL;
-   boxes = NULL;
-   arseedinfo = NULL;
-   
-   hist  = histogram;
+   pqc->hist  = histogram;
   
-   /*
-   ** Count seeds and open slots and copy preset colors to color_table
-   */
+   if (!count_sites(pqc, max_colors, color_map, palsite, num_pal_entries))
    {
-      int i;
-      PALETTE_SITE *ps;
-      uchar *pcolor;
-      
-      NumSeeded = NumOpen = 0;
-      for (i = num_pal_entries, ps = palsite, pcolor = color_map;  i;  i--, ps++)
-      {
-         NumOpen  += (skOpen == ps->SiteKind);
-         NumSeeded += (skSeeded == ps->SiteKind);
-         /*
-         ** Copy unchangable colors directly into color_table. (Note: copies changable ones 
-         ** too for efficiency but they will get overwritten.) 
-         */
-         *pcolor++ = ps->r;
-         *pcolor++ = ps->g;
-         *pcolor++ = ps->b;
-      }
-   }
-   if (NumOpen < max_colors)
-   {  
-      EL_printf ("Error: Not enough open slots (%d) in palette for %d quantized colors\n", NumOpen, max_colors);
       return 2;
    }
    
-   if ((status = initialize(max_colors, palsite, num_pal_entries)) != 0)
+   if ((status = initialize(pqc, max_colors, palsite, num_pal_entries)) != 0)
       goto reduce_error;
 
    /*
    ** Seed preset colors if any 
    */
-   if (NumSeeded)
+   if (pqc->NumSeeded)
    {
       int i;
       box *pbox;
       SEEDINFO *pseedinfo;
       
-      pfnShrinkBox = no_shrink_box;
-      pfnSumBox = sum_box_seeded;
+      pqc->pfnShrinkBox = no_shrink_box;
+      pqc->pfnSumBox = pqc->pfnEngineSumSeeded;
       
 
       /*
@@ -1251,51 +1840,883 @@ int quantize(HIST_ENTRY_TYPE *histogram, int max_colors, uchar *color_map, int *
       ** cube must be represented by the union of the boxes, so the boxes do 
       ** not get shrunk in this pass of the quantization process.  
       */
-      while (num_boxes < NumSeeded)
+      while (pqc->num_boxes < pqc->NumSeeded)
       {
-         if ((pbox = worst_box()) == NULL)
+         if ((pbox = worst_box(pqc)) == NULL)
             break;
    
-         split_box(pbox);
+         split_box(pqc, pbox);
       }
-      ASSERT (num_boxes == NumSeeded);
+      ASSERT (pqc->num_boxes == pqc->NumSeeded);
       
-      for (i = NumSeeded, pbox = boxes; i; i--, pbox++)
+      for (i = pqc->NumSeeded, pbox = pqc->boxes; i; i--, pbox++)
       {
          pbox->fHasSeed = TRUE;
       }
       
       // Restore histogram values at seed positions but make sure they are non zero.
-      for (i = NumSeeded, pseedinfo = arseedinfo+1; i; i--, pseedinfo++)
+      for (i = pqc->NumSeeded, pseedinfo = pqc->arseedinfo+1; i; i--, pseedinfo++)
       {
          *pseedinfo->phist = (0 == pseedinfo->histValue) ? 1 : pseedinfo->histValue;
       }
-      sum_box (boxes); // always call original sum_box here. Don't go through func pointer.
+      pqc->pfnEngineSum (pqc, pqc->boxes); // always call original sum_box here. Don't go through pfnSumBox.
    }
 
-   pfnShrinkBox = shrink_box;
-   pfnSumBox = sum_box;
+   pqc->pfnShrinkBox = pqc->pfnEngineShrink;
+   pqc->pfnSumBox = pqc->pfnEngineSum;
    
-   max_colors += NumSeeded; 
-   while (num_boxes < max_colors)
+   max_colors += pqc->NumSeeded;
+   while (pqc->num_boxes < max_colors)
    {
-    if ((pbox = worst_box()) == NULL)
+    if ((pbox = worst_box(pqc)) == NULL)
       break;
    
-    split_box(pbox);
+    split_box(pqc, pbox);
    }
    
-   make_color_map(color_map, palsite, num_pal_entries);
+   make_color_map(pqc, color_map, palsite, num_pal_entries);
    
-   *num_colors = num_boxes;
+   *num_colors = pqc->num_boxes;
 
 reduce_error:
 
-   if (arseedinfo) free(arseedinfo);
-   if (boxes) free(boxes);
-   if (heap) free(heap);
-   
    return (int)status;
 }
+   
+/*----------------------------------------------------------------------------*/
+int quantize(HIST_ENTRY_TYPE *histogram, int max_colors, uchar *color_map, int *num_colors,
+    PALETTE_SITE *palsite, int num_pal_entries
+)
+{
+   QuantizeContext *pqc;
+   int status;
+
+   if ((pqc = quantize_create()) == NULL)
+      return TRUE;
+
+   status = quantize_ctx(pqc, histogram, max_colors, color_map, num_colors, palsite, num_pal_entries);
+
+   quantize_destroy(pqc);
+
+   return status;
+}
+
+#if !QUANTIZE_ALPHA
+/*----------------------------------------------------------------------------*/
+/* Sparse histograms.  While one is being built it's a hash with linear       */
+/* probing that doubles when it gets half full, so it's only ever as big as   */
+/* the colors in it need.                                                     */
+/*----------------------------------------------------------------------------*/
+#define SPARSE_START_BITS  12     /* a new hash has 1 << this many slots */
+
+#define SPARSE_HASH(rgb,bits)  ((long)((((rgb) * 0x9E3779B1UL) & 0xFFFFFFFFUL) >> (32 - (bits))))
+
+static void sparse_empty(SPARSE_ENTRY *pe, long n)
+{
+   for (; n; n--, pe++)
+   {
+      pe->rgb = SPARSE_EMPTY;
+      pe->count = 0;
+   }
+}
+
+/* The slot rgb is in or the free slot it would go in. */
+static SPARSE_ENTRY *sparse_slot(const SPARSE_HIST *psh, UINT32 rgb)
+{
+   long mask = psh->tableSize - 1;
+   long i = SPARSE_HASH(rgb, psh->tableBits);
+   SPARSE_ENTRY *pe;
+
+   for (;;)
+   {
+      pe = psh->pEntries + i;
+      if (pe->rgb == rgb || pe->rgb == SPARSE_EMPTY)
+         return pe;
+      i = (i + 1) & mask;
+   }
+}
+
+static int sparse_grow(SPARSE_HIST *psh)
+{
+   SPARSE_HIST grown;
+   SPARSE_ENTRY *pe;
+   long i;
+
+   grown = *psh;
+   grown.tableBits++;
+   grown.tableSize <<= 1;
+   if ((grown.pEntries = (SPARSE_ENTRY *)malloc(grown.tableSize * sizeof(SPARSE_ENTRY))) == NULL)
+      return TRUE;
+   sparse_empty (grown.pEntries, grown.tableSize);
+
+   for (i = psh->tableSize, pe = psh->pEntries; i; i--, pe++)
+   {
+      if (pe->rgb != SPARSE_EMPTY)
+         *sparse_slot(&grown, pe->rgb) = *pe;
+   }
+   free (psh->pEntries);
+   *psh = grown;
+
+   return FALSE;
+}
+
+/* The entry for rgb, added with a count of 0 if it's new.  NULL if out of memory. */
+static SPARSE_ENTRY *sparse_entry(SPARSE_HIST *psh, UINT32 rgb)
+{
+   SPARSE_ENTRY *pe;
+
+   ASSERT(!psh->fSorted);
+   pe = sparse_slot(psh, rgb);
+   if (pe->rgb == SPARSE_EMPTY)
+   {
+      if ((psh->numColors + 1) * 2 > psh->tableSize)
+      {
+         if (sparse_grow(psh))
+            return NULL;
+         pe = sparse_slot(psh, rgb);
+      }
+      pe->rgb = rgb;
+      pe->count = 0;
+      psh->numColors++;
+   }
+   return pe;
+}
+
+/*----------------------------------------------------------------------------*/
+/* Makes an empty sparse histogram.  Returns TRUE if out of memory.           */
+/*----------------------------------------------------------------------------*/
+int sparse_hist_init(SPARSE_HIST *psh)
+{
+   psh->numColors = 0;
+   psh->tableBits = SPARSE_START_BITS;
+   psh->tableSize = 1L << SPARSE_START_BITS;
+   psh->fSorted   = FALSE;
+   if ((psh->pEntries = (SPARSE_ENTRY *)malloc(psh->tableSize * sizeof(SPARSE_ENTRY))) == NULL)
+   {
+      psh->tableSize = 0;
+      return TRUE;
+   }
+   sparse_empty (psh->pEntries, psh->tableSize);
+
+   return FALSE;
+}
+
+/*----------------------------------------------------------------------------*/
+void sparse_hist_free(SPARSE_HIST *psh)
+{
+   if (psh->pEntries) free(psh->pEntries);
+   psh->pEntries  = NULL;
+   psh->numColors = 0;
+   psh->tableSize = 0;
+}
+
+/*----------------------------------------------------------------------------*/
+/* Empties a sparse histogram that hasn't been sorted, keeping its memory.    */
+/*----------------------------------------------------------------------------*/
+void sparse_hist_clear(SPARSE_HIST *psh)
+{
+   ASSERT(!psh->fSorted);
+   if (psh->numColors)
+   {
+      sparse_empty (psh->pEntries, psh->tableSize);
+      psh->numColors = 0;
+   }
+}
+
+/*----------------------------------------------------------------------------*/
+/* Adds count pixels of rgb.  Returns TRUE if out of memory.                  */
+/*----------------------------------------------------------------------------*/
+int sparse_hist_add(SPARSE_HIST *psh, UINT32 rgb, UINT32 count)
+{
+   SPARSE_ENTRY *pe;
+
+   if ((pe = sparse_entry(psh, rgb)) == NULL)
+      return TRUE;
+   pe->count = (SPARSE_COUNTMAX - pe->count < count) ? SPARSE_COUNTMAX : pe->count + count;
+
+   return FALSE;
+}
+
+/*----------------------------------------------------------------------------*/
+/* Makes rgb's count at least count.  Returns TRUE if out of memory.          */
+/*----------------------------------------------------------------------------*/
+int sparse_hist_raise(SPARSE_HIST *psh, UINT32 rgb, UINT32 count)
+{
+   SPARSE_ENTRY *pe;
+
+   if ((pe = sparse_entry(psh, rgb)) == NULL)
+      return TRUE;
+   if (pe->count < count)
+      pe->count = count;
+
+   return FALSE;
+}
+
+/*----------------------------------------------------------------------------*/
+/* Adds (or with fMax takes the larger of) every count in pshFrom.  Returns   */
+/* TRUE if out of memory.                                                     */
+/*----------------------------------------------------------------------------*/
+int sparse_hist_merge(SPARSE_HIST *psh, const SPARSE_HIST *pshFrom, int fMax)
+{
+   const SPARSE_ENTRY *pe;
+   long i;
+
+   i = pshFrom->fSorted ? pshFrom->numColors : pshFrom->tableSize;
+   for (pe = pshFrom->pEntries; i; i--, pe++)
+   {
+      if (pe->rgb != SPARSE_EMPTY)
+      {
+         if (fMax ? sparse_hist_raise(psh, pe->rgb, pe->count) : sparse_hist_add(psh, pe->rgb, pe->count))
+            return TRUE;
+      }
+   }
+
+   return FALSE;
+}
+
+static int sparse_compare(const void *p1, const void *p2)
+{
+   UINT32 rgb1 = ((const SPARSE_ENTRY *)p1)->rgb;
+   UINT32 rgb2 = ((const SPARSE_ENTRY *)p2)->rgb;
+
+   return (rgb1 < rgb2) ? -1 : (rgb1 > rgb2);
+}
+
+/*----------------------------------------------------------------------------*/
+/* Turns the hash into a list of the numColors colors sorted by rgb, which    */
+/* is what the quantizer and inv_cmap_sparse() take.  Nothing more can be     */
+/* added after this.                                                          */
+/*----------------------------------------------------------------------------*/
+void sparse_hist_sort(SPARSE_HIST *psh)
+{
+   SPARSE_ENTRY *pe, *peTo, *peShrunk;
+   long i;
+
+   if (psh->fSorted)
+      return;
+
+   for (i = psh->tableSize, pe = peTo = psh->pEntries; i; i--, pe++)
+   {
+      if (pe->rgb != SPARSE_EMPTY)
+         *peTo++ = *pe;
+   }
+   qsort (psh->pEntries, psh->numColors, sizeof(SPARSE_ENTRY), sparse_compare);
+
+   // Give back the empty slots.
+   if (psh->numColors && (peShrunk = (SPARSE_ENTRY *)realloc(psh->pEntries, psh->numColors * sizeof(SPARSE_ENTRY))) != NULL)
+      psh->pEntries = peShrunk;
+   psh->tableSize = psh->numColors;
+   psh->fSorted   = TRUE;
+}
+
+/*----------------------------------------------------------------------------*/
+/* Index of rgb in psh->pEntries or -1 if it isn't there.                     */
+/*----------------------------------------------------------------------------*/
+long sparse_hist_find(const SPARSE_HIST *psh, UINT32 rgb)
+{
+   if (psh->fSorted)
+   {
+      long lo = 0, hi = psh->numColors - 1, mid;
+
+      while (lo <= hi)
+      {
+         mid = (lo + hi) >> 1;
+         if (psh->pEntries[mid].rgb == rgb)
+            return mid;
+         if (psh->pEntries[mid].rgb < rgb)
+            lo = mid + 1;
+         else
+            hi = mid - 1;
+      }
+   }
+   else if (psh->tableSize)
+   {
+      const SPARSE_ENTRY *pe = sparse_slot(psh, rgb);
+
+      if (pe->rgb == rgb)
+         return (long)(pe - psh->pEntries);
+   }
+   return -1;
+}
+
+/*----------------------------------------------------------------------------*/
+/* The quantizer for sparse histograms.  It's the same variance based split   */
+/* as split_box() but a box is the colors in it, so slices come from one pass */
+/* over its colors instead of a scan of every cell.  When seeding, every cell */
+/* of the cube weighs 1 (added in closed form) and the seeds weigh about as   */
+/* much against the 256^3 cube as they do against the 64^3 one.               */
+/*----------------------------------------------------------------------------*/
+#define SPARSE_SEED_WEIGHT \
+   ((double)HIST_ENTRY_TYPEMAX * (SPARSE_MAX / HIST_MAX) * (SPARSE_MAX / HIST_MAX) * (SPARSE_MAX / HIST_MAX))
+
+static double dsum_of(INT i, INT j)          /* i + ... + j */
+{
+   return (double)(i + j) * (double)(j - i + 1) / 2.0;
+}
+
+static double dsum_of_squares(INT i, INT j)  /* i*i + ... + j*j */
+{
+   return ((double)j * (j + 1) * (2 * j + 1) - (double)(i - 1) * i * (2 * i - 1)) / 6.0;
+}
+
+static double sparse_weight(const QuantizeContext *pqc, const SCOLOR *pc)
+{
+   if (pqc->fSeeding)
+      return pc->fSeed ? SPARSE_SEED_WEIGHT : 0.0;
+   if (pc->fSeed && !pc->count)
+      return 1.0;
+   return (double)pc->count;
+}
+
+/* Adds one color to a slice.  pbox is the box for the distance to its seed. */
+static void slice_color(SSLICE *ps, const SCOLOR *pc, double w, const SBOX *pbox)
+{
+   double c0 = pc->c[0], c1 = pc->c[1], c2 = pc->c[2];
+
+   ps->w    += w;
+   ps->t[0] += c0 * w;
+   ps->t[1] += c1 * w;
+   ps->t[2] += c2 * w;
+   ps->tt   += (c0 * c0 + c1 * c1 + c2 * c2) * w;
+   ps->seeds += pc->fSeed;
+   if (pbox->fHasSeed)
+   {
+      double d0 = c0 - pbox->seed[0], d1 = c1 - pbox->seed[1], d2 = c2 - pbox->seed[2];
+
+      ps->sv += (d0 * d0 + d1 * d1 + d2 * d2) * w;
+   }
+}
+
+/* Adds the cells i..j (every cell weighing 1) to a slice. */
+static void slice_cells(SSLICE *ps, const INT *i, const INT *j)
+{
+   double n0 = j[0] - i[0] + 1, n1 = j[1] - i[1] + 1, n2 = j[2] - i[2] + 1;
+
+   ps->w    += n0 * n1 * n2;
+   ps->t[0] += dsum_of (i[0], j[0]) * n1 * n2;
+   ps->t[1] += dsum_of (i[1], j[1]) * n0 * n2;
+   ps->t[2] += dsum_of (i[2], j[2]) * n0 * n1;
+   ps->tt   += dsum_of_squares (i[0], j[0]) * n1 * n2
+             + dsum_of_squares (i[1], j[1]) * n0 * n2
+             + dsum_of_squares (i[2], j[2]) * n0 * n1;
+}
+
+static double sparse_variance(const SSLICE *ps, int fHasSeed)
+{
+   if (fHasSeed)
+      return ps->sv;
+   if (ps->w <= 0.0)
+      return 0.0;
+   return ps->tt - (ps->t[0] * ps->t[0] + ps->t[1] * ps->t[1] + ps->t[2] * ps->t[2]) / ps->w;
+}
+
+/*----------------------------------------------------------------------------*/
+/* Sums a box and, unless seeding, shrinks it to its colors.                  */
+/*----------------------------------------------------------------------------*/
+static void sum_sparse_box(QuantizeContext *pqc, SBOX *pbox)
+{
+   const SCOLOR *pc, *pcEnd;
+   INT lo[3], hi[3];
+   double w;
+   int a;
+
+   memset (&pbox->s, 0, sizeof(pbox->s));
+   lo[0] = lo[1] = lo[2] = SPARSE_MAX - 1;
+   hi[0] = hi[1] = hi[2] = 0;
+
+   for (pc = pqc->pScolors + pbox->first, pcEnd = pqc->pScolors + pbox->last; pc < pcEnd; pc++)
+   {
+      if ((w = sparse_weight(pqc, pc)) == 0.0)
+         continue;
+      slice_color (&pbox->s, pc, w, pbox);
+      for (a = 0; a < 3; a++)
+      {
+         if (pc->c[a] < lo[a]) lo[a] = pc->c[a];
+         if (pc->c[a] > hi[a]) hi[a] = pc->c[a];
+      }
+   }
+
+   if (pqc->fSeeding)
+   {
+      slice_cells (&pbox->s, pbox->i, pbox->j);
+   }
+   else if (pbox->s.w > 0.0)
+   {
+      for (a = 0; a < 3; a++)
+      {
+         pbox->i[a] = lo[a];
+         pbox->j[a] = hi[a];
+      }
+   }
+
+   pbox->variance = sparse_variance(&pbox->s, pbox->fHasSeed);
+}
+
+/*----------------------------------------------------------------------------*/
+/* split_box() for sparse histograms.                                         */
+/*----------------------------------------------------------------------------*/
+static void split_sparse_box(QuantizeContext *pqc, SBOX *pbox)
+{
+   const SCOLOR *pc, *pcEnd;
+   SCOLOR *pScolors = pqc->pScolors;
+   SBOX *pleft;
+   SSLICE left, right;
+   double w, variance, lowest_variance;
+   INT x, pick, i[3], j[3];
+   long lo, hi;
+   int a, axis, fLeftSeed;
+
+   // Cut the box into slices along each axis.
+   for (a = 0; a < 3; a++)
+   {
+      memset (&pqc->arslice[a][pbox->i[a]], 0, (pbox->j[a] - pbox->i[a] + 1) * sizeof(SSLICE));
+   }
+   for (pc = pScolors + pbox->first, pcEnd = pScolors + pbox->last; pc < pcEnd; pc++)
+   {
+      if ((w = sparse_weight(pqc, pc)) == 0.0)
+         continue;
+      for (a = 0; a < 3; a++)
+      {
+         slice_color (&pqc->arslice[a][pc->c[a]], pc, w, pbox);
+      }
+   }
+   if (pqc->fSeeding)
+   {
+      for (a = 0; a < 3; a++)
+      {
+         memcpy (i, pbox->i, sizeof(i));
+         memcpy (j, pbox->j, sizeof(j));
+         for (x = pbox->i[a]; x <= pbox->j[a]; x++)
+         {
+            i[a] = j[a] = x;
+            slice_cells (&pqc->arslice[a][x], i, j);
+         }
+      }
+   }
+
+   /* locate optimum split point on each axis */
+   axis = -1;
+   pick = 0;
+   lowest_variance = 0.0;
+   for (a = 0; a < 3; a++)
+   {
+      memset (&left, 0, sizeof(left));
+      for (x = pbox->i[a]; x < pbox->j[a]; x++)
+      {
+         const SSLICE *ps = &pqc->arslice[a][x];
+
+         left.w    += ps->w;
+         left.t[0] += ps->t[0];
+         left.t[1] += ps->t[1];
+         left.t[2] += ps->t[2];
+         left.tt   += ps->tt;
+         left.sv   += ps->sv;
+         left.seeds += ps->seeds;
+
+         right.w    = pbox->s.w    - left.w;
+         right.t[0] = pbox->s.t[0] - left.t[0];
+         right.t[1] = pbox->s.t[1] - left.t[1];
+         right.t[2] = pbox->s.t[2] - left.t[2];
+         right.tt   = pbox->s.tt   - left.tt;
+         right.sv   = pbox->s.sv   - left.sv;
+         right.seeds = pbox->s.seeds - left.seeds;
+
+         // Seeding must leave a seed on each side.
+         if (pqc->fSeeding && (!left.seeds || !right.seeds))
+            continue;
+
+         fLeftSeed = pbox->fHasSeed && pbox->seed[a] <= x;
+         variance = sparse_variance(&left, fLeftSeed) + sparse_variance(&right, pbox->fHasSeed && !fLeftSeed);
+
+         if (axis < 0 || variance < lowest_variance)
+         {
+            lowest_variance = variance;
+            axis = a;
+            pick = x;
+         }
+      }
+   }
+
+   if (axis < 0)
+   {
+      pbox->variance = 0.0;   // can't be split
+      return;
+   }
+
+   /* split the colors, those at or below pick go to the new box */
+   lo = pbox->first;
+   hi = pbox->last;
+   while (lo < hi)
+   {
+      if (pScolors[lo].c[axis] <= pick)
+      {
+         lo++;
+      }
+      else
+      {
+         SCOLOR t = pScolors[--hi];
+
+         pScolors[hi] = pScolors[lo];
+         pScolors[lo] = t;
+      }
+   }
+
+   pleft = pqc->psboxes + pqc->num_boxes;
+   pqc->num_boxes++;
+   *pleft = *pbox;
+   pleft->last = lo;
+   pleft->j[axis] = pick;
+   pbox->first = lo;
+   pbox->i[axis] = pick + 1;
+
+   fLeftSeed = pbox->fHasSeed && pbox->seed[axis] <= pick;
+   pleft->fHasSeed = fLeftSeed;
+   pbox->fHasSeed = pbox->fHasSeed && !fLeftSeed;
+
+   sum_sparse_box (pqc, pleft);
+   sum_sparse_box (pqc, pbox);
+}
+
+/*----------------------------------------------------------------------------*/
+/* Box with the largest variance that can be split, or NULL.                  */
+/*----------------------------------------------------------------------------*/
+static SBOX *worst_sparse_box(QuantizeContext *pqc)
+{
+   SBOX *pbox, *pworst = NULL;
+   INT i;
+
+   for (i = pqc->num_boxes, pbox = pqc->psboxes; i; i--, pbox++)
+   {
+      if (pbox->variance <= 0.0)
+         continue;
+      if (pqc->fSeeding ? pbox->s.seeds < 2 : pbox->last - pbox->first < 2)
+         continue;
+      if (!pworst || pbox->variance > pworst->variance)
+         pworst = pbox;
+   }
+   return pworst;
+}
+
+/*----------------------------------------------------------------------------*/
+/* Quantizes a sparse histogram (sorted by sparse_hist_sort()) using pqc.     */
+/* Like quantize_ctx() but at full precision.                                 */
+/*----------------------------------------------------------------------------*/
+int quantize_sparse_ctx(QuantizeContext *pqc, const SPARSE_HIST *psh, int max_colors, uchar *color_map, int *num_colors,
+    PALETTE_SITE *palsite, int num_pal_entries
+)
+{
+   SCOLOR *pc;
+   SBOX *pbox;
+   long numScolors, i;
+   int c;
+
+   ASSERT(psh->fSorted || !psh->numColors);
+   pqc->fSeeding = FALSE;
+
+   if (!count_sites(pqc, max_colors, color_map, palsite, num_pal_entries))
+   {
+      return 2;
+   }
+
+   // The context keeps what it allocated for the next run.
+   if (psh->numColors + pqc->NumSeeded > pqc->max_scolors)
+   {
+      if (pqc->pScolors) free(pqc->pScolors);
+      pqc->max_scolors = 0;
+      if ((pqc->pScolors = (SCOLOR *)malloc((psh->numColors + pqc->NumSeeded) * sizeof(SCOLOR))) == NULL)
+         return TRUE;
+      pqc->max_scolors = psh->numColors + pqc->NumSeeded;
+   }
+   if (max_colors + pqc->NumSeeded > pqc->max_sboxes)
+   {
+      if (pqc->psboxes) free(pqc->psboxes);
+      pqc->max_sboxes = 0;
+      if ((pqc->psboxes = (SBOX *)malloc((max_colors + pqc->NumSeeded) * sizeof(SBOX))) == NULL)
+         return TRUE;
+      pqc->max_sboxes = max_colors + pqc->NumSeeded;
+   }
+
+   for (i = 0, pc = pqc->pScolors; i < psh->numColors; i++, pc++)
+   {
+      pc->c[0]  = (UINT8)(psh->pEntries[i].rgb >> 16);
+      pc->c[1]  = (UINT8)(psh->pEntries[i].rgb >> 8);
+      pc->c[2]  = (UINT8)(psh->pEntries[i].rgb);
+      pc->fSeed = FALSE;
+      pc->count = psh->pEntries[i].count;
+   }
+   numScolors = psh->numColors;
+
+   /*
+   ** Mark the seeds, adding the ones that aren't in the picture.
+   */
+   {
+      PALETTE_SITE *ps;
+      long k;
+
+      for (c = num_pal_entries, ps = palsite;  c;  c--, ps++)
+      {
+         if (skSeeded == ps->SiteKind)
+         {
+            k = sparse_hist_find(psh, SPARSE_RGB(ps->r, ps->g, ps->b));
+            if (k < 0)
+            {
+               for (k = psh->numColors; k < numScolors; k++)
+               {
+                  if (pqc->pScolors[k].c[0] == ps->r && pqc->pScolors[k].c[1] == ps->g && pqc->pScolors[k].c[2] == ps->b)
+                     break;
+               }
+               if (k == numScolors)
+               {
+                  pc = pqc->pScolors + numScolors++;
+                  pc->c[0]  = ps->r;
+                  pc->c[1]  = ps->g;
+                  pc->c[2]  = ps->b;
+                  pc->fSeed = FALSE;
+                  pc->count = 0;
+               }
+            }
+            if (pqc->pScolors[k].fSeed)
+            {
+               // Same color as an earlier seed.
+               pqc->NumSeeded--;
+               ps->SiteKind = skRedundant;
+            }
+            pqc->pScolors[k].fSeed = TRUE;
+         }
+      }
+   }
+
+   pbox = pqc->psboxes;
+   memset (pbox, 0, sizeof(*pbox));
+   pbox->first = 0;
+   pbox->last  = numScolors;
+   pbox->j[0]  = pbox->j[1] = pbox->j[2] = SPARSE_MAX - 1;
+   pqc->num_boxes = 1;
+
+   /*
+   ** Split the cube into boxes with one seed in each, then each box is
+   ** that seed's and shrinks to the colors around it.
+   */
+   if (pqc->NumSeeded)
+   {
+      pqc->fSeeding = TRUE;
+      sum_sparse_box (pqc, pbox);
+      while (pqc->num_boxes < pqc->NumSeeded)
+      {
+         if ((pbox = worst_sparse_box(pqc)) == NULL)
+            break;
+         split_sparse_box (pqc, pbox);
+      }
+      ASSERT (pqc->num_boxes == pqc->NumSeeded);
+      pqc->fSeeding = FALSE;
+
+      for (c = pqc->num_boxes, pbox = pqc->psboxes; c; c--, pbox++)
+      {
+         for (pc = pqc->pScolors + pbox->first; !pc->fSeed; pc++)
+            ;
+         pbox->fHasSeed = TRUE;
+         pbox->seed[0]  = pc->c[0];
+         pbox->seed[1]  = pc->c[1];
+         pbox->seed[2]  = pc->c[2];
+         sum_sparse_box (pqc, pbox);
+      }
+   }
+   else
+   {
+      sum_sparse_box (pqc, pbox);
+   }
+
+   max_colors += pqc->NumSeeded;
+   while (pqc->num_boxes < max_colors)
+   {
+      if ((pbox = worst_sparse_box(pqc)) == NULL)
+         break;
+      split_sparse_box (pqc, pbox);
+   }
+
+   /*
+   ** Each open box's color is its average.
+   */
+   for (i = 0, c = 0, pbox = pqc->psboxes; i < pqc->num_boxes; i++, pbox++)
+   {
+      if (pbox->fHasSeed) {continue;}
+
+      for ( NULL; palsite->SiteKind != skOpen; c++, color_map += QUANTIZE_CHANNELS, palsite++) {};
+
+      ASSERT(c < num_pal_entries);
+      {
+         int a;
+
+         for (a = 0; a < 3; a++)
+         {
+            *color_map++ = (pbox->s.w > 0.0) ? (uchar)(pbox->s.t[a] / pbox->s.w + 0.5) : 0;
+         }
+      }
+      ++c;
+      ++palsite;
+   }
+
+   *num_colors = pqc->num_boxes;
+
+   return FALSE;
+}
+
+/*----------------------------------------------------------------------------*/
+int quantize_sparse(const SPARSE_HIST *psh, int max_colors, uchar *color_map, int *num_colors,
+    PALETTE_SITE *palsite, int num_pal_entries
+)
+{
+   QuantizeContext *pqc;
+   int status;
+
+   if ((pqc = quantize_create()) == NULL)
+      return TRUE;
+
+   status = quantize_sparse_ctx(pqc, psh, max_colors, color_map, num_colors, palsite, num_pal_entries);
+
+   quantize_destroy(pqc);
+
+   return status;
+}
+
+/*----------------------------------------------------------------------------*/
+/* Squared distance from a sparse color to entry c of a colormap.             */
+/*----------------------------------------------------------------------------*/
+static long sparse_distance(UINT32 rgb, uchar *colormap[3], int c)
+{
+   long dr = (long)((rgb >> 16) & 0xFF) - colormap[0][c];
+   long dg = (long)((rgb >>  8) & 0xFF) - colormap[1][c];
+   long db = (long)( rgb        & 0xFF) - colormap[2][c];
+
+   return dr * dr + dg * dg + db * db;
+}
+
+/*----------------------------------------------------------------------------*/
+/* Checks quantize_sparse() and inv_cmap_sparse() against quantize() and      */
+/* inv_cmap_2() on a histogram whose colors fit in 6 bits: no two colors in   */
+/* a cell of the 6 bit histogram, no count over HIST_ENTRY_TYPEMAX and a      */
+/* variance that fits the 32 bit sums quantize() keeps.  On those the sparse  */
+/* path must do at least as well:                                             */
+/*                                                                            */
+/*   Each color maps to an entry of the sparse palette no farther from it     */
+/*   than the entry inv_cmap_2() gives its cell (which is picked from the     */
+/*   middle of the cell, not from the color).                                 */
+/*                                                                            */
+/*   The sparse palette's total squared error is within 1/16 of the dense     */
+/*   one's.  It isn't held to the same palette since the two sum at different */
+/*   precisions, so near ties between splits can go either way and the        */
+/*   greedy splits differ from there on.  On random histograms it has been    */
+/*   within 3%.                                                               */
+/*----------------------------------------------------------------------------*/
+QUANTIZECHECK quantize_sparse_check(const SPARSE_HIST *psh, int max_colors)
+{
+   HIST_ENTRY_TYPE *histogram = NULL;
+   unsigned long *dist_buf = NULL;
+   uchar *rgbmap = NULL;
+   uchar *indexes = NULL;
+   PALETTE_SITE palsite[256];
+   uchar color_map[2][256 * QUANTIZE_CHANNELS];
+   uchar planes[2][3][256];
+   uchar *cmap[2][3];
+   int num_colors[2];
+   double w, t[3], tt, error[2];
+   QUANTIZECHECK result = qcNotChecked;
+   long i;
+   int k, a, c;
+
+   ASSERT(psh->fSorted || !psh->numColors);
+   if (max_colors > 256)
+      max_colors = 256;
+
+   if (!psh->numColors || max_colors < 1 ||
+       (histogram = (HIST_ENTRY_TYPE *)calloc(HIST_CELLS, sizeof(HIST_ENTRY_TYPE))) == NULL ||
+       (dist_buf = (unsigned long *)malloc(HIST_CELLS * sizeof(unsigned long))) == NULL ||
+       (rgbmap = (uchar *)malloc(HIST_CELLS)) == NULL ||
+       (indexes = (uchar *)malloc(psh->numColors)) == NULL)
+      goto done;
+
+   w = tt = t[0] = t[1] = t[2] = 0.0;
+   for (i = 0; i < psh->numColors; i++)
+   {
+      UINT32 rgb = psh->pEntries[i].rgb;
+      UINT32 count = psh->pEntries[i].count;
+      INT r = (rgb >> (16 + HIST_SHIFT)) & (HIST_MAX - 1);
+      INT g = (rgb >> ( 8 + HIST_SHIFT)) & (HIST_MAX - 1);
+      INT b = (rgb >>       HIST_SHIFT ) & (HIST_MAX - 1);
+      HIST_ENTRY_TYPE *ph = histogram + r * R_STRIDE + g * G_STRIDE + b * B_STRIDE;
+
+      if (*ph || count > HIST_ENTRY_TYPEMAX)
+         goto done;
+      *ph = (HIST_ENTRY_TYPE)count;
+
+      w    += count;
+      t[0] += (double)r * count;
+      t[1] += (double)g * count;
+      t[2] += (double)b * count;
+      tt   += (double)(r * r + g * g + b * b) * count;
+   }
+   if (w > 0.0 && tt - (t[0] * t[0] + t[1] * t[1] + t[2] * t[2]) / w >= 4294967296.0)
+      goto done;
+
+   for (k = 0; k < 2; k++)
+   {
+      for (c = 0; c < 256; c++)
+      {
+         memset (&palsite[c], 0, sizeof(palsite[c]));
+         palsite[c].SiteKind = skOpen;
+      }
+      if (k ? quantize_sparse(psh, max_colors, color_map[k], &num_colors[k], palsite, 256)
+            : quantize(histogram, max_colors, color_map[k], &num_colors[k], palsite, 256))
+         goto done;
+      for (a = 0; a < 3; a++)
+      {
+         for (c = 0; c < num_colors[k]; c++)
+         {
+            planes[k][a][c] = color_map[k][c * QUANTIZE_CHANNELS + a];
+         }
+         cmap[k][a] = planes[k][a];
+      }
+   }
+
+   // The sparse palette mapped both ways.
+   inv_cmap_2(num_colors[1], cmap[1], HIST_BIT, dist_buf, rgbmap);
+   inv_cmap_sparse(num_colors[1], cmap[1], psh, indexes);
+   result = qcAgree;
+   error[1] = 0.0;
+   for (i = 0; i < psh->numColors; i++)
+   {
+      UINT32 rgb = psh->pEntries[i].rgb;
+      long cell = ((rgb >> (16 + HIST_SHIFT)) & (HIST_MAX - 1)) * R_STRIDE
+                + ((rgb >> ( 8 + HIST_SHIFT)) & (HIST_MAX - 1)) * G_STRIDE
+                + ((rgb >>       HIST_SHIFT ) & (HIST_MAX - 1)) * B_STRIDE;
+      long d = sparse_distance(rgb, cmap[1], indexes[i]);
+
+      if (indexes[i] >= num_colors[1] || d > sparse_distance(rgb, cmap[1], rgbmap[cell]))
+      {
+         result = qcMappingWorse;
+         goto done;
+      }
+      error[1] += (double)d * psh->pEntries[i].count;
+   }
+
+   // The dense palette's error, each color at its nearest entry.
+   inv_cmap_sparse(num_colors[0], cmap[0], psh, indexes);
+   error[0] = 0.0;
+   for (i = 0; i < psh->numColors; i++)
+   {
+      error[0] += (double)sparse_distance(psh->pEntries[i].rgb, cmap[0], indexes[i]) * psh->pEntries[i].count;
+   }
+   if (error[1] > error[0] + error[0] / 16.0)
+      result = qcPaletteWorse;
+
+done:
+   if (indexes) free(indexes);
+   if (rgbmap) free(rgbmap);
+   if (dist_buf) free(dist_buf);
+   if (histogram) free(histogram);
+
+   return result;
+}
+#endif // !QUANTIZE_ALPHA
 /*----------------------------------------------------------------------------*/
 
@@ -85,9 +85,18 @@
 #include <echidna\memsafe.h>
 #include <echidna\utils.h>
 #include <echidna\dbmess.h>
+#include <echidna\ethread.h>
+#include <echidna\pixconv.h>
 
 #include "quantize.h"
 
+#if EL_USE_SIMD && HIST_ENTRY_TYPEMAX == 0xFFFF && (defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)) && (!defined(_MSC_VER) || _MSC_VER >= 1500)
+   #define HIST_SSE2 1
+   #include <emmintrin.h>
+#else
+   #define HIST_SSE2 0
+#endif
+
 #if 0
 	#define qprintf(args)	EL_printf args
 #else
@@ -102,6 +111,32 @@
 #define CODEDRAW_ALL_TRANSPARENT     (1 << 24)
 #define CODEDRAW_SOME_TRANSPARENT    (1 << 25)    
 
+// Most bytes of decoded pictures read ahead while histogramming.
+#define HIST_READ_AHEAD_BYTES  (256 * 1024 * 1024)
+
+// Pictures are histogrammed in groups of up to this many (per thread)
+// or this many pixels, whichever comes first.
+#define HIST_GROUP_PICTURES_PER_THREAD  4
+#define HIST_GROUP_PIXELS      (HIST_READ_AHEAD_BYTES / 4 / sizeof (pixel32))
+
+// Pictures of more pixels than this aren't read ahead whole, they're
+// decoded and counted a band at a time so one never has to fit in
+// memory.
+#define HIST_STREAM_PIXELS     (HIST_READ_AHEAD_BYTES / 4 / sizeof (pixel32))
+
+// Summed histograms are built in pieces of about this many pixels so a
+// big picture is spread over the threads too.
+#define HIST_PIECE_PIXELS      (256 * 1024)
+
+// Groups smaller than this aren't worth handing to other threads.
+#define HIST_MIN_PARALLEL_PIXELS  (64 * 1024)
+
+// Most private histograms, each is HIST_CELLS entries (two for max).
+#define HIST_SLOTS_MAX         32
+
+// Jobs the final merge of the private histograms is split into.
+#define HIST_MERGE_JOBS        64
+
 /******************************* T Y P E S *******************************/
 
 typedef enum {
@@ -146,18 +181,61 @@ typedef enum {
    kpMaxex
 } KINDPAL;
 
+typedef struct {
+   BlockO32BitPixels *pBOP;
+   long y;                          // first row
+   long numRows;
+} HISTPIECE;
+
+/*
+** A histogram being built from a lot of pictures.  Each job of a
+** group has a histogram of its own (a slot) so nothing is shared
+** while counting.  They're merged into one at the end.
+*/
+typedef struct {
+   TRANSPARENCYKIND tk;
+   UINT8 Alpha;
+   UINT8 Red;
+   UINT8 Green;
+   UINT8 Blue;
+   HISTMERGE merge;
+   BOOL fSparse;                                // full precision in arSparseSlot
+   BOOL fOutOfMemory;                           // a sparse histogram couldn't grow
+   int numSlots;
+   HIST_ENTRY_TYPE *arpSlot[HIST_SLOTS_MAX];     // what each job has counted
+   HIST_ENTRY_TYPE *arpCrnt[HIST_SLOTS_MAX];     // histmergeMax: the picture it's counting
+   SPARSE_HIST arSparseSlot[HIST_SLOTS_MAX];    // fSparse: what each job has counted
+   SPARSE_HIST arSparseCrnt[HIST_SLOTS_MAX];    // fSparse histmergeMax: the picture it's counting
+   HISTPIECE *pPieces;
+   long numPieces;
+   long nextPiece;
+   ETHREAD_LOCK *pLock;                         // for nextPiece
+   HIST_ENTRY_TYPE *pHistogram;                 // the final merge's
+   int arfHasEntries[HIST_MERGE_JOBS];
+} HISTBUILD;
+
 /************************** P R O T O T Y P E S **************************/
 
-BOOL BuildHistogramForFile (
-   char *pszFileName,
-   HIST_ENTRY_TYPE *pHistogram,
+void StartHistogram (
+   HISTBUILD *phb,
    TRANSPARENCYKIND tk,
    UINT8 Alpha,
    UINT8 Red,
    UINT8 Green,
-   UINT8 Blue
+   UINT8 Blue,
+   HISTMERGE merge,
+   BOOL fSparse
 );
-BOOL MergeHistograms ( HIST_ENTRY_TYPE *pHistogram, HIST_ENTRY_TYPE *pHistogramCrnt);
+void BuildHistogramForPictures (HISTBUILD *phb, BlockO32BitPixels **ppBOP, int numPictures);
+BOOL BuildHistogramForFile (HISTBUILD *phb, const char *pszFileName, const PictureInfo *pInfo);
+static int HistogramBand (void *pUserData, const PictureInfo *pInfo, const pixel32 *pRows, long y, long numRows);
+BOOL FinishHistogram (HISTBUILD *phb, HIST_ENTRY_TYPE *pHistogram);
+BOOL FinishSparseHistogram (HISTBUILD *phb, SPARSE_HIST *pSparse);
+static void HistogramJob (void *pUserData, int job);
+static void HistogramPixels (const HISTBUILD *phb, HIST_ENTRY_TYPE *pHistogram, const pixel32 *p32, long count);
+static BOOL HistogramPixelsSparse (const HISTBUILD *phb, SPARSE_HIST *pSparse, const pixel32 *p32, long count);
+static void MergeJob (void *pUserData, int job);
+BOOL MergeHistograms (HIST_ENTRY_TYPE *pHistogram, HIST_ENTRY_TYPE *pHistogramCrnt, long numCells, HISTMERGE merge, BOOL fClear);
 
 BOOL PalettizeImageFile (
    char *pszFileName,
@@ -174,7 +252,9 @@ BOOL PalettizeImageFile (
    int   *pNumUsed,
    IMGOUT imgout,
    DITHERMETHOD dmDither,
-   PALETTE_SITE *arpalsite 
+   PALETTE_SITE *arpalsite,
+   const SPARSE_HIST *pSparse,
+   const UINT8 *pSparseIndexes
 );
 BOOL ParseRangeList (
    LST_LIST *plist, 
@@ -228,6 +308,28 @@ int   fQuiet;
 
 #define round(a)  floor((a) + 0.5)
 
+// Count a pixel in a histogram.
+#define HIST_COUNT(pHist,p32)                                                 \
+   {                                                                          \
+      HIST_ENTRY_TYPE *ph = (pHist) + ((p32)->red >> HIST_SHIFT) * R_STRIDE   \
+         + ((p32)->green >> HIST_SHIFT) * G_STRIDE + ((p32)->blue >> HIST_SHIFT); \
+      if (*ph < HIST_ENTRY_TYPEMAX) *ph += 1;                                 \
+   }
+
+// Count a pixel in the run of one color HistogramPixelsSparse is building
+// in rgbRun and run, adding the run to pSparse when the color changes.
+#define SPARSE_RUN_COUNT(pSparse,p32)                                         \
+   {                                                                          \
+      UINT32 rgb = SPARSE_RGB ((p32)->red, (p32)->green, (p32)->blue);        \
+      if (rgb != rgbRun)                                                      \
+      {                                                                       \
+         if (run) fFailed |= sparse_hist_add ((pSparse), rgbRun, run);        \
+         rgbRun = rgb;                                                        \
+         run = 0;                                                             \
+      }                                                                       \
+      run++;                                                                  \
+   }
+
 
 /**************************** R O U T I N E S ****************************/
 
@@ -245,6 +347,7 @@ enum {
    NDX_BlockedIndexes,
    NDX_ConstantIndexes,
    NDX_SumHistograms,
+   NDX_HighPrecision,
    NDX_TransparentColor,
    NDX_TransparentAlpha,
    NDX_TransparentIndex,
@@ -331,6 +434,11 @@ ArgSpec Template[] = {
       //"                      Sum good for collage frames.\n"
       //"                      Max good for animation frames.\n"
    ,},
+   {CHRSWITCH_ARG, "H",
+      "    -H             High precision. Count colors at 8 bits per component\n"
+      "                      (default is 6) for smooth gradients. Uses memory\n"
+      "                      for each different color in the images.\n"
+   ,},
    {KEYWORD_ARG, "-TC=TC",	      
       "    TC<r:g:b>      Transparency by r,g,b value\n"
    , },
@@ -393,11 +501,17 @@ BEGINFUNCMAIN(main)
       DITHERMETHOD   dmDither;      
       UINT8 *pinvcmap;                    // Pointer to inverse color map.
       BOOL  fImagesAllTransparent;        // True if no colors to process from image because images are completely transparent.
+      BOOL  fHighPrecision;               // Histogram colors at 8 bits per component.
+      SPARSE_HIST SparseHist;             // fHighPrecision: the histogram, kept for mapping the image.
+      UINT8 *pSparseIndexes;              // Palette index for each color in SparseHist.
       
       pinvcmap = NULL;
       fImagesAllTransparent = FALSE;
+      memset (&SparseHist, 0, sizeof (SparseHist));
+      pSparseIndexes = NULL;
       
       fQuiet = ARG(Quiet) != NULL;
+      fHighPrecision = ARG(HighPrecision) != NULL;
       fBigEndian = ARG(BigEndian) != NULL;
       
       if (!ARG(InFileList) && !( ARG(PaletteDefault) && ARG(OutPalKind) ) )
@@ -669,11 +783,15 @@ BEGINFUNCMAIN(main)
       if (ARG(InFileList) && EntriesChangeableMax)
       {
          HIST_ENTRY_TYPE *pHistogram;        // Histogram for all images.
-         HIST_ENTRY_TYPE *pHistogramCrnt;    // Histogram for current image.
+         HISTBUILD hb;
          
          // Allocate Histograms
-         MEM_CallocMemNoFail (pHistogram, (HIST_CELLS * sizeof(HIST_ENTRY_TYPE)));
-         MEM_AllocMemNoFail (pHistogramCrnt, (HIST_CELLS * sizeof(HIST_ENTRY_TYPE)));
+         pHistogram = NULL;
+         if (!fHighPrecision)
+         {
+            MEM_CallocMemNoFail (pHistogram, (HIST_CELLS * sizeof(HIST_ENTRY_TYPE)));
+         }
+         StartHistogram (&hb, tkTransparency, AlphaT, RedT, GreenT, BlueT, HistMergeMethod, fHighPrecision);
          
          /*
          ** Build Histogram
@@ -682,25 +800,152 @@ BEGINFUNCMAIN(main)
             LST_LIST	*listInFiles;
             LST_NODE	*pnode;
             int NumInFiles;
+            const char **ppszInFiles;
+            int NumBigFiles;
+            const char **ppszBigFiles;
+            PictureInfo *pBigInfo;
+            PictureInfo info;
+            PicturePool *pPool;
+            PictureBatch *pBatch;
+            BlockO32BitPixels *pBOP;
+            const char *pszInFile;
+            BlockO32BitPixels **ppGroup;
+            int GroupMax;
+            int NumInGroup;
+            long GroupPixels;
+            int i;
          
             listInFiles = MULTI_ARGLINKEDLIST (ARG(InFileList));
-            qprintf (("Building Histogram for:\n"));
+            NumInFiles = 0;
+            for (pnode = LST_Head (listInFiles); !LST_IsEOList(pnode); pnode = LST_Next (pnode))
+            {
+               NumInFiles++;
+            }
+            MEM_AllocMemNoFail (ppszInFiles, (NumInFiles + 1) * sizeof (const char *));
+            MEM_AllocMemNoFail (ppszBigFiles, (NumInFiles + 1) * sizeof (const char *));
+            MEM_AllocMemNoFail (pBigInfo, (NumInFiles + 1) * sizeof (PictureInfo));
+
+            // Pictures too big to read ahead whole are streamed after
+            // the rest.  One whose header can't be read is left to the
+            // batch to report.
             for (
                pnode = LST_Head (listInFiles),
-                  NumInFiles = 0;
+                  NumInFiles = 0,
+                  NumBigFiles = 0;
                !LST_IsEOList(pnode);
-               pnode = LST_Next (pnode),
-                  NumInFiles++
+               pnode = LST_Next (pnode)
             )
             {
-                qprintf (("   %s\n", LST_NodeName (pnode)));
-                if (!BuildHistogramForFile (LST_NodeName(pnode), pHistogramCrnt, 
-                  tkTransparency, AlphaT, RedT, GreenT, BlueT)
-                )
+               if (ReadPictureInfo (LST_NodeName (pnode), &info)
+                  && info.height > 0
+                  && info.width > (long)(HIST_STREAM_PIXELS / info.height))
+               {
+                  pBigInfo[NumBigFiles] = info;
+                  ppszBigFiles[NumBigFiles++] = LST_NodeName (pnode);
+               }
+               else
+               {
+                  ppszInFiles[NumInFiles++] = LST_NodeName (pnode);
+               }
+            }
+
+            // The next pictures are read and decoded on other threads
+            // while this one is histogrammed.  Their pixels come from
+            // a pool so each picture reuses the buffer of one before it
+            // instead of going back to the heap.
+            pPool = CreatePicturePool (HIST_READ_AHEAD_BYTES);
+            pBatch = pPool ? Read32BitPictureBatch (ppszInFiles, NumInFiles, 0, HIST_READ_AHEAD_BYTES, pPool) : NULL;
+            if (!pBatch)
+            {
+               EL_printf ("ERROR: %s\n", GlobalErrMsg);
+               DestroyPicturePool (pPool);
+               MEM_FreeMem (ppszInFiles);
+               MEM_FreeMem (ppszBigFiles);
+               MEM_FreeMem (pBigInfo);
+               RETURN EXIT_FAILURE;
+            }
+
+            // Pictures are taken a group at a time and the group is
+            // spread over the threads.
+            GroupMax = hb.numSlots * HIST_GROUP_PICTURES_PER_THREAD;
+            MEM_AllocMemNoFail (ppGroup, GroupMax * sizeof (BlockO32BitPixels *));
+            NumInGroup = 0;
+            GroupPixels = 0;
+
+            qprintf (("Building Histogram for:\n"));
+            for (;;)
+            {
+                BOOL fMore = Read32BitPictureBatchNext (pBatch, &pBOP, &pszInFile);
+
+                if (fMore)
                 {
-                  RETURN EXIT_FAILURE;
+                  qprintf (("   %s\n", pszInFile));
+                  if (!pBOP)
+                  {
+                    EL_printf("ERROR: unable to read file %s\n", pszInFile);
+                    for (i = 0; i < NumInGroup; i++)
+                    {
+                       Free32BitPicture (ppGroup[i]);
+                    }
+                    Read32BitPictureBatchClose (pBatch);
+                    DestroyPicturePool (pPool);
+                    MEM_FreeMem (ppszInFiles);
+                    MEM_FreeMem (ppszBigFiles);
+                    MEM_FreeMem (pBigInfo);
+                    RETURN EXIT_FAILURE;
+                  }
+                  ppGroup[NumInGroup++] = pBOP;
+                  GroupPixels += pBOP->width * pBOP->height;
                 }
-                fImagesAllTransparent = !MergeHistograms (pHistogram, pHistogramCrnt);
+
+                if (NumInGroup && (!fMore || NumInGroup == GroupMax || GroupPixels >= (long)HIST_GROUP_PIXELS))
+                {
+                  BuildHistogramForPictures (&hb, ppGroup, NumInGroup);
+                  for (i = 0; i < NumInGroup; i++)
+                  {
+                     Free32BitPicture (ppGroup[i]);
+                  }
+                  NumInGroup = 0;
+                  GroupPixels = 0;
+                }
+
+                if (!fMore)
+                {
+                  break;
+                }
+            }
+            MEM_FreeMem (ppGroup);
+            Read32BitPictureBatchClose (pBatch);
+            DestroyPicturePool (pPool);
+
+            for (i = 0; i < NumBigFiles; i++)
+            {
+               qprintf (("   %s\n", ppszBigFiles[i]));
+               if (!BuildHistogramForFile (&hb, ppszBigFiles[i], &pBigInfo[i]))
+               {
+                  EL_printf("ERROR: unable to read file %s\n", ppszBigFiles[i]);
+                  MEM_FreeMem (ppszInFiles);
+                  MEM_FreeMem (ppszBigFiles);
+                  MEM_FreeMem (pBigInfo);
+                  RETURN EXIT_FAILURE;
+               }
+            }
+
+            if (fHighPrecision)
+            {
+               fImagesAllTransparent = !FinishSparseHistogram (&hb, &SparseHist);
+            }
+            else
+            {
+               fImagesAllTransparent = !FinishHistogram (&hb, pHistogram);
+            }
+            MEM_FreeMem (ppszInFiles);
+            MEM_FreeMem (ppszBigFiles);
+            MEM_FreeMem (pBigInfo);
+            if (hb.fOutOfMemory)
+            {
+               EL_printf ("Error: out of memory for the high precision histogram\n");
+               RETURN EXIT_FAILURE;
             }
             if (fImagesAllTransparent)
             {
@@ -715,9 +960,36 @@ BEGINFUNCMAIN(main)
             */
             qprintf (("Quantizing to a maximum of %d new colors...\n", EntriesChangeableMax));
             {
-               if (quantize(pHistogram, EntriesChangeableMax, pColorMap, &EntriesUsable,
-                  arpalsite, ENTRIES_MAX
-               ))
+               int status;
+
+               if (fHighPrecision)
+               {
+                  qprintf (("%ld different colors\n", SparseHist.numColors));
+                  status = quantize_sparse(&SparseHist, EntriesChangeableMax, pColorMap, &EntriesUsable,
+                     arpalsite, ENTRIES_MAX
+                  );
+               #ifdef _DEBUG
+                  // Debug builds check the high precision path against the 6 bit one.
+                  switch (status ? qcNotChecked : quantize_sparse_check(&SparseHist, EntriesChangeableMax))
+                  {
+                  case qcPaletteWorse:
+                     EL_printf ("Warning: high precision palette has more error than the 6 bit one\n");
+                     break;
+                  case qcMappingWorse:
+                     EL_printf ("Warning: high precision mapping is farther than the 6 bit one\n");
+                     break;
+                  default:
+                     break;
+                  }
+               #endif
+               }
+               else
+               {
+                  status = quantize(pHistogram, EntriesChangeableMax, pColorMap, &EntriesUsable,
+                     arpalsite, ENTRIES_MAX
+                  );
+               }
+               if (status)
                {
                   EL_printf ("Error: unable to quantize\n");
                   RETURN EXIT_FAILURE;
@@ -728,8 +1000,10 @@ BEGINFUNCMAIN(main)
          }
          
          // Free historgrams
-         MEM_FreeMem (pHistogramCrnt);
-         MEM_FreeMem (pHistogram);
+         if (pHistogram)
+         {
+            MEM_FreeMem (pHistogram);
+         }
       }
       else
       {
@@ -819,6 +1093,13 @@ BEGINFUNCMAIN(main)
                qprintf (("EntriesUsable = %d\n", EntriesUsable));            
                inv_cmap_2(EntriesUsable, cmap, HIST_BIT, dist_buf, pinvcmap);
                
+               // The image's own colors map at full precision.
+               if (SparseHist.numColors)
+               {
+                  MEM_AllocMemNoFail (pSparseIndexes, SparseHist.numColors);
+                  inv_cmap_sparse(EntriesUsable, cmap, &SparseHist, pSparseIndexes);
+               }
+               
                MEM_FreeMem (dist_buf);
                MEM_FreeMem (cmap[2]);
                MEM_FreeMem (cmap[1]);
@@ -838,6 +1119,11 @@ BEGINFUNCMAIN(main)
                   ENSURE (*pinv < EntriesUsable);
                   *pinv = pMapFromUsed[*pinv];
                }
+               for (i = 0, pinv = pSparseIndexes; pinv && i < SparseHist.numColors; i++, pinv++)
+               {
+                  ENSURE (*pinv < EntriesUsable);
+                  *pinv = pMapFromUsed[*pinv];
+               }
             }
             MEM_FreeMem (pMapFromUsed);
             MEM_FreeMem (pColorsUsed);
@@ -867,7 +1153,7 @@ BEGINFUNCMAIN(main)
             qprintf (("Palettizing image file %s\n", LST_NodeName (pnode)));
             if (!PalettizeImageFile (LST_NodeName(pnode), ARG(OutFile), pinvcmap, pColorMap, EntriesTotal,
                tkTransparency, AlphaT, RedT, GreenT, BlueT, TransparentIndex, &EntriesUsed, imgout, dmDither,
-               arpalsite)
+               arpalsite, pSparseIndexes ? &SparseHist : NULL, pSparseIndexes)
             )
             {
                RETURN EXIT_FAILURE;
@@ -881,6 +1167,11 @@ BEGINFUNCMAIN(main)
       {
          MEM_FreeMem (pinvcmap);
       }
+      if (pSparseIndexes)
+      {
+         MEM_FreeMem (pSparseIndexes);
+      }
+      sparse_hist_free (&SparseHist);
       
       qprintf (("Done.\n"));
 	}
@@ -895,129 +1186,705 @@ BEGINFUNCMAIN(main)
 ENDFUNCMAIN(main)
 
 /*************************************************************************
-                          BuildHistogramForFile
+                             StartHistogram
  *************************************************************************
 
    SYNOPSIS
-		BOOL BuildHistogramForFile (
-		   char *pszFileName,
-		   HIST_ENTRY_TYPE *pHistogram
+		void StartHistogram (
+		   HISTBUILD *phb,
          TRANSPARENCYKIND tk,
          UINT8 Alpha,
          UINT8 Red,
          UINT8 Green,
-         UINT8 Blue
+         UINT8 Blue,
+         HISTMERGE merge,
+         BOOL fSparse
 		)
 
    PURPOSE
-      To open the given file and make a histogram for it.
+      To get ready to build a histogram from a lot of pictures with
+      BuildHistogramForPictures.
 
    INPUT
-		pszFileName : Graphic file to open
-		pHistogram  : Histogram table to fill in.
+		phb         : Histogram to start.
       tk          : Kind of transparency.
       Alpha       : Alpha threshhold for transparency (for transparency by alpha kind).
       Red         : Red value for transparency.
       Green       : Green value for transparency.
       Blue        : Blue value for transparency.
-   OUTPUT
-		Filled in histogram table.
-
-   EFFECTS
-		None
-
-   RETURN
-      TRUE on success. FALSE on failure.
+      merge       : How the pictures' histograms are combined.
+      fSparse     : Count colors at full precision in SPARSE_HISTs
+                    (finish with FinishSparseHistogram).
 
    SEE ALSO
-
+      FinishHistogram
 
    HISTORY
-		08/11/96 : Created.
+		10/17/26 : Created.
+		10/17/26 : Added fSparse.
 
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
-BOOL BuildHistogramForFile (
-   char *pszFileName,
-   HIST_ENTRY_TYPE *pHistogram,
+void StartHistogram (
+   HISTBUILD *phb,
    TRANSPARENCYKIND tk,
    UINT8 Alpha,
    UINT8 Red,
    UINT8 Green,
-   UINT8 Blue
+   UINT8 Blue,
+   HISTMERGE merge,
+   BOOL fSparse
 )
-BEGINPROC (BuildHistogramForFile)
+BEGINPROC (StartHistogram)
+{
+   int i;
+
+   memset (phb, 0, sizeof (*phb));
+   phb->tk = tk;
+   phb->Alpha = Alpha;
+   phb->Red = Red;
+   phb->Green = Green;
+   phb->Blue = Blue;
+   phb->merge = merge;
+   phb->fSparse = fSparse;
+
+   // One slot for each thread that runs a batch, this one included.
+   phb->numSlots = UTL_MIN(ETHREAD_PoolThreads (ETHREAD_DefaultPool ()), HIST_SLOTS_MAX);
+   phb->pLock = phb->numSlots > 1 ? ETHREAD_CreateLock () : NULL;
+   if (!phb->pLock)
+   {
+      phb->numSlots = 1;
+   }
+
+   for (i = 0; i < phb->numSlots; i++)
+   {
+      if (fSparse)
+      {
+         phb->fOutOfMemory |= sparse_hist_init (&phb->arSparseSlot[i]);
+         if (histmergeMax == merge)
+         {
+            phb->fOutOfMemory |= sparse_hist_init (&phb->arSparseCrnt[i]);
+         }
+         continue;
+      }
+      MEM_CallocMemNoFail (phb->arpSlot[i], (HIST_CELLS * sizeof(HIST_ENTRY_TYPE)));
+      if (histmergeMax == merge)
+      {
+         MEM_CallocMemNoFail (phb->arpCrnt[i], (HIST_CELLS * sizeof(HIST_ENTRY_TYPE)));
+      }
+   }
+
+} ENDPROC (StartHistogram)
+
+/*************************************************************************
+                        BuildHistogramForPictures
+ *************************************************************************
+
+   SYNOPSIS
+		void BuildHistogramForPictures (HISTBUILD *phb, BlockO32BitPixels **ppBOP, int numPictures)
+
+   PURPOSE
+      To add some pictures to a histogram.  The pictures are shared
+      out between the threads, and when the histograms are being summed
+      big pictures are cut up so their pieces are shared out too.  Max
+      needs each picture's own counts so those are done a picture at a
+      time.
+
+   INPUT
+		phb         : Histogram from StartHistogram.
+		ppBOP       : Pictures, from Read32BitPictureBatchNext.
+		numPictures : How many.
+
+   HISTORY
+		08/11/96 : Created as BuildHistogramForFile.
+		10/17/26 : Takes a picture so the files can be read ahead.
+		10/17/26 : Takes a group of pictures and spreads them over
+		           threads.
+
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+void BuildHistogramForPictures (HISTBUILD *phb, BlockO32BitPixels **ppBOP, int numPictures)
+BEGINPROC (BuildHistogramForPictures)
+{
+   long numPieces;
+   long pixels;
+   long rowsPerPiece;
+   long y;
+   int i;
+
+   // Cut the pictures up.
+   for (numPieces = 0, pixels = 0, i = 0; i < numPictures; i++)
+   {
+      rowsPerPiece = (histmergeSum == phb->merge) ? UTL_MAX(HIST_PIECE_PIXELS / UTL_MAX(ppBOP[i]->width, 1), 1) : UTL_MAX(ppBOP[i]->height, 1);
+      numPieces += (ppBOP[i]->height + rowsPerPiece - 1) / rowsPerPiece;
+      pixels += ppBOP[i]->width * ppBOP[i]->height;
+   }
+   if (!numPieces)
+   {
+      PROCEXIT;
+   }
+
+   MEM_AllocMemNoFail (phb->pPieces, numPieces * sizeof (HISTPIECE));
+   for (numPieces = 0, i = 0; i < numPictures; i++)
+   {
+      rowsPerPiece = (histmergeSum == phb->merge) ? UTL_MAX(HIST_PIECE_PIXELS / UTL_MAX(ppBOP[i]->width, 1), 1) : UTL_MAX(ppBOP[i]->height, 1);
+      for (y = 0; y < ppBOP[i]->height; y += rowsPerPiece)
+      {
+         phb->pPieces[numPieces].pBOP = ppBOP[i];
+         phb->pPieces[numPieces].y = y;
+         phb->pPieces[numPieces].numRows = UTL_MIN(rowsPerPiece, ppBOP[i]->height - y);
+         numPieces++;
+      }
+   }
+   phb->numPieces = numPieces;
+   phb->nextPiece = 0;
+
+   if (phb->numSlots > 1 && numPieces > 1 && pixels >= HIST_MIN_PARALLEL_PIXELS)
+   {
+      ETHREAD_ParallelFor (NULL, phb->numSlots, HistogramJob, phb);
+   }
+   else
+   {
+      HistogramJob (phb, 0);
+   }
+
+   MEM_FreeMem (phb->pPieces);
+   phb->pPieces = NULL;
+
+} ENDPROC (BuildHistogramForPictures)
+
+/*************************************************************************
+                          BuildHistogramForFile
+ *************************************************************************
+
+   SYNOPSIS
+		BOOL BuildHistogramForFile (HISTBUILD *phb, const char *pszFileName, const PictureInfo *pInfo)
+
+   PURPOSE
+      To add a picture that's too big to read ahead whole to a
+      histogram.  It's decoded a band at a time and each band is
+      counted as it comes, so only one band is ever in memory.
+
+   INPUT
+		phb         : Histogram from StartHistogram.
+		pszFileName : Graphic file to read.
+		pInfo       : Its size, from ReadPictureInfo.
+
+   RETURN
+      TRUE on success. FALSE on failure.
+
+   HISTORY
+		08/11/96 : Created.
+		10/17/26 : Replaced by BuildHistogramForPicture.
+		10/17/26 : Back for pictures bigger than HIST_STREAM_PIXELS.
+
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+BOOL BuildHistogramForFile (HISTBUILD *phb, const char *pszFileName, const PictureInfo *pInfo)
+BEGINFUNC (BuildHistogramForFile)
 {
    BOOL fSuccess;
-   BlockO32BitPixels	*pbop;
+   long bandRows;
 
-   // Clear histogram.
-   memset (pHistogram, 0, (HIST_CELLS * sizeof (HIST_ENTRY_TYPE)));
+   // Bands big enough to give every thread a piece.
+   bandRows = UTL_MAX(phb->numSlots * HIST_PIECE_PIXELS / UTL_MAX(pInfo->width, 1), 1);
+   fSuccess = Stream32BitPicture (pszFileName, bandRows, HistogramBand, phb);
 
-   pbop = Read32BitPicture (pszFileName);
-   fSuccess = pbop != NULL;
-   if (fSuccess)
+   // Max is of the whole picture's counts, which HistogramBand has
+   // been adding up in the first slot's arpCrnt.
+   if (histmergeMax == phb->merge)
    {
-      long int i;
-      pixel32  *p32;
-
-      for (
-         i= pbop->width * pbop->height,
-            p32 = pbop->rgba;      
-         i;
-         i--, p32++
-      )
+      if (phb->fSparse)
       {
-         int b, g, r;
-         HIST_ENTRY_TYPE *ph;
-         
-         switch (tk) {
-         case tkNone:
-            break;
-         case tkAlphaLow:
-            if (p32->alpha <= Alpha) continue;
-            break;
-         case tkAlphaHigh:
-            if (p32->alpha >= Alpha) continue;
-            break;
-         case tkRGB:
-            if (p32->red == Red && p32->green == Green && p32->blue == Blue) continue;
-            break;
+         if (fSuccess && !phb->fOutOfMemory)
+         {
+            phb->fOutOfMemory = sparse_hist_merge (&phb->arSparseSlot[0], &phb->arSparseCrnt[0], TRUE);
          }
-         
-         r = p32->red >> HIST_SHIFT;
-         g = p32->green >> HIST_SHIFT;
-         b = p32->blue >> HIST_SHIFT;
+         sparse_hist_clear (&phb->arSparseCrnt[0]);
+      }
+      else
+      {
+         MergeHistograms (phb->arpSlot[0], phb->arpCrnt[0], HIST_CELLS, histmergeMax, TRUE);
+      }
+   }
+
+   RETURN fSuccess;
+} ENDFUNC (BuildHistogramForFile)
 
-         ph = pHistogram + (r * R_STRIDE) + (g * G_STRIDE) + b;
-         if (*ph < HIST_ENTRY_TYPEMAX) *ph += 1;
+/*************************************************************************
+                              HistogramBand
+ *************************************************************************
+
+   SYNOPSIS
+		static int HistogramBand (void *pUserData, const PictureInfo *pInfo, const pixel32 *pRows, long y, long numRows)
+
+   PURPOSE
+      Stream32BitPicture callback for BuildHistogramForFile.  Adds a
+      band of rows to the histogram.  A sum doesn't care which picture
+      a pixel is from so the band is shared out like a picture of its
+      own.  Max needs the whole picture's counts first so they're
+      added up in the first slot's arpCrnt on this thread.
+
+   INPUT
+		pUserData : HISTBUILD for the histogram being built.
+		pInfo     : Picture size.
+		pRows     : numRows rows of pixels.
+		y         : First row (unused).
+		numRows   : Rows in band.
+
+   RETURN
+      TRUE to keep decoding.
+
+   HISTORY
+		10/17/26 : Created.
+
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+static int HistogramBand (void *pUserData, const PictureInfo *pInfo, const pixel32 *pRows, long y, long numRows)
+{
+   HISTBUILD *phb = (HISTBUILD *)pUserData;
+
+   if (histmergeMax != phb->merge)
+   {
+      BlockO32BitPixels band;
+      BlockO32BitPixels *pBand = &band;
+
+      memset (&band, 0, sizeof (band));
+      band.width = pInfo->width;
+      band.height = numRows;
+      band.rgba = (pixel32 *)pRows;
+      BuildHistogramForPictures (phb, &pBand, 1);
+   }
+   else if (phb->fSparse)
+   {
+      if (HistogramPixelsSparse (phb, &phb->arSparseCrnt[0], pRows, numRows * pInfo->width))
+      {
+         phb->fOutOfMemory = TRUE;
       }
-      Free32BitPicture (pbop);
    }
    else
    {
-      EL_printf("ERROR: unable to read file %s\n", pszFileName);
+      HistogramPixels (phb, phb->arpCrnt[0], pRows, numRows * pInfo->width);
    }
 
-   RETURN fSuccess;
+   return TRUE;
+}
+
+/*************************************************************************
+                             FinishHistogram
+ *************************************************************************
+
+   SYNOPSIS
+		BOOL FinishHistogram (HISTBUILD *phb, HIST_ENTRY_TYPE *pHistogram)
+
+   PURPOSE
+      To merge every thread's histogram into one and free them.
+
+   INPUT
+		phb         : Histogram from StartHistogram.
+		pHistogram  : Histogram table to fill in, cleared.
+
+   RETURN
+      Returns TRUE if there are colors in historgram. FALSE if historgram is empty.
 
-} ENDPROC (BuildHistogramForFile)
+   HISTORY
+		10/17/26 : Created.
+
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+BOOL FinishHistogram (HISTBUILD *phb, HIST_ENTRY_TYPE *pHistogram)
+BEGINFUNC (FinishHistogram)
+{
+   BOOL fHasEntries;
+   int i;
+
+   phb->pHistogram = pHistogram;
+   if (phb->numSlots > 1)
+   {
+      ETHREAD_ParallelFor (NULL, HIST_MERGE_JOBS, MergeJob, phb);
+   }
+   else
+   {
+      for (i = 0; i < HIST_MERGE_JOBS; i++)
+      {
+         MergeJob (phb, i);
+      }
+   }
+
+   fHasEntries = FALSE;
+   for (i = 0; i < HIST_MERGE_JOBS; i++)
+   {
+      fHasEntries |= phb->arfHasEntries[i];
+   }
+
+   for (i = 0; i < phb->numSlots; i++)
+   {
+      MEM_FreeMem (phb->arpSlot[i]);
+      if (phb->arpCrnt[i])
+      {
+         MEM_FreeMem (phb->arpCrnt[i]);
+      }
+   }
+   if (phb->pLock)
+   {
+      ETHREAD_DestroyLock (phb->pLock);
+   }
+
+   RETURN fHasEntries;
+} ENDFUNC (FinishHistogram)
+
+/*************************************************************************
+                          FinishSparseHistogram
+ *************************************************************************
+
+   SYNOPSIS
+		BOOL FinishSparseHistogram (HISTBUILD *phb, SPARSE_HIST *pSparse)
+
+   PURPOSE
+      FinishHistogram for a histogram started with fSparse.  The first
+      thread's histogram becomes the final one, the others are merged
+      into it and it's sorted for quantize_sparse and inv_cmap_sparse.
+
+   INPUT
+		phb         : Histogram from StartHistogram.
+		pSparse     : Filled in.  Free with sparse_hist_free.
+
+   RETURN
+      Returns TRUE if there are colors in historgram. FALSE if historgram
+      is empty or phb->fOutOfMemory is set.
+
+   HISTORY
+		10/17/26 : Created.
+
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+BOOL FinishSparseHistogram (HISTBUILD *phb, SPARSE_HIST *pSparse)
+BEGINFUNC (FinishSparseHistogram)
+{
+   int i;
+
+   *pSparse = phb->arSparseSlot[0];
+   for (i = 1; i < phb->numSlots; i++)
+   {
+      if (!phb->fOutOfMemory)
+      {
+         phb->fOutOfMemory = sparse_hist_merge (pSparse, &phb->arSparseSlot[i], histmergeMax == phb->merge);
+      }
+      sparse_hist_free (&phb->arSparseSlot[i]);
+   }
+   for (i = 0; i < phb->numSlots; i++)
+   {
+      sparse_hist_free (&phb->arSparseCrnt[i]);
+   }
+   if (phb->pLock)
+   {
+      ETHREAD_DestroyLock (phb->pLock);
+   }
+
+   sparse_hist_sort (pSparse);
+
+   RETURN !phb->fOutOfMemory && pSparse->numColors;
+} ENDFUNC (FinishSparseHistogram)
+
+/*************************************************************************
+                              HistogramJob
+ *************************************************************************
+
+   SYNOPSIS
+		static void HistogramJob (void *pUserData, int job)
+
+   PURPOSE
+      Counts pieces of the group into the job's own histogram until
+      there are none left.  Runs on any thread so no BEGINPROC.
+
+   INPUT
+		pUserData : HISTBUILD for the histogram being built.
+		job       : Which slot to count into.
+
+   HISTORY
+		10/17/26 : Created.
+
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+static void HistogramJob (void *pUserData, int job)
+{
+   HISTBUILD *phb = (HISTBUILD *)pUserData;
+
+   for (;;)
+   {
+      const HISTPIECE *pPiece;
+      const pixel32 *p32;
+      long n;
+
+      if (phb->pLock) ETHREAD_Lock (phb->pLock);
+      n = phb->nextPiece++;
+      if (phb->pLock) ETHREAD_Unlock (phb->pLock);
+
+      if (n >= phb->numPieces)
+      {
+         break;
+      }
+
+      pPiece = &phb->pPieces[n];
+      p32 = pPiece->pBOP->rgba + pPiece->y * pPiece->pBOP->width;
+      if (phb->fSparse)
+      {
+         BOOL fFailed;
+
+         if (histmergeMax == phb->merge)
+         {
+            fFailed = HistogramPixelsSparse (phb, &phb->arSparseCrnt[job], p32, pPiece->numRows * pPiece->pBOP->width);
+            fFailed |= sparse_hist_merge (&phb->arSparseSlot[job], &phb->arSparseCrnt[job], TRUE);
+            sparse_hist_clear (&phb->arSparseCrnt[job]);
+         }
+         else
+         {
+            fFailed = HistogramPixelsSparse (phb, &phb->arSparseSlot[job], p32, pPiece->numRows * pPiece->pBOP->width);
+         }
+         if (fFailed)
+         {
+            phb->fOutOfMemory = TRUE;
+         }
+      }
+      else if (histmergeMax == phb->merge)
+      {
+         // max is of each picture's counts so count it by itself
+         // then merge, which leaves arpCrnt clear for the next.
+         HistogramPixels (phb, phb->arpCrnt[job], p32, pPiece->numRows * pPiece->pBOP->width);
+         MergeHistograms (phb->arpSlot[job], phb->arpCrnt[job], HIST_CELLS, histmergeMax, TRUE);
+      }
+      else
+      {
+         HistogramPixels (phb, phb->arpSlot[job], p32, pPiece->numRows * pPiece->pBOP->width);
+      }
+   }
+}
+
+/*************************************************************************
+                             HistogramPixels
+ *************************************************************************
+
+   SYNOPSIS
+		static void HistogramPixels (const HISTBUILD *phb, HIST_ENTRY_TYPE *pHistogram, const pixel32 *p32, long count)
+
+   PURPOSE
+      Adds pixels that aren't transparent to a histogram.  There's a
+      loop for each kind of transparency so the test isn't picked per
+      pixel.
+
+   INPUT
+		phb        : HISTBUILD for the histogram being built.
+		pHistogram : Histogram to add to.
+		p32        : count pixels.
+
+   HISTORY
+		10/17/26 : Created.
+
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+static void HistogramPixels (const HISTBUILD *phb, HIST_ENTRY_TYPE *pHistogram, const pixel32 *p32, long count)
+{
+   const UINT8 Alpha = phb->Alpha;
+   const UINT8 Red = phb->Red;
+   const UINT8 Green = phb->Green;
+   const UINT8 Blue = phb->Blue;
+
+   switch (phb->tk) {
+   case tkNone:
+      for (; count; count--, p32++)
+      {
+         HIST_COUNT (pHistogram, p32);
+      }
+      break;
+   case tkAlphaLow:
+      for (; count; count--, p32++)
+      {
+         if (p32->alpha > Alpha) HIST_COUNT (pHistogram, p32);
+      }
+      break;
+   case tkAlphaHigh:
+      for (; count; count--, p32++)
+      {
+         if (p32->alpha < Alpha) HIST_COUNT (pHistogram, p32);
+      }
+      break;
+   case tkRGB:
+      for (; count; count--, p32++)
+      {
+         if (p32->red != Red || p32->green != Green || p32->blue != Blue) HIST_COUNT (pHistogram, p32);
+      }
+      break;
+   }
+}
+
+/*************************************************************************
+                          HistogramPixelsSparse
+ *************************************************************************
+
+   SYNOPSIS
+		static BOOL HistogramPixelsSparse (const HISTBUILD *phb, SPARSE_HIST *pSparse, const pixel32 *p32, long count)
+
+   PURPOSE
+      HistogramPixels for a sparse histogram.  A run of the same color
+      is added all at once so flat areas only look it up once.  Like
+      HistogramPixels there's a loop for each kind of transparency.
+
+   INPUT
+		phb        : HISTBUILD for the histogram being built.
+		pSparse    : Histogram to add to.
+		p32        : count pixels.
+
+   RETURN
+      TRUE if the histogram ran out of memory.
+
+   HISTORY
+		10/17/26 : Created.
+
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+static BOOL HistogramPixelsSparse (const HISTBUILD *phb, SPARSE_HIST *pSparse, const pixel32 *p32, long count)
+{
+   const UINT8 Alpha = phb->Alpha;
+   const UINT8 Red = phb->Red;
+   const UINT8 Green = phb->Green;
+   const UINT8 Blue = phb->Blue;
+   UINT32 rgbRun = SPARSE_EMPTY;
+   UINT32 run = 0;
+   BOOL fFailed = FALSE;
+
+   switch (phb->tk) {
+   case tkNone:
+      for (; count; count--, p32++)
+      {
+         SPARSE_RUN_COUNT (pSparse, p32);
+      }
+      break;
+   case tkAlphaLow:
+      for (; count; count--, p32++)
+      {
+         if (p32->alpha > Alpha) SPARSE_RUN_COUNT (pSparse, p32);
+      }
+      break;
+   case tkAlphaHigh:
+      for (; count; count--, p32++)
+      {
+         if (p32->alpha < Alpha) SPARSE_RUN_COUNT (pSparse, p32);
+      }
+      break;
+   case tkRGB:
+      for (; count; count--, p32++)
+      {
+         if (p32->red != Red || p32->green != Green || p32->blue != Blue) SPARSE_RUN_COUNT (pSparse, p32);
+      }
+      break;
+   }
+   if (run)
+   {
+      fFailed |= sparse_hist_add (pSparse, rgbRun, run);
+   }
+
+   return fFailed;
+}
+
+/*************************************************************************
+                                MergeJob
+ *************************************************************************
+
+   SYNOPSIS
+		static void MergeJob (void *pUserData, int job)
+
+   PURPOSE
+      Merges one stripe of every thread's histogram into the final one
+      for FinishHistogram.
+
+   INPUT
+		pUserData : HISTBUILD for the histogram being built.
+		job       : Which stripe, 0 to HIST_MERGE_JOBS - 1.
+
+   HISTORY
+		10/17/26 : Created.
 
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+static void MergeJob (void *pUserData, int job)
+{
+   HISTBUILD *phb = (HISTBUILD *)pUserData;
+   long numCells = HIST_CELLS / HIST_MERGE_JOBS;
+   long start = job * numCells;
+   BOOL fHasEntries = FALSE;
+   int i;
+
+   for (i = 0; i < phb->numSlots; i++)
+   {
+      fHasEntries = MergeHistograms (phb->pHistogram + start, phb->arpSlot[i] + start, numCells, phb->merge, FALSE);
+   }
+   phb->arfHasEntries[job] = fHasEntries;
+}
+
+#if HIST_SSE2
+/*************************************************************************
+                           MergeHistogramsSSE2
+ *************************************************************************
+
+   SYNOPSIS
+		static long MergeHistogramsSSE2 (HIST_ENTRY_TYPE *pHistogram, HIST_ENTRY_TYPE *pHistogramCrnt, long numCells, HISTMERGE merge, BOOL fClear)
+
+   PURPOSE
+      MergeHistograms 8 cells at a time.  numCells must be a multiple
+      of 8.  _mm_adds_epu16 clamps at 0xFFFF like the C does and SSE2
+      has no unsigned 16 bit max but (a - b clamped at 0) + b is one.
+
+   HISTORY
+		10/17/26 : Created.
+
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#if !defined(_MSC_VER)
+__attribute__((target("sse2")))
+#endif
+static long MergeHistogramsSSE2 (HIST_ENTRY_TYPE *pHistogram, HIST_ENTRY_TYPE *pHistogramCrnt, long numCells, HISTMERGE merge, BOOL fClear)
+{
+   const __m128i zero = _mm_setzero_si128 ();
+   __m128i any = zero;
+   __m128i *pd = (__m128i *)pHistogram;
+   __m128i *ps = (__m128i *)pHistogramCrnt;
+   long i;
+
+   for (i = numCells / 8; i; i--, pd++, ps++)
+   {
+      __m128i a = _mm_loadu_si128 (pd);
+      __m128i b = _mm_loadu_si128 (ps);
+
+      a = (histmergeSum == merge) ? _mm_adds_epu16 (a, b) : _mm_add_epi16 (_mm_subs_epu16 (a, b), b);
+      _mm_storeu_si128 (pd, a);
+      any = _mm_or_si128 (any, a);
+      if (fClear)
+      {
+         _mm_storeu_si128 (ps, zero);
+      }
+   }
+
+   return _mm_movemask_epi8 (_mm_cmpeq_epi8 (any, zero)) != 0xFFFF;
+}
+#endif
 
 /*************************************************************************
                              MergeHistograms
  *************************************************************************
 
    SYNOPSIS
-		BOOL MergeHistograms ( HIST_ENTRY_TYPE *pHistogram, HIST_ENTRY_TYPE *pHistogramCrnt)
+		BOOL MergeHistograms (HIST_ENTRY_TYPE *pHistogram, HIST_ENTRY_TYPE *pHistogramCrnt, long numCells, HISTMERGE merge, BOOL fClear)
 
    PURPOSE
-      To combine the two histograms according to the method indicated
-      by the global histogram method.
+      To combine the two histograms according to merge.  Runs on any
+      thread so no BEGINFUNC.
       
    INPUT
 		pHistogram      : Input and output
 		pHistogramCrnt : Input histrogram
+		numCells        : How many cells of them.
+		merge           : Sum or max.
+		fClear          : Clear pHistogramCrnt as it's read.
 
    OUTPUT
 		pHistogram = pHistogram merged with pHistogramCrnt
@@ -1033,22 +1900,39 @@ BEGINPROC (BuildHistogramForFile)
 
    HISTORY
 		08/11/96 : Created.
+		10/17/26 : Any part of a histogram, merge passed in, SSE2.
 
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
-BOOL MergeHistograms ( HIST_ENTRY_TYPE *pHistogram, HIST_ENTRY_TYPE *pHistogramCrnt)
-BEGINFUNC (MergeHistograms)
+BOOL MergeHistograms (HIST_ENTRY_TYPE *pHistogram, HIST_ENTRY_TYPE *pHistogramCrnt, long numCells, HISTMERGE merge, BOOL fClear)
 {
    long int i;
    long int fHasEntries;
    
    fHasEntries = 0;
-   for (i = HIST_CELLS; i; i--)
+   #if HIST_SSE2
+      if (PixConv_CPUFeatures () & PIXCONV_CPU_SSE2)
+      {
+         long numVector = numCells & ~7L;
+
+         fHasEntries = MergeHistogramsSSE2 (pHistogram, pHistogramCrnt, numVector, merge, fClear);
+         pHistogram += numVector;
+         pHistogramCrnt += numVector;
+         numCells -= numVector;
+      }
+   #endif
+
+   for (i = numCells; i; i--)
    {
       long int a, b;
       a = (long)*pHistogram;
-      b = (long)*pHistogramCrnt++;
-      switch (HistMergeMethod){
+      b = (long)*pHistogramCrnt;
+      if (fClear)
+      {
+         *pHistogramCrnt = 0;
+      }
+      pHistogramCrnt++;
+      switch (merge){
       case histmergeSum:
          a += b;
          break;
@@ -1066,8 +1950,8 @@ BEGINFUNC (MergeHistograms)
       fHasEntries |= a;
    }
 
-   RETURN (fHasEntries != 0);
-} ENDFUNC (MergeHistograms)
+   return (fHasEntries != 0);
+}
 
 /*************************************************************************
                            PalettizeImageFile                            
@@ -1087,7 +1971,9 @@ BEGINFUNC (MergeHistograms)
          UINT8 Blue,
          UINT8 IndexT,
          int   *pNumUsed,
-         PALETTE_SITE *arpalsite 
+         PALETTE_SITE *arpalsite,
+         const SPARSE_HIST *pSparse,
+         const UINT8 *pSparseIndexes
 		)
 
    PURPOSE
@@ -1109,6 +1995,9 @@ BEGINFUNC (MergeHistograms)
       IndexT         : Index to set tranparent pixels to.
       pNumUsed       : Pointer to int to fill in with number of entries actually used, not counting
                         transparent index.
+      pSparse        : High precision histogram or NULL.  Colors in it map with
+                        pSparseIndexes instead of inv_cmap.
+      pSparseIndexes : Palette index of each color in pSparse.
       
    OUTPUT
 		Sets *pNumUsed to actual number of entries used.
@@ -1126,6 +2015,7 @@ BEGINFUNC (MergeHistograms)
   
    HISTORY
 		08/28/96 : Created.
+		10/17/26 : Added pSparse.
   
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
@@ -1144,7 +2034,9 @@ BOOL PalettizeImageFile (
    int   *pNumUsed,
    IMGOUT imgout,
    DITHERMETHOD dmDither,
-   PALETTE_SITE *arpalsite 
+   PALETTE_SITE *arpalsite,
+   const SPARSE_HIST *pSparse,
+   const UINT8 *pSparseIndexes
 )
 BEGINFUNC (PalettizeImageFile)
 {
@@ -1218,6 +2110,7 @@ BEGINFUNC (PalettizeImageFile)
          )
          {
             int b, g, r;
+            long n;
          
             switch (tk) {
             case tkNone:
@@ -1250,6 +2143,11 @@ BEGINFUNC (PalettizeImageFile)
             
             switch (dmDither) {
             case dmNone:
+               if (pSparse && (n = sparse_hist_find (pSparse, SPARSE_RGB (prgba->Red, prgba->Green, prgba->Blue))) >= 0)
+               {
+                  *ppndx = pSparseIndexes[n];
+                  break;
+               }
                r = prgba->Red >> HIST_SHIFT;
                g = prgba->Green >> HIST_SHIFT;
                b = prgba->Blue >> HIST_SHIFT;
@@ -1300,10 +2198,17 @@ BEGINFUNC (PalettizeImageFile)
                      *pu8ComponentDst = u8Value & 0xFF; 
                   } // End Component loop
                   // Map the resultant error propagated color to the palette  
-                  r = aru8ComponentNew[0] >> HIST_SHIFT;
-                  g = aru8ComponentNew[1] >> HIST_SHIFT;
-                  b = aru8ComponentNew[2] >> HIST_SHIFT;
-                  *ppndx = inv_cmap[(r * R_STRIDE) + (g * G_STRIDE) + b];
+                  if (pSparse && (n = sparse_hist_find (pSparse, SPARSE_RGB (aru8ComponentNew[0], aru8ComponentNew[1], aru8ComponentNew[2]))) >= 0)
+                  {
+                     *ppndx = pSparseIndexes[n];
+                  }
+                  else
+                  {
+                     r = aru8ComponentNew[0] >> HIST_SHIFT;
+                     g = aru8ComponentNew[1] >> HIST_SHIFT;
+                     b = aru8ComponentNew[2] >> HIST_SHIFT;
+                     *ppndx = inv_cmap[(r * R_STRIDE) + (g * G_STRIDE) + b];
+                  }
             
                   // Fill temporary  array with actual color values from palette to which this pixel was mapped.
                   {
@@ -1468,7 +2373,7 @@ BEGINFUNC (PalettizeImageFile)
          }
          break;
       case ioGFF:
-         WriteGFF (pszOutFileName, pgff);
+         WriteGFFEx (pszOutFileName, pgff, GFFWRITE_COMPRESS);
          break;
       case ioCLRTB:
       case ioCDLRTB:
@@ -77,16 +77,36 @@ extern "C" {
 #define FALSE (0)
 #endif
 
+// gfpalalpha defines this as 1 to quantize alpha as a fourth component.
+#ifndef QUANTIZE_ALPHA
+#define QUANTIZE_ALPHA  0
+#endif
+
 /*----------------------------------------------------------------------------*/
 #define HIST_BIT   (6)
 #define HIST_MAX   (1 << HIST_BIT)
+#define A_STRIDE   (HIST_MAX * HIST_MAX * HIST_MAX)
 #define R_STRIDE   (HIST_MAX * HIST_MAX)
 #define G_STRIDE   (HIST_MAX)
+#define B_STRIDE   (1)
 #define HIST_SHIFT (8 - HIST_BIT)
+#if QUANTIZE_ALPHA
+#define HIST_CELLS (HIST_MAX * HIST_MAX * HIST_MAX * HIST_MAX)
+#define QUANTIZE_CHANNELS  4     // bytes per color_map entry
+#else
 #define HIST_CELLS (HIST_MAX * HIST_MAX * HIST_MAX)
+#define QUANTIZE_CHANNELS  3     // bytes per color_map entry
+#endif
 #define HIST_ENTRY_TYPE          UINT16
 #define HIST_ENTRY_TYPEMAX       UINT16MAX
 
+// Sparse (high precision) histograms keep colors at 8 bits a component.
+#define SPARSE_BIT       (8)
+#define SPARSE_MAX       (1 << SPARSE_BIT)
+#define SPARSE_COUNTMAX  0xFFFFFFFFUL
+#define SPARSE_EMPTY     0xFFFFFFFFUL    // rgb of a free hash slot
+#define SPARSE_RGB(r,g,b)  (((UINT32)(r) << 16) | ((UINT32)(g) << 8) | (UINT32)(b))
+
 /******************************* T Y P E S *******************************/
 
 typedef enum {
@@ -106,9 +126,55 @@ typedef struct {
    unsigned char  r;   
    unsigned char  g;   
    unsigned char  b;
+#if QUANTIZE_ALPHA
+   unsigned char  a;
+#endif
    SITEKIND       SiteKind;      
 } PALETTE_SITE;
 
+/*
+** A histogram of just the colors that are there at full precision.  It's
+** an open addressing hash while it's being built (tableSize slots, a power
+** of 2, at most half full) and sparse_hist_sort() turns it into a list of
+** the numColors colors sorted by rgb for the quantizer and inverse mapper.
+*/
+typedef struct {
+   UINT32 rgb;             // SPARSE_RGB(r,g,b)
+   UINT32 count;           // pixels of this color, sticks at SPARSE_COUNTMAX
+} SPARSE_ENTRY;
+
+typedef struct {
+   SPARSE_ENTRY *pEntries;
+   long  numColors;        // colors in the histogram
+   long  tableSize;        // slots in pEntries while it's a hash
+   int   tableBits;        // tableSize == 1 << tableBits
+   int   fSorted;          // pEntries is a sorted list
+} SPARSE_HIST;
+
+/*
+** What quantize_ctx() works in.  One per thread quantizing.
+*/
+typedef struct QuantizeContext QuantizeContext;
+
+/*
+** How the quantizer gathers the statistics of a box.  Both give the same
+** palette.
+*/
+typedef enum {
+   qeMoments,     // from cumulative moment tables made once (default).
+   qeBruteForce,  // by scanning every histogram cell in the box.
+} QUANTIZEENGINE;
+
+/*
+** What quantize_sparse_check() found.
+*/
+typedef enum {
+   qcAgree,          // the sparse palette and mapping are as good as the 6 bit ones.
+   qcNotChecked,     // colors don't fit in 6 bits, no colors or out of memory.
+   qcPaletteWorse,   // the sparse palette has more error than the 6 bit one.
+   qcMappingWorse,   // inv_cmap_sparse() mapped a color farther than inv_cmap_2().
+} QUANTIZECHECK;
+
 /***************************** G L O B A L S *****************************/
 
 
@@ -123,14 +189,42 @@ typedef struct {
 
 /* quantize.c */
 
+QuantizeContext *quantize_create(void);
+void quantize_destroy(QuantizeContext *pqc);
+void quantize_set_engine(QuantizeContext *pqc, QUANTIZEENGINE engine);
+int quantize_ctx(QuantizeContext *pqc, HIST_ENTRY_TYPE *histogram, int max_colors, UINT8 *color_map, int *num_colors,
+    PALETTE_SITE *palsite, int num_pal_entries
+);
 int quantize(HIST_ENTRY_TYPE *histogram, int max_colors, UINT8 *color_map, int *num_colors,
     PALETTE_SITE *palsite, int num_pal_entries
 );
+#if !QUANTIZE_ALPHA
+int quantize_sparse_ctx(QuantizeContext *pqc, const SPARSE_HIST *psh, int max_colors, UINT8 *color_map, int *num_colors,
+    PALETTE_SITE *palsite, int num_pal_entries
+);
+int quantize_sparse(const SPARSE_HIST *psh, int max_colors, UINT8 *color_map, int *num_colors,
+    PALETTE_SITE *palsite, int num_pal_entries
+);
+
+int sparse_hist_init(SPARSE_HIST *psh);
+void sparse_hist_free(SPARSE_HIST *psh);
+void sparse_hist_clear(SPARSE_HIST *psh);
+int sparse_hist_add(SPARSE_HIST *psh, UINT32 rgb, UINT32 count);
+int sparse_hist_raise(SPARSE_HIST *psh, UINT32 rgb, UINT32 count);
+int sparse_hist_merge(SPARSE_HIST *psh, const SPARSE_HIST *pshFrom, int fMax);
+void sparse_hist_sort(SPARSE_HIST *psh);
+long sparse_hist_find(const SPARSE_HIST *psh, UINT32 rgb);
+QUANTIZECHECK quantize_sparse_check(const SPARSE_HIST *psh, int max_colors);
+#endif
 
 /* inv_cmap.c */
 
 void inv_cmap_2( int colors, unsigned char *colormap[3], int bits,
                  unsigned long *dist_buf, unsigned char *rgbmap );
+#if !QUANTIZE_ALPHA
+void inv_cmap_sparse( int colors, unsigned char *colormap[3],
+                      const SPARSE_HIST *psh, unsigned char *indexes );
+#endif
 
 #ifdef __cplusplus
 }
@@ -26,6 +26,7 @@
 
 #define	EL_DEBUG_MESSAGES	0	// dmbess.h
 #define	EL_DEBUG_MEMORY	0	// memsafe.h
+#define	EL_USE_SIMD		1	// gfpal.cpp, inv_cmap.c
 
 #endif /* SWITCHES_H */
 
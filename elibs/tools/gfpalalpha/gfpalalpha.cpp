@@ -146,6 +146,15 @@ typedef enum {
    kpMaxex
 } KINDPAL;
 
+typedef struct {
+   HIST_ENTRY_TYPE *pHistogram;
+   TRANSPARENCYKIND tk;
+   UINT8 Alpha;
+   UINT8 Red;
+   UINT8 Green;
+   UINT8 Blue;
+} HISTBUILD;
+
 /************************** P R O T O T Y P E S **************************/
 
 BOOL BuildHistogramForFile (
@@ -157,6 +166,7 @@ BOOL BuildHistogramForFile (
    UINT8 Green,
    UINT8 Blue
 );
+static int HistogramRows (void *pUserData, const PictureInfo *pInfo, const pixel32 *pRows, long y, long numRows);
 BOOL MergeHistograms ( HIST_ENTRY_TYPE *pHistogram, HIST_ENTRY_TYPE *pHistogramCrnt);
 
 BOOL PalettizeImageFile (
@@ -953,53 +963,22 @@ BOOL BuildHistogramForFile (
 BEGINPROC (BuildHistogramForFile)
 {
    BOOL fSuccess;
-   BlockO32BitPixels	*pbop;
+   HISTBUILD hb;
 
    // Clear histogram.
    memset (pHistogram, 0, (HIST_CELLS * sizeof (HIST_ENTRY_TYPE)));
 
-   pbop = Read32BitPicture (pszFileName);
-   fSuccess = pbop != NULL;
-   if (fSuccess)
-   {
-      long int i;
-      pixel32  *p32;
-
-      for (
-         i= pbop->width * pbop->height,
-            p32 = pbop->rgba;      
-         i;
-         i--, p32++
-      )
-      {
-         int a, b, g, r;
-         HIST_ENTRY_TYPE *ph;
-         
-         switch (tk) {
-         case tkNone:
-            break;
-         case tkAlphaLow:
-            if (p32->alpha <= Alpha) continue;
-            break;
-         case tkAlphaHigh:
-            if (p32->alpha >= Alpha) continue;
-            break;
-         case tkRGB:
-            if (p32->red == Red && p32->green == Green && p32->blue == Blue) continue;
-            break;
-         }
-         
-         r = p32->red >> HIST_SHIFT;
-         g = p32->green >> HIST_SHIFT;
-         b = p32->blue >> HIST_SHIFT;
-         a = p32->alpha >> HIST_SHIFT;
-
-         ph = pHistogram + (a * A_STRIDE) + (r * R_STRIDE) + (g * G_STRIDE) + (b * B_STRIDE);
-         if (*ph < HIST_ENTRY_TYPEMAX) *ph += 1;
-      }
-      Free32BitPicture (pbop);
-   }
-   else
+   hb.pHistogram = pHistogram;
+   hb.tk = tk;
+   hb.Alpha = Alpha;
+   hb.Red = Red;
+   hb.Green = Green;
+   hb.Blue = Blue;
+
+   // Decode a band of rows at a time so big images never need to be
+   // in memory all at once.
+   fSuccess = Stream32BitPicture (pszFileName, 0, HistogramRows, &hb);
+   if (!fSuccess)
    {
       EL_printf("ERROR: unable to read file %s\n", pszFileName);
    }
@@ -1008,6 +987,72 @@ BEGINPROC (BuildHistogramForFile)
 
 } ENDPROC (BuildHistogramForFile)
 
+/*************************************************************************
+                              HistogramRows
+ *************************************************************************
+
+   SYNOPSIS
+		static int HistogramRows (void *pUserData, const PictureInfo *pInfo, const pixel32 *pRows, long y, long numRows)
+
+   PURPOSE
+      Stream32BitPicture callback for BuildHistogramForFile.  Adds a
+      band of rows to the histogram.
+
+   INPUT
+		pUserData : HISTBUILD for the histogram being built.
+		pInfo     : Picture being read.
+		pRows     : numRows rows of pixels.
+
+   RETURN
+      TRUE to keep reading.
+
+   HISTORY
+		10/17/26 : Created.
+
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+static int HistogramRows (void *pUserData, const PictureInfo *pInfo, const pixel32 *pRows, long y, long numRows)
+{
+   HISTBUILD *phb = (HISTBUILD *)pUserData;
+   const pixel32 *p32;
+   long int i;
+
+   for (
+      i = pInfo->width * numRows,
+         p32 = pRows;
+      i;
+      i--, p32++
+   )
+   {
+      int a, b, g, r;
+      HIST_ENTRY_TYPE *ph;
+      
+      switch (phb->tk) {
+      case tkNone:
+         break;
+      case tkAlphaLow:
+         if (p32->alpha <= phb->Alpha) continue;
+         break;
+      case tkAlphaHigh:
+         if (p32->alpha >= phb->Alpha) continue;
+         break;
+      case tkRGB:
+         if (p32->red == phb->Red && p32->green == phb->Green && p32->blue == phb->Blue) continue;
+         break;
+      }
+      
+      r = p32->red >> HIST_SHIFT;
+      g = p32->green >> HIST_SHIFT;
+      b = p32->blue >> HIST_SHIFT;
+      a = p32->alpha >> HIST_SHIFT;
+
+      ph = phb->pHistogram + (a * A_STRIDE) + (r * R_STRIDE) + (g * G_STRIDE) + (b * B_STRIDE);
+      if (*ph < HIST_ENTRY_TYPEMAX) *ph += 1;
+   }
+
+   return TRUE;
+}
+
 
 /*************************************************************************
                              MergeHistograms
@@ -1477,7 +1522,7 @@ BEGINFUNC (PalettizeImageFile)
          }
          break;
       case ioGFF:
-         WriteGFF (pszOutFileName, pgff);
+         WriteGFFEx (pszOutFileName, pgff, GFFWRITE_COMPRESS);
          break;
       case ioCLRTB:
       case ioCDLRTB:
@@ -65,6 +65,7 @@
 #include <echidna\gff.h>
 #include <echidna\memsafe.h>
 #include <echidna\utils.h>
+#include <echidna\planar.h>
 
 /*************************** C O N S T A N T S ***************************/
 
@@ -74,6 +75,7 @@
 
 /************************** P R O T O T Y P E S **************************/
 
+// Same order as the PLANAR_KEY_??? kinds
 typedef enum {
    tkNone,     // No transparency in this image
    tkAlphaLow,  // Transparent if Alpha below given threshhold
@@ -81,7 +83,7 @@ typedef enum {
    tkRGB       // Transparent if Red, Green and Blue component equal given values.
 } TRANSPARENCYKIND;
 
-void ScaleGFF (
+BOOL ScaleGFF (
    int Width,
    int Height,
    RGBADATA *prgbaData,
@@ -111,7 +113,6 @@ int AlphaT;                         // Transparency Alpha threshhold.
 
 /****************************** M A C R O S ******************************/
 
-#define round(a)  floor((a) + 0.5)
 
 /**************************** R O U T I N E S ****************************/
 
@@ -179,8 +180,8 @@ BEGINFUNCMAIN(main)
             // in out pixel ratio values
             int xin, xout; // xout/xin == scale factor for width 
             int yin, yout; // yout/yin == scale factor for height
-            CHUNKNODE   *pchunknodeRGBANew;  // pointer to new chunknode for scaled image.
-            CHUNKRGBA   *pchunkrgbaNew;      // pointer to new chunk for scaled image.
+            CHUNKNODE   *pchunknodeRGBA;     // chunknode of the image, scaled in place.
+            UINT32 NewRGBADataSize;          // Size of rgba data of scaled image.
             int NewWidth, NewHeight;         // New dimensions of scaled image.
 
             ENSURE_PTR(pgff->pchunkggff);
@@ -206,6 +207,7 @@ BEGINFUNCMAIN(main)
 				  AlphaT = atoi (ARG_TA);
 				  tkTransparency = (AlphaT < 0) ? tkAlphaHigh : tkAlphaLow;
 				  AlphaT = UTL_ABS (AlphaT);
+				  ENSURE_(AlphaT <= 255, "Transparency alpha must be from -255 to 255.");
 			   }
 
             xin = xout = yin = yout = 0;
@@ -255,51 +257,41 @@ BEGINFUNCMAIN(main)
                RETURN EXIT_FAILURE;
             }
 
-            /*
-            ** Allocate new RGBA chunk for scaled image data.
-            */
-            {
-               UINT32 NewRGBADataSize;
-
-               NewRGBADataSize = NewSizeOfScaledRGBA (
-                  pgff->pchunkggff->Data.Width,
-                  pgff->pchunkggff->Data.Height,
-                  xin, xout, yin, yout, &NewWidth, &NewHeight);
-               pchunknodeRGBANew = CreateGFFChunkNode (IDRGBA, NewRGBADataSize);
-               pchunkrgbaNew = (CHUNKRGBA *)pchunknodeRGBANew->pchunk;
-            }
+            NewRGBADataSize = NewSizeOfScaledRGBA (
+               pgff->pchunkggff->Data.Width,
+               pgff->pchunkggff->Data.Height,
+               xin, xout, yin, yout, &NewWidth, &NewHeight);
 
             /*
-            ** Scale the image.
+            ** Scale the image.  The new image is never bigger so it's
+            ** written over the old one in the RGBA chunk it was read
+            ** into instead of a second buffer.
             */
-            ScaleGFF (
+            if (!ScaleGFF (
                   pgff->pchunkggff->Data.Width, pgff->pchunkggff->Data.Height,
                   &pgff->pchunkrgba->Data,
                   xin, xout, yin, yout,
-                  &pchunkrgbaNew->Data
-            );
+                  &pgff->pchunkrgba->Data
+               ))
+            {
+               EL_printf ("ERROR: %s\n", GlobalErrMsg);
+               FreeGFF (pgff);
+               RETURN EXIT_FAILURE;
+            }
 
             /*
-            ** Replace old image data with new image data.
+            ** Shrink the RGBA chunk to the new image data.
             */
-            {
-               CHUNKNODE *pchunknodeRGBAOld;
+            pchunknodeRGBA = PChunkNodeOfId (pgff, IDRGBA);
+            ENSURE_PTR(pchunknodeRGBA);
+            pgff->pchunkrgba->Header.Size = NewRGBADataSize;
+            pchunknodeRGBA->Header.Size   = NewRGBADataSize;
 
-               // Remove old  RGBA chunk
-               pchunknodeRGBAOld = PChunkNodeOfId (pgff, IDRGBA);
-               ENSURE_PTR(pchunknodeRGBAOld);
-               LST_Remove (pchunknodeRGBAOld);
-               DestroyGFFChunkNode (pchunknodeRGBAOld);
+            // Overwrite dimensions information in GGFF chunk with new dimensions
+            pgff->pchunkggff->Data.Width = NewWidth;
+            pgff->pchunkggff->Data.Height= NewHeight;
 
-               // Add new rgba chunk 
-               LST_AddTail (pgff->plistChunkNodes, pchunknodeRGBANew);
-
-               // Overwrite dimensions information in GGFF chunk with new dimensions
-               pgff->pchunkggff->Data.Width = NewWidth;
-               pgff->pchunkggff->Data.Height= NewHeight;
-            }
-
-            WriteGFF (ARG_OUTFILE, pgff);
+            WriteGFFEx (ARG_OUTFILE, pgff, GFFWRITE_COMPRESS);
             FreeGFF (pgff);
 			}
 		}
@@ -319,7 +311,7 @@ ENDFUNCMAIN(main)
  *************************************************************************
 
    SYNOPSIS
-		void ScaleGFF (
+		BOOL ScaleGFF (
 		   int Width,
          int Height,
          RGBADATA *prgbaData
@@ -333,6 +325,14 @@ ENDFUNCMAIN(main)
    PURPOSE
       To create a scaled down version of the original image.
 
+      Each new pixel is the area weighted average of the old pixels
+      under it.  Transparent pixels add to the alpha but not the
+      color.  With -TC a new pixel that comes out mostly transparent
+      is set to the transparent color.  A new pixel whose colored
+      area rounds to nothing is left black.
+
+      The picture is copied to planes and scaled with Planar_Scale.
+
    INPUT
 		Width        : Original width
 		Height       : Original height
@@ -342,6 +342,8 @@ ENDFUNCMAIN(main)
 		yin          : yout/yin = scale factor for height.
 		yout         : yout/yin = scale factor for height.
 		prgbaDataNew : Pointer to RGBA data buffer for scaled image data.
+		               Can be prgbaData, the scaled image is made in
+		               its own planes before it is copied back.
 
    OUTPUT
 		None
@@ -349,15 +351,19 @@ ENDFUNCMAIN(main)
    EFFECTS
 		None
 
-   SEE ALSO
+   RETURNS
+      FALSE if out of memory.
 
+   SEE ALSO
+      Planar_Scale
 
    HISTORY
 		08/05/96 : Created.
+		10/17/26 : Scale with Planar_Scale.
 
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
-void ScaleGFF (
+BOOL ScaleGFF (
    int Width,
    int Height,
    RGBADATA *prgbaData,
@@ -367,170 +373,35 @@ void ScaleGFF (
    int yout,
    RGBADATA *prgbaDataNew
 )
-BEGINPROC (ScaleGFF)
+BEGINFUNC (ScaleGFF)
 {
-   float dxStep, dyStep;  // How many pixels to step across in the source for every pixel in the dest.
-   float dxyArea;          // Area in src of one destination pixel.
-   float Red, Green, Blue, Alpha;   // Accumulators for pixel components.
-   int   xDst, yDst;       // Loop indexes for destination image.
-   RGBADATA *prgbadataDst;  // Destination data ptr.
-   int   xDstMaxex, yDstMaxex;   // dimensions of new image.
-
-   dxStep = (float)xin / (float)xout;
-   dyStep = (float)yin / (float)yout;
-   dxyArea = dxStep * dyStep;
-
-   
-   // Get size of new image
-   NewSizeOfScaledRGBA (Width, Height, xin, xout, yin, yout, &xDstMaxex, &yDstMaxex);
-
-   for (yDst = 0, prgbadataDst = prgbaDataNew;
-      yDst < yDstMaxex;
-      yDst++
-   )
+   PlanarImage piSrc;      // Original image.
+   PlanarImage piDst;      // Scaled image.
+   PlanarKey   key;        // Which pixels are transparent.
+   BOOL        fScaled;
+
+   key.kind  = (int)tkTransparency;
+   key.alpha = (uint8)AlphaT;
+   key.red   = (uint8)RedT;
+   key.green = (uint8)GreenT;
+   key.blue  = (uint8)BlueT;
+
+   if (!Planar_Create (&piSrc, Width, Height))
    {
-      for (xDst = 0; xDst < xDstMaxex; xDst++, prgbadataDst++)
-      {
-         float xCrnt, xNext;     // xCrnt = index into leftmost position in source span.
-                                 // xNext = index info leftmost position of next source span on same line.
-         float yCrnt, yNext;
-         int xSrc, ySrc;
-         int xFirst, xLast;     // First and last src pixel to consider in generating dst pixel.
-         int yFirst, yLast;
-         RGBADATA *prgbaLineSrc;  // Source line ptr. 
-         RGBADATA *prgbadataSrc;  // Source pixel data ptr.
-         float NonPixels;		// Pixels off edge of image.
-         float TransPixels;	// Transparent pixels
-
-         /*
-         ** Figure out start position of current and next dst pixels in 
-         ** fractional src coordinates.
-         */
-         xCrnt = xDst * dxStep;
-         xNext = xCrnt + dxStep;
-         yCrnt = yDst * dyStep;
-         yNext = yCrnt + dyStep;
-
-         /*
-         ** Figure out integer span of pixel indexes in src coordinates that covers all src 
-         ** pixels that are part of the current dst pixel.
-         */
-         xFirst = (int)floor(xCrnt);
-         xLast = (int)ceil(xNext) - 1;
-         yFirst = (int)floor(yCrnt);
-         yLast = (int)ceil(yNext) - 1;
-
-         // Clear accumulators.
-         Red = (float)0.0;
-         Green = (float)0.0;
-         Blue = (float)0.0;
-         Alpha = (float)0.0;
-
-         NonPixels = TransPixels = (float)0.0;
-         // Walk over src pixels adding as much of them as is in the dst pixel to the accumulators.
-         for ( ySrc = yFirst,
-                  prgbaLineSrc = prgbaData +
-                     (yFirst * Width) + xFirst,
-                  prgbadataSrc = prgbaLineSrc;
-               ySrc <= yLast;
-               ySrc++,
-                  prgbaLineSrc += Width,
-                  prgbadataSrc = prgbaLineSrc
-         )
-         {
-            float yAliasFactor;
-
-            yAliasFactor = (float)1.0;
-            if ((float)ySrc < yCrnt)
-            {
-               yAliasFactor = (float)ySrc + (float)1.0 - yCrnt;
-            }
-            else if ((float)ySrc + (float)1.0 >= yNext)
-            {
-               yAliasFactor = yNext - (float)ySrc;
-            }
+      RETURN FALSE;
+   }
+   Planar_FromRGBA (&piSrc, (uint8 *)prgbaData);
 
-            for (xSrc = xFirst; xSrc <= xLast; xSrc++, prgbadataSrc++)
-            {
-               float xAliasFactor, AliasFactor;
-
-               xAliasFactor = (float)1.0;
-               if ((float)xSrc < xCrnt)
-               {
-                  xAliasFactor = (float)xSrc + (float)1.0 - xCrnt;
-               }
-               else if ((float)xSrc + (float)1.0 >= xNext)
-               {
-                  xAliasFactor = xNext - (float)xSrc;
-               }
-               AliasFactor = xAliasFactor * yAliasFactor;
-
-               // Only add pixel if is in src image (i.e. not off right or bottom edge).
-               if (xSrc < Width && ySrc < Height)
-               {
-					// And Only add non transparent pixels to color components.
-					 switch (tkTransparency) {
-					 case tkNone:
-						break;
-					 case tkAlphaLow:
-						if (prgbadataSrc->Alpha <= AlphaT)
-						{
-						   TransPixels += AliasFactor;
-						   Alpha += ((float)prgbadataSrc->Alpha)*AliasFactor;
-						 continue;
-						}
-						break;
-					 case tkAlphaHigh:
-						if (prgbadataSrc->Alpha >= AlphaT) 
-						{
-						   TransPixels += AliasFactor;
-						   Alpha += ((float)prgbadataSrc->Alpha)*AliasFactor;
-						   continue;
-						}
-						break;
-					 case tkRGB:
-						#if 1
-						if (prgbadataSrc->Red == RedT && prgbadataSrc->Green == GreenT && prgbadataSrc->Blue == BlueT) 
-						{
-						   TransPixels += AliasFactor;
-						   Alpha += ((float)prgbadataSrc->Alpha)*AliasFactor;
-						   continue;
-						}
-						#endif
-						break;
-					 } // Transparency kind switch
-				
-                  /* Add the AliasFactored RGBA values into accumulator */
-                  Red += ((float)prgbadataSrc->Red)*AliasFactor;
-                  Green += ((float)prgbadataSrc->Green)*AliasFactor;
-                  Blue += ((float)prgbadataSrc->Blue)*AliasFactor;
-                  Alpha += ((float)prgbadataSrc->Alpha)*AliasFactor;
-               }
-               else
-               {
-                  NonPixels += AliasFactor;
-               }
-            }
-         }
-         {
-            float ActualArea, ActualAlphaArea;
-			 ActualAlphaArea = dxyArea - NonPixels;
-            ActualArea = ActualAlphaArea - TransPixels;
-            prgbadataDst->Red   = (UINT8)round(Red   / ActualArea);
-            prgbadataDst->Green = (UINT8)round(Green / ActualArea);
-            prgbadataDst->Blue  = (UINT8)round(Blue  / ActualArea);
-            prgbadataDst->Alpha = (UINT8)round(Alpha / ActualAlphaArea);
-			 if (tkRGB == tkTransparency && prgbadataDst->Alpha <= (float)127.0)
-			 {
-				 prgbadataDst->Red   = (UINT8)RedT;
-				 prgbadataDst->Green = (UINT8)GreenT;
-				 prgbadataDst->Blue  = (UINT8)BlueT;
-			 }
-         }
-      }
+   fScaled = Planar_Scale (&piDst, &piSrc, xin, xout, yin, yout, &key);
+   Planar_Destroy (&piSrc);
+   if (fScaled)
+   {
+      Planar_ToRGBA ((uint8 *)prgbaDataNew, &piDst);
+      Planar_Destroy (&piDst);
    }
 
-} ENDPROC (ScaleGFF)
+   RETURN fScaled;
+} ENDFUNC (ScaleGFF)
 
 /*************************************************************************
                            NewSizeOfScaledRGBA
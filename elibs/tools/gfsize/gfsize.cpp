@@ -412,7 +412,7 @@ BEGINFUNCMAIN(main)
             pgff->pchunkggff->Data.Height = (UINT16)HeightNew;
          }
          
-         WriteGFF (ARG(OutFile), pgff);      
+         WriteGFFEx (ARG(OutFile), pgff, GFFWRITE_COMPRESS);      
       }
    }
    RETURN EXIT_SUCCESS;
@@ -90,6 +90,7 @@ enum {
    NDX_YStart,
    NDX_Width,
    NDX_Height,
+   NDX_RLE,
 };
 #define ARG(name) (newargs [NDX_ ## name])
 #define qprintf(arg_list)  (!ARG(Quiet)) ? EL_printf arg_list : NULL
@@ -116,6 +117,9 @@ ArgSpec Template[] = {
    {CHRKEYWORD_ARG,              "H",	   
       "\t-H<height>   Height of sub image in infile to translate (Default = infile image height - Y start coordinate).\n"
    ,},
+   {CHRSWITCH_ARG,               "R",
+      "\t-R           RLE compress OUTFILE if its format can be (tga).\n"
+   ,},
    
    {0, NULL, NULL, },
 };
@@ -203,7 +207,7 @@ BEGINFUNCMAIN(main)
                b32->height = height;
             }
                
-				Write32BitPicture (ARG(OutFile), b32);
+				Write32BitPictureEx (ARG(OutFile), b32, ARG(RLE) ? PICWRITE_RLE : 0);
 			}
         else
         {